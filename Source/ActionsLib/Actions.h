@@ -48,6 +48,8 @@ template <typename ElemType>
 void DoCrossValidate(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteOutput(const ConfigParameters& config);
+template <typename ElemType>
+void DoBeamSearch(const ConfigParameters& config);
 
 // misc (OtherActions.cpp)
 template <typename ElemType>
@@ -55,6 +57,8 @@ void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config);
+template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
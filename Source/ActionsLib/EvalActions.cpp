@@ -17,6 +17,8 @@
 #include "Config.h"
 #include "SimpleEvaluator.h"
 #include "SimpleOutputWriter.h"
+#include "BeamSearchDecoder.h"
+#include "InputAndParamNodes.h"
 #include "Criterion.h"
 #include "BestGpu.h"
 #include "ScriptableObjects.h"
@@ -257,3 +259,157 @@ void DoWriteOutput(const ConfigParameters& config)
 
 template void DoWriteOutput<float>(const ConfigParameters& config);
 template void DoWriteOutput<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoBeamSearch() - implements CNTK "beamSearch" command
+// ===========================================================================
+
+// Looks up a symbol by its label if a label mapping is given, otherwise parses it as a token index.
+static size_t SymbolIndex(const string& symbol, const vector<string>& labelMapping)
+{
+    if (!labelMapping.empty())
+    {
+        let iter = find(labelMapping.begin(), labelMapping.end(), symbol);
+        if (iter == labelMapping.end())
+            InvalidArgument("beamSearch command: Symbol '%s' is not in the label mapping file.", symbol.c_str());
+        return iter - labelMapping.begin();
+    }
+    return (size_t) stoul(symbol);
+}
+
+// Turns a trained sequence-to-sequence network into a step-wise decoder:
+//  - the decoder input nodes (e.g. the previous label, or its embedding) are replaced by a new sparse token input
+//    'beamSearchToken', optionally embedded with the given [V x E] embedding parameter
+//  - the decoder context nodes (e.g. the thought vector broadcast along the label axis) are replaced by new inputs
+//    that receive the final encoder outputs
+// All new inputs share the new dynamic axis 'beamSearchAxis', with one time step per decoding step.
+template <typename ElemType>
+static ComputationNodeBasePtr CreateBeamSearchInputs(ComputationNetworkPtr net, const vector<wstring>& decoderInputNodeNames, const wstring& embeddingNodeName,
+                                                     const vector<wstring>& contextNodeNames, vector<ComputationNodeBasePtr>& newContextNodes)
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    const wstring axisName = L"beamSearchAxis";
+
+    size_t vocabSize = net->GetNodeFromName(decoderInputNodeNames.front())->GetSampleLayout().GetNumElements();
+    ComputationNodePtr embedding;
+    if (!embeddingNodeName.empty())
+    {
+        embedding = dynamic_pointer_cast<ComputationNode<ElemType>>(net->GetNodeFromName(embeddingNodeName));
+        vocabSize = embedding->GetSampleLayout()[0];
+    }
+
+    net->AddNodeToNetWithElemType(New<DynamicAxisNode<ElemType>>(net->GetDeviceId(), axisName));
+    ComputationNodePtr token = builder.CreateSparseInputNode(L"beamSearchToken", TensorShape(vocabSize), axisName);
+    ComputationNodePtr decoderInput = embedding ? builder.TransposeTimes(embedding, token, L"beamSearchTokenEmbedded") : token;
+    for (let& name : decoderInputNodeNames)
+        net->ReplaceLeafNode(name, decoderInput);
+    for (let& name : contextNodeNames)
+    {
+        let oldNode = net->GetNodeFromName(name);
+        let newNode = builder.CreateInputNode(L"beamSearchContext." + name, oldNode->GetSampleLayout(), axisName);
+        net->ReplaceLeafNode(name, newNode);
+        newContextNodes.push_back(newNode);
+    }
+    return token;
+}
+
+template <typename ElemType>
+void DoBeamSearch(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("randomize", "None");
+    DataReader dataReader(readerConfig);
+
+    ConfigArray minibatchSize = config(L"minibatchSize", "2048");
+    intargvector mbSize = minibatchSize;
+
+    vector<wstring> unusedOutputNodeNames;
+    let net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"outputNodeNames", unusedOutputNodeNames);
+
+    wstring scoreNodeName = config(L"scoreNodeName");
+    stringargvector decoderInputNodeNames = config(L"decoderInputNodeNames");
+    wstring embeddingNodeName = config(L"embeddingNodeName", L"");
+    stringargvector encoderOutputNodeNames = config(L"encoderOutputNodeNames");
+    stringargvector contextNodeNames = config(L"contextNodeNames");
+    if (encoderOutputNodeNames.size() != contextNodeNames.size())
+        InvalidArgument("beamSearch command: 'encoderOutputNodeNames' and 'contextNodeNames' must have the same number of entries.");
+
+    vector<string> labelMapping;
+    wstring labelMappingFile = config(L"labelMappingFile", L"");
+    if (!labelMappingFile.empty())
+        File::LoadLabelFile(labelMappingFile, labelMapping);
+
+    BeamSearchOptions options;
+    options.beamSize = config(L"beamSize", (size_t) 5);
+    options.lengthNormalization = config(L"lengthNormalization", 0.0);
+    options.startSymbol = SymbolIndex(config(L"startSymbol"), labelMapping);
+    options.endSymbol = SymbolIndex(config(L"endSymbol"), labelMapping);
+    options.maxLength = config(L"maxLength", (size_t) 100);
+
+    // rewire the network, then evaluate the encoder outputs and the scores
+    vector<ComputationNodeBasePtr> contextNodes;
+    let tokenNode = CreateBeamSearchInputs<ElemType>(net, decoderInputNodeNames, embeddingNodeName, contextNodeNames, contextNodes);
+    let scoreNode = net->GetNodeFromName(scoreNodeName);
+    let encoderOutputNodes = net->OutputNodesByName(encoderOutputNodeNames);
+    net->AddToNodeGroup(L"output", scoreNode);
+    for (let& node : encoderOutputNodes)
+        net->AddToNodeGroup(L"output", node);
+    net->CompileNetwork();
+    vector<ComputationNodeBasePtr> outputNodes = encoderOutputNodes;
+    outputNodes.push_back(scoreNode);
+    net->AllocateAllMatrices({}, outputNodes, nullptr);
+
+    BeamSearchDecoder<ElemType> decoder(net, scoreNode, tokenNode, contextNodes, options);
+
+    // the reader feeds the encoder
+    let inputNodes = net->InputNodesForOutputs(encoderOutputNodeNames);
+    StreamMinibatchInputs inputMatrices = DataReaderHelpers::RetrieveInputMatrices(inputNodes);
+
+    wstring outputPath = config(L"outputPath");
+    File::MakeIntermediateDirs(outputPath);
+    File outputFile(outputPath, fileOptionsWrite | fileOptionsText);
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    dataReader.StartMinibatchLoop(mbSize[0], 0, requestDataSize);
+    net->StartEvaluateMinibatchLoop(outputNodes);
+    size_t actualMBSize;
+    size_t numSequencesDecoded = 0;
+    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, net, nullptr, false, false, inputMatrices, actualMBSize, nullptr))
+    {
+        ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+        vector<shared_ptr<Matrix<ElemType>>> contexts;
+        size_t numSequences = 0;
+        for (let& node : encoderOutputNodes)
+        {
+            net->ForwardProp(node);
+            contexts.push_back(BeamSearchDecoder<ElemType>::LastFrameOfEachSequence(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(), node->GetMBLayout()));
+            numSequences = contexts.back()->GetNumCols();
+        }
+
+        // one line per input sequence with the best hypothesis, without start and end symbols
+        for (let& hypotheses : decoder.Decode(contexts, numSequences))
+        {
+            string line;
+            if (!hypotheses.empty())
+            {
+                for (size_t token : hypotheses.front().tokens)
+                {
+                    if (token == options.endSymbol)
+                        break;
+                    if (!line.empty())
+                        line += " ";
+                    line += labelMapping.empty() ? to_string(token) : labelMapping[token];
+                }
+            }
+            fprintfOrDie(outputFile, "%s\n", line.c_str());
+        }
+        numSequencesDecoded += numSequences;
+        dataReader.DataEnd();
+    }
+    outputFile.Flush();
+    fprintf(stderr, "beamSearch: Decoded %d sequences into %ls.\n", (int) numSequencesDecoded, outputPath.c_str());
+}
+
+template void DoBeamSearch<float>(const ConfigParameters& config);
+template void DoBeamSearch<double>(const ConfigParameters& config);
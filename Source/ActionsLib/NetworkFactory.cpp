@@ -171,8 +171,11 @@ ComputationNetworkPtr GetModelFromConfig(const ConfigRecordType& config, const w
 
         // We don't use CreateFromFile() here since the user might specify OutputNodeNames in the config.
         // By not compiling the network before patching, we avoid double log output for validation.
+        // memoryMapModel: use the parameters in place from the (shared, read-only) file mapping instead of reading them; for evaluation on the CPU only
+        bool memoryMapModel = config(L"memoryMapModel", false);
+
         net = make_shared<ComputationNetwork>(deviceId);
-        net->Read<ElemType>(modelPath);
+        net->Read<ElemType>(modelPath, memoryMapModel);
         if (outputNodeNames.size() > 0)
             PatchOutputNodes(net, outputNodeNames, outputNodeNamesVector);
         net->CompileNetwork();
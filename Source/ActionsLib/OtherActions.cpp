@@ -203,6 +203,50 @@ void DoParameterSVD(const ConfigParameters& config)
 template void DoParameterSVD<float>(const ConfigParameters& config);
 template void DoParameterSVD<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoOptimizeForInference() - implements CNTK "optimize" command
+// ===========================================================================
+
+//////////////////////////////////////////////////////////////////////////
+//  for action optimize
+//      An action "optimize" rewrites a trained model for inference (see ComputationNetwork::OptimizeForInference()):
+//      it removes what is only needed for training, computes what only depends on parameters,
+//      folds BatchNormalization into the preceding weights, and optionally fuses chains of elementwise operations.
+//      The result is a normal model with the same output node names.
+//
+//      To use this command,
+//          user need to specify:
+//                  1)  modelPath           -- path to the existing model
+//                  2)  outputModelPath     -- where to write the optimized model
+//                  3)  outputNodeNames     -- (optional) the nodes to keep computing; default: the model's output nodes
+//                  4)  fuseElementwise     -- (optional) fuse chains of elementwise operations; default: false.
+//                                             The result can then only be evaluated by the cntk executable and the
+//                                             V1 eval interface, and neither be trained nor loaded by the V2 library.
+//
+//////////////////////////////////////////////////////////////////////////
+template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceID = -1; // the rewrite computes on the CPU; the result can be loaded on any device
+    wstring modelPath = config(L"modelPath");
+    wstring outputModelPath = config(L"outputModelPath");
+    ConfigArray outputNodeNames = config(L"outputNodeNames", ConfigArray(""));
+    bool fuseElementwise = config(L"fuseElementwise", false);
+
+    vector<wstring> outputNodeNamesVector;
+    for (wstring name : outputNodeNames)
+        outputNodeNamesVector.push_back(name);
+
+    ComputationNetwork net(deviceID);
+    net.Load<ElemType>(modelPath);
+
+    net.OptimizeForInference<ElemType>(outputNodeNamesVector, fuseElementwise);
+    net.Save(outputModelPath);
+}
+
+template void DoOptimizeForInference<float>(const ConfigParameters& config);
+template void DoOptimizeForInference<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoWriteWordAndClassInfo() - implements CNTK "writeWordAndClass" command
 // ===========================================================================
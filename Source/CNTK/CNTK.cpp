@@ -22,6 +22,7 @@
 #include "NDLNetworkBuilder.h"
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
+#include "CPUTensorKernels.h"
 #include "GPUMatrix.h" // used for SyncGuard::EnableSync()
 #include "CommonMatrix.h"
 #include "SGD.h"
@@ -172,6 +173,28 @@ static void DisableLegacyUsage(const ConfigParameters& TopLevelConfig, const Con
     }
 }
 
+// configure the vectorized CPU TensorOp kernels
+//  - useVectorizedCPUKernels: if false, use the generic loops only (for comparison)
+//  - reductionPrecision: how vectorized reductions accumulate sums: double (default, like the generic loops),
+//    elemType (faster, but results differ in the last bits), or compensated (Kahan summation in ElemType)
+template <class ConfigRecordType>
+static void SetCPUTensorKernelOptions(const ConfigRecordType& config)
+{
+    if (!config(L"useVectorizedCPUKernels", true))
+        CPUTensorKernels::SetInstructionSet(CPUInstructionSet::None);
+    wstring precision = config(L"reductionPrecision", L"double");
+    if (EqualCI(precision, L"elemType"))
+        CPUTensorKernels::SetReductionPrecision(CPUReductionPrecision::ElemType);
+    else if (EqualCI(precision, L"compensated"))
+        CPUTensorKernels::SetReductionPrecision(CPUReductionPrecision::Compensated);
+    else if (EqualCI(precision, L"double"))
+        CPUTensorKernels::SetReductionPrecision(CPUReductionPrecision::Double);
+    else
+        InvalidArgument("reductionPrecision: '%ls' is not one of 'double', 'elemType' or 'compensated'.", precision.c_str());
+    LOGPRINTF(stderr, "CPU tensor kernels: %s, %s reductions.\n", CPUTensorKernels::InstructionSetName(CPUTensorKernels::GetInstructionSet()),
+              CPUTensorKernels::ReductionPrecisionName(CPUTensorKernels::GetReductionPrecision()));
+}
+
 // When running in parallel with MPI, only commands in 'commandstoRunOnAllRanks' should
 // be run in parallel across multiple ranks. Others should only run on rank 0
 const std::set<std::string> commandstoRunOnAllRanks = { "train", "trainRNN", "adapt", "test", "eval", "cv", "devtest" };
@@ -190,6 +213,8 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
         LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
     }
 
+    SetCPUTensorKernelOptions(config);
+
     bool progressTracing = config(L"progressTracing", false);
 
     // temporary hack to prevent users from failing due to a small breaking change related to the "truncated" flag (will be redone bigger and better some day)
@@ -283,6 +308,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoWriteOutput<ElemType>(commandParams);
                 }
+                else if (thisAction == "beamSearch")
+                {
+                    DoBeamSearch<ElemType>(commandParams);
+                }
                 else if (thisAction == "devtest")
                 {
                     TestCn<ElemType>(config); // for "devtest" action pass the root config instead
@@ -315,6 +344,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoParameterSVD<ElemType>(commandParams);
                 }
+                else if (thisAction == "optimize")
+                {
+                    DoOptimizeForInference<ElemType>(commandParams);
+                }
                 else
                 {
                     RuntimeError("unknown action: %s  in command set: %s", thisAction.c_str(), command[i].c_str());
@@ -568,6 +601,8 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     if (numCPUThreads > 0)
         LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
 
+    SetCPUTensorKernelOptions(config);
+
     bool progressTracing = config(L"progressTracing", false);
     size_t fullTotalMaxEpochs = 1; // BUGBUG: BS does not allow me to read out the max epochs parameters, as that would instantiate and thus execute the objects
 
@@ -59,6 +59,7 @@ enum MELProperty
     melPropFinalCriterion,
     melPropEvaluation,
     melPropOutput,
+    melPropQuantizedInference,
     melPropRecurrent
 };
 
@@ -411,6 +412,7 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         else if (EqualInsensitive(propName, "label"))                  prop = melPropLabel;
         else if (EqualInsensitive(propName, "learningRateMultiplier")) prop = melPropLearningRateMultiplier;
         else if (EqualInsensitive(propName, "output"))                 prop = melPropOutput;
+        else if (EqualInsensitive(propName, "quantizedInference"))     prop = melPropQuantizedInference;
         else if (EqualInsensitive(propName, "recurrent"))              prop = melPropRecurrent;
         else InvalidArgument("Invalid property, %s, is not supported", propName.c_str());
 
@@ -466,6 +468,18 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
                 SetGroupTag(node, cn, L"output", set);
                 break;
             }
+            case melPropQuantizedInference:
+            {
+                auto quantizableNode = dynamic_pointer_cast<IQuantizableNode>(node);
+                if (!quantizableNode)
+                {
+                    fprintf(stderr, "WARNING: Node %ls (%ls operation) does not support quantized inference. Skipping this node.\n",
+                            node->NodeName().c_str(), node->OperationName().c_str());
+                    break;
+                }
+                quantizableNode->SetQuantizedInference((bool)params[2]);
+                break;
+            }
             case melPropRecurrent:
             {
                 // what to do here?
@@ -496,6 +510,10 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         {
             prop = melPropLearningRateMultiplier;
         }
+        else if (EqualInsensitive(propName, "quantizedInference"))
+        {
+            prop = melPropQuantizedInference;
+        }
         else
         {
             RuntimeError("Invalid property, %s, is not supported", propName.c_str());
@@ -524,6 +542,11 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
                 netNdl->cn->SetLearnableNodesBelowLearningRateMultiplier(learningRateMultiplier, node);
                 break;
             }
+            case melPropQuantizedInference:
+            {
+                netNdl->cn->SetQuantizedInference((bool)params[2], node);
+                break;
+            }
             default:
             {
                 RuntimeError("Invalid property, %s, is not supported", propName.c_str());
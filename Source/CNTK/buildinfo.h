@@ -0,0 +1,13 @@
+#ifndef _BUILDINFO_H
+#define _BUILDINFO_H
+#define _GIT_EXIST
+#define _MATHLIB_ "openblas"
+#define _BUILDSHA1_ "435316c99b93bfccafd4ff40dc2a33238dd51fee (modified)"
+#define _BUILDBRANCH_ "master"
+#define _BUILDTARGET_ "CPU-only"
+#define _BUILDTYPE_ "release"
+#define _WITH_1BITSGD_ "no"
+#define _BUILDER_ ""
+#define _BUILDMACHINE_ "vm"
+#define _BUILDPATH_ "/root/repo"
+#endif
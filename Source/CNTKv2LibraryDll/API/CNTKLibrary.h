@@ -1519,6 +1519,15 @@ namespace CNTK
     ///
     CNTK_API FunctionPtr FutureValue(const Variable& initialState, const Variable& operand, size_t stepSize, const std::wstring& name = L"");
 
+    ///
+    /// Create an instance of the CNTK built-in fused recurrent operation that runs a stack of 'numLayers' unidirectional LSTM or GRU layers
+    /// (recurrentOp = L"lstm" or L"gru") of dimension 'hiddenSize' over the lone dynamic axis of the specified operand.
+    /// All parameters are packed into 'weights' of shape [G*hiddenSize x C], with G = 4 for LSTM and 3 for GRU, and each layer owning a
+    /// column block [Wx | Wh | b], i.e. C = operandDim + hiddenSize + 1 + (numLayers - 1) * (2 * hiddenSize + 1).
+    /// Currently only supported on the CPU.
+    ///
+    CNTK_API FunctionPtr RNNStack(const Variable& weights, const Variable& operand, size_t hiddenSize, size_t numLayers = 1, const std::wstring& recurrentOp = L"lstm", const std::wstring& name = L"");
+
 
     ///
     /// Create an instance of the CNTK built-in sum reduction operation on specified tensor input operand along all the axes
@@ -1545,6 +1554,19 @@ namespace CNTK
     template <typename ElementType>
     CNTK_API void SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile);
 
+    ///
+    /// Beam search over the recurrent 'decoder' Function, whose output 'scores' holds the unnormalized scores of the next token, given the one-hot
+    /// 'previousToken' input and the 'contexts' inputs, of which only the last step of each sequence is used (e.g. the final encoder state).
+    /// All hypotheses of all sequences are advanced together, one step at a time, and the recurrent state is carried over instead of recomputing each prefix.
+    /// Hypotheses are ranked by log probability / length^lengthNormalization. Returns the best token sequence for each sequence of the contexts,
+    /// without the start symbol, and ending in the end symbol unless 'maxLength' was reached.
+    ///
+    template <typename ElementType>
+    CNTK_API std::vector<std::vector<size_t>> BeamSearchDecode(const FunctionPtr& decoder, const Variable& scores, const Variable& previousToken,
+                                                               const std::unordered_map<Variable, ValuePtr>& contexts, size_t beamSize, double lengthNormalization,
+                                                               size_t startSymbol, size_t endSymbol, size_t maxLength,
+                                                               const DeviceDescriptor& computeDevice = DeviceDescriptor::DefaultDevice());
+
     ///
     /// A serializable value represents one of:
     /// a) Boolean
@@ -13,6 +13,7 @@
 #include "NonlinearityNodes.h"
 #include "LinearAlgebraNodes.h"
 #include "RecurrentNodes.h"
+#include "RNNNodes.h"
 #include "EvaluationNodes.h"
 #include "TrainingNodes.h"
 
@@ -139,6 +140,14 @@ namespace CNTK
                 opType = PrimitiveOpType::ElementTimes;
             else if (node->OperationName() == OperationNameOf(SumElementsNode))
                 opType = PrimitiveOpType::ReduceSum;
+            else if (node->OperationName() == OperationNameOf(RNNStackNode))
+            {
+                auto rnnStackNode = node->As<RNNStackNode<ElementType>>();
+                primitiveFunctionConfigParameters[L"hiddenSize"] = DictionaryValue(rnnStackNode->HiddenSize());
+                primitiveFunctionConfigParameters[L"numLayers"] = DictionaryValue(rnnStackNode->NumLayers());
+                primitiveFunctionConfigParameters[L"recurrentOp"] = DictionaryValue(rnnStackNode->RecurrentOp());
+                opType = PrimitiveOpType::RNNStack;
+            }
             else
                 LogicError("Unsupported ComputationNode with OperationName='%S' found when loading legacy CNTK model", node->OperationName().c_str());
 
@@ -10,6 +10,7 @@
 #include "Utils.h"
 #include "ComputationNode.h"
 #include "ReshapingNodes.h"
+#include "BeamSearchDecoder.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -291,6 +292,16 @@ namespace CNTK
 
                 break;
             }
+            case PrimitiveOpType::RNNStack:
+            {
+                auto& functionConfig = primitiveFunction->FunctionConfig();
+                computationNodePtr = builder.RNNStack(input0Node, input1Node,
+                                                      functionConfig[L"hiddenSize"].GetValue<size_t>(),
+                                                      functionConfig[L"numLayers"].GetValue<size_t>(),
+                                                      functionConfig[L"recurrentOp"].GetValue<std::wstring>(),
+                                                      function->Name());
+                break;
+            }
             case PrimitiveOpType::ReduceSum:
             {
                 // TODO: Use the new ReduceElements node instead of the legacy SumElements node for reduction. Currently ReduceElements has incorrect MBLayout inference.
@@ -1085,6 +1096,21 @@ namespace CNTK
         return BinaryOp(PrimitiveOpType::FutureValue, initialState, operand, std::move(additionalProperties), name);
     }
 
+    FunctionPtr RNNStack(const Variable& weights, const Variable& operand, size_t hiddenSize, size_t numLayers/* = 1*/, const std::wstring& recurrentOp/* = L"lstm"*/, const std::wstring& name/* = L""*/)
+    {
+        if ((recurrentOp != L"lstm") && (recurrentOp != L"gru"))
+            InvalidArgument("RNNStack: recurrentOp must be 'lstm' or 'gru'");
+
+        if ((hiddenSize == 0) || (numLayers == 0))
+            InvalidArgument("RNNStack: hiddenSize and numLayers must be positive");
+
+        auto additionalProperties = Dictionary();
+        additionalProperties[L"hiddenSize"] = DictionaryValue(hiddenSize);
+        additionalProperties[L"numLayers"] = DictionaryValue(numLayers);
+        additionalProperties[L"recurrentOp"] = DictionaryValue(recurrentOp);
+        return BinaryOp(PrimitiveOpType::RNNStack, weights, operand, std::move(additionalProperties), name);
+    }
+
     FunctionPtr ReduceSum(const Variable& operand, const std::wstring& name/* = L""*/)
     {
         return UnaryOp(PrimitiveOpType::ReduceSum, operand, Dictionary(), name);
@@ -1106,4 +1132,65 @@ namespace CNTK
 
         return CompositeFunction::Create(MakeSharedObject<PrimitiveFunction>(PrimitiveOpType::Combine, inputs, Dictionary(), name), name);
     }
+
+    template <typename ElementType>
+    std::vector<std::vector<size_t>> BeamSearchDecode(const FunctionPtr& decoder, const Variable& scores, const Variable& previousToken,
+                                                      const std::unordered_map<Variable, ValuePtr>& contexts, size_t beamSize, double lengthNormalization,
+                                                      size_t startSymbol, size_t endSymbol, size_t maxLength, const DeviceDescriptor& computeDevice)
+    {
+        CompositeFunction* compositeFunction = dynamic_cast<CompositeFunction*>(decoder.get());
+        if (compositeFunction == nullptr)
+            InvalidArgument("BeamSearchDecode: The decoder must be a composite Function");
+
+        auto outputs = decoder->Outputs();
+        if (std::find(outputs.begin(), outputs.end(), scores) == outputs.end())
+            InvalidArgument("BeamSearchDecode: The scores Variable must be an output of the decoder Function");
+
+        auto network = compositeFunction->GetComputationNetwork<ElementType>(computeDevice, {});
+        auto& variableToNodeMap = compositeFunction->m_variableToNodeMap;
+        if (variableToNodeMap.find(previousToken) == variableToNodeMap.end())
+            InvalidArgument("BeamSearchDecode: The previous token Variable must be an input of the decoder Function");
+
+        // only the last step of each context sequence is used
+        std::vector<ComputationNodeBasePtr> contextNodes;
+        std::vector<std::shared_ptr<Matrix<ElementType>>> contextValues;
+        size_t numSequences = 0;
+        for (const auto& context : contexts)
+        {
+            if (variableToNodeMap.find(context.first) == variableToNodeMap.end())
+                InvalidArgument("BeamSearchDecode: Each context Variable must be an input of the decoder Function");
+            contextNodes.push_back(variableToNodeMap.at(context.first));
+
+            auto matrixAndLayout = CompositeFunction::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(context.first, context.second);
+            auto matrix = std::make_shared<Matrix<ElementType>>(matrixAndLayout.first->DeepClone());
+            if (matrixAndLayout.second)
+                matrix = BeamSearchDecoder<ElementType>::LastFrameOfEachSequence(*matrix, matrixAndLayout.second);
+            matrix->TransferToDeviceIfNotThere(AsCNTKImplDeviceId(computeDevice), true);
+            if (!contextValues.empty() && matrix->GetNumCols() != numSequences)
+                InvalidArgument("BeamSearchDecode: All contexts must have the same number of sequences");
+            numSequences = matrix->GetNumCols();
+            contextValues.push_back(matrix);
+        }
+
+        BeamSearchOptions options;
+        options.beamSize = beamSize;
+        options.lengthNormalization = lengthNormalization;
+        options.startSymbol = startSymbol;
+        options.endSymbol = endSymbol;
+        options.maxLength = maxLength;
+        BeamSearchDecoder<ElementType> beamSearch(network, variableToNodeMap.at(scores), variableToNodeMap.at(previousToken), contextNodes, options);
+
+        std::vector<std::vector<size_t>> bestTokens;
+        for (const auto& hypotheses : beamSearch.Decode(contextValues, numSequences))
+            bestTokens.push_back(hypotheses.empty() ? std::vector<size_t>() : hypotheses.front().tokens);
+        return bestTokens;
+    }
+
+    // Template instantiations
+    template CNTK_API std::vector<std::vector<size_t>> BeamSearchDecode<float>(const FunctionPtr& decoder, const Variable& scores, const Variable& previousToken,
+                                                                               const std::unordered_map<Variable, ValuePtr>& contexts, size_t beamSize, double lengthNormalization,
+                                                                               size_t startSymbol, size_t endSymbol, size_t maxLength, const DeviceDescriptor& computeDevice);
+    template CNTK_API std::vector<std::vector<size_t>> BeamSearchDecode<double>(const FunctionPtr& decoder, const Variable& scores, const Variable& previousToken,
+                                                                                const std::unordered_map<Variable, ValuePtr>& contexts, size_t beamSize, double lengthNormalization,
+                                                                                size_t startSymbol, size_t endSymbol, size_t maxLength, const DeviceDescriptor& computeDevice);
 }
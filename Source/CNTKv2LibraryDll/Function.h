@@ -42,6 +42,7 @@ namespace CNTK
         PastValue,
         FutureValue,
         ReduceSum,
+        RNNStack,
         Combine,
     };
 }
@@ -89,6 +90,7 @@ namespace CNTK
             { PrimitiveOpType::PastValue, "PastValue" },
             { PrimitiveOpType::FutureValue, "FutureValue" },
             { PrimitiveOpType::ReduceSum, "ReduceSum" },
+            { PrimitiveOpType::RNNStack, "RNNStack" },
             { PrimitiveOpType::Combine, "Combine" }
         };
 
@@ -102,7 +104,7 @@ namespace CNTK
     {
     public:
         PrimitiveFunction(PrimitiveOpType op, const std::vector<Variable>& inputs, Dictionary&& functionConfig, const std::wstring& functionName = L"")
-            : Function(inputs, GetOutputVariables(op, inputs, this), nullptr, functionName), m_op(op), m_functionConfig(std::move(functionConfig))
+            : Function(inputs, GetOutputVariables(op, inputs, this, functionConfig), nullptr, functionName), m_op(op), m_functionConfig(std::move(functionConfig))
         {
         }
 
@@ -210,7 +212,7 @@ namespace CNTK
         }
 
         // TODO: Reconcile this with the ComputationNode::Validate functionality in core CNTK to avoid duplication of inference logic
-        static std::vector<Variable> GetOutputVariables(PrimitiveOpType op, const std::vector<Variable>& inputs, Function* owner)
+        static std::vector<Variable> GetOutputVariables(PrimitiveOpType op, const std::vector<Variable>& inputs, Function* owner, const Dictionary& functionConfig)
         {
             std::vector<Variable> outputs;
 
@@ -303,6 +305,17 @@ namespace CNTK
                 outputs.push_back(Variable(ReductionOpOutputShape(op, inputs[0].Shape(), reductionAxes), outputDataType, owner, reductionOutputDynamicAxes));
                 break;
             }
+            case PrimitiveOpType::RNNStack:
+            {
+                assert(inputs.size() == 2);
+
+                if (inputs[1].Shape().NumAxes() != 1)
+                    InvalidArgument("The operand of the %s operation should have exactly one static axis", PrimitiveOpTypeName(op));
+
+                // the output is the hidden state of the top layer; the dynamic axes are those of the operand, the weights have none
+                outputs.push_back(Variable(NDShape({ functionConfig[L"hiddenSize"].GetValue<size_t>() }), outputDataType, owner, inputs[1].DynamicAxes()));
+                break;
+            }
             case PrimitiveOpType::Combine:
                 outputs = inputs;
                 break;
@@ -350,6 +363,11 @@ namespace CNTK
         template <typename ElementType>
         friend void SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile);
 
+        template <typename ElementType>
+        friend std::vector<std::vector<size_t>> BeamSearchDecode(const FunctionPtr& decoder, const Variable& scores, const Variable& previousToken,
+                                                                 const std::unordered_map<Variable, ValuePtr>& contexts, size_t beamSize, double lengthNormalization,
+                                                                 size_t startSymbol, size_t endSymbol, size_t maxLength, const DeviceDescriptor& computeDevice);
+
     public:
         static CompositeFunctionPtr Create(const FunctionPtr& rootFunction, const std::wstring& name = L"")
         {
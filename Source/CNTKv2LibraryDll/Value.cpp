@@ -97,7 +97,7 @@ namespace CNTK
     {
         size_t numElementsPerSample = sampleShape.TotalSize();
         NDMaskPtr deviceValueMask = CreateMask(numElementsPerSample, sequences, device);
-        size_t maxSequenceLength = (deviceValueMask == nullptr) ? sequences[0].size() : deviceValueMask->Shape()[0];
+        size_t maxSequenceLength = (deviceValueMask == nullptr) ? (sequences[0].size() / numElementsPerSample) : deviceValueMask->Shape()[0];
 
         size_t numSequences = sequences.size();
         NDShape valueDataShape = sampleShape.AppendShape({ maxSequenceLength, numSequences });
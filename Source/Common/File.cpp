@@ -11,6 +11,7 @@
 #include "Basics.h"
 #define FORMAT_SPECIALIZE // to get the specialized version of the format routines
 #include "File.h"
+#include "MemoryMappedFile.h"
 #include <string>
 #include <stdint.h>
 #include <locale>
@@ -82,6 +83,8 @@ void File::Init(const wchar_t* filename, int fileOptions)
 {
     m_filename = filename;
     m_options = fileOptions;
+    m_memoryBuffer = nullptr;
+    m_memoryBufferSize = 0;
     if (m_filename.empty())
         RuntimeError("File: filename is empty");
     const auto outputPipe = (m_filename.front() == '|');
@@ -263,6 +266,7 @@ File::~File(void)
     else if (m_file != stdin && m_file != stdout && m_file != stderr)
     {
         int rc = fclose(m_file);
+        free(m_memoryBuffer); // (only set for in-memory files, which must be closed first)
         if ((rc != 0) && !std::uncaught_exception())
             RuntimeError("File: failed to close file at %S", m_filename.c_str());
     }
@@ -592,6 +596,78 @@ bool File::IsUnicodeBOM(bool skip)
     return found;
 }
 
+// MapIntoMemory - map the file, so that TryGetMappedBlock() can reference blocks of it in place
+void File::MapIntoMemory()
+{
+    const int readOnlyBinary = fileOptionsBinary | fileOptionsRead;
+    if ((m_options & (readOnlyBinary | fileOptionsWrite)) != readOnlyBinary || !CanSeek())
+        LogicError("File: only seekable binary files opened for reading can be memory-mapped ('%ls').", m_filename.c_str());
+
+    if (!m_mapping)
+        m_mapping = make_shared<MemoryMappedFile>(m_filename);
+}
+
+// TryGetMappedBlock - reference the next 'size' bytes in the mapping and skip them
+// returns - pointer into the mapping, which keeps the mapping alive; nullptr if the file is not mapped
+shared_ptr<const char> File::TryGetMappedBlock(size_t size)
+{
+    if (!m_mapping)
+        return nullptr;
+
+    uint64_t pos = GetPosition();
+    if (pos + size > m_mapping->Size())
+        RuntimeError("File: unexpected end of file '%ls'.", m_filename.c_str());
+    SetPosition(pos + size);
+    return shared_ptr<const char>(m_mapping, m_mapping->Data() + pos);
+}
+
+// CreateInMemory - create an anonymous file for writing that lives in memory
+/*static*/ unique_ptr<File> File::CreateInMemory(int fileOptions)
+{
+    if ((fileOptions & fileOptionsReadWrite) != fileOptionsWrite)
+        LogicError("File: in-memory files can only be opened for writing.");
+
+    unique_ptr<File> file(new File());
+    file->m_filename = L"(in memory)";
+    file->m_options = fileOptions;
+    file->m_pcloseNeeded = false;
+    file->m_memoryBuffer = nullptr;
+    file->m_memoryBufferSize = 0;
+#ifdef _WIN32
+    // there is no in-memory FILE on Windows; a temp file that is deleted when closed mostly lives in the file cache
+    file->m_file = tmpfile();
+#else
+    file->m_file = open_memstream(&file->m_memoryBuffer, &file->m_memoryBufferSize);
+#endif
+    file->m_seekable = true; // (so that the content is the same as if written to a regular file, e.g. matrix alignment)
+    if (!file->m_file)
+        RuntimeError("File: failed to create an in-memory file: %s", strerror(errno));
+    return file;
+}
+
+// CopyTo - write the entire content of the file to another file
+void File::CopyTo(FILE* f)
+{
+    Flush(); // (for in-memory files, this also updates m_memoryBuffer and m_memoryBufferSize)
+    if (m_memoryBuffer)
+    {
+        fwriteOrDie(m_memoryBuffer, 1, m_memoryBufferSize, f);
+        return;
+    }
+    if (!CanSeek())
+        LogicError("File: CopyTo() requires an in-memory or seekable file ('%ls').", m_filename.c_str());
+
+    uint64_t pos = GetPosition();
+    SetPosition(0);
+    vector<char> buffer(1 << 20);
+    size_t numRead;
+    while ((numRead = fread(buffer.data(), 1, buffer.size(), m_file)) > 0)
+        fwriteOrDie(buffer.data(), 1, numRead, f);
+    if (ferror(m_file))
+        RuntimeError("File: error reading '%ls': %s", m_filename.c_str(), strerror(errno));
+    SetPosition(pos);
+}
+
 //Size - return the size of the file
 // WARNING: calling this will reset the EOF marker, so do so with care
 size_t File::Size()
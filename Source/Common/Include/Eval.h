@@ -26,6 +26,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <stdexcept>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -37,6 +38,8 @@ public:
     // Load a model based on configuration. The syntax is the same as when calling the cntk executable.
     // e.g. "modelFile=model.dat deviceId=0".
     // numCPUThreads can be used to set the thread count of BLAS.
+    // memoryMapModel=true makes a model on the CPU use its parameters in place from the model file, which is mapped
+    // into memory (read-only, shared by all processes that load the same model), instead of reading them.
     // 
     virtual void Init(const std::string& config) = 0;
 
@@ -296,7 +299,7 @@ class VariableSchema : public std::vector<VariableLayout>
 //
 // Extended interface, allowing for sparse input.
 // Implementation constraints: 
-// - Every output is a single tensor (not a batch), 
+// - Every output is a single tensor, or a batch of tensors when evaluating several sequences at once,
 // - Outputs must be dense.
 // - Output buffer must be preallocated.
 //
@@ -340,6 +343,32 @@ public:
     // (e.g. when vectors are manages by .net)
     // 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) = 0;
+
+    //
+    // ForwardPass - Evaluate a batch of (variable length) sequences in a single forward pass.
+    // inputs[s] and outputs[s] are the input and output buffers of sequence s, as for the single sequence
+    // ForwardPass() above. The sequences are packed into one minibatch (shorter sequences leave gaps), and
+    // the results are split back into the output buffers of the sequence they belong to.
+    // Inputs that share a dynamic axis must have the same number of samples within a sequence.
+    // inputs - vector of input buffers for every sequence
+    // outputs - vector of output buffers for every sequence. Each must be sized to fit the output of its sequence.
+    //
+    virtual void ForwardPass(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) = 0;
+
+    //
+    // Same as above, but takes references to static arrays instead of std::vector 
+    //
+    virtual void ForwardPass(const std::vector<ValueRefs<ElemType>>& inputs, std::vector<ValueRefs<ElemType>>& outputs) = 0;
+
+    //
+    // Clone - create another evaluator for the same model, which shares the model parameters with this one
+    // but has its own buffers for the activations. Evaluators that share the parameters can evaluate
+    // concurrently, each of them from one thread at a time, with only one copy of the model in memory.
+    // If this evaluator has been started by StartForwardEvaluation(), the clone is started for the same outputs.
+    // Clone() must not be called while one of the evaluators sharing the parameters is evaluating.
+    // The clone is independent of this evaluator otherwise, and must be released by calling its Destroy().
+    //
+    virtual IEvaluateModelExtended<ElemType>* Clone() = 0;
 };
 
 template <typename ElemType>
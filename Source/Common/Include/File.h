@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string>
 #include <vector>
+#include <memory>
 #include <stdint.h>
 #ifdef _WIN32
 #define NOMINMAX
@@ -24,6 +25,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 using namespace std;
 
+class MemoryMappedFile;
+
 // file options, Type of textfile to use
 enum FileOptions
 {
@@ -99,6 +102,10 @@ private:
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
+    std::shared_ptr<MemoryMappedFile> m_mapping; // see MapIntoMemory()
+    char* m_memoryBuffer;      // see CreateInMemory(); owned, allocated by open_memstream()
+    size_t m_memoryBufferSize;
+    File() { }
     void Init(const wchar_t* filename, int fileOptions);
 
 public:
@@ -115,6 +122,19 @@ public:
     void SetPosition(uint64_t pos);
     void SkipToDelimiter(int delim);
 
+    // Memory-maps the file (seekable binary files opened for reading only), so that large blocks
+    // can be referenced in place instead of being read, see TryGetMappedBlock().
+    void MapIntoMemory();
+    // If the file is memory-mapped, returns the next 'size' bytes as a pointer into the mapping, and skips them.
+    // The pointer keeps the mapping alive, also after this object is gone. Returns nullptr if the file is not mapped.
+    std::shared_ptr<const char> TryGetMappedBlock(size_t size);
+
+    // Creates an anonymous file for writing that lives in host memory (on Windows: a temp file that is
+    // deleted when closed), to serialize something quickly and write it out elsewhere later, see CopyTo().
+    static std::unique_ptr<File> CreateInMemory(int fileOptions);
+    // Writes the entire content of an in-memory or seekable file to 'f'.
+    void CopyTo(FILE* f);
+
     bool IsTextBased();
 
     bool IsUnicodeBOM(bool skip = false);
@@ -195,6 +215,30 @@ public:
         return *this;
     }
 
+    // put/get operators for arrays of basic types; in binary mode, these read or write the whole array at once
+    template <typename T>
+    void WriteArray(const T* val, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this << val[i];
+        }
+        else if (count > 0)
+            fwriteOrDie(val, sizeof(T), count, m_file);
+    }
+    template <typename T>
+    void ReadArray(T* val, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this >> val[i];
+        }
+        else if (count > 0)
+            freadOrDie(val, sizeof(T), count, m_file);
+    }
+
     void WriteString(const char* str, int size = 0);                   // zero terminated strings use size=0
     void ReadString(char* str, int size);                              // read up to size bytes, or a zero terminator (or space in text mode)
     void WriteString(const wchar_t* str, int size = 0);                // zero terminated strings use size=0
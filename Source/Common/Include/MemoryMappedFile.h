@@ -0,0 +1,155 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MemoryMappedFile.h -- read-only mapping of a whole file into memory
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "Platform.h"
+#include <algorithm>
+#include <string>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Maps a whole file read-only. The mapping lives as long as the object.
+// Pages are loaded by the OS on first access, and are shared by all processes that map the same file.
+class MemoryMappedFile
+{
+public:
+    // Throws if the file cannot be opened or mapped.
+    explicit MemoryMappedFile(const std::wstring& path)
+        : m_path(path), m_data(nullptr), m_size(0)
+#ifdef _WIN32
+        , m_file(INVALID_HANDLE_VALUE), m_mapping(NULL)
+#endif
+    {
+#ifdef _WIN32
+        m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            RuntimeError("MemoryMappedFile: cannot open '%ls' (error %d).", path.c_str(), (int) GetLastError());
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size))
+        {
+            Close();
+            RuntimeError("MemoryMappedFile: cannot determine the size of '%ls' (error %d).", path.c_str(), (int) GetLastError());
+        }
+        m_size = (size_t) size.QuadPart;
+        if (m_size == 0)
+            return;
+        m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping != NULL)
+            m_data = (const char*) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (m_data == nullptr)
+        {
+            int error = (int) GetLastError();
+            Close();
+            RuntimeError("MemoryMappedFile: cannot map '%ls' (error %d).", path.c_str(), error);
+        }
+#else
+        int fd = open(wtocharpath(path).c_str(), O_RDONLY);
+        if (fd == -1)
+            RuntimeError("MemoryMappedFile: cannot open '%ls' (errno %d).", path.c_str(), errno);
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            int error = errno;
+            close(fd);
+            RuntimeError("MemoryMappedFile: cannot determine the size of '%ls' (errno %d).", path.c_str(), error);
+        }
+        m_size = (size_t) info.st_size;
+        if (m_size > 0)
+        {
+            void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                int error = errno;
+                close(fd);
+                RuntimeError("MemoryMappedFile: cannot map '%ls' (errno %d).", path.c_str(), error);
+            }
+            m_data = (const char*) data;
+        }
+        close(fd); // the mapping keeps the file referenced
+#endif
+    }
+
+    ~MemoryMappedFile()
+    {
+        Close();
+    }
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    const std::wstring& Path() const { return m_path; }
+
+    // Tells the OS that the whole mapping will be read soon and sequentially (a hint, not all platforms use it).
+    void PrefetchAll() const
+    {
+#ifndef _WIN32
+        if (m_data != nullptr)
+        {
+            madvise((void*) m_data, m_size, MADV_SEQUENTIAL);
+            madvise((void*) m_data, m_size, MADV_WILLNEED);
+        }
+#endif
+    }
+
+    // Same as above, for the given byte range of the file only.
+    void Prefetch(size_t offset, size_t size) const
+    {
+#ifndef _WIN32
+        if (m_data == nullptr || offset >= m_size)
+            return;
+        size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+        size_t begin = offset - offset % pageSize; // madvise needs a page-aligned address
+        size = std::min(size, m_size - offset) + (offset - begin);
+        madvise((void*) (m_data + begin), size, MADV_WILLNEED);
+#else
+        UNUSED(offset);
+        UNUSED(size);
+#endif
+    }
+
+private:
+    void Close()
+    {
+#ifdef _WIN32
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mapping != NULL)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_mapping = NULL;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data != nullptr)
+            munmap((void*) m_data, m_size);
+#endif
+        m_data = nullptr;
+    }
+
+    std::wstring m_path;
+    const char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+};
+
+}}}
@@ -11,6 +11,7 @@
 #include "Matrix.h"
 #include <vector>
 #include <memory> // for shared_ptr
+#include <algorithm>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -197,10 +198,13 @@ public:
     //  - width: maximum width of structure; set to maximum over sequence lengths
     //  - inputSequences: vector of input SequenceInfo records (only seqId and GetNumTimeSteps() are used)
     //  - placement, rowAllocations: temp buffers (passed in to be able to optimize memory allocations)
+    //  - bestFit: place the sequences best-fit decreasing (longest first, each into the fullest row it fits in),
+    //    instead of first-fit in the given order. This needs fewer rows, and thus fewer gaps.
     template<typename SequenceInfoVector>
     void InitAsPackedSequences(const SequenceInfoVector& inputSequences,
         /*temp buffer*/std::vector<std::pair<size_t, size_t>>& placement,
-        /*temp buffer*/std::vector<size_t> rowAllocations)
+        /*temp buffer*/std::vector<size_t> rowAllocations,
+        bool bestFit = false)
     {
         placement.resize(inputSequences.size()); // [sequence index] result goes here (entries are invalid for gaps)
         // determine width of MBLayout
@@ -212,19 +216,42 @@ public:
             else if (width < inputSequences[i].GetNumTimeSteps())
                 width = inputSequences[i].GetNumTimeSteps();
         }
+        // determine the order of placement
+        std::vector<size_t> order;
+        if (bestFit)
+        {
+            order.resize(inputSequences.size());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&inputSequences](size_t a, size_t b)
+            {
+                return inputSequences[a].GetNumTimeSteps() > inputSequences[b].GetNumTimeSteps();
+            });
+        }
         // allocate
         rowAllocations.clear();             // [row] we build rows one by one
-        for (size_t i = 0; i < inputSequences.size(); i++)
+        for (size_t k = 0; k < inputSequences.size(); k++)
         {
+            let i = bestFit ? order[k] : k;
             if (inputSequences[i].seqId == GAP_SEQUENCE_ID)
                 continue;
             let len = inputSequences[i].GetNumTimeSteps();
             // first see if we find a row that has enough space
             // TODO: Should we use a proper priority_queue?
             size_t s;
-            for (s = 0; s < rowAllocations.size(); s++)
-                if (rowAllocations[s] + len <= width)
-                    break; // yep, it fits
+            if (bestFit)
+            {
+                s = rowAllocations.size();
+                for (size_t r = 0; r < rowAllocations.size(); r++)
+                    if (rowAllocations[r] + len <= width && (s == rowAllocations.size() || rowAllocations[r] > rowAllocations[s]))
+                        s = r; // it fits, and leaves less space than the best so far
+            }
+            else
+            {
+                for (s = 0; s < rowAllocations.size(); s++)
+                    if (rowAllocations[s] + len <= width)
+                        break; // yep, it fits
+            }
             // we did not find a s that fit then create a new one
             if (s == rowAllocations.size())
                 rowAllocations.push_back(0);
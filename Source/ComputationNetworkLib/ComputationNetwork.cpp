@@ -34,15 +34,37 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+vector<MatrixPool::MemRequestInfo<float>>& MatrixPool::GetMemRequestInfos<float>()
 {
-    return m_releasedFloatMatrices;
+    return m_floatMemRequestInfos;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+vector<MatrixPool::MemRequestInfo<double>>& MatrixPool::GetMemRequestInfos<double>()
 {
-    return m_releasedDoubleMatrices;
+    return m_doubleMemRequestInfos;
+}
+
+template <>
+vector<shared_ptr<Matrix<float>>>& MatrixPool::GetBlocks<float>()
+{
+    return m_floatBlocks;
+}
+
+template <>
+vector<shared_ptr<Matrix<double>>>& MatrixPool::GetBlocks<double>()
+{
+    return m_doubleBlocks;
+}
+
+size_t MatrixPool::GetAllocatedBytes()
+{
+    size_t allocatedBytes = 0;
+    for (const auto& matrixPtr : GetBlocks<float>())
+        allocatedBytes += matrixPtr->BufferSize();
+    for (const auto& matrixPtr : GetBlocks<double>())
+        allocatedBytes += matrixPtr->BufferSize();
+    return allocatedBytes;
 }
 
 // -----------------------------------------------------------------------
@@ -100,10 +122,16 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
     renameOrDie(tmpFileName, fileName);
 }
 
-// TODO: how does the file distinguish float vs double nodes?
 void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
 {
     File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
+    Save(fstream);
+}
+
+// TODO: how does the file distinguish float vs double nodes?
+void ComputationNetwork::Save(File& fstream) const
+{
+    VerifyIsCompiled("Save");
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
     // model version
@@ -260,11 +288,13 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
 // deserialize the model
 // This does not post-process the model (CompileNetwork()). Use Load() instead.
 template <class ElemType> // for ReadPersistableParameters()
-void ComputationNetwork::Read(const wstring& fileName)
+void ComputationNetwork::Read(const wstring& fileName, bool memoryMapParameters)
 {
     ClearNetwork();
 
     File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    if (memoryMapParameters && m_deviceId < 0)
+        fstream.MapIntoMemory();
 
     ReadPersistableParameters<ElemType>(fstream, true);
 
@@ -1451,7 +1481,7 @@ void ComputationNetwork::SaveToDbnFile(ComputationNetworkPtr net, const std::wst
 }
 
 template void ComputationNetwork::InitLearnableParameters<float>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const float initValueScale, bool initOnCPUOnly);
-template void ComputationNetwork::Read<float>(const wstring& fileName);
+template void ComputationNetwork::Read<float>(const wstring& fileName, bool memoryMapParameters);
 template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, size_t randSeedBase);
@@ -1461,7 +1491,7 @@ template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net,
 template void ComputationNetwork::SaveToDbnFile<float>(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
 template void ComputationNetwork::InitLearnableParameters<double>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly);
-template void ComputationNetwork::Read<double>(const wstring& fileName);
+template void ComputationNetwork::Read<double>(const wstring& fileName, bool memoryMapParameters);
 template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, size_t randSeedBase);
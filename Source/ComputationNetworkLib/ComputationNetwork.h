@@ -13,6 +13,7 @@
 #include "ComputationNode.h"
 #include "ScriptableObjects.h"
 #include "ComputationEnvironment.h"
+#include "NodeProfiler.h"
 
 #include <map>
 #include <string>
@@ -27,6 +28,7 @@
 #include <iostream>
 #include <regex>
 #include <chrono>
+#include <functional>
 #include <unordered_map>
 #include <set>
 
@@ -52,6 +54,11 @@ public:
         m_randomSeedOffset(0),
         m_isCompiled(false),
         m_areMatricesAllocated(false),
+        m_gradientCheckpointing(false),
+        m_memoryPlanNumCols(0),
+        m_memoryPlanTraceLevel(0),
+        m_maxNumColsSeen(0),
+        m_forwardPropSeconds(0),
         m_pMBLayoutOfNetwork(make_shared<MBLayout>(1, 0, L"*")),
         m_environment(make_shared<ComputationEnvironment>())
     {
@@ -100,7 +107,9 @@ public:
     }
     // design BUGBUG: binary files do not know whether they are float or double.
     // TODO: modify file format to know this; then eliminate the <ElemType> dependency (and in some future, allow nodes to be different)
-    template <class ElemType> void Read(const std::wstring& fileName);
+    // If 'memoryMapParameters', parameters of a network on the CPU use the file mapping in place instead of being read.
+    // Such a network can only be evaluated: the parameters must not be modified.
+    template <class ElemType> void Read(const std::wstring& fileName, bool memoryMapParameters = false);
     template <class ElemType> void Load(const std::wstring& fileName)
     {
         Read<ElemType>(fileName);
@@ -118,6 +127,8 @@ public:
     }
 
     void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
+    // serialize into an open file, e.g. one created with File::CreateInMemory()
+    void Save(File& fstream) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
 
 private:
@@ -134,7 +145,9 @@ public:
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // If given, 'onParameterGradientComplete' is called for each learnable parameter as soon as backprop has finalized its gradient,
+    // while the remaining nodes are still being processed (e.g. to start aggregating gradients across workers early).
+    void Backprop(const ComputationNodeBasePtr rootNode, const std::function<void(const ComputationNodeBasePtr&)>& onParameterGradientComplete = nullptr);
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -188,10 +201,41 @@ private:
     void VerifyIsCompiled(const char* where) const;
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    void PrintMatrixPoolUsage();
+
+    // The memory plan made by AllocateAllMatrices() packs the matrices that grow with the minibatch together with those
+    // that do not (e.g. parameter gradients), so it should be made for the minibatch size that will actually be used,
+    // e.g. that of the first epoch, rather than for the layout at allocation time, which usually has 1 column.
+    // expectedNumCols = 0 falls back to the latter. A summary of the plan is printed if traceLevel > 0.
+    // Has no effect once the matrices are allocated.
+    void SetMemoryPlanHint(size_t expectedNumCols, int traceLevel = 0)
+    {
+        if (AreMatricesAllocated())
+            return;
+        m_memoryPlanNumCols = expectedNumCols;
+        m_memoryPlanTraceLevel = traceLevel;
+    }
+
+    // Gradient checkpointing: trade compute for memory by dropping values after forward prop and computing them again
+    // segment by segment during backprop. Segments end at the given nodes, or, if none are given, at every sqrt(N)-th value.
+    // Since the dropped values grow with the minibatch while the parameter gradients do not, the savings only show
+    // if the memory plan is made for the real minibatch size (SetMemoryPlanHint()).
+    // Must be called before AllocateAllMatrices(); see PlanRecomputation().
+    void SetGradientCheckpointing(bool enable, const std::vector<std::wstring>& checkpointNodeNames = std::vector<std::wstring>())
+    {
+        if (AreMatricesAllocated())
+            LogicError("SetGradientCheckpointing: Must be called before the matrices are allocated.");
+        m_gradientCheckpointing = enable;
+        m_checkpointNodeNames = checkpointNodeNames;
+    }
 
 private:
     template <class ElemType> void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
-    void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
+    void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount, const std::map<ComputationNodeBasePtr, ComputationNodeBasePtr>& droppedValues);
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> PlanRecomputation(const ComputationNodeBasePtr& trainRootNode,
+                                                                                             const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                                                                                             const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                                                                             std::map<ComputationNodeBasePtr, ComputationNodeBasePtr>& droppedValues);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
 public:
@@ -359,6 +403,7 @@ public:
     ComputationNodeBasePtr CopyNode(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toName, const CopyNodeFlags flags);
     void CopySubTree(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toNamePrefix, const CopyNodeFlags flags);
     void CopyInputs(const std::wstring fromName, std::wstring toName);
+    ComputationNetworkPtr CloneSharingParameters() const;
     void RenameNode(const std::wstring& nodeNameOrig, const std::wstring& nodeNameNew);
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
     void DeleteNode(const std::wstring& nodeName);
@@ -369,6 +414,7 @@ public:
     void AddFeatureNode(ComputationNodeBasePtr featureNode);
     //ComputationNodeBasePtr RemoveFeatureNode(ComputationNodeBasePtr featureNode);
     void SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode = nullptr);
+    size_t SetQuantizedInference(bool enable, const ComputationNodeBasePtr& rootNode = nullptr);
 
     // -----------------------------------------------------------------------
     // node access
@@ -425,6 +471,14 @@ public:
 
     ComputationEnvironment& Environment() const { return *m_environment; }
 
+    // -----------------------------------------------------------------------
+    // profiling
+    // -----------------------------------------------------------------------
+
+    // while set, ForwardProp() and Backprop() report every node's execution to this profiler
+    void SetNodeProfiler(const std::shared_ptr<NodeProfiler>& profiler) { m_nodeProfiler = profiler; }
+    const std::shared_ptr<NodeProfiler>& GetNodeProfiler() const { return m_nodeProfiler; }
+
     // -----------------------------------------------------------------------
     // functions to pass on specific SGD options to nodes
     // -----------------------------------------------------------------------
@@ -681,9 +735,27 @@ public:
     template <class ElemType>
     void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
 
+    // rewrite the network for inference of the given outputs (default: the output nodes), see ComputationNetworkOptimization.cpp
+    template <class ElemType>
+    void OptimizeForInference(const std::vector<std::wstring>& outputNodeNames, bool fuseElementwise = false);
+
     template <class ElemType>
     void SaveToDbnFile(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
+private:
+    // steps of OptimizeForInference(); each returns the number of nodes it changed
+    void SubstituteNode(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode);
+    size_t RemoveNodesNotNeededForOutputs();
+    size_t BypassDropoutNodes();
+    template <class ElemType>
+    size_t ReplacePreComputedNodesByParameters();
+    template <class ElemType>
+    size_t FoldConstants();
+    template <class ElemType>
+    size_t FoldBatchNormalization();
+    template <class ElemType>
+    size_t FuseElementwiseChains();
+
     // -----------------------------------------------------------------------
     // construction
     // -----------------------------------------------------------------------
@@ -970,10 +1042,12 @@ protected:
         ComputationNodeBasePtr m_sourceNode; // one of the nodes of the loop   --TODO: What is the special meaning of this node? It seems to always be a delay node.
         int m_loopId;                        // unique loop id, index in m_allSEQNodes array
         int m_steppingDirection;             // +1 if left to right (t=0..T-1), -1 if rightt to left (t=T-1..0)
+        NodeProfiler* m_profiler;            // set by the enclosing PARTraversalFlowControlNode for the duration of a ForwardProp() or Backprop() call
 
         SEQTraversalFlowControlNode(int loopId, ComputationNodeBasePtr cur)
             : m_loopId(loopId),
-              m_sourceNode(cur)
+              m_sourceNode(cur),
+              m_profiler(nullptr)
         {
             SetNodeName(L"Loop_" + m_sourceNode->NodeName());
         }
@@ -1029,6 +1103,19 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // called by Backprop() for each learnable parameter once its gradient is final (set for the duration of one ComputationNetwork::Backprop() call)
+        std::function<void(const ComputationNodeBasePtr&)> m_onParameterGradientComplete;
+
+        // receives the execution times of the nodes, or null (set for the duration of one ComputationNetwork::ForwardProp() or Backprop() call)
+        NodeProfiler* m_profiler;
+
+        // gradient checkpointing: [node] -> nodes to compute again before the node's Backprop(), in evaluation order (see ComputationNetwork::PlanRecomputation())
+        std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> m_recomputeBeforeBackprop;
+        double m_recomputeSeconds; // time spent computing them, accumulated
+
+    private:
+        std::vector<shared_ptr<SEQTraversalFlowControlNode>> m_nestedLoops; // the SEQTraversalFlowControlNodes among m_nestedNodes, to pass m_profiler on to
     };
 
 public:
@@ -1072,6 +1159,20 @@ private:
 
     // environment information that nodes may want to inquire, e.g. to know whether we are training
     ComputationEnvironmentPtr m_environment;
+
+    // if set, receives the execution times of all nodes
+    std::shared_ptr<NodeProfiler> m_nodeProfiler;
+
+    // memory plan, see SetMemoryPlanHint()
+    size_t m_memoryPlanNumCols;                    // number of columns to make the memory plan for, 0 if not known
+    int m_memoryPlanTraceLevel;                    // > 0 to print the plan
+    size_t m_maxNumColsSeen;                       // largest minibatch since the last PrintMatrixPoolUsage()
+
+    // gradient checkpointing, see SetGradientCheckpointing()
+    bool m_gradientCheckpointing;
+    std::vector<std::wstring> m_checkpointNodeNames;
+    ComputationNodeBasePtr m_checkpointedRootNode; // training criterion whose backprop recomputes values, or null
+    double m_forwardPropSeconds;                   // time spent in ForwardProp() while values are recomputed, accumulated
 private:
     // -----------------------------------------------------------------------
     // the following members are all result of post-processing by CompileNetwork()
@@ -100,6 +100,59 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
     CopyNode(*this, fromName, toName, CopyNodeFlags::copyNodeInputLinks);
 }
 
+// create a copy of this network to evaluate the same model concurrently, e.g. one copy per thread
+// The LearnableParameter nodes, and therefore the model weights, are shared with this network.
+// All other nodes are duplicated without the matrices they got from the matrix pool, so that the copy
+// gets its own activation memory once it allocates its matrices.
+// The shared nodes remain owned by this network (see ClearNetwork()), and must not be modified while copies are in use.
+ComputationNetworkPtr ComputationNetwork::CloneSharingParameters() const
+{
+    VerifyIsCompiled("CloneSharingParameters");
+
+    auto net = make_shared<ComputationNetwork>(m_deviceId);
+    net->SetRandomSeedOffset(m_randomSeedOffset);
+
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> clonedNodes;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+        {
+            // not using AddNodeToNet(), which would take the node over into the new network's environment
+            net->m_nameToNodeMap[node->NodeName()] = node;
+            clonedNodes[node] = node;
+        }
+        else
+        {
+            auto newNode = node->Duplicate(node->NodeName(), CopyNodeFlags::copyNodeAll);
+            newNode->DetachMatrices();
+            net->AddNodeToNet(newNode);
+            clonedNodes[node] = newNode;
+        }
+    }
+
+    // the duplicates still point to the inputs in this network
+    for (const auto& iter : clonedNodes)
+    {
+        const auto& newNode = iter.second;
+        if (newNode == iter.first)
+            continue;
+        for (size_t i = 0; i < newNode->GetNumInputs(); i++)
+            newNode->SetInput(i, clonedNodes.at(newNode->GetInputs()[i]));
+    }
+
+    auto fromGroups = const_cast<ComputationNetwork*>(this)->GetAllNodeGroups();
+    auto toGroups = net->GetAllNodeGroups();
+    for (size_t i = 0; i < fromGroups.size(); i++)
+    {
+        for (const auto& node : *fromGroups[i])
+            toGroups[i]->push_back(clonedNodes.at(node));
+    }
+
+    net->CompileNetwork();
+    return net;
+}
+
 // RenameNode - Rename a node to another name
 // nodeNameOrig - original node name
 // nodeNameNew - new node name
@@ -361,4 +414,30 @@ void ComputationNetwork::SetLearnableNodesBelowLearningRateMultiplier(const floa
     }
 }
 
+// enable or disable quantized inference for all nodes that support it, or for those below 'rootNode'
+// Returns the number of nodes that support it.
+size_t ComputationNetwork::SetQuantizedInference(bool enable, const ComputationNodeBasePtr& rootNode)
+{
+    list<ComputationNodeBasePtr> nodes;
+    if (rootNode == nullptr)
+    {
+        for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+            nodes.push_back(nodeIter->second);
+    }
+    else
+        nodes = GetAllNodesForRoot(rootNode);
+
+    size_t numQuantizable = 0;
+    for (const auto& node : nodes)
+    {
+        auto quantizableNode = dynamic_pointer_cast<IQuantizableNode>(node);
+        if (quantizableNode)
+        {
+            quantizableNode->SetQuantizedInference(enable);
+            numQuantizable++;
+        }
+    }
+    return numQuantizable;
+}
+
 }}}
@@ -40,7 +40,16 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
     VerifyIsCompiled("ForwardProp");
 
     // traverse all nodes in the pre-determined evaluation order
-    GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    auto start = std::chrono::steady_clock::now();
+    network->m_profiler = m_nodeProfiler.get();
+    network->ForwardProp(FrameRange(nullptr));
+    network->m_profiler = nullptr;
+    m_maxNumColsSeen = max(m_maxNumColsSeen, m_pMBLayoutOfNetwork->GetNumCols());
+
+    // to relate the cost of gradient checkpointing to
+    if (m_checkpointedRootNode)
+        m_forwardPropSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
 // set the gradient matrix of a (root) node 1.0
@@ -63,7 +72,8 @@ static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, // training criterion to compute the gradients for
+                                  const std::function<void(const ComputationNodeBasePtr&)>& onParameterGradientComplete)
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
@@ -76,7 +86,12 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     ZeroInputGradients(rootNode);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    network->m_onParameterGradientComplete = onParameterGradientComplete;
+    network->m_profiler = m_nodeProfiler.get();
+    network->Backprop(FrameRange(nullptr), true, true);
+    network->m_onParameterGradientComplete = nullptr;
+    network->m_profiler = nullptr;
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -103,9 +118,10 @@ ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNod
 // -----------------------------------------------------------------------
 
 ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes /*must be in eval order*/)
+    : m_profiler(nullptr), m_recomputeSeconds(0)
 {
     // traverse the network in evaluation order and create a new list that replaces all recurrence by a SEQTraversalFlowControlNode
-    set<shared_ptr<IComputationNode>> loopsSeen; // for consistency check only
+    std::set<shared_ptr<IComputationNode>> loopsSeen; // for consistency check only
     for (auto nodeIter = allNodes.begin(); nodeIter != allNodes.end();)
     {
         shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(recurrentInfo, *nodeIter); // check if this node participates in a recurrent loop
@@ -113,6 +129,7 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         {
             // instead of the node itself, include the sentinel SEQTraversalFlowControlNode in our list
             m_nestedNodes.push_back(recInfo);
+            m_nestedLoops.push_back(recInfo);
 
             // and verify that we only encountered the loop once (all nodes should have been consecutive)
             if (!loopsSeen.insert(recInfo).second)
@@ -131,6 +148,9 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    for (auto& loop : m_nestedLoops)
+        loop->m_profiler = m_profiler;
+
     for (auto& node : m_nestedNodes)
     {
 #if 0
@@ -139,6 +159,7 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 #endif
         if (node->IsOutOfDateWrtInputs())
         {
+            NodeProfiler::Scope profile(m_profiler, *node, NodeProfiler::Phase::forward);
             node->BeginForwardProp();
             node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
             node->EndForwardProp();
@@ -151,14 +172,43 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    for (auto& loop : m_nestedLoops)
+        loop->m_profiler = m_profiler;
+
     // process nodes in pre-determined order
     for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
     {
         auto& node = *pnode;
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+        // gradient checkpointing: compute the values that were dropped after forward prop again, for the segment that ends here
+        if (!m_recomputeBeforeBackprop.empty())
+        {
+            auto recompute = m_recomputeBeforeBackprop.find(node);
+            if (recompute != m_recomputeBeforeBackprop.end())
+            {
+                auto start = std::chrono::steady_clock::now();
+                for (auto& recomputedNode : recompute->second)
+                {
+                    NodeProfiler::Scope profile(m_profiler, *recomputedNode, NodeProfiler::Phase::forward);
+                    recomputedNode->BeginForwardProp();
+                    recomputedNode->ForwardProp(fr.WithLayout(recomputedNode->GetMBLayout()));
+                    recomputedNode->EndForwardProp();
+                }
+                m_recomputeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+
+        {
+            NodeProfiler::Scope profile(m_profiler, *node, NodeProfiler::Phase::backward);
+            node->BeginBackprop();
+            node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+            node->EndBackprop();
+        }
+
+        // Since we go backwards over the evaluation order, all nodes that consume this one have already propagated into its gradient.
+        // For a learnable parameter (a leaf that needs a gradient), nothing will touch that gradient again in this pass.
+        if (m_onParameterGradientComplete && node->IsLeaf() && node->NeedsGradient())
+            m_onParameterGradientComplete(node);
     }
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
@@ -220,6 +270,7 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     {
         for (auto& node : m_nestedNodes)
         {
+            NodeProfiler::Scope profile(m_profiler, *node, NodeProfiler::Phase::forward, false /*the loop as a whole is on the timeline*/);
             node->ForwardProp(t);
             node->BumpEvalTimeStamp();
         }
@@ -251,6 +302,7 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
         {
             auto& node2 = *nodeIter2;
+            NodeProfiler::Scope profile(m_profiler, *node2, NodeProfiler::Phase::backward, false /*the loop as a whole is on the timeline*/);
             node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
             // The above flags tell Backprop() to skip back-propagation from inside a node into
             // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
@@ -266,6 +318,7 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     for (auto nodeIter2 = m_nestedNodes.rbegin(); nodeIter2 != m_nestedNodes.rend(); ++nodeIter2)
     {
         auto& node2 = *nodeIter2;
+        NodeProfiler::Scope profile(m_profiler, *node2, NodeProfiler::Phase::backward, false /*the loop as a whole is on the timeline*/);
         node2->Backprop(FrameRange(m_nestedNodes[0]->GetMBLayout()), false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
     }
 
@@ -837,6 +890,143 @@ void ComputationNetwork::PrintMemorySharingStructure(const std::vector<Computati
 }
 
 
+// Gradient checkpointing: plan which values are dropped after forward prop and computed again during backprop.
+// The nodes in the evaluation order of 'trainRootNode' are cut into segments that end at checkpoint nodes. Right before a
+// checkpoint is backpropagated, the dropped values of its segment are computed again, from the values that were kept.
+// Candidates for dropping are the values that backprop needs, of nodes outside of loops whose values scale with the minibatch
+// and that CanRecomputeForwardProp(). Without m_checkpointNodeNames, every sqrt(N)-th of the N candidates is a checkpoint.
+// A candidate is only dropped if all nodes that consume it are in its own segment, and if its inputs are kept or can be
+// computed again as well (values that backprop does not need are released after forward prop anyway, and may be needed for this).
+// The segment after the last checkpoint is kept, since backprop starts with it.
+// Returns [checkpoint] -> nodes to compute again before its backprop, in evaluation order, and in 'droppedValues' [dropped value] -> the
+// checkpoint of its segment. Other nodes in a segment's list are only inputs to it, e.g. dropped values of earlier segments that are needed
+// through a value that was released after forward prop.
+map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>> ComputationNetwork::PlanRecomputation(const ComputationNodeBasePtr& trainRootNode,
+                                                                                               const unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                                                                                               const unordered_map<ComputationNodeBasePtr, unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                                                                               map<ComputationNodeBasePtr, ComputationNodeBasePtr>& droppedValues)
+{
+    const std::list<ComputationNodeBasePtr>& evalOrder = GetEvalOrder(trainRootNode);
+
+    auto canRecompute = [](const ComputationNodeBasePtr& node)
+    {
+        return !node->IsPartOfLoop() && !node->IsLeaf() && !node->RequiresPreCompute() && node->IsValueSharable() && node->HasMBLayout() && node->CanRecomputeForwardProp();
+    };
+    auto isNeededDuringBackprop = [&](const ComputationNodeBasePtr& node)
+    {
+        auto iter = outputValueNeededDuringBackProp.find(node);
+        return iter != outputValueNeededDuringBackProp.end() && iter->second;
+    };
+
+    std::vector<ComputationNodeBasePtr> candidates;
+    for (const auto& node : evalOrder)
+    {
+        if (canRecompute(node) && isNeededDuringBackprop(node))
+            candidates.push_back(node);
+    }
+
+    std::set<ComputationNodeBasePtr> checkpoints;
+    if (m_checkpointNodeNames.empty())
+    {
+        const size_t interval = max((size_t) 1, (size_t) (sqrt((double) candidates.size()) + 0.5));
+        for (size_t i = interval - 1; i < candidates.size(); i += interval)
+            checkpoints.insert(candidates[i]);
+    }
+    else
+    {
+        for (const auto& nodeName : m_checkpointNodeNames)
+        {
+            ComputationNodeBasePtr node = GetNodeFromName(nodeName);
+            if (node->IsPartOfLoop())
+                InvalidArgument("Gradient checkpointing: Node '%ls' is part of a recurrent loop and cannot be a checkpoint.", nodeName.c_str());
+            if (std::find(evalOrder.begin(), evalOrder.end(), node) == evalOrder.end())
+                fprintf(stderr, "Gradient checkpointing: Ignoring checkpoint '%ls', which the training criterion does not depend on.\n", nodeName.c_str());
+            else
+                checkpoints.insert(node);
+        }
+    }
+
+    // assign the nodes to segments; segment s ends at checkpoints[s]
+    std::vector<ComputationNodeBasePtr> segmentEnds;
+    std::unordered_map<ComputationNodeBasePtr, size_t> segmentOf;
+    for (const auto& node : evalOrder)
+    {
+        segmentOf[node] = segmentEnds.size();
+        if (checkpoints.find(node) != checkpoints.end())
+            segmentEnds.push_back(node);
+    }
+
+    map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>> recomputeBeforeBackprop;
+    size_t numRecomputed = 0;
+    for (size_t segment = 0; segment < segmentEnds.size(); segment++)
+    {
+        std::vector<ComputationNodeBasePtr> toRecompute;
+        std::set<ComputationNodeBasePtr> recomputed;
+
+        // make 'node's value available when the segment is computed again: it is either kept, or is computed again as well
+        std::function<bool(const ComputationNodeBasePtr&)> makeAvailable = [&](const ComputationNodeBasePtr& node)
+        {
+            if (recomputed.find(node) != recomputed.end())
+                return true;
+            bool isKept = !node->IsValueSharable() || ((isNeededDuringBackprop(node) || !g_shareNodeValueMatrices) && droppedValues.find(node) == droppedValues.end());
+            if (isKept)
+                return true;
+            if (!canRecompute(node))
+                return false;
+            for (const auto& input : node->GetInputs())
+            {
+                if (!makeAvailable(input))
+                    return false;
+            }
+            toRecompute.push_back(node);
+            recomputed.insert(node);
+            return true;
+        };
+
+        for (const auto& node : evalOrder)
+        {
+            if (segmentOf[node] != segment || node == segmentEnds[segment] || !canRecompute(node) || !isNeededDuringBackprop(node))
+                continue;
+
+            auto parents = parentsMap.find(node);
+            bool consumedInSegment = parents != parentsMap.end() && std::all_of(parents->second.begin(), parents->second.end(), [&](const ComputationNodeBasePtr& parent)
+            {
+                auto parentSegment = segmentOf.find(parent);
+                return parentSegment != segmentOf.end() && parentSegment->second == segment;
+            });
+            if (!consumedInSegment)
+                continue;
+
+            // try; if an input cannot be had, the value is kept, and what was added for it is taken back
+            const size_t numToRecompute = toRecompute.size();
+            bool isAvailable = true;
+            for (const auto& input : node->GetInputs())
+                isAvailable = isAvailable && makeAvailable(input);
+            if (!isAvailable)
+            {
+                for (size_t i = numToRecompute; i < toRecompute.size(); i++)
+                    recomputed.erase(toRecompute[i]);
+                toRecompute.resize(numToRecompute);
+                continue;
+            }
+            toRecompute.push_back(node);
+            recomputed.insert(node);
+            droppedValues[node] = segmentEnds[segment];
+        }
+
+        if (!toRecompute.empty())
+        {
+            numRecomputed += toRecompute.size();
+            recomputeBeforeBackprop[segmentEnds[segment]] = move(toRecompute);
+        }
+    }
+
+    if (m_memoryPlanTraceLevel > 0)
+        fprintf(stderr, "\nGradient checkpointing: %d checkpoints; %d of %d values needed for backprop are dropped after forward prop, and %d nodes of %d are computed again for backprop.\n",
+                (int) segmentEnds.size(), (int) droppedValues.size(), (int) candidates.size(), (int) numRecomputed, (int) evalOrder.size());
+    return recomputeBeforeBackprop;
+}
+
 // this function will need to be called before actual validation and execution to
 // predetermine how to share matrices to reduce memory usage.
 // TODO: find a simple topological order and allocateEvalMatrices on that order directly
@@ -917,6 +1107,12 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // gradient checkpointing: determine which values are dropped after forward prop and computed again during backprop
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> recomputeBeforeBackprop;
+    std::map<ComputationNodeBasePtr, ComputationNodeBasePtr> droppedValues;
+    if (performingBackPropagation && m_gradientCheckpointing)
+        recomputeBeforeBackprop = PlanRecomputation(trainRootNode, outputValueNeededDuringBackProp, parentsMap, droppedValues);
+
     set<ComputationNodeBasePtr> completedEvaluate;
     for (auto& nodeIter : compositeForwardPropEvalOrder)
     {
@@ -933,7 +1129,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
                 for (auto& nodeLoopIter : recInfo->m_nestedNodes)
                 {
-                    ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
+                    ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount, droppedValues);
                 }
             }
         }
@@ -942,7 +1138,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
             // we only release matrices for the children since the root node's information will be used and should not be shared
             // with others
-            ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
+            ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount, droppedValues);
         }
     }
 
@@ -975,6 +1171,35 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             }
             else
             {
+                // the dropped values of the segment that ends here are computed again first (gradient checkpointing)
+                // Values that are only computed as inputs to them are released again once their last consumer is computed, as in forward prop.
+                auto recompute = recomputeBeforeBackprop.find(n);
+                if (recompute != recomputeBeforeBackprop.end())
+                {
+                    std::unordered_map<ComputationNodeBasePtr, int> inputOnlyParentCount;
+                    for (const auto& node : recompute->second)
+                    {
+                        auto dropped = droppedValues.find(node);
+                        if (dropped == droppedValues.end() || dropped->second != n)
+                            inputOnlyParentCount[node] = 0;
+                    }
+                    for (const auto& node : recompute->second)
+                        for (const auto& input : node->GetInputs())
+                            if (inputOnlyParentCount.find(input) != inputOnlyParentCount.end())
+                                inputOnlyParentCount[input]++;
+
+                    for (const auto& node : recompute->second)
+                    {
+                        node->RequestValueForRecomputation(m_matrixPool);
+                        for (const auto& input : node->GetInputs())
+                        {
+                            auto parentCount = inputOnlyParentCount.find(input);
+                            if (parentCount != inputOnlyParentCount.end() && --parentCount->second == 0)
+                                input->ReleaseValueForRecomputation(m_matrixPool);
+                        }
+                    }
+                }
+
                 // PAR mode: we can allocate and immediately deallocate one by one
                 n->AllocateGradientMatricesForInputs(m_matrixPool);
                 // Root node's information will be used and should not be shared with others, also it's small (1x1)
@@ -984,6 +1209,18 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // now that all lifetimes are known, assign the shared buffers
+    const size_t numColsHint = max(m_pMBLayoutOfNetwork->GetNumCols(), m_memoryPlanNumCols);
+    m_matrixPool.OptimizedMemoryAllocation<float>(numColsHint, m_memoryPlanTraceLevel);
+    m_matrixPool.OptimizedMemoryAllocation<double>(numColsHint, m_memoryPlanTraceLevel);
+
+    if (!recomputeBeforeBackprop.empty())
+    {
+        auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode));
+        network->m_recomputeBeforeBackprop = move(recomputeBeforeBackprop);
+        m_checkpointedRootNode = trainRootNode;
+    }
+
     m_areMatricesAllocated = true;
 
     //print the memory sharing structure
@@ -999,14 +1236,42 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         LogicError("Unexpected node precision type.");
 }
 
-void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount)
+// compare the peak memory of the plan made in AllocateAllMatrices(), scaled to the largest minibatch since the last call,
+// with the actual peak, i.e. what the shared buffers have grown to (they never shrink)
+void ComputationNetwork::PrintMatrixPoolUsage()
+{
+    const size_t numCols = max(m_maxNumColsSeen, (size_t) 1);
+    m_maxNumColsSeen = 0;
+    const double toMB = 1.0 / 1024.0 / 1024.0;
+    fprintf(stderr, "Shared matrix memory: planned peak %.2f MB for the largest minibatch of %d columns, actual peak %.2f MB.\n",
+            m_matrixPool.GetPlannedBytes(numCols) * toMB, (int) numCols, m_matrixPool.GetAllocatedBytes() * toMB);
+
+    // gradient checkpointing: the memory saved, and the extra forward computation since the last call
+    if (m_checkpointedRootNode)
+    {
+        auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(m_checkpointedRootNode));
+        const size_t plannedBytesWithoutRecomputation = m_matrixPool.GetPlannedBytes(numCols, /*withoutRecomputation=*/true);
+        fprintf(stderr, "Gradient checkpointing: saves %.2f MB of %.2f MB; computing values again took %.3f s, %.1f%% of the %.3f s of forward prop.\n",
+                ((double) plannedBytesWithoutRecomputation - (double) m_matrixPool.GetPlannedBytes(numCols)) * toMB, plannedBytesWithoutRecomputation * toMB,
+                network->m_recomputeSeconds, m_forwardPropSeconds > 0 ? 100.0 * network->m_recomputeSeconds / m_forwardPropSeconds : 0.0, m_forwardPropSeconds);
+        network->m_recomputeSeconds = 0;
+        m_forwardPropSeconds = 0;
+    }
+}
+
+void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount, const std::map<ComputationNodeBasePtr, ComputationNodeBasePtr>& droppedValues)
 {
     for (int i = 0; i < n->GetNumInputs(); i++)
     {
         ComputationNodeBasePtr pNode = n->GetInputs()[i];
         parentCount[pNode]--;
         if (parentCount[pNode] == 0)
+        {
             pNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
+            // backprop needs this value, but it is computed again before (gradient checkpointing)
+            if (droppedValues.find(pNode) != droppedValues.end())
+                pNode->ReleaseValueForRecomputation(m_matrixPool);
+        }
     }
 }
 } } }
@@ -0,0 +1,468 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ComputationNetworkOptimization.cpp -- rewriting a trained network for inference (the 'optimize' action)
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "ComputationNetwork.h"
+#include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "ConvolutionalNodes.h"
+#include "TrainingNodes.h"
+#include "PreComputeNodes.h"
+#include "SpecialPurposeNodes.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <algorithm>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// helpers
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static vector<ElemType> GetValues(const ComputationNodeBasePtr& node)
+{
+    const auto& value = node->As<ComputationNode<ElemType>>()->Value();
+    vector<ElemType> values(value.GetNumElements());
+    if (!values.empty())
+    {
+        unique_ptr<ElemType[]> data(value.CopyToArray());
+        copy(data.get(), data.get() + values.size(), values.begin());
+    }
+    return values;
+}
+
+template <class ElemType>
+static void SetValues(const ComputationNodeBasePtr& node, vector<ElemType>& values)
+{
+    auto& value = node->As<ComputationNode<ElemType>>()->Value();
+    if (value.GetNumElements() != values.size())
+        LogicError("SetValues: %ls %ls operation has %d elements, not %d.", node->NodeName().c_str(), node->OperationName().c_str(), (int) value.GetNumElements(), (int) values.size());
+    value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), values.data());
+}
+
+// a parameter that is not learned, which replaces a computed value of the given name
+template <class ElemType>
+static shared_ptr<LearnableParameter<ElemType>> NewConstant(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& shape, vector<ElemType>& values)
+{
+    auto constant = New<LearnableParameter<ElemType>>(deviceId, name, shape);
+    ComputationNodeBasePtr(constant)->SetLearningRateMultiplier(0);
+    SetValues<ElemType>(constant, values);
+    return constant;
+}
+
+static bool IsParameter(const ComputationNodeBasePtr& node)
+{
+    return node->OperationName() == OperationNameOf(LearnableParameter);
+}
+
+// replace oldNode by newNode, which must have the same name, in all inputs and node groups
+// The inputs of oldNode are left in the network; RemoveNodesNotNeededForOutputs() cleans them up.
+void ComputationNetwork::SubstituteNode(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode)
+{
+    if (newNode->NodeName() != oldNode->NodeName())
+        LogicError("SubstituteNode: New node '%ls' must have the same name as the old node '%ls'.", newNode->NodeName().c_str(), oldNode->NodeName().c_str());
+
+    InvalidateCompiledNetwork();
+    ChangeNodeInputs(oldNode, newNode);
+    for (auto groupIter : GetAllNodeGroups())
+        replace(groupIter->begin(), groupIter->end(), oldNode, newNode);
+    oldNode->DetachInputs();
+    RemoveNodeFromNet(oldNode);
+    AddNodeToNet(newNode);
+}
+
+// delete all nodes that the output nodes do not depend on
+size_t ComputationNetwork::RemoveNodesNotNeededForOutputs()
+{
+    set<ComputationNodeBasePtr> neededNodes;
+    vector<ComputationNodeBasePtr> stack(m_outputNodes.begin(), m_outputNodes.end());
+    while (!stack.empty())
+    {
+        auto node = stack.back();
+        stack.pop_back();
+        if (!neededNodes.insert(node).second)
+            continue;
+        for (const auto& input : node->GetInputs())
+            stack.push_back(input);
+    }
+
+    // Only unneeded nodes use unneeded nodes, so we can detach them all before deleting them.
+    // (DeleteNode() cannot reset the input of a node that still uses the deleted one.)
+    vector<wstring> unneededNodeNames;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        if (neededNodes.find(iter.second) == neededNodes.end())
+        {
+            iter.second->DetachInputs();
+            unneededNodeNames.push_back(iter.first);
+        }
+    }
+    for (const auto& name : unneededNodeNames)
+        DeleteNode(name);
+    return unneededNodeNames.size();
+}
+
+// Dropout is the identity in inference, so its consumers can take its input directly.
+// Dropout nodes that are outputs are kept, since the output name must not change.
+size_t ComputationNetwork::BypassDropoutNodes()
+{
+    size_t numBypassed = 0;
+    for (const auto& node : GetAllNodes())
+    {
+        if (node->OperationName() != OperationNameOf(DropoutNode) ||
+            find(m_outputNodes.begin(), m_outputNodes.end(), node) != m_outputNodes.end())
+            continue;
+        InvalidateCompiledNetwork();
+        ChangeNodeInputs(node, node->Input(0));
+        numBypassed++;
+    }
+    return numBypassed;
+}
+
+// the values of precomputed nodes (e.g. Mean(), InvStdDev()) no longer change, and no longer need their input data
+template <class ElemType>
+size_t ComputationNetwork::ReplacePreComputedNodesByParameters()
+{
+    size_t numReplaced = 0;
+    for (const auto& node : GetAllNodes())
+    {
+        auto preComputedNode = dynamic_pointer_cast<PreComputedNodeBase<ElemType>>(node);
+        if (!preComputedNode)
+            continue;
+        if (!preComputedNode->HasComputed())
+            RuntimeError("OptimizeForInference: %ls %ls operation has not been computed yet.", node->NodeName().c_str(), node->OperationName().c_str());
+        auto values = GetValues<ElemType>(node);
+        SubstituteNode(node, NewConstant<ElemType>(m_deviceId, node->NodeName(), node->GetSampleLayout(), values));
+        numReplaced++;
+    }
+    return numReplaced;
+}
+
+// Compute everything that only depends on parameters, and replace it by parameters holding the result.
+// Returns the number of nodes whose computation was folded away.
+template <class ElemType>
+size_t ComputationNetwork::FoldConstants()
+{
+    CompileNetwork();
+
+    // a node is constant if it is a parameter, or if it is computed from constants only, without a time axis
+    set<ComputationNodeBasePtr> constants;
+    size_t numConstantComputations = 0;
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        bool isConstant = node->IsLeaf() ? IsParameter(node) : !node->HasMBLayout() && !node->IsPartOfLoop();
+        for (const auto& input : node->GetInputs())
+            isConstant &= constants.find(input) != constants.end();
+        if (isConstant)
+        {
+            constants.insert(node);
+            numConstantComputations += !node->IsLeaf();
+        }
+    }
+
+    // we only need to keep the values that are used by a non-constant node or that are outputs
+    vector<ComputationNodeBasePtr> valuesToKeep;
+    auto parents = CreateParentsMap();
+    for (const auto& node : constants)
+    {
+        if (node->IsLeaf())
+            continue;
+        bool isOutput = find(m_outputNodes.begin(), m_outputNodes.end(), node) != m_outputNodes.end();
+        bool hasNonConstantParent = any_of(parents[node].begin(), parents[node].end(), [&](const ComputationNodeBasePtr& parent)
+        {
+            return constants.find(parent) == constants.end();
+        });
+        if (isOutput || hasNonConstantParent)
+            valuesToKeep.push_back(node);
+    }
+    if (valuesToKeep.empty())
+        return 0;
+
+    // evaluate them like output nodes
+    for (const auto& node : valuesToKeep)
+    {
+        if (m_evalOrders.find(node) == m_evalOrders.end())
+        {
+            FormEvalOrder(node);
+            FormNestedNetwork(node);
+        }
+    }
+    AllocateAllMatrices(valuesToKeep, {}, nullptr);
+    StartEvaluateMinibatchLoop(valuesToKeep);
+    ForwardProp(valuesToKeep);
+
+    for (const auto& node : valuesToKeep)
+    {
+        auto values = GetValues<ElemType>(node);
+        SubstituteNode(node, NewConstant<ElemType>(m_deviceId, node->NodeName(), node->GetSampleLayout(), values));
+    }
+    return numConstantComputations;
+}
+
+// In inference, BatchNormalization computes
+//     scale .* (x - runMean) .* runInvStdDev + bias
+// with one (scale, bias, runMean, runInvStdDev) per output element, or per map (spatial). If x = W * z (+ b0),
+// where W * z is a Times() or Convolution(), then this is the same as
+//     (s .* W) * z + (bias - s .* runMean + s .* b0)    where s = scale .* runInvStdDev,
+// which is computed by the product with scaled rows of W, and a single Plus() with the new bias.
+// The cuDNN engine interprets runInvStdDev differently in inference, so its nodes are left alone.
+template <class ElemType>
+size_t ComputationNetwork::FoldBatchNormalization()
+{
+    CompileNetwork();
+
+    size_t numFolded = 0;
+    auto parents = CreateParentsMap();
+    auto hasSingleUse = [&](const ComputationNodeBasePtr& node)
+    {
+        return parents[node].size() == 1 && count(m_outputNodes.begin(), m_outputNodes.end(), node) == 0 &&
+               count((*parents[node].begin())->GetInputs().begin(), (*parents[node].begin())->GetInputs().end(), node) == 1;
+    };
+    for (const auto& node : GetAllNodes())
+    {
+        auto batchNorm = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+        if (!batchNorm || !batchNorm->UsesCntkEngine() || node->IsPartOfLoop())
+            continue;
+        if (!all_of(node->GetInputs().begin() + 1, node->GetInputs().end(), IsParameter) || !hasSingleUse(node->Input(2)))
+            continue;
+
+        // match W * z or W * z + b0
+        auto product = node->Input(0);
+        ComputationNodeBasePtr bias0;
+        if (product->OperationName() == OperationNameOf(PlusNode) && hasSingleUse(product) && IsParameter(product->Input(1)))
+        {
+            bias0 = product->Input(1);
+            product = product->Input(0);
+        }
+        if (!hasSingleUse(product) || !IsParameter(product->Input(0)) || !hasSingleUse(product->Input(0)))
+            continue;
+        auto weights = product->Input(0);
+
+        // The rows of W (as a matrix) are the output elements for Times(), and the output maps for Convolution().
+        // The mapping from output elements to normalization parameters is the same as in the CPU engine.
+        const auto& shape = node->GetSampleLayout();
+        const size_t numOutputs = shape.GetNumElements();
+        const size_t numScales = node->Input(1)->GetSampleLayout().GetNumElements();
+        if (numScales == 0 || numOutputs % numScales != 0 || (numOutputs != numScales && shape[shape.GetRank() - 1] != numScales))
+            continue;
+        size_t rowsPerScale;
+        if (product->OperationName() == OperationNameOf(TimesNode))
+            rowsPerScale = numOutputs / numScales;
+        else if (product->OperationName() == OperationNameOf(ConvolutionNode) && !product->As<ConvolutionNode<ElemType>>()->IsTransposed() &&
+                 weights->As<ComputationNode<ElemType>>()->Value().GetNumRows() == numScales)
+            rowsPerScale = 1;
+        else
+            continue;
+        const size_t numRows = rowsPerScale * numScales;
+        if (bias0 && bias0->GetSampleLayout().GetNumElements() != numScales)
+            continue;
+
+        // compute the new weights and bias
+        auto scale = GetValues<ElemType>(node->Input(1));
+        auto bias = GetValues<ElemType>(node->Input(2));
+        auto runMean = GetValues<ElemType>(node->Input(3));
+        auto runInvStdDev = GetValues<ElemType>(node->Input(4));
+        auto W = GetValues<ElemType>(weights);
+        if (W.size() % numRows != 0)
+            continue;
+        vector<ElemType> s(numScales);
+        for (size_t c = 0; c < numScales; c++)
+        {
+            s[c] = scale[c] * runInvStdDev[c];
+            bias[c] -= s[c] * runMean[c];
+        }
+        if (bias0)
+        {
+            auto b0 = GetValues<ElemType>(bias0);
+            for (size_t c = 0; c < numScales; c++)
+                bias[c] += s[c] * b0[c];
+        }
+        for (size_t i = 0; i < W.size(); i++)
+            W[i] *= s[(i % numRows) / rowsPerScale];
+        SetValues<ElemType>(weights, W);
+
+        // the bias broadcasts over the spatial dimensions of the output
+        SmallVector<size_t> biasDims(shape.GetRank(), 1);
+        if (numOutputs == numScales)
+            biasDims = shape.GetDims();
+        else
+            biasDims.back() = numScales;
+        auto newBias = NewConstant<ElemType>(m_deviceId, node->Input(2)->NodeName(), TensorShape(biasDims), bias);
+
+        auto sum = New<PlusNode<ElemType>>(m_deviceId, node->NodeName());
+        sum->AttachInputs({ product, newBias });
+        auto oldBias = node->Input(2);
+        SubstituteNode(node, sum);
+        SubstituteNode(oldBias, newBias);
+        numFolded++;
+    }
+    return numFolded;
+}
+
+// Replace chains of elementwise nodes, where each only feeds the next one, by a FusedElementwiseNode
+// under the name of the last one. Returns the number of nodes that were fused.
+template <class ElemType>
+size_t ComputationNetwork::FuseElementwiseChains()
+{
+    CompileNetwork();
+
+    // [node type] -> (ElementWiseOperator name, number of arguments) of the nodes that can be fused
+    static const map<wstring, pair<wstring, size_t>> fusableOps =
+    {
+        { OperationNameOf(AbsNode),             { L"Abs",                1 } },
+        { OperationNameOf(CosineNode),          { L"Cosine",             1 } },
+        { OperationNameOf(ExpNode),             { L"Exp",                1 } },
+        { OperationNameOf(FloorNode),           { L"Floor",              1 } },
+        { OperationNameOf(LogNode),             { L"Log",                1 } },
+        { OperationNameOf(NegateNode),          { L"Negate",             1 } },
+        { OperationNameOf(PassNode),            { L"Copy",               1 } },
+        { OperationNameOf(ReciprocalNode),      { L"Reciprocal",         1 } },
+        { OperationNameOf(RectifiedLinearNode), { L"LinearRectifier",    1 } },
+        { OperationNameOf(SigmoidNode),         { L"Sigmoid",            1 } },
+        { OperationNameOf(SinNode),             { L"Sin",                1 } },
+        { OperationNameOf(SqrtNode),            { L"Sqrt",               1 } },
+        { OperationNameOf(TanhNode),            { L"Tanh",               1 } },
+        { OperationNameOf(PlusNode),            { L"Sum",                2 } },
+        { OperationNameOf(MinusNode),           { L"Difference",         2 } },
+        { OperationNameOf(ElementTimesNode),    { L"ElementwiseProduct", 2 } },
+    };
+    auto isFusable = [&](const ComputationNodeBasePtr& node)
+    {
+        return fusableOps.find(node->OperationName()) != fusableOps.end() && !node->IsPartOfLoop();
+    };
+
+    size_t numFused = 0;
+    auto parents = CreateParentsMap();
+    set<ComputationNodeBasePtr> visited;
+    const auto evalOrder = GetEvalOrder(nullptr); // (copy, since the network changes below)
+    for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); iter++)
+    {
+        const auto& last = *iter;
+        if (!isFusable(last) || visited.find(last) != visited.end())
+            continue;
+
+        // walk up from the last node through inputs of the same shape that have no other use
+        deque<ComputationNodeBasePtr> chain(1, last);
+        deque<size_t> chainInputIndices; // [k] index of chain[k] among the inputs of chain[k+1]
+        for (;;)
+        {
+            const auto& node = chain.front();
+            size_t i = 0;
+            for (; i < node->GetNumInputs(); i++)
+            {
+                const auto& input = node->Input(i);
+                if (isFusable(input) && visited.find(input) == visited.end() && parents[input].size() == 1 &&
+                    count(node->GetInputs().begin(), node->GetInputs().end(), input) == 1 &&
+                    count(m_outputNodes.begin(), m_outputNodes.end(), input) == 0 &&
+                    input->GetSampleLayout() == last->GetSampleLayout() && input->GetMBLayout() == last->GetMBLayout())
+                    break;
+            }
+            if (i == node->GetNumInputs())
+                break;
+            chain.push_front(node->Input(i));
+            chainInputIndices.push_front(i);
+        }
+        visited.insert(chain.begin(), chain.end());
+        if (chain.size() < 2)
+            continue;
+
+        // the first node's (first) input is the start value; everything else that goes into the chain is an operand
+        vector<ComputationNodeBasePtr> inputs(1, chain.front()->Input(0));
+        auto operandIndex = [&](const ComputationNodeBasePtr& operand)
+        {
+            auto pos = find(inputs.begin(), inputs.end(), operand);
+            if (pos == inputs.end())
+                pos = inputs.insert(inputs.end(), operand);
+            return (int) (pos - inputs.begin());
+        };
+        vector<typename FusedElementwiseNode<ElemType>::Step> steps;
+        for (size_t k = 0; k < chain.size(); k++)
+        {
+            const auto& node = chain[k];
+            const auto& op = fusableOps.at(node->OperationName());
+            if (op.second == 1)
+                steps.push_back({ op.first, -1, false });
+            else if (k == 0)
+                steps.push_back({ op.first, operandIndex(node->Input(1)), false });
+            else
+            {
+                size_t chainInputIndex = chainInputIndices[k - 1];
+                steps.push_back({ op.first, operandIndex(node->Input(1 - chainInputIndex)), chainInputIndex == 1 });
+            }
+        }
+
+        auto fused = New<FusedElementwiseNode<ElemType>>(m_deviceId, last->NodeName(), steps);
+        fused->AttachInputs(inputs);
+        SubstituteNode(last, fused);
+        numFused += chain.size();
+    }
+    return numFused;
+}
+
+// -----------------------------------------------------------------------
+// OptimizeForInference() -- rewrite the network for inference of the given outputs
+//  - nodes that the outputs do not depend on are removed, e.g. criteria and labels
+//  - precomputed nodes become parameters, and Dropout nodes are bypassed
+//  - values that only depend on parameters are computed once and stored as parameters
+//  - BatchNormalization after Times() or Convolution() is folded into its weights and a bias
+//  - if 'fuseElementwise', chains of elementwise nodes become a single FusedElementwise node
+//    (such networks can only be evaluated, and not be loaded by the V2 library, which has no such operation)
+// Output nodes keep their names, so that the result can be used like the original model.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void ComputationNetwork::OptimizeForInference(const std::vector<std::wstring>& outputNodeNames, bool fuseElementwise)
+{
+    if (!outputNodeNames.empty())
+    {
+        m_outputNodes.clear();
+        for (const auto& name : outputNodeNames)
+            m_outputNodes.push_back(GetNodeFromName(name));
+    }
+    if (m_outputNodes.empty())
+        InvalidArgument("OptimizeForInference: The network has no output nodes. Please specify outputNodeNames.");
+    m_criterionNodes.clear();
+    m_evaluationNodes.clear();
+    InvalidateCompiledNetwork();
+
+    const size_t numNodesBefore = m_nameToNodeMap.size();
+    size_t numRemoved = RemoveNodesNotNeededForOutputs();
+    const size_t numPreComputed = ReplacePreComputedNodesByParameters<ElemType>();
+    const size_t numDropouts = BypassDropoutNodes();
+    numRemoved += RemoveNodesNotNeededForOutputs();
+    const size_t numConstants = FoldConstants<ElemType>();
+    const size_t numBatchNorms = FoldBatchNormalization<ElemType>();
+    numRemoved += RemoveNodesNotNeededForOutputs();
+    const size_t numFused = fuseElementwise ? FuseElementwiseChains<ElemType>() : 0;
+    RemoveNodesNotNeededForOutputs();
+
+    // redo necessary post-processing
+    CompileNetwork();
+
+    fprintf(stderr, "OptimizeForInference: %d nodes before, %d nodes after.\n", (int) numNodesBefore, (int) m_nameToNodeMap.size());
+    fprintf(stderr, "\t%d nodes not needed for the outputs removed\n", (int) numRemoved);
+    fprintf(stderr, "\t%d precomputed nodes replaced by parameters\n", (int) numPreComputed);
+    fprintf(stderr, "\t%d Dropout nodes bypassed\n", (int) numDropouts);
+    fprintf(stderr, "\t%d computations that only depend on parameters folded\n", (int) numConstants);
+    fprintf(stderr, "\t%d BatchNormalization nodes folded into weights\n", (int) numBatchNorms);
+    fprintf(stderr, "\t%d elementwise nodes fused\n", (int) numFused);
+}
+
+template void ComputationNetwork::OptimizeForInference<float>(const std::vector<std::wstring>& outputNodeNames, bool fuseElementwise);
+template void ComputationNetwork::OptimizeForInference<double>(const std::vector<std::wstring>& outputNodeNames, bool fuseElementwise);
+
+}}}
@@ -39,7 +39,9 @@
 #define CNTK_MODEL_VERSION_8 8 // DynamicAxis for inputs
 #define CNTK_MODEL_VERSION_9 9 // Transpose flag in ConvolutionNode to support deconvolution. 
 #define CNTK_MODEL_VERSION_10 10 // Learning rate multiplier for input nodes. 
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_10
+#define CNTK_MODEL_VERSION_11 11 // Dense matrices as aligned blocks (binary files)
+#define CNTK_MODEL_VERSION_12 12 // Quantized inference flag in TimesNode
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_12
 
 extern bool g_shareNodeValueMatrices;
 
@@ -105,6 +107,9 @@ struct /*interface*/ IComputationNode
     virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) = 0;
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) = 0; // request matrices that are needed for gradient computation
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) = 0;  // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void DetachMatrices() = 0;                                       // forget sharable value and gradient matrices (e.g. of a copy of the node), so that they get requested anew
+    virtual void ReleaseValueForRecomputation(MatrixPool& matrixPool) = 0;  // gradient checkpointing: release the value after forward prop although the gradient computation needs it,
+    virtual void RequestValueForRecomputation(MatrixPool& matrixPool) = 0;  // and request it again before it is computed anew for backprop (see ComputationNetwork::AllocateAllMatrices())
 
     // --- optional overrides that describe a feature or property of the node
 
@@ -740,6 +745,11 @@ public:
     // Base-class version makes conservative assumption that it is. Override if not.
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const { return true; }
 
+    // Can ForwardProp() be called once more before backprop, to compute the same value again without other effects?
+    // This allows gradient checkpointing to drop the value after forward prop (see ComputationNetwork::AllocateAllMatrices()).
+    // Override to return false for nodes that draw random numbers, update state, or release temporaries after forward prop.
+    virtual bool CanRecomputeForwardProp() const { return true; }
+
     void SetOutputNeededDuringBackprop(bool f) { m_outputNeededDuringBackprop = f; }
     bool IsOutputNeededDuringBackprop() const { return !g_shareNodeValueMatrices || m_outputNeededDuringBackprop; }
 
@@ -1504,6 +1514,25 @@ public:
         }
     }
 
+    // forget the matrices that a matrix pool provides, e.g. after the node was duplicated into another network
+    // Values that are not sharable (parameters, inputs, precomputed statistics) are kept.
+    virtual void DetachMatrices() override
+    {
+        if (IsValueSharable())
+            m_value = nullptr;
+        m_gradient = nullptr;
+    }
+
+    virtual void ReleaseValueForRecomputation(MatrixPool& matrixPool) override
+    {
+        ReleaseMatrixToPool(m_value, matrixPool);
+    }
+
+    virtual void RequestValueForRecomputation(MatrixPool& matrixPool) override
+    {
+        matrixPool.RequestAgain<ElemType>(&m_value, /*keptWithoutRecomputation=*/IsOutputNeededDuringBackprop());
+    }
+
     void CreateValueMatrixIfNull()
     {
         CreateMatrixIfNull(m_value);
@@ -1531,18 +1560,19 @@ protected:
             matrixPtr = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
+    // The size is planned as that of this node's output; node-internal temporaries are assumed to be of similar size.
     void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            matrixPool.RequestAllocate<ElemType>(m_deviceId, &matrixPtr, GetSampleLayout().GetNumElements(), HasMBLayout());
         }
     }
 
     void ReleaseMatrixToPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
     {
         assert(matrixPtr != nullptr);
-        matrixPool.Release<ElemType>(matrixPtr);
+        matrixPool.Release<ElemType>(&matrixPtr);
     }
 
 public:
@@ -1838,6 +1868,9 @@ public:
     virtual ComputationNodeBasePtr Duplicate(const std::wstring& newName, const CopyNodeFlags flags) const override { NOT_IMPLEMENTED; }
     virtual double Get00Element() const override { NOT_IMPLEMENTED; }
     virtual MatrixBasePtr ValuePtr() const override { NOT_IMPLEMENTED; }
+    virtual void DetachMatrices() override { NOT_IMPLEMENTED; }
+    virtual void ReleaseValueForRecomputation(MatrixPool&) override { NOT_IMPLEMENTED; }
+    virtual void RequestValueForRecomputation(MatrixPool&) override { NOT_IMPLEMENTED; }
     virtual void UpdateFunctionMBSize() override { NOT_IMPLEMENTED; }
     virtual void AttachInputs(const std::vector<ComputationNodeBasePtr>& inputs) override { NOT_IMPLEMENTED; }
     virtual void PrintSelf(bool) const override { NOT_IMPLEMENTED; }
@@ -1904,6 +1937,29 @@ struct IRecurrentNode { virtual int GetRecurrenceSteppingDirection() const = 0;
 
 struct IFreezable { virtual void FreezeParameters() { } };
 
+// =======================================================================
+// IQuantizableNode -- nodes that can evaluate with quantized integer arithmetic
+// This is an evaluation-only mode, which is ignored while training.
+// =======================================================================
+
+struct IQuantizableNode
+{
+    virtual void SetQuantizedInference(bool enable) = 0;
+    virtual bool GetQuantizedInference() const = 0;
+};
+
+// =======================================================================
+// IReorderableStateNode -- nodes that carry state per parallel sequence into the next minibatch,
+// and can reorder that state, e.g. for beam search, where each step continues a different set of hypotheses
+// =======================================================================
+
+struct IReorderableStateNode
+{
+    // After this, parallel sequence s of the next minibatch continues from parallel sequence fromSequences[s]
+    // of the last time step of the previous minibatch. The number of parallel sequences may change.
+    virtual void ReorderState(const std::vector<size_t>& fromSequences) = 0;
+};
+
 // =======================================================================
 // PreComputedNodeBase -- interface implemented by ComputationNodes that precompute
 // TODO: We can use this interface in more places.
@@ -139,6 +139,8 @@ public:
         fstream << "PoolKind: " << (int)m_poolKind << "\n";
     }
 
+    bool IsTransposed() const { return m_transpose; }
+
 protected:
     TensorShape m_kernelShape;
     TensorShape m_mapCount;
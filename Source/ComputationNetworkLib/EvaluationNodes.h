@@ -125,6 +125,9 @@ public:
         ReleaseMatrixToPool(m_maxValues, matrixPool);
     }
 
+    // the temporaries above are released after forward prop
+    virtual bool CanRecomputeForwardProp() const override { return false; }
+
 private:
     shared_ptr<Matrix<ElemType>> m_maxIndexes0, m_maxIndexes1;
     shared_ptr<Matrix<ElemType>> m_maxValues;
@@ -6,8 +6,10 @@
 
 #include "Basics.h"
 #include "ComputationNode.h"
+#include "InputAndParamNodes.h"
 #include "Matrix.h"
 #include "TensorView.h"
+#include "QuantizedMultiplier.h"
 
 #include <unordered_set>
 #include <map>
@@ -233,13 +235,13 @@ template class ElementTimesNode<double>;
 // -----------------------------------------------------------------------
 
 template <class ElemType, bool m_transpose>
-class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>
+class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>, public IQuantizableNode
 {
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembers; using Base::OperationName;                                                                                                                           \
 
 public:
     TimesNodeBase(DEVICEID_TYPE deviceId, const wstring& name, size_t outputRank = 1)
-        : Base(deviceId, name), m_outputRank(outputRank)
+        : Base(deviceId, name), m_outputRank(outputRank), m_quantizedInference(false)
     {
     }
 
@@ -250,6 +252,9 @@ public:
         {
             auto node = dynamic_pointer_cast<TimesNodeBase<ElemType, m_transpose>>(nodeP);
             node->m_outputRank = m_outputRank;
+            node->m_quantizedInference = m_quantizedInference;
+            // the clone shares the quantized weights, which do not change, but multiplies with its own working memory
+            node->m_quantizedWeights = m_quantizedWeights ? make_shared<QuantizedMultiplier<ElemType>>(*m_quantizedWeights) : nullptr;
         }
     }
 
@@ -257,6 +262,7 @@ public:
     {
         Base::Save(fstream);
         fstream << m_outputRank;
+        fstream << m_quantizedInference;
     }
 
     virtual void Load(File& fstream, size_t modelVersion) override
@@ -266,7 +272,22 @@ public:
             fstream >> m_outputRank;
         else
             m_outputRank = 1;
+        if (modelVersion >= CNTK_MODEL_VERSION_12)
+            fstream >> m_quantizedInference;
+        else
+            m_quantizedInference = false;
+        m_quantizedWeights.reset();
+    }
+
+    // Quantized inference: In inference mode, W * X with a parameter W and dense CPU data X is computed with 16-bit integers.
+    // W is quantized at the first use and then assumed not to change until the network is trained again.
+    // Not supported for TransposeTimes.
+    virtual void SetQuantizedInference(bool enable) override
+    {
+        m_quantizedInference = enable;
+        m_quantizedWeights.reset();
     }
+    virtual bool GetQuantizedInference() const override { return m_quantizedInference; }
 
 private:
     // if the left argument of the matrix product (A) has a time axis, it can only be applied sample by sample
@@ -300,6 +321,13 @@ public:
             return;
         }
 
+        if (UseQuantizedInference())
+        {
+            auto output = ValueFor(fr);
+            m_quantizedWeights->Multiply(Input(1)->ValueFor(fr), output);
+            return;
+        }
+
         // TensorView::DoMatrixProductOf() will reduce each tensor object into a 2D tensor (or fail if it cannot)
         // and recreate actual Matrix objects (in case of sparse, they must be identical to the original tensor storage object).
         // Transposition is applied after flattening into 2D, but only allowed if the input sample is 2D anyway.
@@ -464,7 +492,31 @@ public:
     }
 
 private:
+    // check whether the quantized product applies, and quantize the weights if not done yet
+    bool UseQuantizedInference()
+    {
+        bool transpose = m_transpose; // (avoids a compiler warning C4127: conditional expression is constant)
+        bool applies = m_quantizedInference && !transpose && Environment().IsInferring() && m_deviceId == CPUDEVICE &&
+                       Input(0)->OperationName() == OperationNameOf(LearnableParameter) && !Input(0)->HasMBLayout() &&
+                       Input(1)->Value().GetMatrixType() == DENSE;
+        // W [M x K] must be used as a plain matrix, i.e. X may not have dimensions beyond the K reduced ones
+        size_t numRows = 1;
+        for (size_t k = 0; k < m_outputRank && applies; k++)
+            numRows *= Input(0)->GetSampleLayout()[k];
+        applies = applies && numRows == GetSampleMatrixNumRows() && numRows * Input(1)->GetSampleMatrixNumRows() == Input(0)->GetSampleLayout().GetNumElements();
+        if (!applies)
+        {
+            m_quantizedWeights.reset(); // the weights may change while we are not using them, e.g. in training
+            return false;
+        }
+        if (!m_quantizedWeights)
+            m_quantizedWeights = make_shared<QuantizedMultiplier<ElemType>>(Input(0)->Value().Reshaped(numRows, Input(1)->GetSampleMatrixNumRows()));
+        return true;
+    }
+
     size_t m_outputRank;
+    bool m_quantizedInference;
+    shared_ptr<QuantizedMultiplier<ElemType>> m_quantizedWeights; // quantized Input(0), if quantized inference is active
 };
 
 // -----------------------------------------------------------------------
@@ -9,6 +9,8 @@
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <numeric>
+#include <climits>
 #include <stdlib.h>
 
 #include "Basics.h"
@@ -20,57 +22,271 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
+//
+// Memory sharing is planned statically. ComputationNetwork::AllocateAllMatrices() simulates one forward and backward pass,
+// during which nodes request and release their matrices through this class. Each request is only recorded, together with
+// its estimated size and the simulation steps at which it was requested and released (its lifetime).
+// OptimizedMemoryAllocation() then packs these intervals into as few buffers as possible: requests are visited by decreasing
+// size and each one goes into the best-fitting (smallest sufficient) buffer whose occupants' lifetimes do not overlap its own.
+// Since similarly sized requests share a buffer, buffers do not have to grow to the largest size they ever see, and the result
+// no longer depends on the order in which matrices are released.
+// A matrix may have several lifetimes if it is released and requested again (RequestAgain()); it keeps one buffer throughout.
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>>  m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+    static const int NotReleased = INT_MAX;
+
+    // one Request() call, i.e. one matrix that a node needs between two simulation steps
+    // A matrix that is released and requested again (see RequestAgain()) keeps its buffer and gets another lifetime.
+    template <class ElemType>
+    struct MemRequestInfo
+    {
+        DEVICEID_TYPE deviceId;
+        shared_ptr<Matrix<ElemType>>* pMatrixPtr; // where the planned matrix goes
+        size_t matrixSize;                        // in elements; per minibatch column if mbScale
+        bool mbScale;                             // size scales with the minibatch size
+        vector<pair<int, int>> lifetimes;         // (allocStep, releaseStep) in increasing order; releaseStep is NotReleased if never released
+        bool keptWithoutRecomputation;            // whether the matrix would have stayed live between its lifetimes if it was not recomputed
+
+        MemRequestInfo(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>* pMatrixPtr, size_t matrixSize, bool mbScale, int allocStep)
+            : deviceId(deviceId), pMatrixPtr(pMatrixPtr), matrixSize(matrixSize), mbScale(mbScale), lifetimes(1, make_pair(allocStep, NotReleased)), keptWithoutRecomputation(false)
+        {
+        }
+
+        size_t EffectiveSize(size_t numColsHint) const { return matrixSize * (mbScale ? numColsHint : 1); }
+        bool IsReleased() const { return lifetimes.back().second != NotReleased; }
+        // the lifetimes as they would be without recomputation: one from the first request to the last release, or only the first one
+        vector<pair<int, int>> LifetimesWithoutRecomputation() const
+        {
+            if (keptWithoutRecomputation)
+                return vector<pair<int, int>>(1, make_pair(lifetimes.front().first, lifetimes.back().second));
+            return vector<pair<int, int>>(1, lifetimes.front());
+        }
+        static bool Overlap(const vector<pair<int, int>>& lifetimes, const vector<pair<int, int>>& otherLifetimes)
+        {
+            for (const auto& lifetime : lifetimes)
+                for (const auto& otherLifetime : otherLifetimes)
+                    if (lifetime.first <= otherLifetime.second && otherLifetime.first <= lifetime.second)
+                        return true;
+            return false;
+        }
+        bool Overlaps(const MemRequestInfo& other, bool withoutRecomputation) const
+        {
+            if (withoutRecomputation)
+                return Overlap(LifetimesWithoutRecomputation(), other.LifetimesWithoutRecomputation());
+            return Overlap(lifetimes, other.lifetimes);
+        }
+    };
+
+    // one shared buffer, and the requests that were packed into it
+    struct MemBlock
+    {
+        DEVICEID_TYPE deviceId;
+        size_t size;                 // in elements, as planned
+        vector<size_t> requestIds;
+    };
+
+    vector<MemRequestInfo<float>>  m_floatMemRequestInfos;
+    vector<MemRequestInfo<double>> m_doubleMemRequestInfos;
+    vector<shared_ptr<Matrix<float>>>  m_floatBlocks;
+    vector<shared_ptr<Matrix<double>>> m_doubleBlocks;
+    int m_stepCounter = 0;     // simulation time
+    vector<vector<pair<size_t, bool>>> m_plannedBlocks; // [buffer] -> (bytes, mbScale) of each request packed into it, over all element types
+    vector<vector<pair<size_t, bool>>> m_plannedBlocksWithoutRecomputation; // same for the plan without recomputation, if any matrix is recomputed
+
+    template <class ElemType>
+    vector<MemRequestInfo<ElemType>>& GetMemRequestInfos();
+    template <class ElemType>
+    vector<shared_ptr<Matrix<ElemType>>>& GetBlocks();
 
+    // best-fit interval packing of all recorded requests into buffers (see above)
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    vector<MemBlock> PackRequests(size_t numColsHint, bool withoutRecomputation)
+    {
+        vector<MemRequestInfo<ElemType>>& memInfos = GetMemRequestInfos<ElemType>();
+
+        // largest first; ties in request order, to keep the plan deterministic
+        vector<size_t> order(memInfos.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return memInfos[a].EffectiveSize(numColsHint) > memInfos[b].EffectiveSize(numColsHint); });
+
+        vector<MemBlock> blocks;
+        for (size_t id : order)
+        {
+            const MemRequestInfo<ElemType>& memInfo = memInfos[id];
+            const size_t size = memInfo.EffectiveSize(numColsHint);
+            size_t bestBlock = SIZE_MAX;
+#ifndef SUPRESS_MEMSHARING
+            for (size_t b = 0; b < blocks.size(); b++)
+            {
+                const MemBlock& block = blocks[b];
+                if (block.deviceId != memInfo.deviceId || block.size < size)
+                    continue;
+                if (bestBlock != SIZE_MAX && blocks[bestBlock].size <= block.size)
+                    continue;
+                bool isFree = none_of(block.requestIds.begin(), block.requestIds.end(), [&](size_t other) { return memInfos[other].Overlaps(memInfo, withoutRecomputation); });
+                if (isFree)
+                    bestBlock = b;
+            }
+#endif
+            if (bestBlock == SIZE_MAX) // nothing fits: open a new buffer of this size (all later requests are no larger)
+            {
+                bestBlock = blocks.size();
+                blocks.push_back(MemBlock{memInfo.deviceId, size, vector<size_t>()});
+            }
+            blocks[bestBlock].requestIds.push_back(id);
+        }
+        return blocks;
+    }
 
 public:
     // release here means the matrix can be put back and shared by others
+    // Matrices that were not obtained through RequestAllocate() are ignored.
     template <class ElemType>
-    void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
+    void Release(shared_ptr<Matrix<ElemType>>* pMatrixPtr)
     {
-        if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
+        if (pMatrixPtr == nullptr || *pMatrixPtr == nullptr || (*pMatrixPtr)->GetMatrixType() == SPARSE)
             LogicError("MatrixPool::Release: freeMatrix should not be null or sparse.");
 //#define SUPRESS_MEMSHARING // #define this to disable memory sharing through this structure
         // TODO: Make this a runtime option.
 #ifndef SUPRESS_MEMSHARING
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-#ifdef _DEBUG
-        for (int i = 0; i < releasedMatrices.size(); i++)
-        {
-            if (releasedMatrices[i] == freeMatrix)
-                RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
-        }
-
-#endif
-        releasedMatrices.push_back(freeMatrix);
+        vector<MemRequestInfo<ElemType>>& memInfos = GetMemRequestInfos<ElemType>();
+        auto memInfo = find_if(memInfos.rbegin(), memInfos.rend(), [pMatrixPtr](const MemRequestInfo<ElemType>& info) { return info.pMatrixPtr == pMatrixPtr; });
+        if (memInfo == memInfos.rend())
+            return;
+        if (memInfo->IsReleased())
+            RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
+        memInfo->lifetimes.back().second = m_stepCounter++;
 #endif
     }
 
+    // Record that a matrix that was released is needed again, e.g. a value that is computed once more before backprop
+    // (gradient checkpointing). It keeps the buffer it was planned into, which others may use in between.
+    // 'keptWithoutRecomputation' tells whether it would have stayed live in between otherwise; this is only used to report the memory saved.
+    // Matrices that were not obtained through RequestAllocate() are ignored.
+    template <class ElemType>
+    void RequestAgain(shared_ptr<Matrix<ElemType>>* pMatrixPtr, bool keptWithoutRecomputation)
+    {
+        vector<MemRequestInfo<ElemType>>& memInfos = GetMemRequestInfos<ElemType>();
+        auto memInfo = find_if(memInfos.rbegin(), memInfos.rend(), [pMatrixPtr](const MemRequestInfo<ElemType>& info) { return info.pMatrixPtr == pMatrixPtr; });
+        if (memInfo == memInfos.rend())
+            return;
+        if (!memInfo->IsReleased())
+            LogicError("MatrixPool::RequestAgain: matrix has not been released.");
+        memInfo->lifetimes.push_back(make_pair(m_stepCounter++, NotReleased));
+        memInfo->keptWithoutRecomputation |= keptWithoutRecomputation;
+    }
+
+    // Record a request for a matrix of 'matrixSize' elements (per minibatch column if 'mbScale').
+    // *pMatrixPtr receives an empty placeholder right away, which OptimizedMemoryAllocation() replaces by the planned buffer.
+    template <class ElemType>
+    void RequestAllocate(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>* pMatrixPtr, size_t matrixSize, bool mbScale)
+    {
+        vector<MemRequestInfo<ElemType>>& memInfos = GetMemRequestInfos<ElemType>();
+        memInfos.push_back(MemRequestInfo<ElemType>(deviceId, pMatrixPtr, max(matrixSize, (size_t) 1), mbScale, m_stepCounter++));
+        *pMatrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+    }
+
+    // Assign buffers to all recorded requests (best-fit interval packing, see above) and hand them out.
+    // 'numColsHint' is the minibatch size assumed for matrices that scale with it. traceLevel > 0 prints a summary.
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    void OptimizedMemoryAllocation(size_t numColsHint, int traceLevel = 0)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-        shared_ptr<Matrix<ElemType>> matrixPtr;
-        if (releasedMatrices.empty())
+        vector<MemRequestInfo<ElemType>>& memInfos = GetMemRequestInfos<ElemType>();
+        if (memInfos.empty())
+            return;
+        numColsHint = max(numColsHint, (size_t) 1);
+
+        vector<MemBlock> blocks = PackRequests<ElemType>(numColsHint, /*withoutRecomputation=*/false);
+
+        // create one matrix per buffer and hand it to all its requesters
+        vector<shared_ptr<Matrix<ElemType>>>& blockMatrices = GetBlocks<ElemType>();
+        size_t plannedSize = 0;
+        for (const MemBlock& block : blocks)
         {
-            matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            auto matrixPtr = make_shared<Matrix<ElemType>>(block.deviceId);
+            vector<pair<size_t, bool>> plannedBlock;
+            for (size_t id : block.requestIds)
+            {
+                *memInfos[id].pMatrixPtr = matrixPtr;
+                plannedBlock.push_back(make_pair(memInfos[id].matrixSize * sizeof(ElemType), memInfos[id].mbScale));
+            }
+            blockMatrices.push_back(matrixPtr);
+            m_plannedBlocks.push_back(move(plannedBlock));
+            plannedSize += block.size;
         }
-        else
+
+        // for comparison: the plan if values were kept instead of recomputed
+        bool hasRecomputedMatrices = false;
+        for (const auto& memInfo : memInfos)
+            hasRecomputedMatrices |= memInfo.lifetimes.size() > 1;
+        size_t plannedSizeWithoutRecomputation = 0;
+        if (hasRecomputedMatrices)
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
+            for (const MemBlock& block : PackRequests<ElemType>(numColsHint, /*withoutRecomputation=*/true))
+            {
+                vector<pair<size_t, bool>> plannedBlock;
+                for (size_t id : block.requestIds)
+                    plannedBlock.push_back(make_pair(memInfos[id].matrixSize * sizeof(ElemType), memInfos[id].mbScale));
+                m_plannedBlocksWithoutRecomputation.push_back(move(plannedBlock));
+                plannedSizeWithoutRecomputation += block.size;
+            }
         }
 
-        if (!matrixPtr) // this can't really happen
-            LogicError("MatrixPool::Request: failed to get a valid matrix.");
+        if (traceLevel > 0)
+        {
+            // what not sharing at all would take, and the most that is ever live at once (no plan can do with less)
+            size_t unsharedSize = 0;
+            vector<pair<int, ptrdiff_t>> events; // (step, size delta)
+            for (const auto& memInfo : memInfos)
+            {
+                const size_t size = memInfo.EffectiveSize(numColsHint);
+                unsharedSize += size;
+                for (const auto& lifetime : memInfo.lifetimes)
+                {
+                    events.push_back(make_pair(lifetime.first, (ptrdiff_t) size));
+                    if (lifetime.second != NotReleased)
+                        events.push_back(make_pair(lifetime.second, -(ptrdiff_t) size));
+                }
+            }
+            sort(events.begin(), events.end());
+            ptrdiff_t liveSize = 0, maxLiveSize = 0;
+            for (const auto& event : events)
+            {
+                liveSize += event.second;
+                maxLiveSize = max(maxLiveSize, liveSize);
+            }
+
+            const char* elemTypeName = sizeof(ElemType) == sizeof(double) ? "double" : "float";
+            const double toMB = sizeof(ElemType) / 1024.0 / 1024.0;
+            fprintf(stderr, "\nMemory plan (%s): %d matrices in %d shared buffers, assuming %d columns per minibatch.\n",
+                    elemTypeName, (int) memInfos.size(), (int) blocks.size(), (int) numColsHint);
+            fprintf(stderr, "Memory plan (%s): planned peak %.2f MB (at least %.2f MB are live at once), without sharing %.2f MB.\n",
+                    elemTypeName, plannedSize * toMB, maxLiveSize * toMB, unsharedSize * toMB);
+            if (hasRecomputedMatrices)
+                fprintf(stderr, "Memory plan (%s): recomputing values saves %.2f MB (planned %.2f MB without recomputation).\n",
+                        elemTypeName, ((ptrdiff_t) plannedSizeWithoutRecomputation - (ptrdiff_t) plannedSize) * toMB, plannedSizeWithoutRecomputation * toMB);
+        }
 
-        return matrixPtr;
+        memInfos.clear();
     }
+
+    // total size of the planned buffers for a given minibatch size
+    // With 'withoutRecomputation', that of the plan without recomputing values; 0 if no value is recomputed.
+    size_t GetPlannedBytes(size_t numCols, bool withoutRecomputation = false) const
+    {
+        size_t plannedBytes = 0;
+        for (const auto& plannedBlock : withoutRecomputation ? m_plannedBlocksWithoutRecomputation : m_plannedBlocks)
+        {
+            size_t blockBytes = 0;
+            for (const auto& request : plannedBlock)
+                blockBytes = max(blockBytes, request.first * (request.second ? numCols : 1));
+            plannedBytes += blockBytes;
+        }
+        return plannedBytes;
+    }
+
+    // total size the shared buffers have actually been allocated to so far; buffers only grow, so this is the peak
+    size_t GetAllocatedBytes();
 };
 
 }}}
@@ -0,0 +1,256 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "NodeProfiler.h"
+#include "ComputationNode.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static const char* PhaseName(NodeProfiler::Phase phase)
+{
+    return phase == NodeProfiler::Phase::forward ? "forward" : "backward";
+}
+
+// escape a name for use inside a JSON string
+static string JsonString(const wstring& s)
+{
+    string result;
+    for (char c : string(msra::strfun::utf8(s)))
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char) c < 0x20)
+            result += msra::strfun::strprintf("\\u%04x", (int) c);
+        else
+            result += c;
+    }
+    return result;
+}
+
+NodeProfiler::NodeProfiler(size_t numMinibatchesToProfile, size_t numMinibatchesToSkip, size_t maxTimelineEvents)
+    : m_numMinibatchesToProfile(numMinibatchesToProfile),
+      m_numMinibatchesToSkip(numMinibatchesToSkip),
+      m_maxTimelineEvents(maxTimelineEvents),
+      m_numMinibatchesSeen(0),
+      m_isActive(false),
+      m_numDroppedTimelineEvents(0)
+{
+}
+
+void NodeProfiler::NextMinibatch()
+{
+    m_numMinibatchesSeen++;
+    bool wasActive = m_isActive;
+    m_isActive = m_numMinibatchesSeen > m_numMinibatchesToSkip && !IsDone();
+    if (m_isActive && !wasActive)
+        m_profileStart = Clock::now();
+    else if (!m_isActive && wasActive)
+        m_profileEnd = Clock::now();
+}
+
+size_t NodeProfiler::GetNumProfiledMinibatches() const
+{
+    if (m_numMinibatchesSeen <= m_numMinibatchesToSkip)
+        return 0;
+    return min(m_numMinibatchesSeen - m_numMinibatchesToSkip, m_numMinibatchesToProfile);
+}
+
+// wall time from the start of the first profiled minibatch to the end of the last (or to now, if still active)
+double NodeProfiler::ProfiledSeconds() const
+{
+    if (GetNumProfiledMinibatches() == 0)
+        return 0;
+    return chrono::duration<double>((m_isActive ? Clock::now() : m_profileEnd) - m_profileStart).count();
+}
+
+size_t NodeProfiler::EntryIndex(const ComputationNodeBase& node)
+{
+    auto iter = m_entryIndices.find(&node);
+    if (iter != m_entryIndices.end())
+        return iter->second;
+
+    Entry entry;
+    entry.name = node.NodeName();
+    entry.operationName = node.OperationName();
+    entry.isLoop = dynamic_cast<const FlowControlNode*>(&node) != nullptr;
+    m_entries.push_back(entry);
+    m_entryIndices[&node] = m_entries.size() - 1;
+    return m_entries.size() - 1;
+}
+
+void NodeProfiler::Record(const ComputationNodeBase& node, Phase phase, Clock::time_point start, size_t bytesAllocated, bool addToTimeline)
+{
+    if (!m_isActive)
+        return;
+    auto end = Clock::now();
+
+    size_t index = EntryIndex(node);
+    Stats& stats = m_entries[index].stats[(size_t) phase];
+    stats.numCalls++;
+    stats.seconds += chrono::duration<double>(end - start).count();
+    stats.bytesAllocated += bytesAllocated;
+
+    if (!addToTimeline)
+        return;
+    if (m_timeline.size() >= m_maxTimelineEvents)
+    {
+        m_numDroppedTimelineEvents++;
+        return;
+    }
+    TimelineEvent event;
+    event.isSpan = false;
+    event.index = index;
+    event.phase = phase;
+    event.startMicroseconds = chrono::duration<double, micro>(start - m_profileStart).count();
+    event.durationMicroseconds = chrono::duration<double, micro>(end - start).count();
+    event.bytesAllocated = bytesAllocated;
+    m_timeline.push_back(event);
+}
+
+void NodeProfiler::RecordSpan(const wstring& name, Clock::time_point start)
+{
+    if (!m_isActive)
+        return;
+    auto end = Clock::now();
+
+    // there are only a handful of these, so a linear search is fine
+    size_t index = 0;
+    while (index < m_spans.size() && m_spans[index].name != name)
+        index++;
+    if (index == m_spans.size())
+    {
+        m_spans.push_back(Span());
+        m_spans.back().name = name;
+    }
+    Stats& stats = m_spans[index].stats;
+    stats.numCalls++;
+    stats.seconds += chrono::duration<double>(end - start).count();
+
+    if (m_timeline.size() >= m_maxTimelineEvents)
+    {
+        m_numDroppedTimelineEvents++;
+        return;
+    }
+    TimelineEvent event;
+    event.isSpan = true;
+    event.index = index;
+    event.phase = Phase::forward; // (unused)
+    event.startMicroseconds = chrono::duration<double, micro>(start - m_profileStart).count();
+    event.durationMicroseconds = chrono::duration<double, micro>(end - start).count();
+    event.bytesAllocated = 0;
+    m_timeline.push_back(event);
+}
+
+void NodeProfiler::WriteSummary(FILE* f, size_t maxNodes) const
+{
+    double totalSeconds = ProfiledSeconds();
+    fprintf(f, "\nNode profile of %d minibatches (after skipping %d): %.3f ms total, %.3f ms per minibatch.\n",
+            (int) GetNumProfiledMinibatches(), (int) m_numMinibatchesToSkip, totalSeconds * 1000, totalSeconds * 1000 / max(GetNumProfiledMinibatches(), (size_t) 1));
+    if (totalSeconds == 0)
+        return;
+
+    auto printHeader = [f](const char* what)
+    {
+        fprintf(f, "\n%-40s %-8s %10s %12s %7s %10s %12s\n", what, "phase", "calls", "time [ms]", "%", "avg [us]", "alloc [KB]");
+    };
+    auto printRow = [f, totalSeconds](const string& what, const char* phase, const Stats& stats)
+    {
+        fprintf(f, "%-40s %-8s %10d %12.3f %6.2f%% %10.2f %12.3f\n", what.c_str(), phase, (int) stats.numCalls, stats.seconds * 1000,
+                100 * stats.seconds / totalSeconds, stats.seconds * 1e6 / max(stats.numCalls, (size_t) 1), stats.bytesAllocated / 1024.0);
+    };
+    typedef pair<pair<wstring, NodeProfiler::Phase>, Stats> Row;
+    auto byTimeDescending = [](const Row& a, const Row& b)
+    {
+        return a.second.seconds > b.second.seconds;
+    };
+
+    // aggregate by operation type, not counting loops, whose member nodes are recorded as well
+    map<pair<wstring, Phase>, Stats> byOperation;
+    for (const auto& entry : m_entries)
+    {
+        if (entry.isLoop)
+            continue;
+        for (size_t phase = 0; phase < (size_t) Phase::numPhases; phase++)
+        {
+            if (entry.stats[phase].numCalls > 0)
+                byOperation[make_pair(entry.operationName, (Phase) phase)].Add(entry.stats[phase]);
+        }
+    }
+    vector<Row> rows(byOperation.begin(), byOperation.end());
+    sort(rows.begin(), rows.end(), byTimeDescending);
+    Stats total;
+    printHeader("operation");
+    for (const auto& row : rows)
+    {
+        printRow(msra::strfun::utf8(row.first.first), PhaseName(row.first.second), row.second);
+        total.Add(row.second);
+    }
+    printRow("(all nodes)", "", total);
+
+    // the most expensive individual nodes, including loops
+    rows.clear();
+    for (const auto& entry : m_entries)
+    {
+        for (size_t phase = 0; phase < (size_t) Phase::numPhases; phase++)
+        {
+            if (entry.stats[phase].numCalls > 0)
+                rows.push_back(Row(make_pair(entry.name + L" (" + entry.operationName + L")", (Phase) phase), entry.stats[phase]));
+        }
+    }
+    sort(rows.begin(), rows.end(), byTimeDescending);
+    if (rows.size() > maxNodes)
+        rows.resize(maxNodes);
+    printHeader("node");
+    for (const auto& row : rows)
+        printRow(msra::strfun::utf8(row.first.first), PhaseName(row.first.second), row.second);
+
+    // time outside of the network
+    if (!m_spans.empty())
+    {
+        printHeader("other");
+        for (const auto& span : m_spans)
+            printRow(msra::strfun::utf8(span.name), "", span.stats);
+    }
+
+    if (m_numDroppedTimelineEvents > 0)
+        fprintf(f, "\nWARNING: The timeline is truncated; %d events were dropped.\n", (int) m_numDroppedTimelineEvents);
+    fflush(f);
+}
+
+void NodeProfiler::WriteTimeline(const wstring& path) const
+{
+    msra::files::make_intermediate_dirs(path);
+    FILE* f = fopenOrDie(path, L"w");
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < m_timeline.size(); i++)
+    {
+        const auto& event = m_timeline[i];
+        if (event.isSpan)
+        {
+            fprintf(f, "{\"name\":\"%s\",\"cat\":\"other\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":0}",
+                    JsonString(m_spans[event.index].name).c_str(), event.startMicroseconds, event.durationMicroseconds);
+        }
+        else
+        {
+            const auto& entry = m_entries[event.index];
+            fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":0,\"args\":{\"operation\":\"%s\",\"allocatedBytes\":%llu}}",
+                    JsonString(entry.name).c_str(), PhaseName(event.phase), event.startMicroseconds, event.durationMicroseconds,
+                    JsonString(entry.operationName).c_str(), (unsigned long long) event.bytesAllocated);
+        }
+        fputs(i + 1 < m_timeline.size() ? ",\n" : "\n", f);
+    }
+    fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+    fcloseOrDie(f);
+}
+
+}}}
@@ -0,0 +1,150 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "CommonMatrix.h" // for CPUMemoryAllocationCounter
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdio.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ComputationNodeBase;
+
+// ===========================================================================
+// NodeProfiler -- per-node CPU profile of a window of minibatches
+//
+// The network's traversal nodes report the wall time and the CPU matrix bytes
+// allocated by every ForwardProp() and Backprop() call of every node. These
+// are aggregated per node and per operation type, and can be written as a
+// table, or as a timeline in the Chrome trace-event format (chrome://tracing).
+//
+// Profiling starts after 'numMinibatchesToSkip' calls to NextMinibatch() (to
+// exclude warm-up), and ends after another 'numMinibatchesToProfile'. Outside
+// of that window, and if no profiler is set, the cost is a pointer check per node.
+// Steps inside recurrent loops are only aggregated; the timeline shows each
+// loop as one event per minibatch, which keeps the number of events bounded.
+//
+// This is not thread-safe; it is meant to be called from the thread that runs the network.
+// ===========================================================================
+
+class NodeProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Phase
+    {
+        forward,
+        backward,
+        numPhases
+    };
+
+    NodeProfiler(size_t numMinibatchesToProfile, size_t numMinibatchesToSkip = 0, size_t maxTimelineEvents = 1000000);
+
+    // to be called at the start of each minibatch
+    void NextMinibatch();
+    bool IsActive() const { return m_isActive; }
+    bool IsDone() const { return m_numMinibatchesSeen > m_numMinibatchesToSkip + m_numMinibatchesToProfile; }
+    size_t GetNumProfiledMinibatches() const;
+
+    // record one ForwardProp() or Backprop() call of a node that began at 'start'
+    void Record(const ComputationNodeBase& node, Phase phase, Clock::time_point start, size_t bytesAllocated, bool addToTimeline);
+    // record work outside of the network that began at 'start', e.g. reading the minibatch or updating the model
+    void RecordSpan(const std::wstring& name, Clock::time_point start);
+
+    // print the aggregated profile
+    void WriteSummary(FILE* f, size_t maxNodes = 20) const;
+    // write the timeline as a Chrome trace-event JSON file
+    void WriteTimeline(const std::wstring& path) const;
+
+    // measures one call of a node for the lifetime of this object; does nothing if the profiler is null or not active
+    class Scope
+    {
+    public:
+        Scope(NodeProfiler* profiler, const ComputationNodeBase& node, Phase phase, bool addToTimeline = true)
+            : m_profiler((profiler && profiler->IsActive()) ? profiler : nullptr), m_node(node), m_phase(phase), m_addToTimeline(addToTimeline)
+        {
+            if (m_profiler)
+            {
+                m_bytesAllocated = CPUMemoryAllocationCounter::BytesAllocatedByThisThread();
+                m_start = Clock::now();
+            }
+        }
+        ~Scope()
+        {
+            if (m_profiler)
+                m_profiler->Record(m_node, m_phase, m_start, CPUMemoryAllocationCounter::BytesAllocatedByThisThread() - m_bytesAllocated, m_addToTimeline);
+        }
+
+    private:
+        NodeProfiler* m_profiler;
+        const ComputationNodeBase& m_node;
+        Phase m_phase;
+        bool m_addToTimeline;
+        size_t m_bytesAllocated;
+        Clock::time_point m_start;
+
+        DISABLE_COPY_AND_MOVE(Scope);
+    };
+
+private:
+    struct Stats
+    {
+        size_t numCalls;
+        double seconds;
+        size_t bytesAllocated;
+        Stats() : numCalls(0), seconds(0), bytesAllocated(0) { }
+        void Add(const Stats& other) { numCalls += other.numCalls; seconds += other.seconds; bytesAllocated += other.bytesAllocated; }
+    };
+
+    struct Entry
+    {
+        std::wstring name;
+        std::wstring operationName;
+        bool isLoop; // recurrent loops are listed as nodes, but are not counted as an operation since their members are
+        Stats stats[(size_t) Phase::numPhases];
+    };
+
+    struct Span
+    {
+        std::wstring name;
+        Stats stats;
+    };
+
+    struct TimelineEvent
+    {
+        bool isSpan;
+        size_t index; // into m_spans if isSpan, else into m_entries
+        Phase phase;
+        double startMicroseconds; // relative to m_profileStart
+        double durationMicroseconds;
+        size_t bytesAllocated;
+    };
+
+    size_t EntryIndex(const ComputationNodeBase& node);
+    double ProfiledSeconds() const;
+
+    size_t m_numMinibatchesToProfile;
+    size_t m_numMinibatchesToSkip;
+    size_t m_maxTimelineEvents;
+    size_t m_numMinibatchesSeen;
+    bool m_isActive;
+    Clock::time_point m_profileStart;
+    Clock::time_point m_profileEnd;
+
+    std::vector<Entry> m_entries;
+    std::unordered_map<const ComputationNodeBase*, size_t> m_entryIndices;
+    std::vector<Span> m_spans;
+    std::vector<TimelineEvent> m_timeline;
+    size_t m_numDroppedTimelineEvents;
+};
+
+}}}
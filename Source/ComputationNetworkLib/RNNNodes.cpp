@@ -0,0 +1,511 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "RNNNodes.h"
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// elementwise passes over [H x S] are only worth spreading over threads if they are big enough
+static const size_t c_minElementsForParallelStep = 4096;
+
+template <class ElemType>
+static inline ElemType Sigmoid(ElemType x)
+{
+    return 1 / (1 + std::exp(-x));
+}
+
+// -----------------------------------------------------------------------
+// RNNStackNode (weights, input, hiddenDims, numLayers=1, recurrentOp='lstm')
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+RNNStackNode<ElemType>::RNNStackNode(const ScriptableObjects::IConfigRecordPtr configp) :
+    RNNStackNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"hiddenDims"), configp->Get(L"numLayers"), (const std::wstring&) configp->Get(L"recurrentOp"))
+{
+    AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::Save(File& fstream) const /*override*/
+{
+    Base::Save(fstream);
+    fstream << m_hiddenSize << m_numLayers << m_recurrentOp;
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::Load(File& fstream, size_t modelVersion) /*override*/
+{
+    Base::Load(fstream, modelVersion);
+    fstream >> m_hiddenSize >> m_numLayers >> m_recurrentOp;
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const /*override*/
+{
+    Base::CopyTo(nodeP, newName, flags);
+    if (flags & CopyNodeFlags::copyNodeValue)
+    {
+        auto node = dynamic_pointer_cast<RNNStackNode<ElemType>>(nodeP);
+        node->m_hiddenSize  = m_hiddenSize;
+        node->m_numLayers   = m_numLayers;
+        node->m_recurrentOp = m_recurrentOp;
+    }
+}
+
+// first column of layer 'layer' in the packed weight matrix; for layer == m_numLayers this is the total number of columns
+template <class ElemType>
+size_t RNNStackNode<ElemType>::LayerColumnOffset(size_t layer) const
+{
+    if (layer == 0)
+        return 0;
+    return (LayerInputDim(0) + m_hiddenSize + 1) + (layer - 1) * (2 * m_hiddenSize + 1);
+}
+
+// output of a layer; the top layer writes directly into our Value()
+template <class ElemType>
+Matrix<ElemType> RNNStackNode<ElemType>::LayerOutput(size_t layer, size_t numCols)
+{
+    if (layer + 1 == m_numLayers)
+        return Value().ColumnSlice(0, numCols);
+    else
+        return m_hidden->ColumnSlice(layer * numCols, numCols);
+}
+
+template <class ElemType>
+void RNNStackNode<ElemType>::DetermineStepKinds(size_t numParallelSequences, size_t numTimeSteps)
+{
+    m_stepKinds.assign(numParallelSequences * numTimeSteps, StepKind::Gap);
+    for (const auto& seq : GetMBLayout()->GetAllSequences())
+    {
+        if (seq.seqId == GAP_SEQUENCE_ID)
+            continue;
+        size_t tBegin = (size_t) max(seq.tBegin, (ptrdiff_t) 0);
+        size_t tEnd = min(seq.tEnd, numTimeSteps);
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            StepKind kind = (ptrdiff_t) t == seq.tBegin ? StepKind::Start : t == 0 ? StepKind::Carry : StepKind::Continue;
+            m_stepKinds[t * numParallelSequences + seq.s] = kind;
+        }
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::ForwardProp(const FrameRange& fr) /*override*/
+{
+    if (!fr.IsAllFrames())
+        LogicError("%ls %ls operation must be evaluated for the whole minibatch at once.", NodeName().c_str(), OperationName().c_str());
+
+    const size_t S = GetMBLayout()->GetNumParallelSequences();
+    const size_t T = GetMBLayout()->GetNumTimeSteps();
+    const size_t N = S * T;
+    const size_t H = m_hiddenSize;
+    const size_t GH = NumGates() * H;
+    const size_t L = m_numLayers;
+    const bool isLSTM = IsLSTM();
+
+    DetermineStepKinds(S, T);
+    m_bpttDone = false;
+
+    // state from the previous minibatch can only be used if the parallel sequences line up
+    const bool haveCarry = m_carryNumParallelSequences == S && m_carryHidden.GetNumCols() == L * S;
+    if (!haveCarry)
+    {
+        m_carryHidden.Resize(H, L * S);
+        m_carryCell.Resize(isLSTM ? H : 0, L * S);
+        m_carryNumParallelSequences = S;
+    }
+
+    m_gates->Resize(GH, L * N);
+    m_states->Resize(H, L * N);
+    m_prevHidden->Resize(H, L * N);
+    m_prevCell->Resize(isLSTM ? H : 0, L * N);
+    m_hidden->Resize(H, (L - 1) * N);
+    m_stepBuffer->Resize(GH, S);
+
+    const Matrix<ElemType>& W = Input(0)->Value();
+    for (size_t l = 0; l < L; l++)
+    {
+        const size_t inDim = LayerInputDim(l);
+        const size_t wOffset = LayerColumnOffset(l);
+        Matrix<ElemType> Wx = W.ColumnSlice(wOffset, inDim);
+        Matrix<ElemType> Wh = W.ColumnSlice(wOffset + inDim, H);
+        const ElemType* bias = W.ColumnSlice(wOffset + inDim + H, 1).Data();
+
+        Matrix<ElemType> X = l == 0 ? Input(1)->ValueFor(fr) : LayerOutput(l - 1, N);
+        Matrix<ElemType> Y = LayerOutput(l, N);
+        Matrix<ElemType> gates = m_gates->ColumnSlice(l * N, N);
+
+        // input projection of all frames at once
+        Matrix<ElemType>::Multiply(Wx, false, X, false, gates);
+
+        ElemType* pY = Y.Data();
+        ElemType* pGates = gates.Data();
+        ElemType* pStates = m_states->Data() + l * N * H;
+        ElemType* pPrevHidden = m_prevHidden->Data() + l * N * H;
+        ElemType* pPrevCell = isLSTM ? m_prevCell->Data() + l * N * H : nullptr;
+        ElemType* pCarryHidden = m_carryHidden.Data() + l * S * H;
+        ElemType* pCarryCell = isLSTM ? m_carryCell.Data() + l * S * H : nullptr;
+        ElemType* pRec = m_stepBuffer->Data();
+
+        for (size_t t = 0; t < T; t++)
+        {
+            const StepKind* kinds = &m_stepKinds[t * S];
+
+            // gather the state entering this step
+            for (size_t s = 0; s < S; s++)
+            {
+                ElemType* h = pPrevHidden + (t * S + s) * H;
+                ElemType* c = isLSTM ? pPrevCell + (t * S + s) * H : nullptr;
+                if (kinds[s] == StepKind::Continue)
+                {
+                    memcpy(h, pY + ((t - 1) * S + s) * H, H * sizeof(ElemType));
+                    if (isLSTM)
+                        memcpy(c, pStates + ((t - 1) * S + s) * H, H * sizeof(ElemType));
+                }
+                else if (kinds[s] == StepKind::Carry && haveCarry)
+                {
+                    memcpy(h, pCarryHidden + s * H, H * sizeof(ElemType));
+                    if (isLSTM)
+                        memcpy(c, pCarryCell + s * H, H * sizeof(ElemType));
+                }
+                else
+                {
+                    memset(h, 0, H * sizeof(ElemType));
+                    if (isLSTM)
+                        memset(c, 0, H * sizeof(ElemType));
+                }
+            }
+
+            // recurrent projection of all parallel sequences at once
+            Matrix<ElemType> prevHidden = m_prevHidden->ColumnSlice(l * N + t * S, S);
+            Matrix<ElemType> gatesT = gates.ColumnSlice(t * S, S);
+            if (isLSTM)
+                Matrix<ElemType>::MultiplyAndAdd(Wh, false, prevHidden, false, gatesT);
+            else
+                Matrix<ElemType>::Multiply(Wh, false, prevHidden, false, *m_stepBuffer);
+
+            // fused gate nonlinearities and state update
+#pragma omp parallel for if (S * H >= c_minElementsForParallelStep)
+            for (long k = 0; k < (long) (S * H); k++)
+            {
+                const size_t s = k / H;
+                const size_t j = k % H;
+                const size_t col = t * S + s;
+                ElemType* a = pGates + col * GH;
+                if (kinds[s] == StepKind::Gap)
+                {
+                    for (size_t g = j; g < GH; g += H)
+                        a[g] = 0;
+                    pStates[col * H + j] = 0;
+                    pY[col * H + j] = 0;
+                    continue;
+                }
+                if (isLSTM)
+                {
+                    const ElemType i = Sigmoid(a[j]         + bias[j]);
+                    const ElemType f = Sigmoid(a[j + H]     + bias[j + H]);
+                    const ElemType o = Sigmoid(a[j + 2 * H] + bias[j + 2 * H]);
+                    const ElemType g = std::tanh(a[j + 3 * H] + bias[j + 3 * H]);
+                    const ElemType c = f * pPrevCell[col * H + j] + i * g;
+                    a[j] = i; a[j + H] = f; a[j + 2 * H] = o; a[j + 3 * H] = g;
+                    pStates[col * H + j] = c;
+                    pY[col * H + j] = o * std::tanh(c);
+                }
+                else
+                {
+                    const ElemType* rec = pRec + s * GH;
+                    const ElemType r = Sigmoid(a[j]     + bias[j]     + rec[j]);
+                    const ElemType z = Sigmoid(a[j + H] + bias[j + H] + rec[j + H]);
+                    const ElemType n = std::tanh(a[j + 2 * H] + bias[j + 2 * H] + r * rec[j + 2 * H]);
+                    a[j] = r; a[j + H] = z; a[j + 2 * H] = n;
+                    pStates[col * H + j] = rec[j + 2 * H];
+                    pY[col * H + j] = (1 - z) * n + z * pPrevHidden[col * H + j];
+                }
+            }
+        }
+
+        // remember the final state for sequences that continue into the next minibatch
+        if (T > 0)
+        {
+            memcpy(pCarryHidden, pY + (T - 1) * S * H, S * H * sizeof(ElemType));
+            if (isLSTM)
+                memcpy(pCarryCell, pStates + (T - 1) * S * H, S * H * sizeof(ElemType));
+        }
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::ReorderState(const std::vector<size_t>& fromSequences) /*override*/
+{
+    const size_t S = m_carryNumParallelSequences;
+    const size_t newS = fromSequences.size();
+    const size_t H = m_hiddenSize;
+    const size_t L = m_numLayers;
+    const bool isLSTM = IsLSTM();
+    if (S == 0 || m_carryHidden.GetNumCols() != L * S)
+        LogicError("%ls %ls operation: There is no carried-over state to reorder.", NodeName().c_str(), OperationName().c_str());
+
+    Matrix<ElemType> hidden(H, L * newS, CPUDEVICE);
+    Matrix<ElemType> cell(isLSTM ? H : 0, L * newS, CPUDEVICE);
+    for (size_t l = 0; l < L; l++)
+    {
+        for (size_t s = 0; s < newS; s++)
+        {
+            if (fromSequences[s] >= S)
+                InvalidArgument("%ls %ls operation: Cannot continue from parallel sequence %d, there are only %d.", NodeName().c_str(), OperationName().c_str(), (int) fromSequences[s], (int) S);
+            memcpy(hidden.Data() + (l * newS + s) * H, m_carryHidden.Data() + (l * S + fromSequences[s]) * H, H * sizeof(ElemType));
+            if (isLSTM)
+                memcpy(cell.Data() + (l * newS + s) * H, m_carryCell.Data() + (l * S + fromSequences[s]) * H, H * sizeof(ElemType));
+        }
+    }
+    m_carryHidden = std::move(hidden);
+    m_carryCell = std::move(cell);
+    m_carryNumParallelSequences = newS;
+}
+
+// Backpropagation through time over all layers. This computes the gradients w.r.t. the gate pre-activations
+// (stored in place of the gates), from which BackpropTo() derives the gradients of weights and input.
+template <class ElemType>
+void RNNStackNode<ElemType>::BackpropThroughTime()
+{
+    if (m_bpttDone)
+        return;
+
+    const size_t S = GetMBLayout()->GetNumParallelSequences();
+    const size_t T = GetMBLayout()->GetNumTimeSteps();
+    const size_t N = S * T;
+    const size_t H = m_hiddenSize;
+    const size_t GH = NumGates() * H;
+    const size_t L = m_numLayers;
+    const bool isLSTM = IsLSTM();
+
+    m_recurrentGrad->Resize(isLSTM ? 0 : GH, L * N);
+    m_hiddenGrad->Resize(H, L > 1 ? N : 0);
+    m_hiddenCarryGrad->Resize(H, S);
+    m_cellCarryGrad->Resize(isLSTM ? H : 0, S);
+
+    const Matrix<ElemType>& W = Input(0)->Value();
+    for (size_t l = L; l-- > 0;)
+    {
+        const size_t inDim = LayerInputDim(l);
+        const size_t wOffset = LayerColumnOffset(l);
+        Matrix<ElemType> Wh = W.ColumnSlice(wOffset + inDim, H);
+
+        const ElemType* pOutGrad = (l + 1 == L ? Gradient() : *m_hiddenGrad).Data();
+        ElemType* pGates = m_gates->Data() + l * N * GH;
+        const ElemType* pStates = m_states->Data() + l * N * H;
+        const ElemType* pPrevHidden = m_prevHidden->Data() + l * N * H;
+        const ElemType* pPrevCell = isLSTM ? m_prevCell->Data() + l * N * H : nullptr;
+        ElemType* pRecGrad = isLSTM ? nullptr : m_recurrentGrad->Data() + l * N * GH;
+        ElemType* pHiddenCarry = m_hiddenCarryGrad->Data();
+        ElemType* pCellCarry = isLSTM ? m_cellCarryGrad->Data() : nullptr;
+
+        for (size_t t = T; t-- > 0;)
+        {
+            const StepKind* kinds = &m_stepKinds[t * S];
+            const StepKind* nextKinds = t + 1 < T ? &m_stepKinds[(t + 1) * S] : nullptr;
+
+#pragma omp parallel for if (S * H >= c_minElementsForParallelStep)
+            for (long k = 0; k < (long) (S * H); k++)
+            {
+                const size_t s = k / H;
+                const size_t j = k % H;
+                const size_t col = t * S + s;
+                ElemType* a = pGates + col * GH;
+                if (kinds[s] == StepKind::Gap)
+                {
+                    for (size_t g = j; g < GH; g += H)
+                    {
+                        a[g] = 0;
+                        if (!isLSTM)
+                            pRecGrad[col * GH + g] = 0;
+                    }
+                    pHiddenCarry[s * H + j] = 0;
+                    if (isLSTM)
+                        pCellCarry[s * H + j] = 0;
+                    continue;
+                }
+                const bool hasNext = nextKinds && nextKinds[s] == StepKind::Continue;
+                const ElemType dh = pOutGrad[col * H + j] + (hasNext ? pHiddenCarry[s * H + j] : 0);
+                if (isLSTM)
+                {
+                    const ElemType i = a[j], f = a[j + H], o = a[j + 2 * H], g = a[j + 3 * H];
+                    const ElemType tc = std::tanh(pStates[col * H + j]);
+                    const ElemType dc = dh * o * (1 - tc * tc) + (hasNext ? pCellCarry[s * H + j] : 0);
+                    a[j]         = dc * g * i * (1 - i);
+                    a[j + H]     = dc * pPrevCell[col * H + j] * f * (1 - f);
+                    a[j + 2 * H] = dh * tc * o * (1 - o);
+                    a[j + 3 * H] = dc * i * (1 - g * g);
+                    pCellCarry[s * H + j] = dc * f;
+                    pHiddenCarry[s * H + j] = 0;
+                }
+                else
+                {
+                    const ElemType r = a[j], z = a[j + H], n = a[j + 2 * H];
+                    const ElemType dn = dh * (1 - z) * (1 - n * n);
+                    const ElemType dz = dh * (pPrevHidden[col * H + j] - n) * z * (1 - z);
+                    const ElemType dr = dn * pStates[col * H + j] * r * (1 - r);
+                    a[j] = dr; a[j + H] = dz; a[j + 2 * H] = dn;
+                    ElemType* dRec = pRecGrad + col * GH;
+                    dRec[j] = dr; dRec[j + H] = dz; dRec[j + 2 * H] = dn * r;
+                    pHiddenCarry[s * H + j] = dh * z;
+                }
+            }
+
+            // gradient into the previous step through the recurrent weights (nothing flows out of the first step)
+            if (t > 0)
+            {
+                Matrix<ElemType> recGrad = isLSTM ? m_gates->ColumnSlice(l * N + t * S, S) : m_recurrentGrad->ColumnSlice(l * N + t * S, S);
+                Matrix<ElemType>::MultiplyAndAdd(Wh, true, recGrad, false, *m_hiddenCarryGrad);
+            }
+        }
+
+        // gradient into the output of the layer below
+        if (l > 0)
+        {
+            Matrix<ElemType> Wx = W.ColumnSlice(wOffset, inDim);
+            Matrix<ElemType>::Multiply(Wx, true, m_gates->ColumnSlice(l * N, N), false, *m_hiddenGrad);
+        }
+    }
+
+    m_bpttDone = true;
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::BackpropTo(const size_t inputIndex, const FrameRange& fr) /*override*/
+{
+    if (!fr.IsAllFrames())
+        LogicError("%ls %ls operation must be differentiated for the whole minibatch at once.", NodeName().c_str(), OperationName().c_str());
+
+    BackpropThroughTime();
+
+    const size_t N = GetMBLayout()->GetNumParallelSequences() * GetMBLayout()->GetNumTimeSteps();
+    const size_t H = m_hiddenSize;
+    const size_t GH = NumGates() * H;
+    if (inputIndex == 0) // derivative with respect to the weights
+    {
+        Input(1)->MaskMissingValueColumnsToZero(fr); // gaps in the input must not leak into the weight gradient
+        Matrix<ElemType>& dW = Input(0)->Gradient();
+        for (size_t l = 0; l < m_numLayers; l++)
+        {
+            const size_t inDim = LayerInputDim(l);
+            const size_t wOffset = LayerColumnOffset(l);
+            Matrix<ElemType> dP = m_gates->ColumnSlice(l * N, N);
+            Matrix<ElemType> dRec = IsLSTM() ? dP.ColumnSlice(0, N) : m_recurrentGrad->ColumnSlice(l * N, N);
+            Matrix<ElemType> X = l == 0 ? Input(1)->ValueFor(fr) : LayerOutput(l - 1, N);
+
+            Matrix<ElemType> dWx = dW.ColumnSlice(wOffset, inDim);
+            Matrix<ElemType>::MultiplyAndAdd(dP, false, X, true, dWx);
+            Matrix<ElemType> dWh = dW.ColumnSlice(wOffset + inDim, H);
+            Matrix<ElemType>::MultiplyAndAdd(dRec, false, m_prevHidden->ColumnSlice(l * N, N), true, dWh);
+
+            ElemType* db = dW.ColumnSlice(wOffset + inDim + H, 1).Data();
+            const ElemType* pdP = dP.Data();
+#pragma omp parallel for
+            for (long r = 0; r < (long) GH; r++)
+            {
+                ElemType sum = 0;
+                for (size_t j = 0; j < N; j++)
+                    sum += pdP[j * GH + r];
+                db[r] += sum;
+            }
+        }
+    }
+    else // derivative with respect to the input
+    {
+        Matrix<ElemType> Wx0 = Input(0)->Value().ColumnSlice(0, LayerInputDim(0));
+        Matrix<ElemType> inputGrad = Input(1)->GradientFor(fr);
+        Matrix<ElemType>::MultiplyAndAdd(Wx0, true, m_gates->ColumnSlice(0, N), false, inputGrad);
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+    if (isFinalValidationPass)
+    {
+        if (m_recurrentOp != L"lstm" && m_recurrentOp != L"gru")
+            InvalidArgument("%ls %ls operation: recurrentOp must be 'lstm' or 'gru', not '%ls'.", NodeName().c_str(), OperationName().c_str(), m_recurrentOp.c_str());
+        if (m_hiddenSize == 0 || m_numLayers == 0)
+            InvalidArgument("%ls %ls operation requires hiddenDims and numLayers to be positive.", NodeName().c_str(), OperationName().c_str());
+        if (Input(0)->HasMBLayout() || !Input(1)->HasMBLayout())
+            InvalidArgument("%ls %ls operation requires weights without and an input with a dynamic axis.", NodeName().c_str(), OperationName().c_str());
+        if (Input(0)->GetAsMatrixNumRows() != NumGates() * m_hiddenSize || Input(0)->GetAsMatrixNumCols() != NumWeightColumns())
+            InvalidArgument("%ls %ls operation: For %d %ls layers of dimension %d over an input of dimension %d, the weights must be of dimension [%d x %d], but are [%s].",
+                            NodeName().c_str(), OperationName().c_str(), (int) m_numLayers, m_recurrentOp.c_str(), (int) m_hiddenSize, (int) LayerInputDim(0),
+                            (int) (NumGates() * m_hiddenSize), (int) NumWeightColumns(), string(Input(0)->GetSampleLayout()).c_str());
+        if (m_deviceId != CPUDEVICE)
+            InvalidArgument("%ls %ls operation is currently only implemented for the CPU.", NodeName().c_str(), OperationName().c_str());
+    }
+
+    // the output replaces the input vector by the hidden state, keeping any trailing singleton dimensions
+    auto dims = Input(1)->GetSampleLayout().GetDims();
+    if (isFinalValidationPass && (dims.empty() || Input(1)->GetSampleLayout().GetNumElements() != dims[0]))
+        InvalidArgument("%ls %ls operation requires the input to be a vector, but it is [%s].", NodeName().c_str(), OperationName().c_str(), string(Input(1)->GetSampleLayout()).c_str());
+    if (dims.empty())
+        dims.push_back(m_hiddenSize);
+    else
+        dims[0] = m_hiddenSize;
+    SetDims(TensorShape(dims), HasMBLayout());
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
+{
+    Base::RequestMatricesBeforeForwardProp(matrixPool);
+    RequestMatrixFromPool(m_gates, matrixPool);
+    RequestMatrixFromPool(m_states, matrixPool);
+    RequestMatrixFromPool(m_prevHidden, matrixPool);
+    RequestMatrixFromPool(m_prevCell, matrixPool);
+    RequestMatrixFromPool(m_hidden, matrixPool);
+    RequestMatrixFromPool(m_stepBuffer, matrixPool);
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) /*override*/
+{
+    Base::ReleaseMatricesAfterForwardProp(matrixPool);
+    ReleaseMatrixToPool(m_stepBuffer, matrixPool);
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::RequestMatricesBeforeBackprop(MatrixPool& matrixPool) /*override*/
+{
+    Base::RequestMatricesBeforeBackprop(matrixPool);
+    RequestMatrixFromPool(m_recurrentGrad, matrixPool);
+    RequestMatrixFromPool(m_hiddenGrad, matrixPool);
+    RequestMatrixFromPool(m_hiddenCarryGrad, matrixPool);
+    RequestMatrixFromPool(m_cellCarryGrad, matrixPool);
+}
+
+template <class ElemType>
+/*virtual*/ void RNNStackNode<ElemType>::ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) /*override*/
+{
+    Base::ReleaseMatricesAfterBackprop(matrixPool);
+    ReleaseMatrixToPool(m_gates, matrixPool);
+    ReleaseMatrixToPool(m_states, matrixPool);
+    ReleaseMatrixToPool(m_prevHidden, matrixPool);
+    ReleaseMatrixToPool(m_prevCell, matrixPool);
+    ReleaseMatrixToPool(m_hidden, matrixPool);
+    ReleaseMatrixToPool(m_recurrentGrad, matrixPool);
+    ReleaseMatrixToPool(m_hiddenGrad, matrixPool);
+    ReleaseMatrixToPool(m_hiddenCarryGrad, matrixPool);
+    ReleaseMatrixToPool(m_cellCarryGrad, matrixPool);
+}
+
+template class RNNStackNode<float>;
+template class RNNStackNode<double>;
+
+}}}
@@ -0,0 +1,130 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "Matrix.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// This header collects fused recurrent nodes, i.e. nodes that run a whole recurrence internally
+// instead of being unrolled by the network's loop analysis.
+
+// -----------------------------------------------------------------------
+// RNNStackNode (weights, input, hiddenDims, numLayers=1, recurrentOp='lstm') -- fused stack of LSTM or GRU layers
+//
+// Runs 'numLayers' stacked unidirectional LSTM or GRU layers over all sequences of the minibatch in a single node.
+// Compared to composing the recurrence out of PastValue() and elementwise nodes, each layer computes
+//  - the input projection of all frames of the minibatch as one GEMM,
+//  - one GEMM per time step for the recurrent projection of all parallel sequences, and
+//  - all gate nonlinearities and the state update in one fused elementwise pass per time step.
+//
+// All parameters are packed into 'weights', a [G*H x C] matrix with G=4 (LSTM) or G=3 (GRU) and H=hiddenDims.
+// Layer l owns a column block [Wx | Wh | b] of width inDim_l + H + 1, where inDim_0 is the input dimension
+// and inDim_l = H for l > 0, i.e. C = inDim + H + 1 + (numLayers-1) * (2H + 1).
+// Gate rows are ordered (i, f, o, g) for LSTM, and (r, z, n) for GRU, where
+//     n = tanh(Wx_n x + b_n + r .* (Wh_n h)),  h' = (1 - z) .* n + z .* h.
+// The output is the hidden state of the top layer, [H] per frame.
+//
+// Like PastValue(), state is carried over from the previous minibatch for sequences that begin before the
+// minibatch start (truncated BPTT). Gradients are not propagated across minibatch boundaries.
+//
+// This node is currently only implemented for the CPU.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class RNNStackNode : public ComputationNode<ElemType>, public IReorderableStateNode, public NumInputs<2>
+{
+    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"RNNStack"; }
+
+public:
+    RNNStackNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : RNNStackNode(deviceId, name, 0, 1, L"lstm")
+    {
+    }
+    RNNStackNode(DEVICEID_TYPE deviceId, const wstring& name, size_t hiddenSize, size_t numLayers, const std::wstring& recurrentOp)
+        : Base(deviceId, name), m_hiddenSize(hiddenSize), m_numLayers(numLayers), m_recurrentOp(recurrentOp),
+          m_carryHidden(deviceId), m_carryCell(deviceId), m_carryNumParallelSequences(0), m_bpttDone(false)
+    {
+    }
+    RNNStackNode(const ScriptableObjects::IConfigRecordPtr configp);
+
+    virtual void Save(File& fstream) const override;
+    virtual void Load(File& fstream, size_t modelVersion) override;
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override;
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override;
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
+
+    // the backward pass works off the saved gates and states, the output itself is not needed
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return true; }
+    // m_stepBuffer is released after forward prop
+    virtual bool CanRecomputeForwardProp() const override { return false; }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override;
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override;
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override;
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override;
+
+    virtual void /*IReorderableStateNode::*/ ReorderState(const std::vector<size_t>& fromSequences) override;
+
+    size_t HiddenSize() const { return m_hiddenSize; }
+    size_t NumLayers() const { return m_numLayers; }
+    const std::wstring& RecurrentOp() const { return m_recurrentOp; }
+
+private:
+    // how the recurrent state entering frame (t, s) is obtained
+    enum class StepKind : unsigned char
+    {
+        Gap,      // no sequence at this frame
+        Start,    // sequence starts here: zero state
+        Carry,    // sequence started in a previous minibatch: state carried over from there
+        Continue  // state from frame (t-1, s)
+    };
+
+    bool IsLSTM() const { return m_recurrentOp == L"lstm"; }
+    size_t NumGates() const { return IsLSTM() ? 4 : 3; }
+    size_t LayerInputDim(size_t layer) const { return layer == 0 ? Input(1)->GetSampleMatrixNumRows() : m_hiddenSize; }
+    size_t LayerColumnOffset(size_t layer) const;
+    size_t NumWeightColumns() const { return LayerColumnOffset(m_numLayers); }
+
+    void DetermineStepKinds(size_t numParallelSequences, size_t numTimeSteps);
+    Matrix<ElemType> LayerOutput(size_t layer, size_t numCols);
+    void BackpropThroughTime();
+
+    // configuration
+    size_t m_hiddenSize;
+    size_t m_numLayers;
+    std::wstring m_recurrentOp; // L"lstm" or L"gru"
+
+    // state carried over to the next minibatch, [H x numLayers * S]; not persisted
+    Matrix<ElemType> m_carryHidden;
+    Matrix<ElemType> m_carryCell;
+    size_t m_carryNumParallelSequences;
+
+    // per-minibatch working variables, all [. x numLayers * numCols] with the layers side by side
+    std::vector<StepKind> m_stepKinds;            // [t * S + s]
+    shared_ptr<Matrix<ElemType>> m_gates;         // activated gates; overwritten with the gate pre-activation gradients in backprop
+    shared_ptr<Matrix<ElemType>> m_states;        // LSTM: cell state; GRU: Wh_n h of the candidate gate
+    shared_ptr<Matrix<ElemType>> m_prevHidden;    // hidden state that entered each frame
+    shared_ptr<Matrix<ElemType>> m_prevCell;      // LSTM only: cell state that entered each frame
+    shared_ptr<Matrix<ElemType>> m_hidden;        // outputs of all but the top layer
+    shared_ptr<Matrix<ElemType>> m_stepBuffer;    // [G*H x S] recurrent projection of one time step
+    shared_ptr<Matrix<ElemType>> m_recurrentGrad; // GRU only: gradient w.r.t. the recurrent projection
+    shared_ptr<Matrix<ElemType>> m_hiddenGrad;    // gradient w.r.t. the output of the layer below
+    shared_ptr<Matrix<ElemType>> m_hiddenCarryGrad; // [H x S] gradient flowing into the previous time step
+    shared_ptr<Matrix<ElemType>> m_cellCarryGrad;   // [H x S] LSTM only: cell gradient flowing into the previous time step
+    bool m_bpttDone;
+};
+
+}}}
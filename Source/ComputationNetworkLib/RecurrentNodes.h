@@ -89,7 +89,7 @@ protected:
 
 // TODO: 'direction' is really too general. signOfTimeOffset?
 template <class ElemType, int direction /*-1 for Past/left-to-right or +1 for Future/right-to-left*/ /*, MinibatchPackingFlags SequenceStart_or_End/*-Start or -End*/>
-class DelayedValueNodeBase : public ComputationNode<ElemType>, public IRecurrentNode, public ILateAttachingNode, public IStatefulNode, public NumInputs<1>
+class DelayedValueNodeBase : public ComputationNode<ElemType>, public IRecurrentNode, public ILateAttachingNode, public IStatefulNode, public IReorderableStateNode, public NumInputs<1>
 {
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembers;
     typedef std::shared_ptr<DelayedValueNodeState<ElemType>> DelayedNodeStatePtr;
@@ -244,6 +244,8 @@ public:
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    // EndForwardProp() carries the state over to the next minibatch
+    virtual bool CanRecomputeForwardProp() const override { return false; }
 
     virtual void EndForwardProp() override // called after last iteration step of ForwardProp()
     {
@@ -464,6 +466,34 @@ public:
             LogicError("Unrecognized direction in DelayedValueNodeBase");
     }
 
+    virtual void /*IReorderableStateNode::*/ ReorderState(const std::vector<size_t>& fromSequences) override
+    {
+        int dir = direction;
+        if (dir != -1 || m_timeStep != 1)
+            LogicError("%ls: Reordering the carried-over state is only supported for a PastValue with a time step of 1.", NodeDescription().c_str());
+        if (!m_delayedActivationMBLayout || m_delayedValue.IsEmpty())
+            LogicError("%ls: There is no carried-over state to reorder.", NodeDescription().c_str());
+
+        // keep only the last time step, with the parallel sequences in the new order
+        size_t nT = m_delayedActivationMBLayout->GetNumTimeSteps();
+        size_t nU = m_delayedActivationMBLayout->GetNumParallelSequences();
+        std::vector<ElemType> columns(fromSequences.size());
+        for (size_t s = 0; s < fromSequences.size(); s++)
+        {
+            if (fromSequences[s] >= nU)
+                InvalidArgument("%ls: Cannot continue from parallel sequence %d, there are only %d.", NodeDescription().c_str(), (int) fromSequences[s], (int) nU);
+            columns[s] = (ElemType) ((nT - 1) * nU + fromSequences[s]);
+        }
+        Matrix<ElemType> columnIndices(1, columns.size(), columns.data(), m_delayedValue.GetDeviceId());
+        Matrix<ElemType> reordered(m_delayedValue.GetDeviceId());
+        reordered.DoGatherColumnsOf(0, columnIndices, m_delayedValue, 1);
+        m_delayedValue = std::move(reordered);
+
+        m_delayedActivationMBLayout = make_shared<MBLayout>(fromSequences.size(), 1, m_delayedActivationMBLayout->GetAxisName());
+        for (size_t s = 0; s < fromSequences.size(); s++)
+            m_delayedActivationMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, 2); // (all sequences continue into the next minibatch)
+    }
+
     int TimeStep() const { return m_timeStep; }
     ElemType InitialActivationValue() const { return m_initialActivationValue; }
 
@@ -1068,6 +1098,10 @@ public:
     {
         return false;
     }
+    virtual bool CanRecomputeForwardProp() const override
+    {
+        return false; // EndForwardProp() carries the state over to the next minibatch
+    }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
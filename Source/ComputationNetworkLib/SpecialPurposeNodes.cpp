@@ -6,6 +6,7 @@
 #include "Basics.h"
 #include "ComputationNode.h"
 #include "SpecialPurposeNodes.h"
+#include "TensorOps.h"
 
 #include <string>
 #include <vector>
@@ -133,4 +134,229 @@ template <class ElemType>
 template class TraceNode<float>;
 template class TraceNode<double>;
 
+// -----------------------------------------------------------------------
+// FusedElementwise (input0, operands...)
+// -----------------------------------------------------------------------
+
+// the output is computed in tiles of this many rows, which stay in the L1 cache while all steps are applied
+static const size_t c_fusedElementwiseTileSize = 256;
+
+// look up an ElementWiseOperator by its name without the 'op' prefix
+// Returns the number of arguments (1 or 2), or 0 if there is no unary or binary op of that name.
+static size_t ElementWiseOperatorFromName(const std::wstring& name, ElementWiseOperator& op)
+{
+#define CaseUnaryOpName(Op)  if (name == msra::strfun::utf16(#Op)) { op = ElementWiseOperator::op##Op; return 1; }
+#define CaseBinaryOpName(Op) if (name == msra::strfun::utf16(#Op)) { op = ElementWiseOperator::op##Op; return 2; }
+    ForAllUnaryOps(CaseUnaryOpName);
+    ForAllBinaryOps(CaseBinaryOpName);
+#undef CaseUnaryOpName
+#undef CaseBinaryOpName
+    return 0;
+}
+
+template <class ElemType>
+/*virtual*/ void FusedElementwiseNode<ElemType>::CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const /*override*/
+{
+    Base::CopyTo(nodeP, newName, flags);
+    if (flags & CopyNodeFlags::copyNodeValue)
+    {
+        auto node = dynamic_pointer_cast<FusedElementwiseNode<ElemType>>(nodeP);
+        node->m_steps = m_steps;
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void FusedElementwiseNode<ElemType>::Save(File& fstream) const /*override*/
+{
+    Base::Save(fstream);
+    fstream << m_steps.size();
+    for (const auto& step : m_steps) // note: we serialize the op names and not the opcodes, since opcodes may change
+        fstream << step.m_operation << (int32_t) step.m_operand << step.m_operandFirst;
+}
+
+template <class ElemType>
+/*virtual*/ void FusedElementwiseNode<ElemType>::Load(File& fstream, size_t modelVersion) /*override*/
+{
+    Base::Load(fstream, modelVersion);
+    size_t numSteps;
+    fstream >> numSteps;
+    m_steps.resize(numSteps);
+    for (auto& step : m_steps)
+    {
+        int32_t operand;
+        fstream >> step.m_operation >> operand >> step.m_operandFirst;
+        step.m_operand = operand;
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void FusedElementwiseNode<ElemType>::ForwardProp(const FrameRange& fr) /*override*/
+{
+    bool allDenseOnCPU = m_deviceId == CPUDEVICE;
+    for (size_t i = 0; i < GetNumInputs(); i++)
+        allDenseOnCPU &= Input(i)->Value().GetMatrixType() == DENSE;
+    if (allDenseOnCPU)
+    {
+        ForwardPropCPU(fr);
+        return;
+    }
+
+    // otherwise apply the steps one by one, in place
+    size_t rank = DetermineElementwiseTensorRank();
+    auto result = ValueTensorFor(rank, fr);
+    result.AssignCopyOf(Input(0)->ValueTensorFor(rank, fr.AllowBroadcast()));
+    for (size_t k = 0; k < m_steps.size(); k++)
+    {
+        const auto& step = m_steps[k];
+        if (step.m_operand < 0)
+            result.DoUnaryOpOf(0, result, 1, m_ops[k], ElementWiseOperator::opSum);
+        else
+        {
+            auto operand = Input(step.m_operand)->ValueTensorFor(rank, fr.AllowBroadcast());
+            if (step.m_operandFirst)
+                result.DoBinaryOpOf(0, operand, result, 1, m_ops[k], ElementWiseOperator::opSum);
+            else
+                result.DoBinaryOpOf(0, result, operand, 1, m_ops[k], ElementWiseOperator::opSum);
+        }
+    }
+}
+
+template <class ElemType>
+void FusedElementwiseNode<ElemType>::ForwardPropCPU(const FrameRange& fr)
+{
+    Matrix<ElemType> result = ValueFor(fr);
+    const size_t rows = GetSampleLayout().GetNumElements();
+    const size_t cols = rows == 0 ? 0 : result.GetNumElements() / rows;
+
+    // inputs without minibatch layout are the same for all columns
+    std::vector<Matrix<ElemType>> inputs;
+    std::vector<size_t> colStrides;
+    for (size_t i = 0; i < GetNumInputs(); i++)
+    {
+        inputs.push_back(Input(i)->HasMBLayout() ? Input(i)->ValueFor(fr) : Input(i)->Value().AsReference());
+        colStrides.push_back(Input(i)->HasMBLayout() ? Input(i)->GetSampleLayout().GetNumElements() : 0);
+    }
+
+    ElemType* pResult = result.Data();
+    const size_t numTilesPerCol = (rows + c_fusedElementwiseTileSize - 1) / c_fusedElementwiseTileSize;
+#pragma omp parallel for if (rows * cols >= 4 * c_fusedElementwiseTileSize)
+    for (long t = 0; t < (long) (cols * numTilesPerCol); t++)
+    {
+        const size_t col = t / numTilesPerCol;
+        const size_t row0 = (t % numTilesPerCol) * c_fusedElementwiseTileSize;
+        const size_t n = std::min(c_fusedElementwiseTileSize, rows - row0);
+        ElemType buffer[c_fusedElementwiseTileSize];
+
+        // get the elements of input i for this tile, gathering them into 'buffer' if the input is broadcast
+        auto getInput = [&](size_t i) -> const ElemType*
+        {
+            const ElemType* pInput = inputs[i].Data() + col * colStrides[i];
+            if (m_rowOffsets[i].empty())
+                return pInput + row0;
+            const size_t* offsets = m_rowOffsets[i].data() + row0;
+            for (size_t j = 0; j < n; j++)
+                buffer[j] = pInput[offsets[j]];
+            return buffer;
+        };
+
+        ElemType* value = pResult + col * rows + row0;
+        const ElemType* a = getInput(0);
+        for (size_t j = 0; j < n; j++)
+            value[j] = a[j];
+
+        for (size_t k = 0; k < m_steps.size(); k++)
+        {
+            const auto& step = m_steps[k];
+            if (step.m_operand < 0)
+            {
+                switch (m_ops[k])
+                {
+#define CaseUnaryOp(oper)                              \
+                case ElementWiseOperator::op##oper:    \
+                    for (size_t j = 0; j < n; j++)     \
+                        value[j] = Op##oper(value[j]); \
+                    break
+                ForAllUnaryOps(CaseUnaryOp);
+#undef CaseUnaryOp
+                default: LogicError("FusedElementwise: Unexpected unary op %d.", (int) m_ops[k]);
+                }
+            }
+            else
+            {
+                const ElemType* b = getInput(step.m_operand);
+                switch (m_ops[k])
+                {
+#define CaseBinaryOp(oper)                                       \
+                case ElementWiseOperator::op##oper:              \
+                    if (step.m_operandFirst)                     \
+                        for (size_t j = 0; j < n; j++)           \
+                            value[j] = Op##oper(b[j], value[j]); \
+                    else                                         \
+                        for (size_t j = 0; j < n; j++)           \
+                            value[j] = Op##oper(value[j], b[j]); \
+                    break
+                ForAllBinaryOps(CaseBinaryOp);
+#undef CaseBinaryOp
+                default: LogicError("FusedElementwise: Unexpected binary op %d.", (int) m_ops[k]);
+                }
+            }
+        }
+    }
+}
+
+template <class ElemType>
+/*virtual*/ void FusedElementwiseNode<ElemType>::BackpropTo(const size_t /*inputIndex*/, const FrameRange& /*fr*/) /*override*/
+{
+    LogicError("%ls %ls operation is for inference only and cannot be differentiated.", NodeName().c_str(), OperationName().c_str());
+}
+
+template <class ElemType>
+/*virtual*/ void FusedElementwiseNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    ValidateNaryZip(isFinalValidationPass, /*allowBroadcast=*/true, GetNumInputs());
+    if (!isFinalValidationPass)
+        return;
+
+    if (m_steps.empty())
+        InvalidArgument("%ls %ls operation has no steps.", NodeName().c_str(), OperationName().c_str());
+    m_ops.resize(m_steps.size());
+    for (size_t k = 0; k < m_steps.size(); k++)
+    {
+        const auto& step = m_steps[k];
+        size_t numArgs = ElementWiseOperatorFromName(step.m_operation, m_ops[k]);
+        if (numArgs == 0)
+            InvalidArgument("%ls %ls operation: Unknown elementwise operation '%ls'.", NodeName().c_str(), OperationName().c_str(), step.m_operation.c_str());
+        if (numArgs != (step.m_operand < 0 ? 1 : 2) || step.m_operand >= (int) GetNumInputs())
+            InvalidArgument("%ls %ls operation: Invalid operand for '%ls'.", NodeName().c_str(), OperationName().c_str(), step.m_operation.c_str());
+    }
+
+    // determine where each element of a broadcast input comes from, for each row of the output
+    const auto& shape = GetSampleLayout();
+    m_rowOffsets.assign(GetNumInputs(), std::vector<size_t>());
+    for (size_t i = 0; i < GetNumInputs(); i++)
+    {
+        const auto& inputShape = Input(i)->GetSampleLayout();
+        if (inputShape.GetNumElements() == shape.GetNumElements())
+            continue;
+        auto& offsets = m_rowOffsets[i];
+        offsets.resize(shape.GetNumElements());
+        for (size_t row = 0; row < offsets.size(); row++)
+        {
+            size_t index = row, offset = 0, stride = 1;
+            for (size_t k = 0; k < shape.GetRank(); k++)
+            {
+                size_t inputDim = k < inputShape.GetRank() ? inputShape[k] : 1;
+                if (inputDim != 1)
+                    offset += (index % shape[k]) * stride;
+                index /= shape[k];
+                stride *= inputDim;
+            }
+            offsets[row] = offset;
+        }
+    }
+}
+
+template class FusedElementwiseNode<float>;
+template class FusedElementwiseNode<double>;
+
 }}}
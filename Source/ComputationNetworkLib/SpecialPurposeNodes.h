@@ -61,6 +61,64 @@ private:
     std::vector<std::string> m_labelMapping;
 };
 
+// -----------------------------------------------------------------------
+// FusedElementwiseNode (input0, operands...) -- a chain of elementwise operations computed in one pass
+// This node is not meant to be written by hand. It is created by the 'optimize' action
+// (ComputationNetwork::OptimizeForInference()) from chains of elementwise nodes, such as Sigmoid(Plus(z, b)),
+// so that the values in between are neither stored nor read back.
+// The value starts out as input0, and each step then updates it in turn:
+//     value = op(value)                                                for unary ops
+//     value = op(value, Input(operand)) or op(Input(operand), value)  for binary ops
+// where 'op' is the name of an ElementWiseOperator without the 'op' prefix, e.g. 'Sigmoid' or 'Sum'.
+// Inputs broadcast to the output shape like in Plus().
+// This node is for inference only and has no gradient.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class FusedElementwiseNode : public ComputationNode<ElemType>
+{
+    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"FusedElementwise"; }
+
+public:
+    struct Step
+    {
+        std::wstring m_operation; // ElementWiseOperator name, e.g. L"Sigmoid" for opSigmoid
+        int m_operand;            // input index of the other argument of a binary op, or -1 for a unary op
+        bool m_operandFirst;      // the other argument comes first, e.g. for Minus(b, value)
+    };
+
+    FusedElementwiseNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+    FusedElementwiseNode(DEVICEID_TYPE deviceId, const wstring& name, const std::vector<Step>& steps)
+        : Base(deviceId, name), m_steps(steps)
+    {
+    }
+    DeclareConstructorFromConfig(FusedElementwiseNode);
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
+    virtual void Save(File& fstream) const override;
+    virtual void Load(File& fstream, size_t modelVersion) override;
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override;
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override;
+    virtual void /*ComputationNode::*/ Validate(bool isFinalValidationPass) override;
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    const std::vector<Step>& GetSteps() const { return m_steps; }
+
+private:
+    void ForwardPropCPU(const FrameRange& fr);
+
+    std::vector<Step> m_steps;
+    // cached stuff (not persisted)
+    std::vector<ElementWiseOperator> m_ops;      // [step] resolved m_operation
+    std::vector<std::vector<size_t>> m_rowOffsets; // [input][output row] offset of the broadcast input element; empty if the input has the output shape
+};
+
 #ifdef COMING_SOON
 
 // -----------------------------------------------------------------------
@@ -1439,6 +1439,8 @@ public:
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    // a second ForwardProp() would draw a different mask
+    virtual bool CanRecomputeForwardProp() const override { return false; }
 
     virtual void UpdateFunctionMBSize() override
     {
@@ -1733,6 +1735,8 @@ public:
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    // ForwardProp() updates the running statistics
+    virtual bool CanRecomputeForwardProp() const override { return false; }
 
     void ForwardProp(const FrameRange& fr) override
     {
@@ -1864,6 +1868,9 @@ public:
             m_blendTimeConst = blendTimeConstant;
     }
 
+    bool IsSpatial() const { return m_spatial; }
+    bool UsesCntkEngine() const { return m_useCntkEngine; }
+
     // called from CloneFunction(..., parameters="constant")
     // Once called, this node is put into inference mode.
     virtual void FreezeParameters() override // from IFreezable
@@ -62,6 +62,13 @@ void CNTKEvalBase<ElemType>::CreateNetwork(const std::string& networkDescription
     {
         LogicError("Unable to construct network from description");
     }
+
+    // evaluation-only: compute matrix products with quantized integer arithmetic where supported (TimesNode on the CPU)
+    if (config(L"quantizedInference", false))
+    {
+        size_t numQuantized = this->m_net->SetQuantizedInference(true);
+        fprintf(stderr, "CreateNetwork: Quantized inference enabled for %d nodes.\n", (int) numQuantized);
+    }
 }
 
 
@@ -307,68 +314,183 @@ VariableSchema CNTKEvalExtended<ElemType>::GetInputSchema() const
     return inputLayouts;
 }
 
+// Checks the input buffer of one sequence against the input node and returns its number of samples.
+template<typename ElemType, template<typename> class ValueContainer>
+static size_t ValidateInputBuffer(const ComputationNodeBasePtr& inputNode, MatrixType type, const ValueBuffer<ElemType, ValueContainer>& buffer)
+{
+    size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+
+    if (buffer.m_buffer.data() == nullptr)
+        RuntimeError("Input %ls: Buffer is not allocated.", inputNode->GetName().c_str());
+    if (type == MatrixType::DENSE)
+    {
+        if (buffer.m_buffer.size() % numRows != 0)
+            RuntimeError("Input %ls: Expected input data to be a multiple of %" PRIu64 ", but it is %" PRIu64 ".", 
+                         inputNode->GetName().c_str(), numRows, buffer.m_buffer.size());
+        if (buffer.m_buffer.size() == 0)
+            RuntimeError("Input %ls: Expected at least one element.", inputNode->GetName().c_str());
+    }
+    else if (type == MatrixType::SPARSE)
+    {
+        if (buffer.m_colIndices.data() == nullptr)
+            RuntimeError("Input %ls: Due to sparse input format, expected colIndices array, but was nullptr.", inputNode->GetName().c_str());
+        if (buffer.m_indices.data() == nullptr)
+            RuntimeError("Input %ls: Due to sparse input format, expected Indices array, but was nullptr.", inputNode->GetName().c_str());
+        if (buffer.m_colIndices.size() < 2)
+            RuntimeError("Input %ls: Expected at least one element (2 entries in colIndices array).", inputNode->GetName().c_str());
+        if (buffer.m_colIndices[0] != 0)
+            RuntimeError("Input %ls: First element of column indices must be 0", inputNode->GetName().c_str());
+        if (buffer.m_colIndices[buffer.m_colIndices.size() - 1] != buffer.m_indices.size())
+            RuntimeError("Input %ls: Last element of column indices must be equal to the size of indices (%ld), but was %d", 
+                         inputNode->GetName().c_str(), buffer.m_indices.size(), 
+                         buffer.m_colIndices[buffer.m_colIndices.size() - 1]);
+    }
+
+    size_t numCols = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
+    assert(numCols >= 1);
+    return numCols;
+}
+
 template<typename ElemType>
 template<template<typename> class ValueContainer>
-void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs)
+void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<const std::vector<ValueBuffer<ElemType, ValueContainer>>*>& inputs,
+                                              const std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>*>& outputs)
 {
     if (!m_started)
         RuntimeError("ForwardPass() called before StartForwardEvaluation()");
 
-    if (inputs.size() != (size_t)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()))
-        RuntimeError("Expected %d inputs, but got %d.", (int)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()), (int)inputs.size());
+    size_t numSequences = inputs.size();
+    if (numSequences == 0)
+        RuntimeError("Expected at least one sequence.");
+
+    if (outputs.size() != numSequences)
+        RuntimeError("Expected outputs for %d sequences, but got %d.", (int)numSequences, (int)outputs.size());
+
+    size_t numInputs = (size_t)std::distance(m_inputMatrices.begin(), m_inputMatrices.end());
+    for (size_t s = 0; s < numSequences; ++s)
+    {
+        if (inputs[s]->size() != numInputs)
+            RuntimeError("Expected %d inputs, but got %d.", (int)numInputs, (int)inputs[s]->size());
 
-    if (outputs.size() != m_outputNodes.size())
-        RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs.size());
+        if (outputs[s]->size() != m_outputNodes.size())
+            RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs[s]->size());
+    }
+
+    // Inputs on the same dynamic axis share their MBLayout, it is packed once, by the first of them.
+    struct PackedLayout
+    {
+        MBLayoutPtr m_layout;
+        std::vector<size_t> m_numSamples;                      // [sequence]
+        std::vector<std::pair<size_t, size_t>> m_placement;    // [sequence] -> (parallel sequence, first time step)
+    };
+    std::vector<PackedLayout> packedLayouts;
 
     size_t i = 0;
     for (auto& inputNode : m_inputNodes)
     {
-        // const cast: The matrix class takes this over without copying and could theoretically change the contents,
-        // though it doesn't in this case.
-        auto& buffer = const_cast<ValueBuffer<ElemType, ValueContainer>&>(inputs[i]);
         auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
         auto type = matrix->GetMatrixType();
         size_t numRows = inputNode->GetSampleLayout().GetNumElements();
 
-        if (buffer.m_buffer.data() == nullptr)
-            RuntimeError("Input %ls: Buffer is not allocated.", m_inputNodes[i]->GetName().c_str());
-        if (type == MatrixType::DENSE)
+        std::vector<size_t> numSamples(numSequences);
+        for (size_t s = 0; s < numSequences; ++s)
+            numSamples[s] = ValidateInputBuffer(inputNode, type, (*inputs[s])[i]);
+
+        auto layout = inputNode->GetMBLayout();
+        auto packed = std::find_if(packedLayouts.begin(), packedLayouts.end(), [&layout](const PackedLayout& p) { return p.m_layout == layout; });
+        if (packed == packedLayouts.end())
         {
-            if (buffer.m_buffer.size() % numRows != 0)
-                RuntimeError("Input %ls: Expected input data to be a multiple of %" PRIu64 ", but it is %" PRIu64 ".", 
-                             m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
-            if (buffer.m_buffer.size() == 0)
-                RuntimeError("Input %ls: Expected at least one element.", m_inputNodes[i]->GetName().c_str());
+            packedLayouts.push_back(PackedLayout{ layout, numSamples, {} });
+            packed = packedLayouts.end() - 1;
+            if (numSequences == 1)
+            {
+                layout->Init(1, numSamples[0]);
+                layout->AddSequence(0, 0, 0, numSamples[0]);
+                packed->m_placement.assign(1, std::make_pair(0, 0));
+            }
+            else
+            {
+                std::vector<MBLayout::SequenceInfo> sequences;
+                for (size_t s = 0; s < numSequences; ++s)
+                    sequences.push_back({ s, SIZE_MAX, 0, numSamples[s] });
+                layout->InitAsPackedSequences(sequences, packed->m_placement, m_rowAllocations);
+            }
         }
-        else if (type == MatrixType::SPARSE)
+        else if (packed->m_numSamples != numSamples)
         {
-            if (buffer.m_colIndices.data() == nullptr)
-                RuntimeError("Input %ls: Due to sparse input format, expected colIndices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_indices.data() == nullptr)
-                RuntimeError("Input %ls: Due to sparse input format, expected Indices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices.size() < 2)
-                RuntimeError("Input %ls: Expected at least one element (2 entries in colIndices array).", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices[0] != 0)
-                RuntimeError("Input %ls: First element of column indices must be 0", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices[buffer.m_colIndices.size() - 1] != buffer.m_indices.size())
-                RuntimeError("Input %ls: Last element of column indices must be equal to the size of indices (%ld), but was %d", 
-                             m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
-                             buffer.m_colIndices[buffer.m_colIndices.size() - 1]);
+            RuntimeError("Input %ls: The number of samples of every sequence must match those of the other inputs on the same dynamic axis.",
+                         inputNode->GetName().c_str());
         }
 
-        int numCols = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
-        assert(numCols >= 1);
-        inputNode->GetMBLayout()->Init(1, numCols);
-        inputNode->GetMBLayout()->AddSequence(0, 0, 0, numCols);
+        if (numSequences == 1)
+        {
+            // A single sequence is taken over as it is.
+            // const cast: The matrix class takes this over without copying and could theoretically change the contents,
+            // though it doesn't in this case.
+            auto& buffer = const_cast<ValueBuffer<ElemType, ValueContainer>&>((*inputs[0])[i]);
+            size_t numCols = numSamples[0];
+            if (type == MatrixType::DENSE)
+                matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
+            else if (type == MatrixType::SPARSE)
+            {
+                // In the sparse case the m_data layout is identical to CUDA's CSC layout
+                // (see http://docs.nvidia.com/cuda/cusparse/#compressed-sparse-column-format-csc).
+                matrix->SetMatrixFromCSCFormat(buffer.m_colIndices.data(), buffer.m_indices.data(), buffer.m_buffer.data(),
+                                               buffer.m_buffer.size(), numRows, numCols);
+            }
+
+            ++i;
+            continue;
+        }
+
+        // Several sequences are interleaved along the time axis: sample t of the sequence placed
+        // at (s, tBegin) goes to column (tBegin + t) * numParallelSequences + s, gaps are left empty.
+        size_t numParallelSequences = layout->GetNumParallelSequences();
+        size_t numCols = layout->GetNumCols();
+        m_sampleSources.assign(numCols, std::make_pair(SIZE_MAX, SIZE_MAX)); // [column] -> (sequence, sample)
+        for (size_t s = 0; s < numSequences; ++s)
+        {
+            for (size_t t = 0; t < numSamples[s]; ++t)
+                m_sampleSources[(packed->m_placement[s].second + t) * numParallelSequences + packed->m_placement[s].first] = std::make_pair(s, t);
+        }
 
         if (type == MatrixType::DENSE)
-            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
+        {
+            m_packedValues.assign(numRows * numCols, 0);
+            for (size_t col = 0; col < numCols; ++col)
+            {
+                const auto& source = m_sampleSources[col];
+                if (source.first == SIZE_MAX)
+                    continue;
+
+                const ElemType* sample = (*inputs[source.first])[i].m_buffer.data() + source.second * numRows;
+                std::copy(sample, sample + numRows, m_packedValues.begin() + col * numRows);
+            }
+
+            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), m_packedValues.data(), matrixFlagNormal);
+        }
         else if (type == MatrixType::SPARSE)
         {
-            // In the sparse case the m_data layout is identical to CUDA's CSC layout
-            // (see http://docs.nvidia.com/cuda/cusparse/#compressed-sparse-column-format-csc).
-            matrix->SetMatrixFromCSCFormat(buffer.m_colIndices.data(), buffer.m_indices.data(), buffer.m_buffer.data(),
-                                           buffer.m_buffer.size(), numRows, numCols);
+            m_packedValues.clear();
+            m_packedIndices.clear();
+            m_packedColIndices.assign(1, 0);
+            for (size_t col = 0; col < numCols; ++col)
+            {
+                const auto& source = m_sampleSources[col];
+                if (source.first != SIZE_MAX)
+                {
+                    const auto& buffer = (*inputs[source.first])[i];
+                    size_t begin = buffer.m_colIndices[source.second];
+                    size_t end = buffer.m_colIndices[source.second + 1];
+                    m_packedValues.insert(m_packedValues.end(), buffer.m_buffer.data() + begin, buffer.m_buffer.data() + end);
+                    m_packedIndices.insert(m_packedIndices.end(), buffer.m_indices.data() + begin, buffer.m_indices.data() + end);
+                }
+
+                m_packedColIndices.push_back((int)m_packedIndices.size());
+            }
+
+            matrix->SetMatrixFromCSCFormat(m_packedColIndices.data(), m_packedIndices.data(), m_packedValues.data(),
+                                           m_packedValues.size(), numRows, numCols);
         }
 
         ++i;
@@ -382,47 +504,135 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
         this->m_net->ForwardProp(node);
         shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
         auto pMBLayout = node->GetMBLayout();
-        if (!pMBLayout)
+
+        // Without a layout, the output is one single sample, which is the same for all sequences.
+        if (!pMBLayout || numSequences == 1)
         {
-            pMBLayout = make_shared<MBLayout>();
-            pMBLayout->InitAsFrameMode(1); // treat this as if we have one single sample
+            if (pMBLayout && pMBLayout->GetNumSequences() != 1)
+                RuntimeError("Only 1 output sequence supported by this API");
+
+            size_t numElements = outputMatrix->GetNumElements();
+            for (size_t s = 0; s < numSequences; ++s)
+            {
+                ValueContainer<ElemType>& vec = (*outputs[s])[i].m_buffer;
+                if (vec.capacity() < numElements)
+                {
+                    // Bad luck - we can't reallocate memory of an external object at this point.
+                    RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+                }
+
+                vec.resize(numElements);
+                ElemType* data = const_cast<ElemType*>(vec.data());
+                outputMatrix->CopyToArray(data, numElements);
+            }
+            continue;
         }
 
-        const auto& seq = pMBLayout->GetAllSequences();
-        if (seq.size() != 1)
-            RuntimeError("Only 1 output sequence supported by this API");
-
-        ValueContainer<ElemType>& vec = outputs[i].m_buffer;
-
+        // Split the minibatch back into the sequences, which are identified by their position in the batch.
+        size_t numRows = outputMatrix->GetNumRows();
         size_t numElements = outputMatrix->GetNumElements();
+        m_outputValues.resize(numElements);
+        ElemType* values = m_outputValues.data();
+        outputMatrix->CopyToArray(values, numElements);
 
-        if (vec.capacity() < numElements)
+        size_t numSequencesFound = 0;
+        for (const auto& seq : pMBLayout->GetAllSequences())
         {
-            // Bad luck - we can't reallocate memory of an external object at this point.
-            RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+
+            if (seq.seqId >= numSequences || seq.tBegin < 0 || seq.tEnd > pMBLayout->GetNumTimeSteps())
+                RuntimeError("Output '%ls': The output sequences do not correspond to the input sequences.", node->GetName().c_str());
+
+            ValueContainer<ElemType>& vec = (*outputs[seq.seqId])[i].m_buffer;
+            size_t numSamples = seq.GetNumTimeSteps();
+            if (vec.capacity() < numSamples * numRows)
+            {
+                // Bad luck - we can't reallocate memory of an external object at this point.
+                RuntimeError("Not enough space in output buffer for output '%ls' of sequence %d.", node->GetName().c_str(), (int)seq.seqId);
+            }
+
+            vec.resize(numSamples * numRows);
+            ElemType* data = const_cast<ElemType*>(vec.data());
+            for (size_t t = 0; t < numSamples; ++t)
+            {
+                const ElemType* sample = values + pMBLayout->GetColumnIndex(seq, t) * numRows;
+                std::copy(sample, sample + numRows, data + t * numRows);
+            }
+            ++numSequencesFound;
         }
 
-        vec.resize(numElements);
-        ElemType* data = const_cast<ElemType*>(vec.data());
-        outputMatrix->CopyToArray(data, numElements);
+        if (numSequencesFound != numSequences)
+            RuntimeError("Output '%ls': Expected %d output sequences, but got %d.", node->GetName().c_str(), (int)numSequences, (int)numSequencesFound);
     }
 }
 
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+void CNTKEvalExtended<ElemType>::ForwardPassBatchT(const std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>>& inputs,
+                                                   std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>>& outputs)
+{
+    std::vector<const std::vector<ValueBuffer<ElemType, ValueContainer>>*> inputSequences;
+    for (const auto& sequence : inputs)
+        inputSequences.push_back(&sequence);
+
+    std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>*> outputSequences;
+    for (auto& sequence : outputs)
+        outputSequences.push_back(&sequence);
+
+    ForwardPassT(inputSequences, outputSequences);
+}
+
 template<typename ElemType>
 void CNTKEvalExtended<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs)
 {
-    ForwardPassT(inputs, outputs);
+    ForwardPassT<Vector>({ &inputs }, { &outputs });
 }
 
 template<typename ElemType>
 void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& outputs)
 {
-    ForwardPassT(inputs, outputs);
+    ForwardPassT<VectorRef>({ &inputs }, { &outputs });
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPass(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs)
+{
+    ForwardPassBatchT(inputs, outputs);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPass(const std::vector<ValueRefs<ElemType>>& inputs, std::vector<ValueRefs<ElemType>>& outputs)
+{
+    ForwardPassBatchT(inputs, outputs);
+}
+
+template<typename ElemType>
+IEvaluateModelExtended<ElemType>* CNTKEvalExtended<ElemType>::Clone()
+{
+    if (!this->m_net)
+        RuntimeError("Clone() called before CreateNetwork()");
+
+    std::unique_ptr<CNTKEvalExtended<ElemType>> clone(new CNTKEvalExtended<ElemType>());
+    clone->m_config = this->m_config;
+    clone->m_net = this->m_net->CloneSharingParameters();
+
+    if (m_started)
+    {
+        std::vector<wstring> outputNodeNames;
+        for (const auto& node : m_outputNodes)
+            outputNodeNames.push_back(node->GetName());
+        clone->StartForwardEvaluation(outputNodeNames);
+    }
+
+    return clone.release();
 }
 
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
+    // restore the operation mode while the network is still alive
+    m_scopedNetworkOperationMode.reset();
     CNTKEvalBase<ElemType>::Destroy();
     delete this;
 }
@@ -102,6 +102,12 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) override;
 
+    virtual void ForwardPass(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) override;
+
+    virtual void ForwardPass(const std::vector<ValueRefs<ElemType>>& inputs, std::vector<ValueRefs<ElemType>>& outputs) override;
+
+    virtual IEvaluateModelExtended<ElemType>* Clone() override;
+
     virtual void Destroy() override;
 
     virtual void CreateNetwork(const std::string& networkDescription) override
@@ -121,8 +127,23 @@ private:
     StreamMinibatchInputs m_inputMatrices;
     bool m_started;
 
+    // Buffers for packing the inputs of several sequences into one minibatch and for unpacking the outputs,
+    // kept across calls to avoid reallocating them for every batch.
+    std::vector<ElemType> m_packedValues;
+    std::vector<int> m_packedIndices;
+    std::vector<int> m_packedColIndices;
+    std::vector<ElemType> m_outputValues;
+    std::vector<std::pair<size_t, size_t>> m_sampleSources;
+    std::vector<size_t> m_rowAllocations;
+
+    // Evaluates the given sequences in one forward pass, inputs[s] and outputs[s] being the buffers of sequence s.
+    template<template<typename> class ValueContainer> 
+    void ForwardPassT(const std::vector<const std::vector<ValueBuffer<ElemType, ValueContainer>>*>& inputs,
+                      const std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>*>& outputs);
+
+    // Calls ForwardPassT() for a batch of sequences.
     template<template<typename> class ValueContainer> 
-    void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
-                      std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs);
+    void ForwardPassBatchT(const std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>>& inputs,
+                           std::vector<std::vector<ValueBuffer<ElemType, ValueContainer>>>& outputs);
 };
 } } }
@@ -549,6 +549,7 @@ template<typename BlockHandlerT> class BlockMultiplier
         int m_numThreads;
 
         BlockMultiplier(int numThreads = 1) 
+            : m_pBlockHandlerBInfo(nullptr)
         {
             SetNumThreads(numThreads);
         }
@@ -560,7 +561,7 @@ template<typename BlockHandlerT> class BlockMultiplier
             m_pPool.reset(new StdThreadPool<HandlerArgs<BlockHandlerT>>(threads));
 #else
 #ifdef OPENMPTHREAD
-            m_oldNumThreads = omp_get_num_threads();
+            m_oldNumThreads = omp_get_max_threads(); // (omp_get_num_threads() would return 1 outside of a parallel region)
             omp_set_num_threads(threads);
 #endif
 #endif
@@ -939,12 +940,13 @@ template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyMa
 #endif
                     for (int startRow = 0; startRow < m; startRow += 4)
                     {
-                        ha.startRow = startRow;
+                        HandlerArgs<BlockHandlerT> haRow = ha; // (a copy per iteration, since iterations may run concurrently)
+                        haRow.startRow = startRow;
 #ifdef STDTHREAD
-                        m_pPool->QueueAndWake(ha, currBlockInfo.fourFn);
+                        m_pPool->QueueAndWake(haRow, currBlockInfo.fourFn);
 #else
 #ifdef OPENMPTHREAD
-                        currBlockInfo.fourFn(ha);
+                        currBlockInfo.fourFn(haRow);
 #endif
 #endif
                     }
@@ -961,12 +963,13 @@ template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyMa
 #endif
                     for (int startRow = 0; startRow < m; ++startRow)
                     {
-                        ha.startRow = startRow;
+                        HandlerArgs<BlockHandlerT> haRow = ha; // (a copy per iteration, since iterations may run concurrently)
+                        haRow.startRow = startRow;
 #ifdef STDTHREAD
-                        m_pPool->QueueAndWake(ha, currBlockInfo.oneFn);
+                        m_pPool->QueueAndWake(haRow, currBlockInfo.oneFn);
 #else
 #ifdef OPENMPTHREAD
-                        currBlockInfo.oneFn(ha);
+                        currBlockInfo.oneFn(haRow);
 #endif
 #endif
                     }
@@ -10,6 +10,7 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "CPUTensorKernels.h"
 #include "TensorOps.h"
 #include <assert.h>
 #include <stdexcept>
@@ -84,6 +85,22 @@ bool TracingGPUMemoryAllocator::IsTraceEnabled()
     return (m_traceLevel > 0);
 }
 
+#ifdef _MSC_VER
+static __declspec(thread) size_t s_cpuBytesAllocatedByThisThread = 0;
+#else
+static __thread size_t s_cpuBytesAllocatedByThisThread = 0;
+#endif
+
+size_t CPUMemoryAllocationCounter::BytesAllocatedByThisThread()
+{
+    return s_cpuBytesAllocatedByThisThread;
+}
+
+void CPUMemoryAllocationCounter::Add(size_t bytes)
+{
+    s_cpuBytesAllocatedByThisThread += bytes;
+}
+
 #pragma region Helpful Enum Definitions
 enum class MatrixOrder
 {
@@ -127,6 +144,7 @@ template <class ElemType>
 static ElemType* NewArray(size_t n)
 {
     ElemType* p = new ElemType[n]();
+    CPUMemoryAllocationCounter::Add(n * sizeof(ElemType));
 #if 0 // _DEBUG
         ElemType nan = Matrix<ElemType>::MakeNan(__LINE__);
         for (size_t i = 0; i < n; i++)
@@ -875,6 +893,33 @@ void CPUMatrix<ElemType>::SetValue(const GPUSparseMatrix<ElemType>& /*deepCopyFr
 }
 #endif
 
+template <class ElemType>
+void CPUMatrix<ElemType>::SetReadOnlyBuffer(const size_t numRows, const size_t numCols, const std::shared_ptr<const ElemType>& pArray)
+{
+    if (pArray == nullptr && numRows * numCols > 0)
+        InvalidArgument("SetReadOnlyBuffer: pArray == nullptr, but matrix is of size %d * %d.", (int) numRows, (int) numCols);
+
+    // fresh storage, so that neither the previous buffer nor other views of it are affected
+    Base::ZeroInit(matrixFormatDense, CPUDEVICE);
+    m_numRows = numRows;
+    m_numCols = numCols;
+    SetBuffer(const_cast<ElemType*>(pArray.get()), GetNumElements() * sizeof(ElemType), true, pArray, /*readOnly=*/true);
+    SetSizeAllocated(GetNumElements());
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::SetSharedBuffer(const size_t numRows, const size_t numCols, const std::shared_ptr<ElemType>& pArray)
+{
+    if (pArray == nullptr && numRows * numCols > 0)
+        InvalidArgument("SetSharedBuffer: pArray == nullptr, but matrix is of size %d * %d.", (int) numRows, (int) numCols);
+
+    Base::ZeroInit(matrixFormatDense, CPUDEVICE);
+    m_numRows = numRows;
+    m_numCols = numCols;
+    SetBuffer(pArray.get(), GetNumElements() * sizeof(ElemType), true, pArray, /*readOnly=*/false);
+    SetSizeAllocated(GetNumElements());
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, ElemType* pArray, const size_t matrixFlags)
 {
@@ -1021,35 +1066,51 @@ void CPUMatrix<ElemType>::SetDiagonalValue(const CPUMatrix<ElemType>& vector)
     }
 }
 
+// Calls blockOp(u, data, count) for consecutive pieces of data[0..n), with uniform values u[0..count) in [0, 1) from the
+// Philox blocks offset, offset + 1, ... of the stream 'seed'. Since the blocks are independent, this runs in parallel,
+// and the values do not depend on the number of threads.
+template <class ElemType, class BlockOp>
+static void ForEachPhiloxBlock(ElemType* data, size_t n, uint64_t seed, uint64_t offset, const BlockOp& blockOp)
+{
+    const size_t valuesPerBlock = Philox4x32::ValuesPerBlock<ElemType>();
+    const long numBlocks = (long) ((n + valuesPerBlock - 1) / valuesPerBlock);
+#pragma omp parallel for
+    for (long b = 0; b < numBlocks; b++)
+    {
+        ElemType u[Philox4x32::FloatsPerBlock];
+        Philox4x32::ToUniform(Philox4x32::Generate(seed, offset + b), u);
+        const size_t begin = b * valuesPerBlock;
+        blockOp(u, data + begin, min(valuesPerBlock, n - begin));
+    }
+}
+
+// Box-Muller transform of pairs of uniform values into pairs of standard normal values.
+// valuesPerBlock is even, so u[count - 1] always has a partner.
+template <class ElemType, class Assign>
+static void ForEachGaussian(const ElemType* u, ElemType* data, size_t count, const Assign& assign)
+{
+    for (size_t k = 0; k < count; k += 2)
+    {
+        const ElemType r = sqrt(-2 * log(1 - u[k])); // 1 - u is in (0, 1]
+        const ElemType theta = (ElemType) 6.283185307179586 * u[k + 1]; // 2 pi u
+        assign(data[k], r * cos(theta));
+        if (k + 1 < count)
+            assign(data[k + 1], r * sin(theta));
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed)
 {
     if (IsEmpty())
         LogicError("SetUniformRandomValue: Matrix is empty.");
 
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    std::ranlux64_base_01 generator;
-    generator.seed(seed == USE_TIME_BASED_SEED ? (unsigned long) time(NULL) : seed);
-#else
-    std::default_random_engine generator(seed);
-#endif
-    std::uniform_real_distribution<ElemType> r(low, high);
-
-    ElemType* bufPtr = Data();
-    long m = (long) GetNumElements();
-    // four-way unrolling
-    for (long i = 0; i < (m & ~3); i += 4)
-    {
-        bufPtr[i] = r(generator);
-        bufPtr[i + 1] = r(generator);
-        bufPtr[i + 2] = r(generator);
-        bufPtr[i + 3] = r(generator);
-    }
-    // handle remaining stuffs
-    for (long i = m & ~3; i < m; i++)
+    const ElemType range = high - low;
+    ForEachPhiloxBlock(Data(), GetNumElements(), CPURNGHandle::ResolveSeed(seed), 0, [=](const ElemType* u, ElemType* data, size_t count)
     {
-        bufPtr[i] = r(generator);
-    }
+        for (size_t k = 0; k < count; k++)
+            data[k] = low + range * u[k];
+    });
 }
 
 template <class ElemType>
@@ -1061,19 +1122,10 @@ void CPUMatrix<ElemType>::SetGaussianRandomValue(const ElemType mean, const Elem
     if (IsEmpty())
         LogicError("SetUniformRandomValue: Matrix is empty.");
 
-    auto& us = *this;
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    std::ranlux64_base_01 generator;
-    generator.seed(seed == USE_TIME_BASED_SEED ? (unsigned long) time(NULL) : seed);
-#else
-    std::default_random_engine generator(seed);
-#endif
-    std::normal_distribution<ElemType> r(mean, sigma);
-    // #pragma omp parallel for   // is it thread safe?
-    foreach_coord (i, j, us)
+    ForEachPhiloxBlock(Data(), GetNumElements(), CPURNGHandle::ResolveSeed(seed), 0, [=](const ElemType* u, ElemType* data, size_t count)
     {
-        us(i, j) = r(generator);
-    }
+        ForEachGaussian(u, data, count, [=](ElemType& d, ElemType z) { d = mean + sigma * z; });
+    });
 }
 
 template <class ElemType>
@@ -1085,32 +1137,10 @@ void CPUMatrix<ElemType>::AddGaussianRandomValue(const ElemType mean, const Elem
     if (IsEmpty())
         LogicError("SetUniformRandomValue: Matrix is empty.");
 
-    auto& us = *this;
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    std::ranlux64_base_01 generator;
-    generator.seed(seed == USE_TIME_BASED_SEED ? (unsigned long) time(NULL) : seed);
-#else
-    std::default_random_engine generator(seed);
-#endif
-    std::normal_distribution<ElemType> r(mean, sigma);
-
-    long m = (long) GetNumRows(), n = (long) GetNumCols();
-    for (long j = 0; j < n; j++)
+    ForEachPhiloxBlock(Data(), GetNumElements(), CPURNGHandle::ResolveSeed(seed), 0, [=](const ElemType* u, ElemType* data, size_t count)
     {
-        // four-way unrolling
-        for (long i = 0; i < (m & ~3); i += 4)
-        {
-            us(i, j) = r(generator);
-            us(i + 1, j) = r(generator);
-            us(i + 2, j) = r(generator);
-            us(i + 3, j) = r(generator);
-        }
-        // handle remaining stuffs
-        for (long i = m & ~3; i < m; i++)
-        {
-            us(i, j) = r(generator);
-        }
-    }
+        ForEachGaussian(u, data, count, [=](ElemType& d, ElemType z) { d += mean + sigma * z; });
+    });
 }
 
 //maskRate: percentage of values masked out (similar to dropout rate)
@@ -1124,32 +1154,15 @@ void CPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     CPURNGHandle* cpuRNGHandle = dynamic_cast<CPURNGHandle*>(&rngHandle);
     assert(cpuRNGHandle != nullptr);
 
-    auto& us = *this;
-    std::uniform_real_distribution<ElemType> r(0, 1);
-
-    long m = (long) GetNumRows(), n = (long) GetNumCols();
-    ElemType v;
-    for (long j = 0; j < n; j++)
+    // each mask takes the next part of the handle's stream
+    const size_t n = GetNumElements();
+    const size_t valuesPerBlock = Philox4x32::ValuesPerBlock<ElemType>();
+    const uint64_t offset = cpuRNGHandle->Advance((n + valuesPerBlock - 1) / valuesPerBlock);
+    ForEachPhiloxBlock(Data(), n, cpuRNGHandle->Seed(), offset, [=](const ElemType* u, ElemType* data, size_t count)
     {
-        // four-way unrolling
-        for (long i = 0; i < (m & ~3); i += 4)
-        {
-            v = r(cpuRNGHandle->Generator());
-            us(i, j) = v <= maskRate ? 0 : scaleValue;
-            v = r(cpuRNGHandle->Generator());
-            us(i + 1, j) = v <= maskRate ? 0 : scaleValue;
-            v = r(cpuRNGHandle->Generator());
-            us(i + 2, j) = v <= maskRate ? 0 : scaleValue;
-            v = r(cpuRNGHandle->Generator());
-            us(i + 3, j) = v <= maskRate ? 0 : scaleValue;
-        }
-        // handle remaining stuffs
-        for (long i = m & ~3; i < m; i++)
-        {
-            v = r(cpuRNGHandle->Generator());
-            us(i, j) = v <= maskRate ? 0 : scaleValue;
-        }
-    }
+        for (size_t k = 0; k < count; k++)
+            data[k] = u[k] < maskRate ? 0 : scaleValue;
+    });
 }
 
 template <class ElemType>
@@ -1396,8 +1409,9 @@ void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
     VerifyResizable(__func__);
 
     size_t numElements = numRows * numCols;
-    if (numElements > GetSizeAllocated() ||                 // grow allocation
-        (!growOnly && (numElements != GetSizeAllocated()))) // shrink allocation (not if 'growOnly')
+    if (numElements > GetSizeAllocated() ||                        // grow allocation
+        (!growOnly && (numElements != GetSizeAllocated())) ||       // shrink allocation (not if 'growOnly')
+        (HasExternalBuffer() && numElements != GetSizeAllocated())) // a shared buffer (see SetSharedBuffer()) is only kept for a reshape
     {
         // reallocate buffer
         ElemType* pArray = nullptr;
@@ -1406,7 +1420,8 @@ void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
             pArray = NewArray<ElemType>(numElements);
         }
         // success: update the object
-        delete[] Buffer();
+        if (!HasExternalBuffer())
+            delete[] Buffer();
 
         SetBuffer(pArray, numElements * sizeof(ElemType));
         SetSizeAllocated(numElements);
@@ -1459,10 +1474,16 @@ size_t CPUMatrix<ElemType>::CopyToArray(ElemType*& arrayCopyTo, size_t& currentA
 }
 
 template <typename ElemType>
-void CPUMatrix<ElemType>::CopySection(size_t /*numRows*/, size_t /*numCols*/, ElemType* /*dst*/, size_t /*colStride*/) const
+void CPUMatrix<ElemType>::CopySection(size_t numRows, size_t numCols, ElemType* dst, size_t colStride) const
 {
-    // REVIEW alexeyk: currently not used by CPU, but implement when possible.
-    RuntimeError("Not implemented.");
+    if (numRows > m_numRows || numCols > m_numCols || colStride < numRows)
+        InvalidArgument("CopySection: The section [%d x %d] with column stride %d does not fit.", (int) numRows, (int) numCols, (int) colStride);
+
+    if (numRows == m_numRows && colStride == numRows)
+        memcpy(dst, Data(), numRows * numCols * sizeof(ElemType));
+    else
+        for (size_t j = 0; j < numCols; j++)
+            memcpy(dst + j * colStride, Data() + LocateColumn(j), numRows * sizeof(ElemType));
 }
 
 template <class ElemType>
@@ -6139,6 +6160,7 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/,
             for (int k = 0; k < (int) K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
+        //       The most frequent ops bypass this through the explicitly vectorized kernels in CPUTensorKernels.cpp.
         // TODO: The signedness of k (required for omp) causes an extra sign-extend.
         // TODO: OMP adds LOTS of overhead. Do we need a guard, a min size when to use it?
     }
@@ -6266,6 +6288,7 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
 // * It is not consitent with what we do on GPU, there we aggregate on ElemType.
 // * It costs performance.
 // TODO: apdapt e2e tests to run with aggregator of type ElemType.
+// Note: The vectorized kernels (CPUTensorKernels) accumulate sums in double by default as well.
 #define CaseTensorOpWithFnAndReduction(oper)                                                  \
     case ElementWiseOperator::op##oper:                                                       \
     return TensorOpWithFnAndReduction(beta, pointers, alpha, opfn, [](double a, double b)     \
@@ -6299,7 +6322,12 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     if (reductionOp != ElementWiseOperator::opSum && reductionOp != ElementWiseOperator::opMax && reductionOp != ElementWiseOperator::opMin)
         InvalidArgument("TensorOp: Unary reduction operations other than opMax, opMin, opSum not yet implemented.");
 
+    // common ops on contiguous data go to the explicitly vectorized kernels
+    if (CPUTensorKernels::TensorOp(beta, a.Data(), Data(), alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
+
 // TODO: Change the lambda to take a pointer and a number of elements, so that we can pass it 1 or 4 elements, in order for it to SSE-vectorize.
+//       (Done for the most frequent ops in CPUTensorKernels, see above.)
 #define CaseUnaryTensorOp(oper)                                                        \
     case ElementWiseOperator::op##oper:                                                \
         return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 2>& pp) \
@@ -6328,6 +6356,9 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     if (reductionOp != ElementWiseOperator::opSum)
         InvalidArgument("TensorOp (binary): The only permitted binary reduction operation is opSum.");
 
+    if (CPUTensorKernels::TensorOp(beta, a.Data(), b.Data(), Data(), alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
+
 #define CaseBinaryTensorOp(oper)                                                       \
     case ElementWiseOperator::op##oper:                                                \
         return TensorOpWithFn(beta, pointers, alpha, [](const array<ElemType*, 3>& pp) \
@@ -136,6 +136,12 @@ public:
     //void SetValue(const CPUSparseMatrix<ElemType>& deepCopyFrom);
     //void SetValue(const GPUSparseMatrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, ElemType* pArray, size_t matrixFlags = matrixFlagNormal);
+    // Makes the matrix use the given buffer without copying it, and keeps the buffer alive. The matrix must not be modified
+    // afterwards (e.g., the buffer may be a read-only file mapping); resizing it fails.
+    void SetReadOnlyBuffer(const size_t numRows, const size_t numCols, const std::shared_ptr<const ElemType>& pArray);
+    // Same for a buffer that is handed over to the matrix, which may write to it (e.g., a packed minibatch, see ReaderShim).
+    // Resizing it to a different number of elements replaces the buffer by one of the matrix' own.
+    void SetSharedBuffer(const size_t numRows, const size_t numCols, const std::shared_ptr<ElemType>& pArray);
 
     void MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val);
 
@@ -453,13 +459,9 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        us.RequireSize(numRows, numCols);
+        stream.ReadArray(us.Data(), numRows * numCols);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
-
-        delete[] d_array;
         return stream;
     }
     friend File& operator<<(File& stream, const CPUMatrix<ElemType>& us)
@@ -472,8 +474,7 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.Buffer()[i];
+        stream.WriteArray(us.Data(), us.GetNumElements());
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
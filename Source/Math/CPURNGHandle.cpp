@@ -11,14 +11,8 @@
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 CPURNGHandle::CPURNGHandle(int deviceId, unsigned long seed)
-    : RNGHandle(deviceId)
+    : RNGHandle(deviceId), m_seed(ResolveSeed(seed)), m_offset(0)
 {
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    m_generator.reset(new std::ranlux64_base_01());
-    m_generator->seed(seed);
-#else
-    m_generator.reset(new std::default_random_engine(seed));
-#endif
 }
 
 }}}
@@ -8,35 +8,87 @@
 #pragma once
 
 #include "RNGHandle.h"
-#include <memory>
-#include <random>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+#ifndef USE_TIME_BASED_SEED
+#define USE_TIME_BASED_SEED ULONG_MAX
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Philox4x32-10 counter-based random number generator (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011).
+// Each (key, counter) pair maps to four independent 32-bit random numbers, so that any part of a random stream
+// can be computed without computing what comes before it. The CPU random fills use the element index as the
+// counter, so that their results do not depend on the number of threads.
+struct Philox4x32
+{
+    typedef std::array<uint32_t, 4> Block;
+
+    static Block Generate(uint64_t key, uint64_t counter)
+    {
+        Block c = {(uint32_t) counter, (uint32_t) (counter >> 32), 0, 0};
+        uint32_t k0 = (uint32_t) key, k1 = (uint32_t) (key >> 32);
+        for (int round = 0; round < 10; round++)
+        {
+            const uint64_t p0 = (uint64_t) 0xD2511F53 * c[0];
+            const uint64_t p1 = (uint64_t) 0xCD9E8D57 * c[2];
+            c = {(uint32_t) (p1 >> 32) ^ c[1] ^ k0, (uint32_t) p1, (uint32_t) (p0 >> 32) ^ c[3] ^ k1, (uint32_t) p0};
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        return c;
+    }
+
+    // Uniform values in [0, 1) made from one block: four floats with 24 bits each, or two doubles with 53 bits each.
+    static const size_t FloatsPerBlock = 4;
+    static const size_t DoublesPerBlock = 2;
+    template <class ElemType>
+    static size_t ValuesPerBlock()
+    {
+        return sizeof(ElemType) == sizeof(float) ? FloatsPerBlock : DoublesPerBlock;
+    }
+    static void ToUniform(const Block& b, float* u)
+    {
+        for (size_t i = 0; i < FloatsPerBlock; i++)
+            u[i] = (b[i] >> 8) * (1.0f / (1 << 24));
+    }
+    static void ToUniform(const Block& b, double* u)
+    {
+        for (size_t i = 0; i < DoublesPerBlock; i++)
+            u[i] = ((((uint64_t) b[2 * i] << 32) | b[2 * i + 1]) >> 11) * (1.0 / ((uint64_t) 1 << 53));
+    }
+};
+
 class CPURNGHandle : public RNGHandle
 {
 public:
     CPURNGHandle(int deviceId, unsigned long seed);
 
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    std::ranlux64_base_01& Generator()
+    // the key of the Philox stream for a seed, where USE_TIME_BASED_SEED stands for the current time
+    static uint64_t ResolveSeed(unsigned long seed)
     {
-        return *m_generator;
+        return seed == USE_TIME_BASED_SEED ? (uint64_t) time(NULL) : seed;
     }
 
-private:
-    std::unique_ptr<std::ranlux64_base_01> m_generator;
+    uint64_t Seed() const
+    {
+        return m_seed;
+    }
 
-#else
-    std::default_random_engine& Generator()
+    // Reserves the next numBlocks counter values of the stream, and returns the first of them.
+    uint64_t Advance(uint64_t numBlocks)
     {
-        return *m_generator;
+        uint64_t offset = m_offset;
+        m_offset += numBlocks;
+        return offset;
     }
 
 private:
-    std::unique_ptr<std::default_random_engine> m_generator;
-#endif
-
+    uint64_t m_seed;
+    uint64_t m_offset;
 };
 
 }}}
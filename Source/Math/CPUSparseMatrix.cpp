@@ -245,8 +245,9 @@ void CPUSparseMatrix<ElemType>::SetValue(const size_t row, const size_t col, con
         SetColIdx((int) c);
     }
 	// Note we don't have m_nz anymore. In order for the change from m_nz to
-    // NzCount to make sense, we need to propogate nz+1 to all col slices.
-    for (size_t max = c + 1; max < m_numCols + 1; max++)
+    // NzCount to make sense, we need to propogate nz+1 to all col slices (row slices for CSR).
+    size_t numOuter = (GetFormat() == matrixFormatSparseCSC) ? m_numCols : m_numRows;
+    for (size_t max = c + 1; max < numOuter + 1; max++)
     {
         SecondaryIndexLocation()[max] = CPUSPARSE_INDEX_TYPE(nz + 1);
     }
@@ -618,6 +619,7 @@ void CPUSparseMatrix<ElemType>::Allocate(const size_t numRows, const size_t numC
             auto* pArray      = new ElemType[numNZElemToReserve]();
             auto* unCompIndex = new CPUSPARSE_INDEX_TYPE[numNZElemToReserve]();
             auto* compIndex   = new CPUSPARSE_INDEX_TYPE[newCompIndexSize]();
+            CPUMemoryAllocationCounter::Add(numNZElemToReserve * (sizeof(ElemType) + sizeof(CPUSPARSE_INDEX_TYPE)) + newCompIndexSize * sizeof(CPUSPARSE_INDEX_TYPE));
 
             if (keepExistingValues && (NzCount() > numNZElemToReserve || GetCompIndexSize() > newCompIndexSize))
                 LogicError("Allocate: To keep values m_nz should <= numNZElemToReserve and m_compIndexSize <= newCompIndexSize");
@@ -647,6 +649,7 @@ void CPUSparseMatrix<ElemType>::Allocate(const size_t numRows, const size_t numC
         {
             ElemType* blockVal = new ElemType[numNZElemToReserve];
             size_t* blockIds = new size_t[newCompIndexSize];
+            CPUMemoryAllocationCounter::Add(numNZElemToReserve * sizeof(ElemType) + newCompIndexSize * sizeof(size_t));
 
             if (keepExistingValues && (NzCount() > numNZElemToReserve || GetCompIndexSize() > newCompIndexSize))
                 LogicError("Resize: To keep values m_nz should <= numNZElemToReserve and m_compIndexSize <= newCompIndexSize");
@@ -741,8 +744,116 @@ void CPUSparseMatrix<ElemType>::Reset()
     SetBlockIdShift(0);
 }
 
+// The nonzeros of op(a), for a sparse CSC or CSR matrix a, listed column by column.
+// A CSR matrix is the CSC representation of its transpose, so a CSC a with transposeA = false and a CSR a with
+// transposeA = true directly provide the columns of op(a). In the other two cases the nonzeros are regrouped by
+// their row index; only the non-empty columns are listed then.
+// Listed column k is column ColumnId(k) of op(a), its nonzeros are at positions start[k] <= p < start[k + 1]
+// of rowIndex[] and values[].
+template <class ElemType>
+class SparseColumnsOf
+{
+public:
+    SparseColumnsOf(size_t numOuter, const CPUSPARSE_INDEX_TYPE* outerStart, const CPUSPARSE_INDEX_TYPE* innerIndex, const ElemType* values, bool regroup)
+    {
+        if (!regroup)
+        {
+            m_numColumns = numOuter;
+            m_columnIds = nullptr;
+            m_start = outerStart;
+            m_rowIndex = innerIndex;
+            m_values = values;
+            return;
+        }
+
+        // order the nonzeros by their inner index; within an inner index they stay ordered by the outer index
+        vector<pair<CPUSPARSE_INDEX_TYPE, CPUSPARSE_INDEX_TYPE>> entries; // (inner index, outer index) of the nonzero at position p
+        entries.reserve(outerStart[numOuter] - outerStart[0]);
+        for (size_t j = 0; j < numOuter; j++)
+            for (CPUSPARSE_INDEX_TYPE p = outerStart[j]; p < outerStart[j + 1]; p++)
+                entries.push_back(make_pair(innerIndex[p], (CPUSPARSE_INDEX_TYPE) j));
+        vector<CPUSPARSE_INDEX_TYPE> order(entries.size());
+        for (size_t q = 0; q < order.size(); q++)
+            order[q] = (CPUSPARSE_INDEX_TYPE) q;
+        stable_sort(order.begin(), order.end(), [&entries](CPUSPARSE_INDEX_TYPE x, CPUSPARSE_INDEX_TYPE y) { return entries[x].first < entries[y].first; });
+
+        m_regroupedRowIndex.resize(order.size());
+        m_regroupedValues.resize(order.size());
+        for (size_t q = 0; q < order.size(); q++)
+        {
+            const auto& entry = entries[order[q]];
+            if (m_regroupedColumnIds.empty() || m_regroupedColumnIds.back() != (size_t) entry.first)
+            {
+                m_regroupedColumnIds.push_back(entry.first);
+                m_regroupedStart.push_back((CPUSPARSE_INDEX_TYPE) q);
+            }
+            m_regroupedRowIndex[q] = entry.second;
+            m_regroupedValues[q] = values[outerStart[0] + order[q]];
+        }
+        m_regroupedStart.push_back((CPUSPARSE_INDEX_TYPE) order.size());
+
+        m_numColumns = m_regroupedColumnIds.size();
+        m_columnIds = m_regroupedColumnIds.data();
+        m_start = m_regroupedStart.data();
+        m_rowIndex = m_regroupedRowIndex.data();
+        m_values = m_regroupedValues.data();
+    }
+
+    size_t NumColumns() const { return m_numColumns; }
+    size_t ColumnId(size_t k) const { return m_columnIds ? m_columnIds[k] : k; }
+    bool IsEmpty(size_t k) const { return m_start[k] == m_start[k + 1]; }
+
+    // target[h] += alpha * sum_p op(lhs)(h, rowIndex[p]) * values[p] over the nonzeros p of listed column k, for hBegin <= h < hEnd
+    void AccumulateProduct(ElemType alpha, const CPUMatrix<ElemType>& lhs, bool transposeLhs, size_t k, size_t hBegin, size_t hEnd, ElemType* target) const
+    {
+        const size_t ld = lhs.GetNumRows();
+        const ElemType* lhsData = lhs.Data();
+        if (!transposeLhs)
+        {
+            // axpy of the (contiguous) lhs columns into the target segment
+            for (CPUSPARSE_INDEX_TYPE p = m_start[k]; p < m_start[k + 1]; p++)
+            {
+                const ElemType* a = lhsData + m_rowIndex[p] * ld;
+                const ElemType v = alpha * m_values[p];
+                for (size_t h = hBegin; h < hEnd; h++)
+                    target[h] += v * a[h];
+            }
+        }
+        else
+        {
+            // op(lhs)(h, i) = lhs(i, h): sparse dot product with (contiguous) lhs column h
+            for (size_t h = hBegin; h < hEnd; h++)
+            {
+                const ElemType* a = lhsData + h * ld;
+                ElemType sum = 0;
+                for (CPUSPARSE_INDEX_TYPE p = m_start[k]; p < m_start[k + 1]; p++)
+                    sum += a[m_rowIndex[p]] * m_values[p];
+                target[h] += alpha * sum;
+            }
+        }
+    }
+
+private:
+    size_t m_numColumns;
+    const size_t* m_columnIds; // nullptr: listed column k is column k
+    const CPUSPARSE_INDEX_TYPE* m_start;
+    const CPUSPARSE_INDEX_TYPE* m_rowIndex;
+    const ElemType* m_values;
+
+    // storage of the regrouped nonzeros
+    vector<size_t> m_regroupedColumnIds;
+    vector<CPUSPARSE_INDEX_TYPE> m_regroupedStart;
+    vector<CPUSPARSE_INDEX_TYPE> m_regroupedRowIndex;
+    vector<ElemType> m_regroupedValues;
+};
+
+// Rows of the result that one task of a dense x sparse product computes. Each task updates one column segment of this
+// length with the matching segments of the lhs columns, which keeps them in the L1 cache while the nonzeros are applied.
+static const size_t c_denseTimesSparseRowBlock = 256;
+
 // c = alpha*op(lhs) * op(rhs) + beta*c
 // dense x sparse = dense
+// The work is split into (column of c, block of rows of c) tasks, which write to disjoint parts of c.
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                                        const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
@@ -762,6 +873,9 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
         InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
     }
 
+    if (rhs.GetFormat() != matrixFormatSparseCSC && rhs.GetFormat() != matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
+
     if (beta == 0)
         c.RequireSize(m, n);
     else
@@ -770,7 +884,7 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
 
     if (beta == 0)
     {
-        memset(c.Buffer(), 0, sizeof(ElemType) * c.GetNumElements());
+        memset(c.Data(), 0, sizeof(ElemType) * c.GetNumElements());
     }
     else if (beta != 1)
     {
@@ -781,57 +895,26 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
         }
     }
 
-    if (rhs.GetFormat() != matrixFormatSparseCSC)
-        NOT_IMPLEMENTED;
+    bool isCSC = rhs.GetFormat() == matrixFormatSparseCSC;
+    const SparseColumnsOf<ElemType> columns(isCSC ? rhs.GetNumCols() : rhs.GetNumRows(), rhs.SecondaryIndexLocation(), rhs.GetUnCompIndex(), rhs.Buffer(),
+                                            /*regroup=*/isCSC == transposeB);
 
-    if (!transposeA && !transposeB)
-    {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
-        {
-            size_t start = rhs.SecondaryIndexLocation()[j]; // ColLocation
-            size_t end = rhs.SecondaryIndexLocation()[j + 1];
-            for (size_t p = start; p < end; p++)
-            {
-                size_t i = rhs.MajorIndexLocation()[p]; // RowLocation
-                ElemType val = rhs.Buffer()[p];
-
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                {
-                    c(h, j) += alpha * lhs(h, i) * val;
-                }
-            }
-        }
-    }
-    else if (!transposeA && transposeB)
-    {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
-        {
-            size_t start = rhs.SecondaryIndexLocation()[j];
-            size_t end = rhs.SecondaryIndexLocation()[j + 1];
-
-            for (size_t p = start; p < end; p++)
-            {
-                size_t i = rhs.MajorIndexLocation()[p];
-                ElemType val = rhs.Buffer()[p];
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                {
-                    c(h, i) += alpha * lhs(h, j) * val;
-                }
-            }
-        }
-    }
-    else if (transposeA && !transposeB)
-    {
-        NOT_IMPLEMENTED;
-    }
-    else
+    const long numRowBlocks = (long) ((m + c_denseTimesSparseRowBlock - 1) / c_denseTimesSparseRowBlock);
+    const long numTasks = numRowBlocks * (long) columns.NumColumns();
+#pragma omp parallel for
+    for (long t = 0; t < numTasks; t++)
     {
-        NOT_IMPLEMENTED;
+        size_t col = t / numRowBlocks;
+        size_t hBegin = (t % numRowBlocks) * c_denseTimesSparseRowBlock;
+        size_t hEnd = min(hBegin + c_denseTimesSparseRowBlock, (size_t) m);
+        columns.AccumulateProduct(alpha, lhs, transposeA, col, hBegin, hEnd, c.Data() + columns.ColumnId(col) * m);
     }
 }
 
 // dense x sparse = sparse
 // c = alpha * op(lhs) * op(rhs)
+// The result is stored in SparseBlockCol format, with one block per non-zero column of op(rhs), in increasing column order.
+// This is the gradient of the weight matrix of a product with sparse input; the blocks are computed concurrently.
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                                const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, CPUSparseMatrix<ElemType>& c)
@@ -856,71 +939,41 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         InvalidArgument("CPUSparseMatrix::MultiplyAndAdd: The inner dimensions of a and b must match.");
     }
 
-    c.Reset();
-
-    if (!transposeA && !transposeB)
-    {
+    if (rhs.GetFormat() != matrixFormatSparseCSC && rhs.GetFormat() != matrixFormatSparseCSR)
         NOT_IMPLEMENTED;
-    }
-    else if (!transposeA && transposeB)
-    {
-        if (rhs.GetFormat() != matrixFormatSparseCSC)
-            NOT_IMPLEMENTED;
-
-        // allocate enough memory
-        c.SetFormat(matrixFormatSparseBlockCol);
-        c.RequireSizeAndAllocate(m, n, m * min(n, rhs.NzCount()), true, false);
 
-        map<size_t, size_t> w2Id;
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
-        { // j ranges over batches
-            size_t start = rhs.SecondaryIndexLocation()[j];
-            size_t end = rhs.SecondaryIndexLocation()[j + 1];
+    c.Reset();
 
-            for (size_t p = start; p < end; p++)
-            {
-                size_t i = rhs.MajorIndexLocation()[p]; // i ranges over words
-                ElemType val = rhs.Buffer()[p];  // 1 for(i, j)
+    bool isCSC = rhs.GetFormat() == matrixFormatSparseCSC;
+    const SparseColumnsOf<ElemType> columns(isCSC ? rhs.GetNumCols() : rhs.GetNumRows(), rhs.SecondaryIndexLocation(), rhs.GetUnCompIndex(), rhs.Buffer(),
+                                            /*regroup=*/isCSC == transposeB);
 
-                bool first = true;
-                if (w2Id.find(i) == w2Id.end())
-                {
-                    size_t id = w2Id.size();
-                    w2Id[i] = id;
-                    c.GetBlockIds()[c.GetBlockSize()] = i;
-                    c.SetBlockSize(c.GetBlockSize() + 1);
-                }
-                else
-                {
-                    first = false;
-                }
-                size_t pos = w2Id[i] * lhs.GetNumRows();
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                { // h range over hidden layer
-                    if (first == true)
-                    {
-                        c.Buffer()[pos] = alpha * lhs(h, j) * val;
-                    }
-                    else
-                    {
-                        c.Buffer()[pos] += alpha * lhs(h, j) * val;
-                    }
-                    pos++;
-                }
-            }
-        }
-        if (c.GetBlockSize() * m > c.GetSizeAllocated())
-        {
-            LogicError("Sparse matrix is unexpectedly out of range.");
-        }
-    }
-    else if (transposeA && !transposeB)
+    vector<size_t> blocks; // listed columns that become blocks
+    blocks.reserve(columns.NumColumns());
+    for (size_t col = 0; col < columns.NumColumns(); col++)
     {
-        NOT_IMPLEMENTED;
+        if (!columns.IsEmpty(col))
+            blocks.push_back(col);
     }
-    else
+
+    // allocate enough memory
+    c.SetFormat(matrixFormatSparseBlockCol);
+    c.RequireSizeAndAllocate(m, n, m * blocks.size(), true, false);
+    for (size_t b = 0; b < blocks.size(); b++)
+        c.GetBlockIds()[b] = columns.ColumnId(blocks[b]);
+    c.SetBlockSize(blocks.size());
+
+    const long numRowBlocks = (long) ((m + c_denseTimesSparseRowBlock - 1) / c_denseTimesSparseRowBlock);
+    const long numTasks = numRowBlocks * (long) blocks.size();
+#pragma omp parallel for
+    for (long t = 0; t < numTasks; t++)
     {
-        NOT_IMPLEMENTED;
+        size_t b = t / numRowBlocks;
+        size_t hBegin = (t % numRowBlocks) * c_denseTimesSparseRowBlock;
+        size_t hEnd = min(hBegin + c_denseTimesSparseRowBlock, m);
+        ElemType* block = c.Buffer() + b * m;
+        memset(block + hBegin, 0, sizeof(ElemType) * (hEnd - hBegin));
+        columns.AccumulateProduct(alpha, lhs, transposeA, blocks[b], hBegin, hEnd, block);
     }
 }
 
@@ -938,38 +991,49 @@ void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSpars
         InvalidArgument("CPUSparseMatrix::ScaleAndAdd: The dimensions of a and b must match.");
     }
 
+    // Every iteration of the parallel loops below updates a different column (row for CSR and SparseBlockRow) of rhs.
     if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC || lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSR)
     {
-        size_t col_num = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? lhs.GetNumCols() : lhs.GetNumRows();
-        for (size_t j = 0; j < col_num; j++)
+        bool isCSC = lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC;
+        long col_num = (long) (isCSC ? lhs.GetNumCols() : lhs.GetNumRows());
+#pragma omp parallel for
+        for (long j = 0; j < col_num; j++)
         {
-            size_t start = lhs.SecondaryIndexLocation()[j];
-            size_t end = lhs.SecondaryIndexLocation()[j + 1];
-            for (size_t p = start; p < end; p++)
+            long start = (long) lhs.SecondaryIndexLocation()[j];
+            long end = (long) lhs.SecondaryIndexLocation()[j + 1];
+            for (long p = start; p < end; p++)
             {
-                size_t i = lhs.MajorIndexLocation()[p];
+                size_t i = lhs.GetUnCompIndex()[p];
                 ElemType val = lhs.Buffer()[p];
-                size_t r = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? i : j;
-                size_t c = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? j : i;
+                size_t r = isCSC ? i : (size_t) j;
+                size_t c = isCSC ? (size_t) j : i;
                 rhs(r, c) += alpha * val;
             }
         }
     }
-    else if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
+    else if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol)
     {
-        for (size_t j = 0; j < lhs.GetBlockSize(); j++)
+        const size_t len = lhs.GetNumRows();
+#pragma omp parallel for
+        for (long j = 0; j < (long) lhs.GetBlockSize(); j++)
         {
             size_t i = lhs.GetBlockIds()[j] - lhs.GetBlockIdShift();
-            size_t len = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? lhs.GetNumRows() : lhs.GetNumCols();
-            size_t start = j * len;
-            for (size_t p = start; p < start + len; p++)
-            {
-                ElemType val = lhs.Buffer()[p];
-
-                size_t r = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? (p - start) : i;
-                size_t c = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? i : (p - start);
-                rhs(r, c) += alpha * val;
-            }
+            const ElemType* block = lhs.Buffer() + j * len;
+            ElemType* column = rhs.Data() + i * rhs.GetNumRows();
+            for (size_t h = 0; h < len; h++)
+                column[h] += alpha * block[h];
+        }
+    }
+    else if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
+    {
+        const size_t len = lhs.GetNumCols();
+#pragma omp parallel for
+        for (long j = 0; j < (long) lhs.GetBlockSize(); j++)
+        {
+            size_t i = lhs.GetBlockIds()[j] - lhs.GetBlockIdShift();
+            const ElemType* block = lhs.Buffer() + j * len;
+            for (size_t h = 0; h < len; h++)
+                rhs(i, h) += alpha * block[h];
         }
     }
     else
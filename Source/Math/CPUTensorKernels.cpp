@@ -0,0 +1,457 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernels.cpp -- runtime dispatch of TensorOp calls to the explicitly vectorized kernels
+//
+// This file maps a TensorOp call (op code, dims and strides) onto one of the kernels in CPUTensorKernelsImpl.h,
+// and splits it across OpenMP threads. The kernels themselves live in the per-ISA translation units.
+//
+
+#include "stdafx.h"
+#include "CPUTensorKernels.h"
+#include "CPUTensorKernelsImpl.h"
+#include <omp.h>
+#include <type_traits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace VectorKernels;
+
+// -----------------------------------------------------------------------
+// instruction-set selection
+// -----------------------------------------------------------------------
+
+static CPUInstructionSet DetectInstructionSet()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return CPUInstructionSet::None;
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx)
+        return CPUInstructionSet::None;
+    const unsigned long long xcr0 = _xgetbv(0);
+    if ((xcr0 & 0x6) != 0x6) // OS saves XMM and YMM state
+        return CPUInstructionSet::None;
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+    const bool avx512f = (info[1] & (1 << 16)) != 0;
+    if (avx512f && (xcr0 & 0xe6) == 0xe6) // OS also saves opmask and ZMM state
+        return CPUInstructionSet::AVX512;
+    if (avx2 && fma)
+        return CPUInstructionSet::AVX2;
+#elif defined(__GNUC__)
+    // note: libgcc only reports AVX features that the OS has enabled
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return CPUInstructionSet::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return CPUInstructionSet::AVX2;
+#endif
+    return CPUInstructionSet::None;
+}
+
+static const CPUInstructionSet s_supportedInstructionSet = DetectInstructionSet();
+static CPUInstructionSet s_instructionSet = s_supportedInstructionSet;
+static CPUReductionPrecision s_reductionPrecision = CPUReductionPrecision::Double;
+
+CPUInstructionSet CPUTensorKernels::SupportedInstructionSet()
+{
+    return s_supportedInstructionSet;
+}
+
+CPUInstructionSet CPUTensorKernels::GetInstructionSet()
+{
+    return s_instructionSet;
+}
+
+void CPUTensorKernels::SetInstructionSet(CPUInstructionSet isa)
+{
+    s_instructionSet = (int) isa < (int) s_supportedInstructionSet ? isa : s_supportedInstructionSet;
+}
+
+const char* CPUTensorKernels::InstructionSetName(CPUInstructionSet isa)
+{
+    switch (isa)
+    {
+    case CPUInstructionSet::AVX2:   return "AVX2";
+    case CPUInstructionSet::AVX512: return "AVX-512";
+    default:                        return "none";
+    }
+}
+
+void CPUTensorKernels::SetReductionPrecision(CPUReductionPrecision precision)
+{
+    s_reductionPrecision = precision;
+}
+
+CPUReductionPrecision CPUTensorKernels::GetReductionPrecision()
+{
+    return s_reductionPrecision;
+}
+
+const char* CPUTensorKernels::ReductionPrecisionName(CPUReductionPrecision precision)
+{
+    switch (precision)
+    {
+    case CPUReductionPrecision::ElemType:    return "elemType";
+    case CPUReductionPrecision::Compensated: return "compensated";
+    default:                                 return "double";
+    }
+}
+
+static Accumulation GetAccumulation()
+{
+    switch (s_reductionPrecision)
+    {
+    case CPUReductionPrecision::ElemType:    return Accumulation::Single;
+    case CPUReductionPrecision::Compensated: return Accumulation::Compensated;
+    default:                                 return Accumulation::Double;
+    }
+}
+
+static const KernelTable* GetKernels()
+{
+    switch (s_instructionSet)
+    {
+    case CPUInstructionSet::AVX512: return &GetAVX512Kernels();
+    case CPUInstructionSet::AVX2:   return &GetAVX2Kernels();
+    default:                        return nullptr;
+    }
+}
+
+// -----------------------------------------------------------------------
+// mapping of op codes
+// -----------------------------------------------------------------------
+
+static bool GetUnaryKernel(ElementWiseOperator op, UnaryKernel& kernel)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opCopy:            kernel = UnaryKernel::Copy;            return true;
+    case ElementWiseOperator::opSigmoid:         kernel = UnaryKernel::Sigmoid;         return true;
+    case ElementWiseOperator::opTanh:            kernel = UnaryKernel::Tanh;            return true;
+    case ElementWiseOperator::opExp:             kernel = UnaryKernel::Exp;             return true;
+    case ElementWiseOperator::opLog:             kernel = UnaryKernel::Log;             return true;
+    case ElementWiseOperator::opLinearRectifier: kernel = UnaryKernel::LinearRectifier; return true;
+    default:                                     return false;
+    }
+}
+
+static bool GetBinaryKernel(ElementWiseOperator op, BinaryKernel& kernel)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opSum:                kernel = BinaryKernel::Sum;                return true;
+    case ElementWiseOperator::opDifference:         kernel = BinaryKernel::Difference;         return true;
+    case ElementWiseOperator::opElementwiseProduct: kernel = BinaryKernel::ElementwiseProduct; return true;
+    case ElementWiseOperator::opElementwiseProductWithSigmoidDerivativeFromOutput:
+        kernel = BinaryKernel::ElementwiseProductWithSigmoidDerivativeFromOutput;
+        return true;
+    case ElementWiseOperator::opElementwiseProductWithTanhDerivativeFromOutput:
+        kernel = BinaryKernel::ElementwiseProductWithTanhDerivativeFromOutput;
+        return true;
+    case ElementWiseOperator::opElementwiseProductWithLinearRectifierDerivativeFromOutput:
+        kernel = BinaryKernel::ElementwiseProductWithLinearRectifierDerivativeFromOutput;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool GetReductionKernel(ElementWiseOperator reductionOp, ReductionKernel& kernel)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opSum: kernel = ReductionKernel::Sum; return true;
+    case ElementWiseOperator::opMax: kernel = ReductionKernel::Max; return true;
+    case ElementWiseOperator::opMin: kernel = ReductionKernel::Min; return true;
+    default:                         return false;
+    }
+}
+
+// -----------------------------------------------------------------------
+// parallelization
+// -----------------------------------------------------------------------
+
+// below this many elements, an op runs on the calling thread (OMP overhead would dominate)
+static const size_t s_parallelThreshold = 32768;
+// elements per OMP work item; a multiple of all vector widths
+static const size_t s_chunkSize = 8192;
+
+// call fn(row, begin, end) for 'rows' rows of 'n' elements, split into chunks across threads if large enough
+template <class F>
+static void ForAllChunks(size_t rows, size_t n, size_t work, size_t chunkSize, const F& fn)
+{
+    if (work < s_parallelThreshold)
+    {
+        for (size_t r = 0; r < rows; r++)
+            fn(r, 0, n);
+        return;
+    }
+    const size_t chunksPerRow = (n + chunkSize - 1) / chunkSize;
+    const int numChunks = (int) (rows * chunksPerRow);
+#pragma omp parallel for
+    for (int i = 0; i < numChunks; i++)
+    {
+        const size_t r = i / chunksPerRow;
+        const size_t begin = (i % chunksPerRow) * chunkSize;
+        fn(r, begin, min(begin + chunkSize, n));
+    }
+}
+
+// combine the partial results of the chunks, in the precision of the accumulation
+static double CombineReduction(ReductionKernel kernel, const vector<double>& partials, Accumulation accumulation)
+{
+    if (kernel == ReductionKernel::Sum && accumulation != Accumulation::Double)
+    {
+        float r = (float) partials[0], comp = 0;
+        for (size_t i = 1; i < partials.size(); i++)
+        {
+            const float x = (float) partials[i];
+            if (accumulation == Accumulation::Compensated)
+            {
+                float y = x - comp;
+                float t = r + y;
+                comp = (t - r) - y;
+                r = t;
+            }
+            else
+                r += x;
+        }
+        return r;
+    }
+    double r = partials[0];
+    for (size_t i = 1; i < partials.size(); i++)
+    {
+        const double x = partials[i];
+        switch (kernel)
+        {
+        case ReductionKernel::Sum: r += x; break;
+        case ReductionKernel::Max: r = x > r ? x : r; break;
+        case ReductionKernel::Min: r = x < r ? x : r; break;
+        }
+    }
+    return r;
+}
+
+// reduce n contiguous elements, splitting long vectors across threads
+static double ReduceContiguous(const KernelTable& kernels, ReductionKernel kernel, const float* a, size_t n, Accumulation accumulation, bool allowParallel)
+{
+    if (!allowParallel || n < s_parallelThreshold)
+        return kernels.reduce(kernel, a, n, accumulation);
+    const int numChunks = (int) ((n + s_chunkSize - 1) / s_chunkSize);
+    vector<double> partials(numChunks);
+#pragma omp parallel for
+    for (int i = 0; i < numChunks; i++)
+    {
+        const size_t begin = i * s_chunkSize;
+        partials[i] = kernels.reduce(kernel, a + begin, min(s_chunkSize, n - begin), accumulation);
+    }
+    return CombineReduction(kernel, partials, accumulation);
+}
+
+static double DotContiguous(const KernelTable& kernels, const float* a, const float* b, size_t n, Accumulation accumulation, bool allowParallel)
+{
+    if (!allowParallel || n < s_parallelThreshold)
+        return kernels.dot(a, b, n, accumulation);
+    const int numChunks = (int) ((n + s_chunkSize - 1) / s_chunkSize);
+    vector<double> partials(numChunks);
+#pragma omp parallel for
+    for (int i = 0; i < numChunks; i++)
+    {
+        const size_t begin = i * s_chunkSize;
+        partials[i] = kernels.dot(a + begin, b + begin, min(s_chunkSize, n - begin), accumulation);
+    }
+    return CombineReduction(ReductionKernel::Sum, partials, accumulation);
+}
+
+// c = alpha * r + beta * c, with r rounded to float first, like the generic loops do
+static inline void StoreScalar(float* c, double result, float alpha, float beta)
+{
+    float r = (float) result * alpha;
+    if (beta != 0)
+        r += beta * *c;
+    *c = r;
+}
+
+// -----------------------------------------------------------------------
+// shape analysis
+// Covered are (after the dimension flattening done by TensorView):
+//  - elementwise ops over 1 or 2 dims where the inner dim is contiguous for all operands
+//  - reductions over one dim that is contiguous in the input, producing 0 or 1 output dims (e.g. ReduceSum, column sums)
+//  - reductions over one outer dim into a contiguous output (e.g. row sums, such as bias gradients)
+// -----------------------------------------------------------------------
+
+template <size_t N>
+static bool IsInnerContiguous(const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides)
+{
+    if (regularOpDims.size() < 1 || regularOpDims.size() > 2)
+        return false;
+    for (size_t i = 0; i < N; i++)
+        if (regularStrides[i][0] != 1)
+            return false;
+    return true;
+}
+
+static bool UnaryOpFloat(float beta, const float* pa, float* pc, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                         const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                         const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+    const KernelTable* kernels = GetKernels();
+    if (!kernels)
+        return false;
+
+    if (reducingOpDims.size() == 0) // elementwise
+    {
+        UnaryKernel kernel;
+        if (!GetUnaryKernel(op, kernel) || !IsInnerContiguous(regularOpDims, regularStrides))
+            return false;
+        const size_t n = regularOpDims[0];
+        const size_t rows = regularOpDims.size() > 1 ? regularOpDims[1] : 1;
+        const ptrdiff_t sa = regularOpDims.size() > 1 ? regularStrides[0][1] : 0;
+        const ptrdiff_t sc = regularOpDims.size() > 1 ? regularStrides[1][1] : 0;
+        ForAllChunks(rows, n, rows * n, s_chunkSize, [&](size_t r, size_t begin, size_t end)
+        {
+            kernels->unary(kernel, pc + r * sc + begin, pa + r * sa + begin, end - begin, alpha, beta);
+        });
+        return true;
+    }
+
+    ReductionKernel kernel;
+    if (op != ElementWiseOperator::opCopy || reducingOpDims.size() != 1 || regularOpDims.size() > 1 || !GetReductionKernel(reductionOp, kernel))
+        return false;
+    const Accumulation accumulation = GetAccumulation();
+    const size_t m = reducingOpDims[0];
+    const size_t outputs = regularOpDims.size() > 0 ? regularOpDims[0] : 1;
+    if (reducingStrides[0][0] == 1) // reduction over the contiguous dim of the input
+    {
+        const ptrdiff_t sa = regularOpDims.size() > 0 ? regularStrides[0][0] : 0;
+        const ptrdiff_t sc = regularOpDims.size() > 0 ? regularStrides[1][0] : 0;
+        if (outputs == 1)
+            StoreScalar(pc, ReduceContiguous(*kernels, kernel, pa, m, accumulation, /*allowParallel=*/true), alpha, beta);
+        else if (outputs * m < s_parallelThreshold)
+        {
+            for (size_t j = 0; j < outputs; j++)
+                StoreScalar(pc + j * sc, kernels->reduce(kernel, pa + j * sa, m, accumulation), alpha, beta);
+        }
+        else
+        {
+#pragma omp parallel for
+            for (int j = 0; j < (int) outputs; j++)
+                StoreScalar(pc + j * sc, ReduceContiguous(*kernels, kernel, pa + j * sa, m, accumulation, /*allowParallel=*/false), alpha, beta);
+        }
+        return true;
+    }
+    else if (regularOpDims.size() == 1 && regularStrides[0][0] == 1 && regularStrides[1][0] == 1) // reduction over an outer dim into a contiguous output
+    {
+        const ptrdiff_t lda = reducingStrides[0][0];
+        vector<float> result(outputs);
+        ForAllChunks(1, outputs, outputs * m, 512, [&](size_t, size_t begin, size_t end)
+        {
+            kernels->reduceOuter(kernel, result.data() + begin, pa + begin, end - begin, m, lda, accumulation);
+            kernels->unary(UnaryKernel::Copy, pc + begin, result.data() + begin, end - begin, alpha, beta);
+        });
+        return true;
+    }
+    return false;
+}
+
+static bool BinaryOpFloat(float beta, const float* pa, const float* pb, float* pc, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                          const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                          const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
+{
+    const KernelTable* kernels = GetKernels();
+    if (!kernels)
+        return false;
+
+    if (reducingOpDims.size() == 0) // elementwise
+    {
+        BinaryKernel kernel;
+        if (!GetBinaryKernel(op, kernel) || !IsInnerContiguous(regularOpDims, regularStrides))
+            return false;
+        const size_t n = regularOpDims[0];
+        const size_t rows = regularOpDims.size() > 1 ? regularOpDims[1] : 1;
+        const ptrdiff_t sa = regularOpDims.size() > 1 ? regularStrides[0][1] : 0;
+        const ptrdiff_t sb = regularOpDims.size() > 1 ? regularStrides[1][1] : 0;
+        const ptrdiff_t sc = regularOpDims.size() > 1 ? regularStrides[2][1] : 0;
+        ForAllChunks(rows, n, rows * n, s_chunkSize, [&](size_t r, size_t begin, size_t end)
+        {
+            kernels->binary(kernel, pc + r * sc + begin, pa + r * sa + begin, pb + r * sb + begin, end - begin, alpha, beta);
+        });
+        return true;
+    }
+
+    // inner products, e.g. the gradient of an ElementTimes with a broadcast operand
+    if (op != ElementWiseOperator::opElementwiseProduct || reductionOp != ElementWiseOperator::opSum ||
+        reducingOpDims.size() != 1 || regularOpDims.size() > 1 || reducingStrides[0][0] != 1 || reducingStrides[1][0] != 1)
+        return false;
+    const Accumulation accumulation = GetAccumulation();
+    const size_t m = reducingOpDims[0];
+    const size_t outputs = regularOpDims.size() > 0 ? regularOpDims[0] : 1;
+    const ptrdiff_t sa = regularOpDims.size() > 0 ? regularStrides[0][0] : 0;
+    const ptrdiff_t sb = regularOpDims.size() > 0 ? regularStrides[1][0] : 0;
+    const ptrdiff_t sc = regularOpDims.size() > 0 ? regularStrides[2][0] : 0;
+    if (outputs == 1)
+        StoreScalar(pc, DotContiguous(*kernels, pa, pb, m, accumulation, /*allowParallel=*/true), alpha, beta);
+    else if (outputs * m < s_parallelThreshold)
+    {
+        for (size_t j = 0; j < outputs; j++)
+            StoreScalar(pc + j * sc, kernels->dot(pa + j * sa, pb + j * sb, m, accumulation), alpha, beta);
+    }
+    else
+    {
+#pragma omp parallel for
+        for (int j = 0; j < (int) outputs; j++)
+            StoreScalar(pc + j * sc, kernels->dot(pa + j * sa, pb + j * sb, m, accumulation), alpha, beta);
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------
+// entry points from CPUMatrix::TensorOp()
+// Only float has vectorized kernels at present.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+/*static*/ bool CPUTensorKernels::TensorOp(ElemType beta, const ElemType* pa, ElemType* pc, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                           const array<size_t, 2>& offsets,
+                                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                                           const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+    if (!std::is_same<ElemType, float>::value)
+        return false;
+    return UnaryOpFloat((float) beta, (const float*) (pa + offsets[0]), (float*) (pc + offsets[1]), (float) alpha, op, reductionOp,
+                        regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
+template <class ElemType>
+/*static*/ bool CPUTensorKernels::TensorOp(ElemType beta, const ElemType* pa, const ElemType* pb, ElemType* pc, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                           const array<size_t, 3>& offsets,
+                                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                                           const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
+{
+    if (!std::is_same<ElemType, float>::value)
+        return false;
+    return BinaryOpFloat((float) beta, (const float*) (pa + offsets[0]), (const float*) (pb + offsets[1]), (float*) (pc + offsets[2]), (float) alpha, op, reductionOp,
+                         regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
+template bool CPUTensorKernels::TensorOp<float>(float, const float*, float*, float, ElementWiseOperator, ElementWiseOperator, const array<size_t, 2>&,
+                                                const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 2>&, const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 2>&);
+template bool CPUTensorKernels::TensorOp<double>(double, const double*, double*, double, ElementWiseOperator, ElementWiseOperator, const array<size_t, 2>&,
+                                                 const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 2>&, const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 2>&);
+template bool CPUTensorKernels::TensorOp<float>(float, const float*, const float*, float*, float, ElementWiseOperator, ElementWiseOperator, const array<size_t, 3>&,
+                                                const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 3>&, const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 3>&);
+template bool CPUTensorKernels::TensorOp<double>(double, const double*, const double*, double*, double, ElementWiseOperator, ElementWiseOperator, const array<size_t, 3>&,
+                                                 const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 3>&, const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 3>&);
+
+}}}
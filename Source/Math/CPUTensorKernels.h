@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernels.h -- explicitly vectorized (AVX2, AVX-512) kernels for the most frequent CPU TensorOp cases.
+//
+// CPUMatrix<ElemType>::TensorOp() offers every call to these first. They cover contiguous float tensors
+// for a subset of the ops (Sigmoid, Tanh, Exp, Log, LinearRectifier, Copy, Sum, Difference, ElementwiseProduct,
+// the LSTM gradient ops) and for opSum/opMax/opMin reductions; everything else falls back to the generic loops.
+// The instruction set is picked once at runtime from CPUID.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include "TensorShape.h"
+#include <array>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class CPUInstructionSet
+{
+    None   = 0, // generic (compiler-vectorized) loops only
+    AVX2   = 1, // AVX2 + FMA
+    AVX512 = 2  // AVX-512F
+};
+
+// how the vectorized kernels accumulate sums
+enum class CPUReductionPrecision
+{
+    Double      = 0, // in double, like the generic loops (default)
+    ElemType    = 1, // in ElemType: faster, but results differ from the generic loops in the last bits
+    Compensated = 2  // in ElemType, with Kahan summation
+};
+
+class MATH_API CPUTensorKernels
+{
+public:
+    // the best instruction set supported by this CPU and OS
+    static CPUInstructionSet SupportedInstructionSet();
+
+    // the instruction set currently in use; can be lowered, e.g. to compare against the generic code
+    static CPUInstructionSet GetInstructionSet();
+    static void SetInstructionSet(CPUInstructionSet isa); // capped at SupportedInstructionSet()
+    static const char* InstructionSetName(CPUInstructionSet isa);
+
+    // This affects the vectorized reductions only. The generic loops always accumulate sums in double.
+    static void SetReductionPrecision(CPUReductionPrecision precision);
+    static CPUReductionPrecision GetReductionPrecision();
+    static const char* ReductionPrecisionName(CPUReductionPrecision precision);
+
+    // Execute a TensorOp if it is covered by a vectorized kernel. Returns false, without touching anything, otherwise.
+    // The arguments are those of CPUMatrix::TensorOp(), with the matrices' data pointers instead of the matrices.
+    template <class ElemType>
+    static bool TensorOp(ElemType beta, const ElemType* pa, ElemType* pc, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                         const std::array<size_t, 2>& offsets,
+                         const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                         const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
+
+    template <class ElemType>
+    static bool TensorOp(ElemType beta, const ElemType* pa, const ElemType* pb, ElemType* pc, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                         const std::array<size_t, 3>& offsets,
+                         const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                         const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& reducingStrides);
+};
+
+}}}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsAVX2.cpp -- AVX2/FMA instantiation of the vectorized CPU tensor kernels.
+// This file is compiled with -mavx2 -mfma (see Makefile); it is only entered after a CPUID check.
+// Do not include stdafx.h or other CNTK headers here (see CPUTensorKernelsImpl.h).
+//
+
+#define VECTOR_KERNELS_IMPLEMENTATION
+#include "CPUTensorKernelsImpl.h"
+#include <immintrin.h>
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace VectorKernels {
+
+struct VecAVX2
+{
+    typedef __m256 V;
+    typedef __m256 Mask;
+    typedef __m256d VD; // half a V, in double
+    static const size_t width = 8;
+
+    static inline V Load(const float* p)     { return _mm256_loadu_ps(p); }
+    static inline void Store(float* p, V v)  { _mm256_storeu_ps(p, v); }
+    static inline V Set1(float f)            { return _mm256_set1_ps(f); }
+    static inline V Zero()                   { return _mm256_setzero_ps(); }
+    static inline V Infinity()               { return _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800000)); }
+
+    static inline V Add(V a, V b)            { return _mm256_add_ps(a, b); }
+    static inline V Sub(V a, V b)            { return _mm256_sub_ps(a, b); }
+    static inline V Mul(V a, V b)            { return _mm256_mul_ps(a, b); }
+    static inline V Div(V a, V b)            { return _mm256_div_ps(a, b); }
+    static inline V FMAdd(V a, V b, V c)     { return _mm256_fmadd_ps(a, b, c); } // a * b + c
+    static inline V Max(V a, V b)            { return _mm256_max_ps(a, b); }      // b if either is NaN
+    static inline V Min(V a, V b)            { return _mm256_min_ps(a, b); }      // b if either is NaN
+    static inline V Round(V a)               { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static inline V Abs(V a)                 { return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff))); }
+    static inline V CopySign(V a, V s)       { return _mm256_or_ps(Abs(a), _mm256_and_ps(s, _mm256_castsi256_ps(_mm256_set1_epi32(INT32_MIN)))); }
+
+    static inline VD ZeroD()                 { return _mm256_setzero_pd(); }
+    static inline VD AddD(VD a, VD b)        { return _mm256_add_pd(a, b); }
+    static inline void StoreD(double* p, VD v) { _mm256_storeu_pd(p, v); }
+    static inline VD WidenLo(V a)            { return _mm256_cvtps_pd(_mm256_castps256_ps128(a)); }
+    static inline VD WidenHi(V a)            { return _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)); }
+
+    static inline Mask CmpLT(V a, V b)       { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline Mask CmpGT(V a, V b)       { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static inline Mask CmpEQ(V a, V b)       { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static inline Mask IsNaN(V a)            { return _mm256_cmp_ps(a, a, _CMP_UNORD_Q); }
+    static inline V Select(Mask m, V a, V b) { return _mm256_blendv_ps(b, a, m); } // m ? a : b
+
+    // 2^n for integral-valued n in [-127, 128]
+    static inline V Pow2i(V n)
+    {
+        __m256i i = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(i, 23));
+    }
+    // unbiased binary exponent, as float
+    static inline V Exponent(V x)
+    {
+        __m256i i = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+        return _mm256_cvtepi32_ps(_mm256_sub_epi32(i, _mm256_set1_epi32(127)));
+    }
+    // mantissa scaled into [0.5, 1)
+    static inline V MantissaHalf(V x)
+    {
+        __m256i i = _mm256_and_si256(_mm256_castps_si256(x), _mm256_set1_epi32(~0x7f800000));
+        return _mm256_castsi256_ps(_mm256_or_si256(i, _mm256_castps_si256(_mm256_set1_ps(0.5f))));
+    }
+};
+
+const KernelTable& GetAVX2Kernels()
+{
+    return MakeKernelTable<VecAVX2>();
+}
+
+}}}}
@@ -0,0 +1,83 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsAVX512.cpp -- AVX-512F instantiation of the vectorized CPU tensor kernels.
+// This file is compiled with -mavx512f (see Makefile); it is only entered after a CPUID check.
+// Do not include stdafx.h or other CNTK headers here (see CPUTensorKernelsImpl.h).
+//
+
+#define VECTOR_KERNELS_IMPLEMENTATION
+#include "CPUTensorKernelsImpl.h"
+#include <immintrin.h>
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace VectorKernels {
+
+// Only AVX-512F instructions are used; bitwise float ops go through the integer unit (AVX-512DQ is not assumed).
+struct VecAVX512
+{
+    typedef __m512 V;
+    typedef __mmask16 Mask;
+    typedef __m512d VD; // half a V, in double
+    static const size_t width = 16;
+
+    static inline V Load(const float* p)     { return _mm512_loadu_ps(p); }
+    static inline void Store(float* p, V v)  { _mm512_storeu_ps(p, v); }
+    static inline V Set1(float f)            { return _mm512_set1_ps(f); }
+    static inline V Zero()                   { return _mm512_setzero_ps(); }
+    static inline V Infinity()               { return _mm512_castsi512_ps(_mm512_set1_epi32(0x7f800000)); }
+
+    static inline V Add(V a, V b)            { return _mm512_add_ps(a, b); }
+    static inline V Sub(V a, V b)            { return _mm512_sub_ps(a, b); }
+    static inline V Mul(V a, V b)            { return _mm512_mul_ps(a, b); }
+    static inline V Div(V a, V b)            { return _mm512_div_ps(a, b); }
+    static inline V FMAdd(V a, V b, V c)     { return _mm512_fmadd_ps(a, b, c); } // a * b + c
+    static inline V Max(V a, V b)            { return _mm512_max_ps(a, b); }      // b if either is NaN
+    static inline V Min(V a, V b)            { return _mm512_min_ps(a, b); }      // b if either is NaN
+    static inline V Round(V a)               { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static inline V Abs(V a)                 { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+    static inline V CopySign(V a, V s)
+    {
+        __m512i sign = _mm512_and_si512(_mm512_castps_si512(s), _mm512_set1_epi32(INT32_MIN));
+        return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(Abs(a)), sign));
+    }
+
+    static inline VD ZeroD()                 { return _mm512_setzero_pd(); }
+    static inline VD AddD(VD a, VD b)        { return _mm512_add_pd(a, b); }
+    static inline void StoreD(double* p, VD v) { _mm512_storeu_pd(p, v); }
+    static inline VD WidenLo(V a)            { return _mm512_cvtps_pd(_mm512_castps512_ps256(a)); }
+    static inline VD WidenHi(V a)            { return _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1))); }
+
+    static inline Mask CmpLT(V a, V b)       { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static inline Mask CmpGT(V a, V b)       { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static inline Mask CmpEQ(V a, V b)       { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static inline Mask IsNaN(V a)            { return _mm512_cmp_ps_mask(a, a, _CMP_UNORD_Q); }
+    static inline V Select(Mask m, V a, V b) { return _mm512_mask_blend_ps(m, b, a); } // m ? a : b
+
+    // 2^n for integral-valued n in [-127, 128]
+    static inline V Pow2i(V n)
+    {
+        __m512i i = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(i, 23));
+    }
+    // unbiased binary exponent, as float
+    static inline V Exponent(V x)
+    {
+        __m512i i = _mm512_srli_epi32(_mm512_castps_si512(x), 23);
+        return _mm512_cvtepi32_ps(_mm512_sub_epi32(i, _mm512_set1_epi32(127)));
+    }
+    // mantissa scaled into [0.5, 1)
+    static inline V MantissaHalf(V x)
+    {
+        __m512i i = _mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(~0x7f800000));
+        return _mm512_castsi512_ps(_mm512_or_si512(i, _mm512_castps_si512(_mm512_set1_ps(0.5f))));
+    }
+};
+
+const KernelTable& GetAVX512Kernels()
+{
+    return MakeKernelTable<VecAVX512>();
+}
+
+}}}}
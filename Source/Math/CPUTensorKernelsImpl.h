@@ -0,0 +1,562 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsImpl.h -- ISA-independent implementation of the explicitly vectorized CPU tensor kernels.
+//
+// The kernels are written once against a small 'vector traits' class (VecAVX2, VecAVX512) and are instantiated
+// in a translation unit per instruction set (CPUTensorKernelsAVX2.cpp, CPUTensorKernelsAVX512.cpp), which are
+// the only ones compiled with the respective target flags. CPUTensorKernels.cpp selects one at runtime.
+//
+// Note: this header must stay free of CNTK headers with inline functions. Otherwise the linker may pick up
+// an AVX-compiled copy of such a function for code that runs on a CPU without AVX.
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace VectorKernels {
+
+// the subset of ElementWiseOperator that has a vectorized implementation
+enum class UnaryKernel
+{
+    Copy,
+    Sigmoid,
+    Tanh,
+    Exp,
+    Log, // ClippedLog()
+    LinearRectifier
+};
+
+enum class BinaryKernel
+{
+    Sum,
+    Difference,
+    ElementwiseProduct,
+    ElementwiseProductWithSigmoidDerivativeFromOutput,
+    ElementwiseProductWithTanhDerivativeFromOutput,
+    ElementwiseProductWithLinearRectifierDerivativeFromOutput
+};
+
+enum class ReductionKernel
+{
+    Sum,
+    Max,
+    Min
+};
+
+// how sums are accumulated (max and min are exact either way)
+enum class Accumulation
+{
+    Double,     // in double precision, like the generic CPU loops
+    Single,     // in float
+    Compensated // in float, with a Kahan compensation term per lane
+};
+
+// entry points of one instruction set
+// All kernels compute c = alpha * f(...) + beta * c elementwise, where c is not read if beta == 0.
+struct KernelTable
+{
+    void (*unary)(UnaryKernel kernel, float* c, const float* a, size_t n, float alpha, float beta);
+    void (*binary)(BinaryKernel kernel, float* c, const float* a, const float* b, size_t n, float alpha, float beta);
+    // reduce a[0..n-1] into a single value
+    double (*reduce)(ReductionKernel kernel, const float* a, size_t n, Accumulation accumulation);
+    // c[i] = reduce_j a[i + j * lda] for i < n, j < m (reduction over the outer dimension, e.g. a bias gradient)
+    void (*reduceOuter)(ReductionKernel kernel, float* c, const float* a, size_t n, size_t m, ptrdiff_t lda, Accumulation accumulation);
+    // sum_i a[i] * b[i]; the products are rounded to float, like in the generic loops
+    double (*dot)(const float* a, const float* b, size_t n, Accumulation accumulation);
+};
+
+const KernelTable& GetAVX2Kernels();
+const KernelTable& GetAVX512Kernels();
+
+#ifdef VECTOR_KERNELS_IMPLEMENTATION
+
+// -----------------------------------------------------------------------
+// math functions
+// Polynomial approximations follow the Cephes single-precision library (expf, logf, tanhf).
+// Max(a, b) and Min(a, b) of the traits return b if either argument is NaN; argument order below relies on that
+// to propagate NaNs like the scalar code does.
+// -----------------------------------------------------------------------
+
+// Like expf(), this overflows to inf, underflows through the denormals to 0, and propagates NaN.
+template <class T>
+static inline typename T::V Exp(typename T::V x)
+{
+    typedef typename T::V V;
+    // beyond these bounds the result is inf or 0 anyway; they keep n = round(x / ln 2) within [-150, 128]
+    x = T::Min(T::Set1(89.0f), T::Max(T::Set1(-104.0f), x));
+    V fx = T::Round(T::Mul(x, T::Set1(1.44269504088896341f))); // n = round(x / ln 2)
+    x = T::FMAdd(fx, T::Set1(-0.693359375f), x);                // x -= n * ln 2, in two steps for precision
+    x = T::FMAdd(fx, T::Set1(2.12194440e-4f), x);
+    V y = T::Set1(1.9875691500E-4f);
+    y = T::FMAdd(y, x, T::Set1(1.3981999507E-3f));
+    y = T::FMAdd(y, x, T::Set1(8.3334519073E-3f));
+    y = T::FMAdd(y, x, T::Set1(4.1665795894E-2f));
+    y = T::FMAdd(y, x, T::Set1(1.6666665459E-1f));
+    y = T::FMAdd(y, x, T::Set1(5.0000001201E-1f));
+    y = T::Add(T::FMAdd(y, T::Mul(x, x), x), T::Set1(1.0f));
+    // y * 2^n in two steps, since 2^n itself is not representable at the ends of the range
+    V n1 = T::Round(T::Mul(fx, T::Set1(0.5f)));
+    return T::Mul(T::Mul(y, T::Pow2i(n1)), T::Pow2i(T::Sub(fx, n1)));
+}
+
+// log(x) for finite positive normalized x; callers handle everything else
+template <class T>
+static inline typename T::V LogPositive(typename T::V x)
+{
+    typedef typename T::V V;
+    typedef typename T::Mask Mask;
+    V e = T::Add(T::Exponent(x), T::Set1(1.0f));
+    x = T::MantissaHalf(x); // in [0.5, 1)
+    Mask small = T::CmpLT(x, T::Set1(0.707106781186547524f));
+    e = T::Select(small, T::Sub(e, T::Set1(1.0f)), e);
+    x = T::Sub(T::Select(small, T::Add(x, x), x), T::Set1(1.0f));
+    V z = T::Mul(x, x);
+    V y = T::Set1(7.0376836292E-2f);
+    y = T::FMAdd(y, x, T::Set1(-1.1514610310E-1f));
+    y = T::FMAdd(y, x, T::Set1(1.1676998740E-1f));
+    y = T::FMAdd(y, x, T::Set1(-1.2420140846E-1f));
+    y = T::FMAdd(y, x, T::Set1(1.4249322787E-1f));
+    y = T::FMAdd(y, x, T::Set1(-1.6668057665E-1f));
+    y = T::FMAdd(y, x, T::Set1(2.0000714765E-1f));
+    y = T::FMAdd(y, x, T::Set1(-2.4999993993E-1f));
+    y = T::FMAdd(y, x, T::Set1(3.3333331174E-1f));
+    y = T::Mul(T::Mul(y, x), z);
+    y = T::FMAdd(e, T::Set1(-2.12194440e-4f), y);
+    y = T::FMAdd(z, T::Set1(-0.5f), y);
+    x = T::Add(x, y);
+    return T::FMAdd(e, T::Set1(0.693359375f), x);
+}
+
+// same as ClippedLog() in TensorOps.h
+template <class T>
+static inline typename T::V ClippedLog(typename T::V x)
+{
+    const float epsInLog = 1e-37f;         // EPS_IN_LOG
+    const float logOfEpsInLog = -85.1f;    // LOG_OF_EPS_IN_LOG
+    typename T::V r = LogPositive<T>(T::Max(T::Set1(epsInLog), x));
+    r = T::Select(T::CmpLT(x, T::Set1(epsInLog)), T::Set1(logOfEpsInLog), r);
+    r = T::Select(T::CmpEQ(x, T::Infinity()), x, r); // log(inf) = inf
+    return T::Select(T::IsNaN(x), x, r);
+}
+
+template <class T>
+static inline typename T::V Tanh(typename T::V x)
+{
+    typedef typename T::V V;
+    V ax = T::Abs(x);
+    // small |x|: odd polynomial
+    V z = T::Mul(x, x);
+    V p = T::Set1(-5.70498872745E-3f);
+    p = T::FMAdd(p, z, T::Set1(2.06390887954E-2f));
+    p = T::FMAdd(p, z, T::Set1(-5.37397155531E-2f));
+    p = T::FMAdd(p, z, T::Set1(1.33314422036E-1f));
+    p = T::FMAdd(p, z, T::Set1(-3.33332819422E-1f));
+    V small = T::FMAdd(T::Mul(p, z), x, x);
+    // large |x|: 1 - 2 / (exp(2|x|) + 1), with the sign of x
+    V e = Exp<T>(T::Add(ax, ax));
+    V large = T::Sub(T::Set1(1.0f), T::Div(T::Set1(2.0f), T::Add(e, T::Set1(1.0f))));
+    large = T::CopySign(large, x);
+    return T::Select(T::CmpLT(ax, T::Set1(0.625f)), small, large);
+}
+
+// same formula as Sigmoid() in TensorOps.h
+template <class T>
+static inline typename T::V Sigmoid(typename T::V x)
+{
+    typename T::V e = Exp<T>(T::Sub(T::Zero(), x));
+    return T::Div(T::Set1(1.0f), T::Add(e, T::Set1(1.0f)));
+}
+
+// -----------------------------------------------------------------------
+// elementwise ops
+// -----------------------------------------------------------------------
+
+template <class T, UnaryKernel kernel>
+static inline typename T::V ApplyUnary(typename T::V a)
+{
+    switch (kernel) // compile-time constant
+    {
+    case UnaryKernel::Copy:            return a;
+    case UnaryKernel::Sigmoid:         return Sigmoid<T>(a);
+    case UnaryKernel::Tanh:            return Tanh<T>(a);
+    case UnaryKernel::Exp:             return Exp<T>(a);
+    case UnaryKernel::Log:             return ClippedLog<T>(a);
+    case UnaryKernel::LinearRectifier: return T::Select(T::CmpGT(a, T::Zero()), a, T::Zero());
+    }
+    return a;
+}
+
+template <class T, BinaryKernel kernel>
+static inline typename T::V ApplyBinary(typename T::V a, typename T::V b)
+{
+    switch (kernel) // compile-time constant
+    {
+    case BinaryKernel::Sum:                return T::Add(a, b);
+    case BinaryKernel::Difference:         return T::Sub(a, b);
+    case BinaryKernel::ElementwiseProduct: return T::Mul(a, b);
+    case BinaryKernel::ElementwiseProductWithSigmoidDerivativeFromOutput: return T::Mul(a, T::Mul(b, T::Sub(T::Set1(1.0f), b)));
+    case BinaryKernel::ElementwiseProductWithTanhDerivativeFromOutput:    return T::Mul(a, T::Sub(T::Set1(1.0f), T::Mul(b, b)));
+    case BinaryKernel::ElementwiseProductWithLinearRectifierDerivativeFromOutput: return T::Select(T::CmpGT(b, T::Zero()), a, T::Zero());
+    }
+    return a;
+}
+
+// c = alpha * r + beta * c; 'c' is not read if beta == 0
+template <class T>
+static inline void StoreScaled(float* c, typename T::V r, typename T::V alpha, typename T::V beta, bool hasBeta)
+{
+    r = T::Mul(r, alpha);
+    if (hasBeta)
+        r = T::FMAdd(T::Load(c), beta, r);
+    T::Store(c, r);
+}
+
+// The remainder of n that does not fill a full vector is processed through a padded stack buffer,
+// so that every element goes through the exact same code as the rest.
+template <class T, UnaryKernel kernel>
+static void UnaryLoop(float* c, const float* a, size_t n, float alpha, float beta)
+{
+    const size_t W = T::width;
+    const typename T::V valpha = T::Set1(alpha), vbeta = T::Set1(beta);
+    const bool hasBeta = beta != 0;
+    size_t i = 0;
+    for (; i + W <= n; i += W)
+        StoreScaled<T>(c + i, ApplyUnary<T, kernel>(T::Load(a + i)), valpha, vbeta, hasBeta);
+    if (i < n)
+    {
+        float ta[T::width] = {}, tc[T::width] = {};
+        for (size_t j = 0; j < n - i; j++)
+        {
+            ta[j] = a[i + j];
+            tc[j] = hasBeta ? c[i + j] : 0;
+        }
+        StoreScaled<T>(tc, ApplyUnary<T, kernel>(T::Load(ta)), valpha, vbeta, hasBeta);
+        for (size_t j = 0; j < n - i; j++)
+            c[i + j] = tc[j];
+    }
+}
+
+template <class T, BinaryKernel kernel>
+static void BinaryLoop(float* c, const float* a, const float* b, size_t n, float alpha, float beta)
+{
+    const size_t W = T::width;
+    const typename T::V valpha = T::Set1(alpha), vbeta = T::Set1(beta);
+    const bool hasBeta = beta != 0;
+    size_t i = 0;
+    for (; i + W <= n; i += W)
+        StoreScaled<T>(c + i, ApplyBinary<T, kernel>(T::Load(a + i), T::Load(b + i)), valpha, vbeta, hasBeta);
+    if (i < n)
+    {
+        float ta[T::width] = {}, tb[T::width] = {}, tc[T::width] = {};
+        for (size_t j = 0; j < n - i; j++)
+        {
+            ta[j] = a[i + j];
+            tb[j] = b[i + j];
+            tc[j] = hasBeta ? c[i + j] : 0;
+        }
+        StoreScaled<T>(tc, ApplyBinary<T, kernel>(T::Load(ta), T::Load(tb)), valpha, vbeta, hasBeta);
+        for (size_t j = 0; j < n - i; j++)
+            c[i + j] = tc[j];
+    }
+}
+
+template <class T>
+static void Unary(UnaryKernel kernel, float* c, const float* a, size_t n, float alpha, float beta)
+{
+#define CaseUnaryKernel(k) case UnaryKernel::k: return UnaryLoop<T, UnaryKernel::k>(c, a, n, alpha, beta)
+    switch (kernel)
+    {
+    CaseUnaryKernel(Copy);
+    CaseUnaryKernel(Sigmoid);
+    CaseUnaryKernel(Tanh);
+    CaseUnaryKernel(Exp);
+    CaseUnaryKernel(Log);
+    CaseUnaryKernel(LinearRectifier);
+    }
+#undef CaseUnaryKernel
+}
+
+template <class T>
+static void Binary(BinaryKernel kernel, float* c, const float* a, const float* b, size_t n, float alpha, float beta)
+{
+#define CaseBinaryKernel(k) case BinaryKernel::k: return BinaryLoop<T, BinaryKernel::k>(c, a, b, n, alpha, beta)
+    switch (kernel)
+    {
+    CaseBinaryKernel(Sum);
+    CaseBinaryKernel(Difference);
+    CaseBinaryKernel(ElementwiseProduct);
+    CaseBinaryKernel(ElementwiseProductWithSigmoidDerivativeFromOutput);
+    CaseBinaryKernel(ElementwiseProductWithTanhDerivativeFromOutput);
+    CaseBinaryKernel(ElementwiseProductWithLinearRectifierDerivativeFromOutput);
+    }
+#undef CaseBinaryKernel
+}
+
+// -----------------------------------------------------------------------
+// reductions
+// By default, sums are accumulated in double: each vector of floats is widened into two vectors of doubles.
+// Otherwise they are accumulated in float, and in compensated mode every lane carries a Kahan compensation term.
+// -----------------------------------------------------------------------
+
+// Kahan-style accumulation of vectors: sum += x, with running compensation
+template <class T>
+static inline void KahanAdd(typename T::V& sum, typename T::V& comp, typename T::V x)
+{
+    typename T::V y = T::Sub(x, comp);
+    typename T::V t = T::Add(sum, y);
+    comp = T::Sub(T::Sub(t, sum), y);
+    sum = t;
+}
+
+static inline void KahanAdd(float& sum, float& comp, float x)
+{
+    float y = x - comp;
+    float t = sum + y;
+    comp = (t - sum) - y;
+    sum = t;
+}
+
+// (lo, hi) += x, widened to double
+template <class T>
+static inline void AddWidened(typename T::VD& lo, typename T::VD& hi, typename T::V x)
+{
+    lo = T::AddD(lo, T::WidenLo(x));
+    hi = T::AddD(hi, T::WidenHi(x));
+}
+
+template <class T>
+static float HorizontalSum(typename T::V v, typename T::V comp, bool compensated)
+{
+    float lanes[T::width], comps[T::width];
+    T::Store(lanes, v);
+    T::Store(comps, comp);
+    float sum = 0, c = 0;
+    for (size_t j = 0; j < T::width; j++)
+    {
+        if (compensated)
+        {
+            KahanAdd(sum, c, lanes[j]);
+            KahanAdd(sum, c, -comps[j]);
+        }
+        else
+            sum += lanes[j];
+    }
+    return sum;
+}
+
+template <class T>
+static double HorizontalSum(typename T::VD lo, typename T::VD hi)
+{
+    double lanes[T::width];
+    T::StoreD(lanes, lo);
+    T::StoreD(lanes + T::width / 2, hi);
+    double sum = 0;
+    for (size_t j = 0; j < T::width; j++)
+        sum += lanes[j];
+    return sum;
+}
+
+template <class T>
+static double ReduceSum(const float* a, size_t n, Accumulation accumulation)
+{
+    const size_t W = T::width;
+    typedef typename T::V V;
+    float tail[T::width] = {};
+    size_t i = 0;
+    if (accumulation == Accumulation::Double)
+    {
+        typename T::VD lo = T::ZeroD(), hi = T::ZeroD();
+        for (; i + W <= n; i += W)
+            AddWidened<T>(lo, hi, T::Load(a + i));
+        for (size_t j = 0; i + j < n; j++)
+            tail[j] = a[i + j];
+        AddWidened<T>(lo, hi, T::Load(tail));
+        return HorizontalSum<T>(lo, hi);
+    }
+    const bool compensated = accumulation == Accumulation::Compensated;
+    V s0 = T::Zero(), s1 = T::Zero(), c0 = T::Zero();
+    if (compensated)
+    {
+        for (; i + W <= n; i += W)
+            KahanAdd<T>(s0, c0, T::Load(a + i));
+    }
+    else
+    {
+        // two independent accumulators to hide the add latency
+        for (; i + 2 * W <= n; i += 2 * W)
+        {
+            s0 = T::Add(s0, T::Load(a + i));
+            s1 = T::Add(s1, T::Load(a + i + W));
+        }
+        for (; i + W <= n; i += W)
+            s0 = T::Add(s0, T::Load(a + i));
+        s0 = T::Add(s0, s1);
+    }
+    for (size_t j = 0; i + j < n; j++)
+        tail[j] = a[i + j];
+    if (compensated)
+        KahanAdd<T>(s0, c0, T::Load(tail));
+    else
+        s0 = T::Add(s0, T::Load(tail));
+    return HorizontalSum<T>(s0, c0, compensated);
+}
+
+template <class T, bool isMax>
+static float ReduceMaxMin(const float* a, size_t n)
+{
+    const size_t W = T::width;
+    typedef typename T::V V;
+    // pad with the first element, which is neutral for max and min
+    float tail[T::width];
+    for (size_t j = 0; j < W; j++)
+        tail[j] = a[0];
+    size_t i = 0;
+    V m = T::Set1(a[0]);
+    for (; i + W <= n; i += W)
+        m = isMax ? T::Max(m, T::Load(a + i)) : T::Min(m, T::Load(a + i));
+    for (size_t j = 0; i + j < n; j++)
+        tail[j] = a[i + j];
+    m = isMax ? T::Max(m, T::Load(tail)) : T::Min(m, T::Load(tail));
+    float lanes[T::width];
+    T::Store(lanes, m);
+    float r = lanes[0];
+    for (size_t j = 1; j < W; j++)
+        r = isMax ? (lanes[j] > r ? lanes[j] : r) : (lanes[j] < r ? lanes[j] : r);
+    return r;
+}
+
+template <class T>
+static double Reduce(ReductionKernel kernel, const float* a, size_t n, Accumulation accumulation)
+{
+    if (n == 0)
+        return 0;
+    switch (kernel)
+    {
+    case ReductionKernel::Sum: return ReduceSum<T>(a, n, accumulation);
+    case ReductionKernel::Max: return ReduceMaxMin<T, true>(a, n);
+    case ReductionKernel::Min: return ReduceMaxMin<T, false>(a, n);
+    }
+    return 0;
+}
+
+// c[i] = reduce_j a[i + j * lda], processing one vector of rows at a time across all columns
+template <class T>
+static void ReduceOuter(ReductionKernel kernel, float* c, const float* a, size_t n, size_t m, ptrdiff_t lda, Accumulation accumulation)
+{
+    const size_t W = T::width;
+    typedef typename T::V V;
+    if (m == 0)
+    {
+        for (size_t i = 0; i < n; i++)
+            c[i] = 0;
+        return;
+    }
+    float ta[T::width];
+    double td[T::width];
+    for (size_t i = 0; i < n; i += W)
+    {
+        const size_t w = n - i < W ? n - i : W;
+        auto load = [&](size_t j) -> V
+        {
+            const float* p = a + i + j * lda;
+            if (w == W)
+                return T::Load(p);
+            for (size_t k = 0; k < W; k++)
+                ta[k] = k < w ? p[k] : 0;
+            return T::Load(ta);
+        };
+        if (kernel == ReductionKernel::Sum && accumulation == Accumulation::Double)
+        {
+            typename T::VD lo = T::ZeroD(), hi = T::ZeroD();
+            for (size_t j = 0; j < m; j++)
+                AddWidened<T>(lo, hi, load(j));
+            T::StoreD(td, lo);
+            T::StoreD(td + W / 2, hi);
+            for (size_t k = 0; k < w; k++)
+                c[i + k] = (float) td[k];
+            continue;
+        }
+        V r = load(0), comp = T::Zero();
+        for (size_t j = 1; j < m; j++)
+        {
+            switch (kernel)
+            {
+            case ReductionKernel::Sum:
+                if (accumulation == Accumulation::Compensated)
+                    KahanAdd<T>(r, comp, load(j));
+                else
+                    r = T::Add(r, load(j));
+                break;
+            case ReductionKernel::Max: r = T::Max(r, load(j)); break;
+            case ReductionKernel::Min: r = T::Min(r, load(j)); break;
+            }
+        }
+        T::Store(ta, r);
+        for (size_t k = 0; k < w; k++)
+            c[i + k] = ta[k];
+    }
+}
+
+template <class T>
+static double Dot(const float* a, const float* b, size_t n, Accumulation accumulation)
+{
+    const size_t W = T::width;
+    typedef typename T::V V;
+    float ta[T::width] = {}, tb[T::width] = {};
+    size_t i = 0;
+    if (accumulation == Accumulation::Double)
+    {
+        typename T::VD lo = T::ZeroD(), hi = T::ZeroD();
+        for (; i + W <= n; i += W)
+            AddWidened<T>(lo, hi, T::Mul(T::Load(a + i), T::Load(b + i)));
+        for (size_t j = 0; i + j < n; j++)
+        {
+            ta[j] = a[i + j];
+            tb[j] = b[i + j];
+        }
+        AddWidened<T>(lo, hi, T::Mul(T::Load(ta), T::Load(tb)));
+        return HorizontalSum<T>(lo, hi);
+    }
+    const bool compensated = accumulation == Accumulation::Compensated;
+    V s0 = T::Zero(), s1 = T::Zero(), c0 = T::Zero();
+    if (compensated)
+    {
+        for (; i + W <= n; i += W)
+            KahanAdd<T>(s0, c0, T::Mul(T::Load(a + i), T::Load(b + i)));
+    }
+    else
+    {
+        for (; i + 2 * W <= n; i += 2 * W)
+        {
+            s0 = T::FMAdd(T::Load(a + i), T::Load(b + i), s0);
+            s1 = T::FMAdd(T::Load(a + i + W), T::Load(b + i + W), s1);
+        }
+        for (; i + W <= n; i += W)
+            s0 = T::FMAdd(T::Load(a + i), T::Load(b + i), s0);
+        s0 = T::Add(s0, s1);
+    }
+    for (size_t j = 0; i + j < n; j++)
+    {
+        ta[j] = a[i + j];
+        tb[j] = b[i + j];
+    }
+    if (compensated)
+        KahanAdd<T>(s0, c0, T::Mul(T::Load(ta), T::Load(tb)));
+    else
+        s0 = T::FMAdd(T::Load(ta), T::Load(tb), s0);
+    return HorizontalSum<T>(s0, c0, compensated);
+}
+
+template <class T>
+static const KernelTable& MakeKernelTable()
+{
+    static const KernelTable table = { &Unary<T>, &Binary<T>, &Reduce<T>, &ReduceOuter<T>, &Dot<T> };
+    return table;
+}
+
+#endif // VECTOR_KERNELS_IMPLEMENTATION
+
+}}}}
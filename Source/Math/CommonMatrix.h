@@ -65,6 +65,14 @@ private:
     static std::pair<size_t, size_t> GetFreeAndTotalMemoryInMBs(int deviceId);
 };
 
+// counts the bytes of CPU matrix storage allocated by the calling thread, e.g. for attributing allocations to nodes when profiling
+class MATH_API CPUMemoryAllocationCounter
+{
+public:
+    static size_t BytesAllocatedByThisThread();
+    static void Add(size_t bytes);
+};
+
 // -----------------------------------------------------------------------
 // ElementWiseOperator -- This enum represents which function to apply.
 // This is shared between all matrix types and tensors.
@@ -275,6 +283,7 @@ protected:
     void SetFormat(MatrixFormat format) { m_format = format; }
 
     bool HasExternalBuffer() const { return m_externalBuffer; }
+    bool HasWritableSharedBuffer() const { return m_externalBuffer && m_externalBufferOwner != nullptr && !m_externalBufferReadOnly; }
 
     DEVICEID_TYPE GetComputeDeviceId() const { return m_computeDevice; }
     void SetComputeDeviceId(const DEVICEID_TYPE computeId) const { m_computeDevice = computeId; }
@@ -292,7 +301,16 @@ protected:
     bool IsEmpty() const { return m_numRows == 0 || m_numCols == 0; }
 
     ElemType* Buffer() const { return m_pArray; }
-    void SetBuffer(ElemType* pArray, size_t alloc, bool external = false) { m_pArray = pArray; m_totalBufferSizeAllocated = alloc; m_externalBuffer = external; }
+    // 'owner' optionally keeps an external buffer alive for as long as the storage uses it (e.g., a file mapping).
+    // A buffer that is not 'readOnly' is handed over to the storage, which may write to it (e.g., a packed minibatch).
+    void SetBuffer(ElemType* pArray, size_t alloc, bool external = false, const shared_ptr<const void>& owner = nullptr, bool readOnly = true)
+    {
+        m_pArray = pArray;
+        m_totalBufferSizeAllocated = alloc;
+        m_externalBuffer = external;
+        m_externalBufferOwner = external ? owner : nullptr;
+        m_externalBufferReadOnly = external && readOnly;
+    }
 
     size_t BufferSizeAllocated() const { return m_totalBufferSizeAllocated; }
     
@@ -332,6 +350,8 @@ protected:
     void ZeroInit(const MatrixFormat matrixFormat = matrixFormatDense, const DEVICEID_TYPE computeDevice = -1)
     {
         m_externalBuffer           = false;
+        m_externalBufferOwner      = nullptr;
+        m_externalBufferReadOnly   = false;
         m_format                   = matrixFormat;
         m_computeDevice            = computeDevice;
         m_numRows                  = 0;
@@ -359,6 +379,8 @@ protected:
     MatrixFormat m_format;
     mutable DEVICEID_TYPE m_computeDevice; // current GPU device Id or CPUDEVICE
     bool m_externalBuffer; // is the buffer used by this matrix,
+    shared_ptr<const void> m_externalBufferOwner; // keeps an external buffer alive, if set
+    bool m_externalBufferReadOnly; // the external buffer must not be written to, nor replaced
 
     // m_numRows and m_numCols should be removed
     size_t m_numRows;
@@ -418,7 +440,7 @@ public:
     { 
         if (!m_sob.unique())
             LogicError("%s: Cannot resize the matrix because it is a view.", function);
-        else if (m_sob->HasExternalBuffer())
+        else if (m_sob->HasExternalBuffer() && !m_sob->HasWritableSharedBuffer()) // (a buffer handed over to the matrix is simply replaced)
             LogicError("%s: Cannot resize the matrix because it is externally owned.", function);
     }
 
@@ -481,7 +503,7 @@ protected:
     void SetSizeAllocated(size_t alloc) { m_sob->SetSizeAllocated(alloc); }
 
     ElemType* Buffer() const { return m_sob->Buffer(); }
-    void SetBuffer(ElemType* parray, size_t alloc, bool external = false) { m_sob->SetBuffer(parray, alloc, external); }
+    void SetBuffer(ElemType* parray, size_t alloc, bool external = false, const shared_ptr<const void>& owner = nullptr, bool readOnly = true) { m_sob->SetBuffer(parray, alloc, external, owner, readOnly); }
 
     
     size_t GetBlockSize() const { return m_sob->GetBlockSize(); }
@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
+#include "DirectConvolutionEngine.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -878,6 +879,13 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
     }
 
+    // The direct engine is not part of ConvolutionEngineKind::All, so it is only used when explicitly requested.
+    if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind))
+    {
+        fprintf(stderr, "\n%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+        return DirectConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         fprintf(stderr, "\n%lsusing GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
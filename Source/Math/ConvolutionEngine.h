@@ -22,6 +22,8 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Direct    = 1 << 4, // Direct CPU convolution without unrolling. Works only for 2D 1x1/3x3 convos with stride 1/2 and full sharing, and 2D pooling.
+                        // Opt-in only: it is slower than Gemm (convolution) and Reference (pooling), so it is not part of All.
 
     All       = Reference | CuDnn | Legacy | Gemm
 };
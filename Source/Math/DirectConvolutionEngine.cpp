@@ -0,0 +1,450 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "DirectConvolutionEngine.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Number of output maps (or input channels) a task of the direct engine works on.
+static const int c_mapBlock = 8;
+// Number of output rows a task works on in the forward pass.
+static const int c_rowBlock = 8;
+// Kernels are at most 3x3.
+static const int c_maxKernelCells = 9;
+
+//------------------------------------------------------------------
+// Direct convolution engine implementation.
+// Unlike the GEMM engine, this engine does not unroll the input into a workspace: each parallel task owns
+// a few rows of a few output maps (or channels) of one sample and accumulates into them input row by input row,
+// so that the working set stays in cache and the inner loops over contiguous rows are vectorized by the compiler.
+// Padding is handled by clipping the inner loops instead of by masks.
+// We use the notation of the GEMM engine: W, H, C - input width, height and channels, W', H', K - output ones,
+// X, Y - kernel width and height. Inputs and outputs are [WHC x N] and [W'H'K x N], kernels are stored as [XYC x K].
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public ConvolutionEngine<ElemType>
+{
+public:
+    using Base = ConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& outT = geometry->OutputShape();
+        const auto& kernT = geometry->KernelShape();
+        m_inW = (int)inT[0];
+        m_inH = (int)inT[1];
+        m_inC = (int)inT[2];
+        m_outW = (int)outT[0];
+        m_outH = (int)outT[1];
+        m_outC = (int)outT[2];
+        m_kernW = (int)kernT[0];
+        m_kernH = (int)kernT[1];
+        m_strideW = (int)geometry->GetStride(0);
+        m_strideH = (int)geometry->GetStride(1);
+
+        // MpRowCol[0] is the input cell under the center of the kernel applied to the first output cell,
+        // the kernel center is at (size - 1) / 2 (see ConvolveGeometry).
+        int col = geometry->MpRowCol()[0];
+        m_offsetW = col % m_inW - (m_kernW - 1) / 2;
+        m_offsetH = (col / m_inW) % m_inH - (m_kernH - 1) / 2;
+
+        // Output columns that kernel column x can be applied to without reading padding.
+        for (int x = 0; x < m_kernW; x++)
+            m_validOutW.push_back(ValidRange(m_offsetW + x, m_strideW, m_inW, m_outW));
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_poolKind;
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Direct convolution engine supports only CHW/cudnn layout.");
+        if (m_deviceId >= 0)
+            LogicError("Direct convolution engine supports only CPU device.");
+    }
+
+    void EnsureConvolutionInitialized() override
+    {
+    }
+
+    // Each task computes up to c_rowBlock rows of up to c_mapBlock output maps of one sample:
+    // out[k][y'][x'] = sum over c, y, x of kernel[k][c][y][x] * in[c][y' * strideH + offsetH + y][x' * strideW + offsetW + x]
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& /*workspace*/) override
+    {
+        const ElemType* pin = in.Data();
+        const ElemType* pkernel = kernel.Data();
+        ElemType* pout = out.Data();
+        const size_t inSize = in.GetNumRows();
+        const size_t outSize = out.GetNumRows();
+        const int kernelSize = m_inC * m_kernH * m_kernW;
+
+        const long mapBlocks = (m_outC + c_mapBlock - 1) / c_mapBlock;
+        const long rowBlocks = (m_outH + c_rowBlock - 1) / c_rowBlock;
+        const long taskCount = (long)in.GetNumCols() * mapBlocks * rowBlocks;
+#pragma omp parallel for
+        for (long task = 0; task < taskCount; task++)
+        {
+            const long sample = task / (mapBlocks * rowBlocks);
+            const int map0 = (int)((task / rowBlocks) % mapBlocks) * c_mapBlock;
+            const int mapCount = std::min(c_mapBlock, m_outC - map0);
+            const int row0 = (int)(task % rowBlocks) * c_rowBlock;
+            const int rowEnd = std::min(row0 + c_rowBlock, m_outH);
+            const ElemType* sampleIn = pin + sample * inSize;
+            ElemType* sampleOut = pout + sample * outSize;
+
+            ElemType* outRows[c_mapBlock];
+            // With a horizontal stride, the input cells of a kernel column are gathered once and reused for all maps of the block.
+            std::vector<ElemType> gathered(m_strideW != 1 ? m_outW : 0);
+            for (int outY = row0; outY < rowEnd; outY++)
+            {
+                for (int j = 0; j < mapCount; j++)
+                {
+                    outRows[j] = sampleOut + ((size_t)(map0 + j) * m_outH + outY) * m_outW;
+                    std::fill(outRows[j], outRows[j] + m_outW, (ElemType)0);
+                }
+                for (int c = 0; c < m_inC; c++)
+                {
+                    for (int y = 0; y < m_kernH; y++)
+                    {
+                        int inY = outY * m_strideH + m_offsetH + y;
+                        if (inY < 0 || inY >= m_inH)
+                            continue;
+                        const ElemType* inRow = sampleIn + ((size_t)c * m_inH + inY) * m_inW;
+                        for (int x = 0; x < m_kernW; x++)
+                        {
+                            const auto& range = m_validOutW[x];
+                            if (range.first >= range.second)
+                                continue;
+                            const int count = range.second - range.first;
+                            const ElemType* src = inRow + range.first * m_strideW + m_offsetW + x;
+                            if (m_strideW != 1)
+                            {
+                                for (int i = 0; i < count; i++)
+                                    gathered[i] = src[i * m_strideW];
+                                src = gathered.data();
+                            }
+                            const ElemType* weights = pkernel + map0 * kernelSize + (c * m_kernH + y) * m_kernW + x;
+                            for (int j = 0; j < mapCount; j++)
+                                AddScaledRow(weights[j * kernelSize], src, 1, outRows[j] + range.first, 1, count);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // The transposed operation, scattering each output row into the input rows it was computed from.
+    // Tasks own up to c_mapBlock input channels of one sample, so that no two tasks write to the same gradient.
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& /*workspace*/) override
+    {
+        const ElemType* psrcGrad = srcGrad.Data();
+        const ElemType* pkernel = kernel.Data();
+        ElemType* pgrad = grad.Data();
+        const size_t inSize = grad.GetNumRows();
+        const size_t outSize = srcGrad.GetNumRows();
+        const int kernelSize = m_inC * m_kernH * m_kernW;
+
+        const long channelBlocks = (m_inC + c_mapBlock - 1) / c_mapBlock;
+        const long taskCount = (long)srcGrad.GetNumCols() * channelBlocks;
+#pragma omp parallel for
+        for (long task = 0; task < taskCount; task++)
+        {
+            const long sample = task / channelBlocks;
+            const int channel0 = (int)(task % channelBlocks) * c_mapBlock;
+            const int channelCount = std::min(c_mapBlock, m_inC - channel0);
+            const ElemType* sampleSrcGrad = psrcGrad + sample * outSize;
+            ElemType* sampleGrad = pgrad + sample * inSize;
+
+            for (int k = 0; k < m_outC; k++)
+            {
+                for (int outY = 0; outY < m_outH; outY++)
+                {
+                    const ElemType* srcRow = sampleSrcGrad + ((size_t)k * m_outH + outY) * m_outW;
+                    for (int y = 0; y < m_kernH; y++)
+                    {
+                        int inY = outY * m_strideH + m_offsetH + y;
+                        if (inY < 0 || inY >= m_inH)
+                            continue;
+                        for (int x = 0; x < m_kernW; x++)
+                        {
+                            const auto& range = m_validOutW[x];
+                            if (range.first >= range.second)
+                                continue;
+                            for (int j = 0; j < channelCount; j++)
+                            {
+                                int c = channel0 + j;
+                                ElemType weight = pkernel[k * kernelSize + (c * m_kernH + y) * m_kernW + x];
+                                ElemType* dst = sampleGrad + ((size_t)c * m_inH + inY) * m_inW + range.first * m_strideW + m_offsetW + x;
+                                AddScaledRow(weight, srcRow + range.first, 1, dst, m_strideW, range.second - range.first);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Each task accumulates the XY kernel weights of one (output map, input channel) pair over the whole minibatch.
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool /*allowReuse*/, Mat& /*workspace*/) override
+    {
+        const ElemType* psrcGrad = srcGrad.Data();
+        const ElemType* pin = in.Data();
+        ElemType* pkernelGrad = kernelGrad.Data();
+        const size_t inSize = in.GetNumRows();
+        const size_t outSize = srcGrad.GetNumRows();
+        const int kernelSize = m_inC * m_kernH * m_kernW;
+        const long batchSize = (long)in.GetNumCols();
+
+        const long taskCount = (long)m_outC * m_inC;
+#pragma omp parallel for
+        for (long task = 0; task < taskCount; task++)
+        {
+            const int k = (int)(task / m_inC);
+            const int c = (int)(task % m_inC);
+            ElemType sums[c_maxKernelCells] = {};
+            for (long sample = 0; sample < batchSize; sample++)
+            {
+                const ElemType* sampleIn = pin + sample * inSize;
+                const ElemType* sampleSrcGrad = psrcGrad + sample * outSize;
+                for (int outY = 0; outY < m_outH; outY++)
+                {
+                    const ElemType* srcRow = sampleSrcGrad + ((size_t)k * m_outH + outY) * m_outW;
+                    for (int y = 0; y < m_kernH; y++)
+                    {
+                        int inY = outY * m_strideH + m_offsetH + y;
+                        if (inY < 0 || inY >= m_inH)
+                            continue;
+                        const ElemType* inRow = sampleIn + ((size_t)c * m_inH + inY) * m_inW;
+                        for (int x = 0; x < m_kernW; x++)
+                        {
+                            const auto& range = m_validOutW[x];
+                            const ElemType* src = inRow + range.first * m_strideW + m_offsetW + x;
+                            ElemType sum = 0;
+                            for (int i = 0; i < range.second - range.first; i++)
+                                sum += srcRow[range.first + i] * src[i * m_strideW];
+                            sums[y * m_kernW + x] += sum;
+                        }
+                    }
+                }
+            }
+            ElemType* kernelGradCells = pkernelGrad + k * kernelSize + c * m_kernH * m_kernW;
+            for (int i = 0; i < m_kernH * m_kernW; i++)
+                kernelGradCells[i] += sums[i];
+        }
+    }
+
+    void EnsurePoolingInitialized() override
+    {
+    }
+
+    // Pooling is computed per channel; the window of an output cell is clipped to the input,
+    // so padding is neither a candidate for the maximum nor counted for the average (same as the reference engine).
+    void ForwardPoolingCore(const Mat& in, Mat& out) override
+    {
+        if (m_poolKind != PoolKind::Max && m_poolKind != PoolKind::Average)
+            InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
+        const bool isMax = m_poolKind == PoolKind::Max;
+        const ElemType* pin = in.Data();
+        ElemType* pout = out.Data();
+        const size_t inSize = in.GetNumRows();
+        const size_t outSize = out.GetNumRows();
+        ForEachPoolingWindow(in.GetNumCols(), [&](long sample, int c, int outIndex, int yBegin, int yEnd, int xBegin, int xEnd)
+        {
+            const ElemType* plane = pin + sample * inSize + (size_t)c * m_inH * m_inW;
+            ElemType res = isMax ? -std::numeric_limits<ElemType>::infinity() : 0;
+            for (int y = yBegin; y < yEnd; y++)
+            {
+                for (int x = xBegin; x < xEnd; x++)
+                    res = isMax ? std::max(res, plane[y * m_inW + x]) : res + plane[y * m_inW + x];
+            }
+            if (!isMax)
+                res /= (yEnd - yBegin) * (xEnd - xBegin);
+            pout[sample * outSize + outIndex] = res;
+        });
+    }
+
+    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad) override
+    {
+        if (m_poolKind != PoolKind::Max && m_poolKind != PoolKind::Average)
+            InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
+        const bool isMax = m_poolKind == PoolKind::Max;
+        const ElemType* pout = out.Data();
+        const ElemType* psrcGrad = srcGrad.Data();
+        const ElemType* pin = in.Data();
+        ElemType* pgrad = grad.Data();
+        const size_t inSize = in.GetNumRows();
+        const size_t outSize = out.GetNumRows();
+        ForEachPoolingWindow(srcGrad.GetNumCols(), [&](long sample, int c, int outIndex, int yBegin, int yEnd, int xBegin, int xEnd)
+        {
+            size_t planeOffset = sample * inSize + (size_t)c * m_inH * m_inW;
+            const ElemType* inPlane = pin + planeOffset;
+            ElemType* gradPlane = pgrad + planeOffset;
+            ElemType g = psrcGrad[sample * outSize + outIndex];
+            if (isMax)
+            {
+                // all cells that are equal to the maximum get the gradient
+                ElemType m = pout[sample * outSize + outIndex];
+                for (int y = yBegin; y < yEnd; y++)
+                {
+                    for (int x = xBegin; x < xEnd; x++)
+                    {
+                        if (inPlane[y * m_inW + x] >= m)
+                            gradPlane[y * m_inW + x] += g;
+                    }
+                }
+            }
+            else
+            {
+                g /= (yEnd - yBegin) * (xEnd - xBegin);
+                for (int y = yBegin; y < yEnd; y++)
+                {
+                    for (int x = xBegin; x < xEnd; x++)
+                        gradPlane[y * m_inW + x] += g;
+                }
+            }
+        });
+    }
+
+    // Writes each output value to the position of the first maximum of its window.
+    void MaxUnpoolingCore(const Mat& out, const Mat& poolIn, Mat& in) override
+    {
+        const ElemType* pout = out.Data();
+        const ElemType* ppoolIn = poolIn.Data();
+        ElemType* pin = in.Data();
+        const size_t inSize = in.GetNumRows();
+        const size_t outSize = out.GetNumRows();
+        ForEachPoolingWindow(out.GetNumCols(), [&](long sample, int c, int outIndex, int yBegin, int yEnd, int xBegin, int xEnd)
+        {
+            size_t planeOffset = sample * inSize + (size_t)c * m_inH * m_inW;
+            const ElemType* poolInPlane = ppoolIn + planeOffset;
+            int imax = yBegin * m_inW + xBegin;
+            for (int y = yBegin; y < yEnd; y++)
+            {
+                for (int x = xBegin; x < xEnd; x++)
+                {
+                    if (poolInPlane[y * m_inW + x] > poolInPlane[imax])
+                        imax = y * m_inW + x;
+                }
+            }
+            pin[planeOffset + imax] = pout[sample * outSize + outIndex];
+        });
+    }
+
+private:
+    // Calls fn(sample, channel, output index within the sample, [yBegin, yEnd), [xBegin, xEnd)) for the clipped window
+    // of each output cell. Channels of samples are processed in parallel, the cells of a channel in order.
+    template <class Fn>
+    void ForEachPoolingWindow(size_t batchSize, const Fn& fn)
+    {
+        const long taskCount = (long)batchSize * m_inC;
+#pragma omp parallel for
+        for (long task = 0; task < taskCount; task++)
+        {
+            const long sample = task / m_inC;
+            const int c = (int)(task % m_inC);
+            for (int outY = 0; outY < m_outH; outY++)
+            {
+                int y0 = outY * m_strideH + m_offsetH;
+                int yBegin = std::max(y0, 0);
+                int yEnd = std::min(y0 + m_kernH, m_inH);
+                for (int outX = 0; outX < m_outW; outX++)
+                {
+                    int x0 = outX * m_strideW + m_offsetW;
+                    int xBegin = std::max(x0, 0);
+                    int xEnd = std::min(x0 + m_kernW, m_inW);
+                    fn(sample, c, (c * m_outH + outY) * m_outW + outX, yBegin, yEnd, xBegin, xEnd);
+                }
+            }
+        }
+    }
+
+    // dst[i * dstStride] += alpha * src[i * srcStride] for i in [0, count). The common unit-stride case is split out
+    // so that the compiler vectorizes it.
+    static void AddScaledRow(ElemType alpha, const ElemType* src, int srcStride, ElemType* dst, int dstStride, int count)
+    {
+        if (srcStride == 1 && dstStride == 1)
+        {
+            for (int i = 0; i < count; i++)
+                dst[i] += alpha * src[i];
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+                dst[i * dstStride] += alpha * src[i * srcStride];
+        }
+    }
+
+    // Range of output cells o for which 0 <= o * stride + offset < inSize.
+    static std::pair<int, int> ValidRange(int offset, int stride, int inSize, int outSize)
+    {
+        int begin = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+        int end = offset >= inSize ? 0 : std::min((inSize - 1 - offset) / stride + 1, outSize);
+        return std::make_pair(std::min(begin, end), end);
+    }
+
+public:
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& outT = geometry->OutputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& sharing = geometry->Sharing();
+        if (deviceId >= 0 || inT.GetRank() != 3 ||
+            std::find(begin(sharing), end(sharing), false) != sharing.end() ||
+            geometry->MapCount().GetNumElements() != geometry->GetMapCount(2))
+            return false;
+
+        if (poolKind != PoolKind::None)
+        {
+            // 2D windows applied to each channel.
+            return kernT[2] == 1 && outT[2] == inT[2] && geometry->GetMapCount(2) == 1;
+        }
+
+        // The kernel must cover all input channels exactly once.
+        int firstChannel = geometry->MpRowCol()[0] / (int)(inT[0] * inT[1]);
+        auto isSupportedSize = [](size_t size) { return size == 1 || size == 3; };
+        auto isSupportedStride = [](size_t stride) { return stride == 1 || stride == 2; };
+        return kernT[2] == inT[2] && outT[2] == geometry->GetMapCount(2) && firstChannel == ((int)kernT[2] - 1) / 2 &&
+               isSupportedSize(kernT[0]) && isSupportedSize(kernT[1]) &&
+               isSupportedStride(geometry->GetStride(0)) && isSupportedStride(geometry->GetStride(1));
+    }
+
+private:
+    int m_inW, m_inH, m_inC;
+    int m_outW, m_outH, m_outC;
+    int m_kernW, m_kernH;
+    int m_strideW, m_strideH;
+    // Offset of the first kernel cell, relative to the first input cell, for the first output cell (negative if padded).
+    int m_offsetW, m_offsetH;
+    std::vector<std::pair<int, int>> m_validOutW;
+};
+
+template <class ElemType>
+std::unique_ptr<ConvolutionEngine<ElemType>> DirectConvolutionEngineFactory<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
+                                                                                              ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples,
+                                                                                              PoolKind poolKind)
+{
+    return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+}
+
+template <class ElemType>
+bool DirectConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind)
+{
+    return DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry, poolKind);
+}
+
+template class DirectConvolutionEngineFactory<float>;
+template class DirectConvolutionEngineFactory<double>;
+
+} } }
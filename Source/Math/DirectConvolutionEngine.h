@@ -0,0 +1,25 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "ConvolutionEngine.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Direct (non-unrolled) CPU convolution and pooling for 2D inputs in CHW layout.
+// Convolutions are supported for 1x1 and 3x3 kernels (and mixes of these) with strides 1 and 2 and full sharing,
+// pooling for any 2D window applied to each channel.
+template <class ElemType>
+class DirectConvolutionEngineFactory
+{
+public:
+    static std::unique_ptr<ConvolutionEngine<ElemType>> Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
+                                                               ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples,
+                                                               PoolKind poolKind);
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind);
+};
+
+} } }
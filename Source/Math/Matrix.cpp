@@ -147,6 +147,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 MatrixBase::~MatrixBase() { }
 
+// alignment (within the file) of the elements of dense matrices written in binary mode
+static const size_t c_matrixBlockAlignment = 64;
+
 #pragma region Constructors, destructors and other static matrix builders
 
 
@@ -613,6 +616,46 @@ void Matrix<ElemType>::Read(File& stream)
             M.SetDataLocation(GPU, DENSE);
         }
     }
+    else if (type == 'b') // dense, elements as one aligned block (binary files only)
+    {
+        stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        size_t elsize, numRows, numCols, padding;
+        stream >> elsize >> numRows >> numCols >> padding;
+        if (sizeof(ElemType) != elsize)
+            RuntimeError("Read: Template argument size doesn't match those in file.");
+        for (size_t i = 0; i < padding; i++)
+        {
+            char zero;
+            stream >> zero;
+        }
+
+        const size_t numElements = numRows * numCols;
+        if (M.GetDeviceId() < 0)
+        {
+            if (!M.m_CPUMatrix)
+                M.m_CPUMatrix = make_shared<CPUMatrix<ElemType>>();
+            // a memory-mapped file is referenced in place
+            auto block = stream.TryGetMappedBlock(numElements * sizeof(ElemType));
+            if (block)
+                M.m_CPUMatrix->SetReadOnlyBuffer(numRows, numCols, shared_ptr<const ElemType>(block, reinterpret_cast<const ElemType*>(block.get())));
+            else
+            {
+                M.m_CPUMatrix->RequireSize(numRows, numCols);
+                stream.ReadArray(M.m_CPUMatrix->Data(), numElements);
+            }
+            M.SetDataLocation(CPU, DENSE);
+        }
+        else
+        {
+            if (!M.m_GPUMatrix)
+                M.m_GPUMatrix = make_shared<GPUMatrix<ElemType>>(M.GetDeviceId());
+            vector<ElemType> buffer(numElements);
+            stream.ReadArray(buffer.data(), numElements);
+            M.m_GPUMatrix->SetValue(numRows, numCols, M.GetDeviceId(), buffer.data());
+            M.SetDataLocation(GPU, DENSE);
+        }
+        stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+    }
     else if (type == 's')
     {
         if (M.GetDeviceId() < 0)
@@ -635,7 +678,34 @@ template <class ElemType>
 void Matrix<ElemType>::Write(File& stream) const
 {
     const Matrix<ElemType>& M = *this;
-    if (M.GetMatrixType() == MatrixType::DENSE)
+    if (M.GetMatrixType() == MatrixType::DENSE && !stream.IsTextBased())
+    {
+        // The elements are written as one block, aligned within the file, so that they can be read at once,
+        // or used in place from a memory-mapped file (see Read()).
+        stream << 'b';
+        stream.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        stream << sizeof(ElemType) << M.GetNumRows() << M.GetNumCols();
+        size_t padding = 0;
+        if (stream.CanSeek())
+        {
+            size_t dataPosition = stream.GetPosition() + sizeof(padding);
+            padding = (c_matrixBlockAlignment - dataPosition % c_matrixBlockAlignment) % c_matrixBlockAlignment;
+        }
+        stream << padding;
+        for (size_t i = 0; i < padding; i++)
+            stream << '\0';
+
+        if (M.GetDeviceId() < 0)
+            stream.WriteArray(M.m_CPUMatrix->Data(), M.GetNumElements());
+        else
+        {
+            ElemType* pArray = M.m_GPUMatrix->CopyToArray();
+            stream.WriteArray(pArray, M.GetNumElements());
+            delete[] pArray;
+        }
+        stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+    }
+    else if (M.GetMatrixType() == MatrixType::DENSE)
     {
         stream << 'd';
         if (M.GetDeviceId() < 0)
@@ -1275,6 +1345,18 @@ void Matrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, int
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::SetSharedBuffer(const size_t numRows, const size_t numCols, const shared_ptr<ElemType>& pArray)
+{
+    if (GetDeviceId() != CPUDEVICE)
+        LogicError("SetSharedBuffer: Only a matrix on the CPU can use a buffer in place.");
+
+    if (!m_CPUMatrix)
+        m_CPUMatrix = make_shared<CPUMatrix<ElemType>>();
+    m_CPUMatrix->SetSharedBuffer(numRows, numCols, pArray);
+    SetDataLocation(CPU, DENSE);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetValue(const size_t rIdx, const size_t cIdx, ElemType val)
 {
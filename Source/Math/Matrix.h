@@ -243,6 +243,8 @@ public:
     // AssignValuesOf respects the target matrix's information. It copies the values from the target into the memory of the source.
     void AssignValuesOf(const Matrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, const size_t matrixFlags = matrixFlagNormal);
+    // make this a dense CPU matrix that takes over the given buffer in place and keeps it alive (see CPUMatrix::SetSharedBuffer())
+    void SetSharedBuffer(const size_t numRows, const size_t numCols, const std::shared_ptr<ElemType>& pArray);
     void SetValue(const size_t rIdx, const size_t cIdx, ElemType val); // set matrix sparsely
     void SetValue(const size_t numRows, const size_t numCols, std::initializer_list<ElemType> l) // SetValue(2,3, {1,2,3,  4,5,6});
     {
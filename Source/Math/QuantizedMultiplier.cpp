@@ -0,0 +1,187 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "QuantizedMultiplier.h"
+#include "BlockMultiplier.h"
+#include <cmath>
+#include <limits>
+#include <omp.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef SUPPORT_AVX2
+typedef BlockHandlerAVX QuantizedBlockHandler;
+#else
+typedef BlockHandlerSSE QuantizedBlockHandler;
+#endif
+
+//------------------------------------------------------------------
+// The product is computed as a row-major product in BlockMultiplier terms: a column-major [K x N] input
+// is a row-major N x K matrix A, and a column-major [M x K] weight matrix W is, element by element,
+// the row-major K x M matrix W^T, which serves as B. The row-major N x M result C = A B is then exactly
+// the column-major [M x N] result W X. So no data needs to be transposed.
+//------------------------------------------------------------------
+template <class ElemType>
+class QuantizedMultiplier<ElemType>::Impl
+{
+public:
+    typedef BlockMultiplier<QuantizedBlockHandler> Multiplier;
+    typedef typename Multiplier::ScalarAT ScalarAT;
+    typedef typename Multiplier::ScalarBT ScalarBT;
+
+    // The quantized weights, which do not change after construction and may be shared by several multipliers.
+    // BlockMultiplier::PrepareB() keeps no state for the SSE and AVX2 handlers (their PrepareExtraB() returns null),
+    // so weights prepared by one BlockMultiplier can be multiplied by any other.
+    struct Weights
+    {
+        Weights(size_t numRows, size_t numCols)
+            : m_preparedWeights(nullptr), m_range(QuantizationRange(numCols)), m_rowScales(numRows)
+        {
+        }
+        ~Weights()
+        {
+            if (m_preparedWeights)
+                Multiplier::FreeMatrix(m_preparedWeights);
+        }
+
+        ScalarBT* m_preparedWeights;        // W^T in block order
+        int m_range;                        // quantized values are in [-m_range, m_range]
+        std::vector<ElemType> m_rowScales;  // [M] dequantization factor of each row of W
+    };
+
+    Impl(const std::shared_ptr<Weights>& weights)
+        : m_weights(weights), m_multiplier(omp_get_max_threads())
+    {
+    }
+
+    // largest quantized magnitude such that the sum of 'innerDim' products cannot overflow the 32-bit accumulators
+    static int QuantizationRange(size_t innerDim)
+    {
+        int range = std::numeric_limits<ScalarAT>::max();
+        while (range > 1 && (double) innerDim * range * range > (double) std::numeric_limits<int32_t>::max())
+            range /= 2;
+        return range;
+    }
+
+    // returns the dequantization factor
+    // 'stride' is the distance between consecutive values in both 'from' and 'to'.
+    template <class ScalarT>
+    static ElemType Quantize(const ElemType* from, size_t count, size_t stride, int range, ScalarT* to)
+    {
+        ElemType absMax = 0;
+        for (size_t i = 0; i < count; i++)
+            absMax = std::max(absMax, (ElemType) fabs(from[i * stride]));
+        if (!(absMax > 0) || !std::isfinite(absMax)) // all zeroes, or garbage (e.g. in gaps of a minibatch)
+        {
+            for (size_t i = 0; i < count; i++)
+                to[i * stride] = 0;
+            return 0;
+        }
+        const ElemType factor = range / absMax;
+        for (size_t i = 0; i < count; i++)
+        {
+            const ElemType v = from[i * stride] * factor;
+            to[i * stride] = (ScalarT) (v >= 0 ? v + (ElemType) 0.5 : v - (ElemType) 0.5);
+        }
+        return absMax / range;
+    }
+
+    std::shared_ptr<Weights> m_weights;
+    // Each multiplier has its own BlockMultiplier, which serializes the calls to MultiplyMatrices(),
+    // and working memory of Multiply().
+    Multiplier m_multiplier;
+    std::vector<ElemType> m_colScales;  // [N] dequantization factor of each column of the current input
+    std::vector<ScalarAT> m_input;      // quantized input
+    std::vector<int32_t> m_product;     // integer result
+};
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::QuantizedMultiplier(const Matrix<ElemType>& weights)
+    : m_numRows(weights.GetNumRows()), m_numCols(weights.GetNumCols())
+{
+    if (weights.GetDeviceId() != CPUDEVICE || weights.GetMatrixType() != DENSE)
+        InvalidArgument("QuantizedMultiplier: Weights must be a dense CPU matrix.");
+    if (m_numRows == 0 || m_numCols == 0 || m_numRows > INT_MAX || m_numCols > INT_MAX)
+        InvalidArgument("QuantizedMultiplier: Invalid weight matrix dimensions [%d x %d].", (int) m_numRows, (int) m_numCols);
+
+    typedef typename Impl::ScalarBT ScalarBT;
+    auto prepared = std::make_shared<typename Impl::Weights>(m_numRows, m_numCols);
+    const ElemType* w = weights.Data();
+    ScalarBT* quantized = Impl::Multiplier::CreateMatrixB((int) m_numCols, (int) m_numRows);
+#pragma omp parallel for
+    for (long i = 0; i < (long) m_numRows; i++)
+        prepared->m_rowScales[i] = Impl::Quantize(w + i, m_numCols, m_numRows, prepared->m_range, quantized + i);
+    m_impl.reset(new Impl(prepared));
+    prepared->m_preparedWeights = m_impl->m_multiplier.PrepareB(quantized, (int) m_numCols, (int) m_numRows);
+    Impl::Multiplier::FreeMatrix(quantized);
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::QuantizedMultiplier(const QuantizedMultiplier<ElemType>& other)
+    : m_impl(new Impl(other.m_impl->m_weights)), m_numRows(other.m_numRows), m_numCols(other.m_numCols)
+{
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::~QuantizedMultiplier()
+{
+}
+
+template <class ElemType>
+void QuantizedMultiplier<ElemType>::Multiply(const Matrix<ElemType>& input, Matrix<ElemType>& result)
+{
+    if (input.GetDeviceId() != CPUDEVICE || input.GetMatrixType() != DENSE || result.GetDeviceId() != CPUDEVICE || result.GetMatrixType() != DENSE)
+        InvalidArgument("QuantizedMultiplier: Input and result must be dense CPU matrices.");
+    if (input.GetNumRows() != m_numCols || result.GetNumRows() != m_numRows || result.GetNumCols() != input.GetNumCols())
+        InvalidArgument("QuantizedMultiplier: Cannot multiply weights [%d x %d] with input [%d x %d] into [%d x %d].",
+                        (int) m_numRows, (int) m_numCols, (int) input.GetNumRows(), (int) input.GetNumCols(), (int) result.GetNumRows(), (int) result.GetNumCols());
+
+    const size_t numRows = m_numRows;
+    const size_t innerDim = m_numCols;
+    const size_t numSamples = input.GetNumCols();
+    if (numSamples == 0)
+        return;
+    if (numSamples > INT_MAX)
+        InvalidArgument("QuantizedMultiplier: Too many input columns (%d).", (int) numSamples);
+
+    auto& impl = *m_impl;
+    auto& weights = *impl.m_weights;
+    impl.m_input.resize(numSamples * innerDim);
+    impl.m_colScales.resize(numSamples);
+    impl.m_product.assign(numSamples * numRows, 0); // BlockMultiplier expects a zeroed result
+
+    const ElemType* x = input.Data();
+#pragma omp parallel for if (numSamples * innerDim >= 4096)
+    for (long j = 0; j < (long) numSamples; j++)
+        impl.m_colScales[j] = Impl::Quantize(x + j * innerDim, innerDim, 1, weights.m_range, impl.m_input.data() + j * innerDim);
+
+    impl.m_multiplier.MultiplyMatrices(impl.m_input.data(), (int) numSamples, (int) innerDim, weights.m_preparedWeights, (int) numRows, impl.m_product.data());
+
+    ElemType* y = result.Data();
+    const int32_t* c = impl.m_product.data();
+    const ElemType* rowScales = weights.m_rowScales.data();
+#pragma omp parallel for if (numSamples * numRows >= 4096)
+    for (long j = 0; j < (long) numSamples; j++)
+    {
+        const ElemType colScale = impl.m_colScales[j];
+        for (size_t i = 0; i < numRows; i++)
+            y[j * numRows + i] = c[j * numRows + i] * rowScales[i] * colScale;
+    }
+}
+
+template <class ElemType>
+/*static*/ size_t QuantizedMultiplier<ElemType>::QuantizedBits(size_t innerDim)
+{
+    size_t bits = 1; // sign
+    for (int range = Impl::QuantizationRange(innerDim); range > 0; range /= 2)
+        bits++;
+    return bits;
+}
+
+template class QuantizedMultiplier<float>;
+template class QuantizedMultiplier<double>;
+
+}}}
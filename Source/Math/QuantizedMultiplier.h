@@ -0,0 +1,48 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Matrix.h"
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// QuantizedMultiplier -- evaluation-only matrix product W * X in 16-bit integer arithmetic on the CPU
+//
+// The constant left operand W [M x K] is quantized once, at construction, with one scale per row, and kept
+// in the block order that BlockMultiplier works off. The right operand X [K x N] is quantized on the fly
+// with one scale per column. Quantization is symmetric, as in SymmetricQuantizer.
+// Products are accumulated exactly in 32 bits. To rule out overflow of the accumulators, both operands use
+// fewer than 16 bits as K grows (e.g. 12 bits for K = 512, 11 bits for K = 2048).
+template <class ElemType>
+class MATH_API QuantizedMultiplier
+{
+public:
+    // 'weights' must be a dense CPU matrix. Its values are copied, i.e. later changes to it are not seen.
+    QuantizedMultiplier(const Matrix<ElemType>& weights);
+    // shares the quantized weights of 'other', which do not change, but has its own BlockMultiplier and working memory,
+    // so that copies can multiply concurrently
+    QuantizedMultiplier(const QuantizedMultiplier<ElemType>& other);
+    ~QuantizedMultiplier();
+
+    // result = W * input, with 'input' a dense CPU matrix [K x N] and 'result' a dense CPU matrix [M x N],
+    // which may be a column slice of a larger matrix
+    void Multiply(const Matrix<ElemType>& input, Matrix<ElemType>& result);
+
+    size_t GetNumRows() const { return m_numRows; }
+    size_t GetNumCols() const { return m_numCols; }
+
+    // number of bits (including the sign) that values are quantized to for a given inner dimension
+    static size_t QuantizedBits(size_t innerDim);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> m_impl;
+    size_t m_numRows;
+    size_t m_numCols;
+};
+
+}}}
@@ -0,0 +1,343 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "BinaryTextDeserializer.h"
+#include "TextToBinaryConverter.h"
+#include "Indexer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// true if the range [offset, offset + length) lies within the first size bytes, without overflowing
+static inline bool IsInRange(uint64_t offset, uint64_t length, uint64_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+static inline bool IsTableInRange(uint64_t offset, uint64_t numberOfRecords, size_t recordSize, uint64_t size)
+{
+    return numberOfRecords <= size / recordSize && IsInRange(offset, numberOfRecords * recordSize, size);
+}
+
+// A chunk of the container. Sequence data points into the mapping,
+// every sequence keeps the chunk (and therefore the mapping) alive.
+template <class ElemType>
+class BinaryTextDeserializer<ElemType>::BinaryDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
+{
+public:
+    BinaryDataChunk(const ChunkInfo& info, std::shared_ptr<MemoryMappedFile> container, const std::wstring& containerFile, const std::vector<StreamDescriptionPtr>& streams) :
+        m_records(info.m_records), m_end(info.m_record->m_offset + info.m_record->m_byteSize), m_container(container), m_containerFile(containerFile), m_streams(streams)
+    {}
+
+    void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId < m_records.size());
+        const char* position = m_container->Data() + m_records[sequenceId]->m_offset;
+        const char* end = m_container->Data() + m_end;
+
+        // BuildIndex() has checked that the sequence starts within the chunk, and the chunk within the container;
+        // the block sizes are only known here.
+        auto checkBlock = [&](size_t blockSize)
+        {
+            if (blockSize > (size_t) (end - position))
+            {
+                RuntimeError("Binary container '%ls' is corrupt: a block of sequence %" PRIu64 " ends beyond its chunk.",
+                    m_containerFile.c_str(), m_records[sequenceId]->m_key);
+            }
+        };
+
+        result.reserve(m_streams.size());
+        for (const auto& stream : m_streams)
+        {
+            checkBlock(sizeof(BinaryBlockHeader));
+            const BinaryBlockHeader& block = *reinterpret_cast<const BinaryBlockHeader*>(position);
+            position += sizeof(BinaryBlockHeader);
+
+            SequenceDataPtr data;
+            if (stream->m_storageType == StorageType::dense)
+            {
+                auto dense = std::make_shared<DenseSequenceData>();
+                dense->m_sampleLayout = stream->m_sampleLayout;
+                dense->m_data = const_cast<char*>(position);
+                checkBlock(sizeof(ElemType) * block.m_numberOfSamples * stream->m_sampleLayout->GetNumElements());
+                position += AlignToBinaryContainer(sizeof(ElemType) * block.m_numberOfSamples * stream->m_sampleLayout->GetNumElements());
+                data = dense;
+            }
+            else
+            {
+                auto sparse = std::make_shared<SparseSequenceData>();
+                checkBlock(AlignToBinaryContainer(sizeof(IndexType) * block.m_numberOfSamples) +
+                           AlignToBinaryContainer(sizeof(IndexType) * block.m_totalNnzCount) + sizeof(ElemType) * block.m_totalNnzCount);
+                const IndexType* nnzCounts = reinterpret_cast<const IndexType*>(position);
+                sparse->m_nnzCounts.assign(nnzCounts, nnzCounts + block.m_numberOfSamples);
+                position += AlignToBinaryContainer(sizeof(IndexType) * block.m_numberOfSamples);
+                sparse->m_indices = reinterpret_cast<IndexType*>(const_cast<char*>(position));
+                position += AlignToBinaryContainer(sizeof(IndexType) * block.m_totalNnzCount);
+                sparse->m_data = const_cast<char*>(position);
+                position += AlignToBinaryContainer(sizeof(ElemType) * block.m_totalNnzCount);
+                sparse->m_totalNnzCount = block.m_totalNnzCount;
+                data = sparse;
+            }
+
+            data->m_id = sequenceId;
+            data->m_numberOfSamples = block.m_numberOfSamples;
+            data->m_chunk = shared_from_this();
+            result.push_back(data);
+        }
+    }
+
+private:
+    // Copies, so that the chunk does not depend on the lifetime of the deserializer;
+    // the records point into the mapping, which the chunk keeps alive.
+    std::vector<const BinarySequenceRecord*> m_records;
+    uint64_t m_end; // offset of the end of the chunk data
+    std::shared_ptr<MemoryMappedFile> m_container;
+    std::wstring m_containerFile;
+    std::vector<StreamDescriptionPtr> m_streams;
+};
+
+template <class ElemType>
+BinaryTextDeserializer<ElemType>::BinaryTextDeserializer(CorpusDescriptorPtr corpus, const TextConfigHelper& helper) :
+    m_containerFile(helper.GetBinaryContainerFile()),
+    m_header(nullptr)
+{
+    for (const auto& stream : helper.GetStreams())
+    {
+        auto streamDescription = std::make_shared<StreamDescription>(stream);
+        streamDescription->m_sampleLayout = std::make_shared<TensorShape>(stream.m_sampleDimension);
+        m_streams.push_back(streamDescription);
+    }
+
+    ConvertIfNeeded(helper);
+    Open(helper);
+    BuildIndex(corpus);
+}
+
+template <class ElemType>
+void BinaryTextDeserializer<ElemType>::ConvertIfNeeded(const TextConfigHelper& helper)
+{
+    uint64_t sourceSize = 0;
+    int64_t sourceModificationTime = 0;
+    bool hasSource = Indexer::GetFileStamp(helper.GetFilePath(), sourceSize, sourceModificationTime);
+
+    if (fexists(m_containerFile))
+    {
+        if (!hasSource)
+        {
+            // Only the container is available, use it as it is.
+            return;
+        }
+
+        MemoryMappedFile container(m_containerFile);
+        if (container.Size() >= sizeof(BinaryContainerHeader))
+        {
+            const auto& header = *reinterpret_cast<const BinaryContainerHeader*>(container.Data());
+            if (memcmp(header.m_magic, BINARY_CONTAINER_MAGIC, sizeof(BINARY_CONTAINER_MAGIC)) == 0 &&
+                header.m_version == BINARY_CONTAINER_VERSION &&
+                header.m_elementSize == sizeof(ElemType) &&
+                header.m_sourceSize == sourceSize &&
+                header.m_sourceModificationTime == sourceModificationTime)
+            {
+                return;
+            }
+        }
+
+        fprintf(stderr, "Binary container '%ls' is out of date, converting '%ls' again.\n",
+            m_containerFile.c_str(), helper.GetFilePath().c_str());
+    }
+    else if (!hasSource)
+    {
+        RuntimeError("Neither the input file '%ls' nor the binary container '%ls' exists.",
+            helper.GetFilePath().c_str(), m_containerFile.c_str());
+    }
+
+    TextToBinaryConverter<ElemType>::Convert(helper, m_containerFile);
+}
+
+template <class ElemType>
+void BinaryTextDeserializer<ElemType>::Open(const TextConfigHelper& helper)
+{
+    m_container = std::make_shared<MemoryMappedFile>(m_containerFile);
+    const char* data = m_container->Data();
+    size_t size = m_container->Size();
+
+    if (size < sizeof(BinaryContainerHeader))
+    {
+        RuntimeError("'%ls' is not a binary container (file too short).", m_containerFile.c_str());
+    }
+
+    m_header = reinterpret_cast<const BinaryContainerHeader*>(data);
+    if (memcmp(m_header->m_magic, BINARY_CONTAINER_MAGIC, sizeof(BINARY_CONTAINER_MAGIC)) != 0)
+    {
+        RuntimeError("'%ls' is not a binary container.", m_containerFile.c_str());
+    }
+
+    if (m_header->m_version != BINARY_CONTAINER_VERSION)
+    {
+        RuntimeError("Binary container '%ls' has version %u, expected %u.",
+            m_containerFile.c_str(), m_header->m_version, BINARY_CONTAINER_VERSION);
+    }
+
+    if (m_header->m_elementSize != sizeof(ElemType))
+    {
+        RuntimeError("Binary container '%ls' holds %u-byte values, but the reader precision needs %u-byte values.",
+            m_containerFile.c_str(), m_header->m_elementSize, (unsigned int) sizeof(ElemType));
+    }
+
+    if (!IsTableInRange(m_header->m_streamTableOffset, m_header->m_numberOfStreams, sizeof(BinaryStreamRecord), size) ||
+        !IsTableInRange(m_header->m_chunkTableOffset, m_header->m_numberOfChunks, sizeof(BinaryChunkRecord), size) ||
+        !IsTableInRange(m_header->m_sequenceTableOffset, m_header->m_numberOfSequences, sizeof(BinarySequenceRecord), size))
+    {
+        RuntimeError("Binary container '%ls' is truncated.", m_containerFile.c_str());
+    }
+
+    const auto& streams = helper.GetStreams();
+    if (m_header->m_numberOfStreams != streams.size())
+    {
+        RuntimeError("Binary container '%ls' has %" PRIu64 " streams, but %" PRIu64 " are configured.",
+            m_containerFile.c_str(), m_header->m_numberOfStreams, (uint64_t) streams.size());
+    }
+
+    const auto* streamRecords = reinterpret_cast<const BinaryStreamRecord*>(data + m_header->m_streamTableOffset);
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+        const auto& record = streamRecords[i];
+        if (!IsInRange(record.m_aliasOffset, record.m_aliasLength, size))
+        {
+            RuntimeError("Binary container '%ls' is corrupt: the alias of stream %" PRIu64 " lies outside of the file.",
+                m_containerFile.c_str(), (uint64_t) i);
+        }
+
+        std::string alias(data + record.m_aliasOffset, record.m_aliasLength);
+        if (alias != streams[i].m_alias ||
+            record.m_storageType != (uint32_t) streams[i].m_storageType ||
+            record.m_sampleDimension != streams[i].m_sampleDimension)
+        {
+            RuntimeError("Stream '%s' of the binary container '%ls' does not match the configured input '%ls'.",
+                alias.c_str(), m_containerFile.c_str(), streams[i].m_name.c_str());
+        }
+    }
+}
+
+template <class ElemType>
+void BinaryTextDeserializer<ElemType>::BuildIndex(CorpusDescriptorPtr corpus)
+{
+    const char* data = m_container->Data();
+    const uint64_t size = m_container->Size();
+    const auto* chunkRecords = reinterpret_cast<const BinaryChunkRecord*>(data + m_header->m_chunkTableOffset);
+    const auto* sequenceRecords = reinterpret_cast<const BinarySequenceRecord*>(data + m_header->m_sequenceTableOffset);
+    auto& stringRegistry = corpus->GetStringRegistry();
+
+    for (uint64_t c = 0; c < m_header->m_numberOfChunks; ++c)
+    {
+        ChunkInfo chunk;
+        chunk.m_record = &chunkRecords[c];
+        chunk.m_numberOfSamples = 0;
+        ChunkIdType chunkId = (ChunkIdType) m_chunks.size();
+
+        const auto& chunkRecord = chunkRecords[c];
+        if (!IsInRange(chunkRecord.m_firstSequence, chunkRecord.m_numberOfSequences, m_header->m_numberOfSequences))
+        {
+            RuntimeError("Binary container '%ls' is corrupt: chunk %" PRIu64 " refers to sequences beyond the sequence table.",
+                m_containerFile.c_str(), c);
+        }
+
+        if (!IsInRange(chunkRecord.m_offset, chunkRecord.m_byteSize, size))
+        {
+            RuntimeError("Binary container '%ls' is corrupt: the data of chunk %" PRIu64 " lies outside of the file.",
+                m_containerFile.c_str(), c);
+        }
+
+        for (uint64_t s = 0; s < chunkRecord.m_numberOfSequences; ++s)
+        {
+            const auto& record = sequenceRecords[chunkRecord.m_firstSequence + s];
+            if (record.m_offset < chunkRecord.m_offset || record.m_offset >= chunkRecord.m_offset + chunkRecord.m_byteSize)
+            {
+                RuntimeError("Binary container '%ls' is corrupt: sequence %" PRIu64 " does not start within its chunk.",
+                    m_containerFile.c_str(), record.m_key);
+            }
+
+            auto key = std::to_string(record.m_key);
+            if (!corpus->IsIncluded(key))
+            {
+                continue;
+            }
+
+            SequenceDescription description;
+            description.m_id = chunk.m_sequences.size();
+            description.m_numberOfSamples = record.m_numberOfSamples;
+            description.m_chunkId = chunkId;
+            description.m_key.m_sequence = stringRegistry[key];
+            description.m_key.m_sample = 0;
+
+            m_keyToSequenceInChunk[description.m_key.m_sequence] = std::make_pair(chunkId, description.m_id);
+            chunk.m_numberOfSamples += record.m_numberOfSamples;
+            chunk.m_sequences.push_back(description);
+            chunk.m_records.push_back(&record);
+        }
+
+        if (!chunk.m_sequences.empty())
+        {
+            m_chunks.push_back(std::move(chunk));
+        }
+    }
+}
+
+template <class ElemType>
+ChunkDescriptions BinaryTextDeserializer<ElemType>::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    result.reserve(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        result.push_back(std::shared_ptr<ChunkDescription>(
+            new ChunkDescription {
+                (ChunkIdType) i,
+                m_chunks[i].m_numberOfSamples,
+                m_chunks[i].m_sequences.size()
+        }));
+    }
+
+    return result;
+}
+
+template <class ElemType>
+void BinaryTextDeserializer<ElemType>::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
+{
+    const auto& sequences = m_chunks[chunkId].m_sequences;
+    result.insert(result.end(), sequences.begin(), sequences.end());
+}
+
+template <class ElemType>
+ChunkPtr BinaryTextDeserializer<ElemType>::GetChunk(ChunkIdType chunkId)
+{
+    const auto& chunk = m_chunks[chunkId];
+
+    // Pages are read by the OS on first access; ask for the whole chunk now,
+    // so that it is (being) read by the time the sequences are packed.
+    m_container->Prefetch(chunk.m_record->m_offset, chunk.m_record->m_byteSize);
+
+    return std::make_shared<BinaryDataChunk>(chunk, m_container, m_containerFile, m_streams);
+}
+
+template <class ElemType>
+bool BinaryTextDeserializer<ElemType>::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    auto sequenceLocation = m_keyToSequenceInChunk.find(key.m_sequence);
+    if (sequenceLocation == m_keyToSequenceInChunk.end())
+    {
+        return false;
+    }
+
+    result = m_chunks[sequenceLocation->second.first].m_sequences[sequenceLocation->second.second];
+    return true;
+}
+
+template class BinaryTextDeserializer<float>;
+template class BinaryTextDeserializer<double>;
+
+}}}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "TextConfigHelper.h"
+#include "CorpusDescriptor.h"
+#include "MemoryMappedFile.h"
+#include "BinaryTextFormat.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A deserializer for the binary container that TextToBinaryConverter produces from a CNTKTextFormat file.
+// The container is memory-mapped, and the sequence data handed out points straight into the mapping,
+// so that neither parsing nor copying happens on the reader path.
+// It is configured like the text deserializer; the container is (re)created from the text file
+// when it is missing or older than the text file.
+template <class ElemType>
+class BinaryTextDeserializer : public DataDeserializerBase
+{
+public:
+    BinaryTextDeserializer(CorpusDescriptorPtr corpus, const TextConfigHelper& helper);
+
+    // Retrieves a chunk of data.
+    ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    // Get information about chunks.
+    ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get information about particular chunk.
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+
+    bool GetSequenceDescriptionByKey(const KeyType&, SequenceDescription&) override;
+
+private:
+    class BinaryDataChunk;
+
+    // Converts the text file into the container, unless there is an up-to-date container already.
+    void ConvertIfNeeded(const TextConfigHelper& helper);
+
+    // Maps the container and checks that it matches the configured streams.
+    void Open(const TextConfigHelper& helper);
+
+    // Builds chunk and sequence descriptions for the sequences included in the corpus.
+    void BuildIndex(CorpusDescriptorPtr corpus);
+
+    // Sequences of a chunk that are included in the corpus.
+    struct ChunkInfo
+    {
+        const BinaryChunkRecord* m_record;
+        size_t m_numberOfSamples;
+        std::vector<SequenceDescription> m_sequences;
+        std::vector<const BinarySequenceRecord*> m_records; // same order as m_sequences
+    };
+
+    std::wstring m_containerFile;
+    std::shared_ptr<MemoryMappedFile> m_container;
+    const BinaryContainerHeader* m_header;
+
+    std::vector<ChunkInfo> m_chunks;
+    std::map<size_t, std::pair<ChunkIdType, size_t>> m_keyToSequenceInChunk;
+
+    DISABLE_COPY_AND_MOVE(BinaryTextDeserializer);
+};
+
+}}}
@@ -0,0 +1,83 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Layout of the binary container that holds the same data as a CNTKTextFormat file
+// (written by TextToBinaryConverter, read by BinaryTextDeserializer):
+//
+//   header
+//   sequence data, chunk after chunk, every sequence holding one block per stream:
+//     dense block:  BinaryBlockHeader, values[numberOfSamples * sampleDimension]
+//     sparse block: BinaryBlockHeader, nnzCounts[numberOfSamples], indices[totalNnzCount], values[totalNnzCount]
+//   stream aliases (not terminated)
+//   stream table   (BinaryStreamRecord[numberOfStreams])
+//   chunk table    (BinaryChunkRecord[numberOfChunks])
+//   sequence table (BinarySequenceRecord[numberOfSequences])
+//
+// Every block, array and table starts at a multiple of BINARY_CONTAINER_ALIGNMENT bytes,
+// so that the deserializer can hand out pointers straight into the memory-mapped container.
+// Values are stored with the precision of the reader (see m_elementSize), indices as IndexType.
+
+static const char BINARY_CONTAINER_MAGIC[8] = { 'C', 'T', 'F', 'B', 'I', 'N', 'A', 'R' };
+static const uint32_t BINARY_CONTAINER_VERSION = 1;
+static const size_t BINARY_CONTAINER_ALIGNMENT = 8;
+
+struct BinaryContainerHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_elementSize;            // sizeof(float) or sizeof(double)
+    uint64_t m_sourceSize;             // size of the text file the container was converted from
+    int64_t m_sourceModificationTime;  // and its modification time
+    uint64_t m_numberOfStreams;
+    uint64_t m_numberOfChunks;
+    uint64_t m_numberOfSequences;
+    uint64_t m_streamTableOffset;
+    uint64_t m_chunkTableOffset;
+    uint64_t m_sequenceTableOffset;
+};
+
+struct BinaryStreamRecord
+{
+    uint32_t m_storageType;            // StorageType
+    uint32_t m_aliasLength;
+    uint64_t m_aliasOffset;
+    uint64_t m_sampleDimension;
+};
+
+struct BinaryChunkRecord
+{
+    uint64_t m_firstSequence;          // index of the first sequence of the chunk in the sequence table
+    uint64_t m_numberOfSequences;
+    uint64_t m_numberOfSamples;
+    uint64_t m_offset;                 // offset and size of the sequence data of the chunk
+    uint64_t m_byteSize;
+};
+
+struct BinarySequenceRecord
+{
+    uint64_t m_key;                    // sequence id from the text file
+    uint64_t m_offset;                 // offset of the first block of the sequence
+    uint32_t m_numberOfSamples;
+    uint32_t m_reserved;
+};
+
+struct BinaryBlockHeader
+{
+    uint32_t m_numberOfSamples;
+    uint32_t m_totalNnzCount;          // sparse blocks only
+};
+
+inline size_t AlignToBinaryContainer(size_t size)
+{
+    return (size + BINARY_CONTAINER_ALIGNMENT - 1) / BINARY_CONTAINER_ALIGNMENT * BINARY_CONTAINER_ALIGNMENT;
+}
+
+}}}
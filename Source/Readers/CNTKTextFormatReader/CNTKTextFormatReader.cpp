@@ -10,6 +10,7 @@
 #include "ChunkCache.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
+#include "LengthBucketingEnumerator.h"
 #include "TextParser.h"
 #include "SequencePacker.h"
 #include "FramePacker.h"
@@ -41,18 +42,38 @@ CNTKTextFormatReader::CNTKTextFormatReader(MemoryProviderPtr provider,
             m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer));
         }
 
+        // Verbosity is a general config parameter, not specific to the text format reader.
+        int verbosity = config(L"verbosity", 0);
+
         size_t window = configHelper.GetRandomizationWindow();
         if (window > 0)
         {
-            // Verbosity is a general config parameter, not specific to the text format reader.
-            int verbosity = config(L"verbosity", 0);
-            m_randomizer = make_shared<BlockRandomizer>(verbosity, window, m_deserializer, true);
+            // Number of chunks to load ahead of the randomization window, and a bound on their total size.
+            // They are loaded on a single I/O thread, since the text parser reads all chunks through one file handle.
+            size_t prefetchDepth = config(L"prefetchDepth", (size_t) 1);
+            size_t prefetchBudgetInSamples = config(L"prefetchBudgetInSamples", (size_t) SIZE_MAX);
+            m_randomizer = make_shared<BlockRandomizer>(verbosity, window, m_deserializer, true,
+                BlockRandomizer::DecimationMode::chunk, false /* useLegacyRandomization */, false /* multithreadedGetNextSequences */,
+                prefetchDepth, 1 /* numPrefetchThreads */, prefetchBudgetInSamples);
         }
         else
         {
             m_randomizer = std::make_shared<NoRandomizer>(m_deserializer);
         }
 
+        // Optionally grouping sequences of similar length into the same minibatch, to reduce padding.
+        bool lengthBucketing = config(L"lengthBucketing", false);
+        if (lengthBucketing)
+        {
+            if (configHelper.IsInFrameMode())
+            {
+                InvalidArgument("lengthBucketing is only supported when packing whole sequences, not with frameMode.");
+            }
+
+            size_t bucketingWindow = config(L"lengthBucketingWindow", (size_t) 32);
+            m_randomizer = make_shared<LengthBucketingEnumerator>(m_randomizer, bucketingWindow);
+        }
+
         if (configHelper.IsInFrameMode()) 
         {
             m_packer = std::make_shared<FramePacker>(
@@ -65,7 +86,9 @@ CNTKTextFormatReader::CNTKTextFormatReader(MemoryProviderPtr provider,
         m_packer = std::make_shared<SequencePacker>(
             m_provider,
             m_randomizer,
-            GetStreamDescriptions());
+            GetStreamDescriptions(),
+            lengthBucketing,
+            lengthBucketing || verbosity > 0 /* reportPadding */);
         }
     }
     catch (const std::runtime_error& e)
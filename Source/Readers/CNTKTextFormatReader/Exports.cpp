@@ -10,6 +10,7 @@
 #include "DataReader.h"
 #include "ReaderShim.h"
 #include "CNTKTextFormatReader.h"
+#include "BinaryTextDeserializer.h"
 #include "HeapMemoryProvider.h"
 #include "StringUtil.h"
 
@@ -33,7 +34,7 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
 }
 
 // TODO: Not safe from the ABI perspective. Will be uglified to make the interface ABI.
-// A factory method for creating text deserializers.
+// A factory method for creating text deserializers (and deserializers of their binary version).
 extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool)
 {
     string precision = deserializerConfig.Find("precision", "float");
@@ -50,6 +51,13 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
         else // double
             *deserializer = new TextParser<double>(corpus, TextConfigHelper(deserializerConfig));
     }
+    else if (type == L"CNTKBinaryTextFormatDeserializer")
+    {
+        if (precision == "float")
+            *deserializer = new BinaryTextDeserializer<float>(corpus, TextConfigHelper(deserializerConfig));
+        else // double
+            *deserializer = new BinaryTextDeserializer<double>(corpus, TextConfigHelper(deserializerConfig));
+    }
     else
         InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
 
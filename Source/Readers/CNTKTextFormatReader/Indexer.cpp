@@ -8,13 +8,41 @@
 #include <inttypes.h>
 #include "Indexer.h"
 #include "TextReaderConstants.h"
+#include "MemoryMappedFile.h"
+#include <sys/types.h>
+#include <sys/stat.h>
 
 using std::string;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize) :
+// Layout of the index cache file: the header, followed by the sequences in file order.
+// The cache is only used if the input file still has the recorded size and modification time,
+// and if it was built with the same skipSequenceIds setting.
+static const char s_indexCacheMagic[8] = { 'C', 'T', 'F', 'I', 'N', 'D', 'E', 'X' };
+static const uint32_t s_indexCacheVersion = 1;
+
+struct IndexCacheHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_flags;             // see below
+    uint64_t m_inputSize;         // size of the input file in bytes
+    int64_t m_inputModificationTime;
+    uint64_t m_numberOfSequences;
+};
+
+enum IndexCacheFlags : uint32_t
+{
+    skipSequenceIdsRequested = 1, // the index was built with skipSequenceIds = true
+    hasSequenceIds = 2,           // the input has a sequence id column
+};
+
+Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize, const std::wstring& indexCacheFile) :
     m_file(file),
+    m_indexCacheFile(indexCacheFile),
+    m_loadedFromCache(false),
+    m_skipSequenceIds(skipSequenceIds),
     m_fileOffsetStart(0),
     m_fileOffsetEnd(0),
     m_buffer(new char[BUFFER_SIZE + 1]),
@@ -98,6 +126,157 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
         return;
     }
 
+    if (m_indexCacheFile.empty())
+    {
+        BuildFromFile(corpus);
+        return;
+    }
+
+    if (TryLoadCache(corpus))
+    {
+        return;
+    }
+
+    // Taking the stamp before reading, so that a cache of a file modified while indexing gets invalidated.
+    uint64_t inputSize = 0;
+    int64_t inputModificationTime = 0;
+    bool hasStamp = GetFileStamp(m_file, inputSize, inputModificationTime);
+
+    BuildFromFile(corpus);
+
+    if (hasStamp)
+    {
+        SaveCache(inputSize, inputModificationTime);
+    }
+    m_cachedSequences.clear();
+    m_cachedSequences.shrink_to_fit();
+}
+
+/*static*/ bool Indexer::GetFileStamp(FILE* file, uint64_t& size, int64_t& modificationTime)
+{
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_fstat64(_fileno(file), &info) != 0)
+        return false;
+#else
+    struct stat info;
+    if (fstat(fileno(file), &info) != 0)
+        return false;
+#endif
+    size = info.st_size;
+    modificationTime = info.st_mtime;
+    return true;
+}
+
+/*static*/ bool Indexer::GetFileStamp(const std::wstring& path, uint64_t& size, int64_t& modificationTime)
+{
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (file == nullptr)
+        return false;
+
+    bool result = GetFileStamp(file, size, modificationTime);
+    fclose(file);
+    return result;
+}
+
+bool Indexer::TryLoadCache(CorpusDescriptorPtr corpus)
+{
+    if (!fexists(m_indexCacheFile))
+    {
+        return false;
+    }
+
+    uint64_t inputSize = 0;
+    int64_t inputModificationTime = 0;
+    if (!GetFileStamp(m_file, inputSize, inputModificationTime))
+    {
+        return false;
+    }
+
+    unique_ptr<MemoryMappedFile> cache;
+    try
+    {
+        cache = make_unique<MemoryMappedFile>(m_indexCacheFile);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Could not read the index cache file, rebuilding the index: %s\n", e.what());
+        return false;
+    }
+
+    if (cache->Size() < sizeof(IndexCacheHeader))
+    {
+        return false;
+    }
+
+    const IndexCacheHeader& header = *reinterpret_cast<const IndexCacheHeader*>(cache->Data());
+    uint32_t skipSequenceIds = m_skipSequenceIds ? skipSequenceIdsRequested : 0;
+    if (memcmp(header.m_magic, s_indexCacheMagic, sizeof(s_indexCacheMagic)) != 0 ||
+        header.m_version != s_indexCacheVersion ||
+        header.m_inputSize != inputSize ||
+        header.m_inputModificationTime != inputModificationTime ||
+        (header.m_flags & skipSequenceIdsRequested) != skipSequenceIds ||
+        cache->Size() != sizeof(IndexCacheHeader) + header.m_numberOfSequences * sizeof(CachedSequence))
+    {
+        fprintf(stderr, "Index cache file '%ls' is out of date, rebuilding the index.\n", m_indexCacheFile.c_str());
+        return false;
+    }
+
+    m_index.Reserve(inputSize);
+    m_hasSequenceIds = (header.m_flags & hasSequenceIds) != 0;
+
+    const CachedSequence* sequences = reinterpret_cast<const CachedSequence*>(cache->Data() + sizeof(IndexCacheHeader));
+    for (uint64_t i = 0; i < header.m_numberOfSequences; ++i)
+    {
+        SequenceDescriptor sd = {};
+        sd.m_fileOffsetBytes = sequences[i].m_fileOffsetBytes;
+        sd.m_byteSize = sequences[i].m_byteSize;
+        sd.m_numberOfSamples = (uint32_t) sequences[i].m_numberOfSamples;
+        AddSequenceIfIncluded(corpus, sequences[i].m_key, sd);
+    }
+
+    m_loadedFromCache = true;
+    return true;
+}
+
+void Indexer::SaveCache(uint64_t inputSize, int64_t inputModificationTime)
+{
+    IndexCacheHeader header = {};
+    memcpy(header.m_magic, s_indexCacheMagic, sizeof(s_indexCacheMagic));
+    header.m_version = s_indexCacheVersion;
+    header.m_flags = (m_skipSequenceIds ? skipSequenceIdsRequested : 0) | (m_hasSequenceIds ? hasSequenceIds : 0);
+    header.m_inputSize = inputSize;
+    header.m_inputModificationTime = inputModificationTime;
+    header.m_numberOfSequences = m_cachedSequences.size();
+
+    // Written under a temporary name and renamed, so that other processes never see a partial cache file.
+    std::wstring tempFile = m_indexCacheFile + L".tmp" + std::to_wstring(GetCurrentProcessId());
+    try
+    {
+        FILE* f = fopenOrDie(tempFile, L"wb");
+        try
+        {
+            fwriteOrDie(&header, sizeof(header), 1, f);
+            fwriteOrDie(m_cachedSequences, f);
+            fflushOrDie(f);
+        }
+        catch (...)
+        {
+            fclose(f);
+            throw;
+        }
+        fclose(f);
+        renameOrDie(tempFile, m_indexCacheFile);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Could not write the index cache file '%ls': %s\n", m_indexCacheFile.c_str(), e.what());
+        _wunlink(tempFile.c_str());
+    }
+}
+
+void Indexer::BuildFromFile(CorpusDescriptorPtr corpus)
+{
     m_index.Reserve(filesize(m_file));
 
     RefillBuffer(); // read the first block of data
@@ -160,6 +339,11 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
 
 void Indexer::AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceKey, SequenceDescriptor& sd)
 {
+    if (!m_indexCacheFile.empty() && !m_loadedFromCache)
+    {
+        m_cachedSequences.push_back(CachedSequence{ sequenceKey, sd.m_fileOffsetBytes, sd.m_byteSize, sd.m_numberOfSamples });
+    }
+
     auto& stringRegistry = corpus->GetStringRegistry();
     auto key = std::to_string(sequenceKey);
     if (corpus->IsIncluded(key))
@@ -17,15 +17,22 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // others specify size and file offset of the respective structure).
 // As opposed to the data deserializer, indexer performs almost no parsing 
 // and therefore is several magnitudes faster.
+// If an index cache file is given, the pass over the input is done only once: the sequences found
+// are written to the cache file, keyed by the size and modification time of the input,
+// and later runs (and other MPI ranks) memory-map the cache instead of reading the input.
 class Indexer 
 {
 public:
-    Indexer(FILE* file, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
+    Indexer(FILE* file, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024,
+            const std::wstring& indexCacheFile = std::wstring());
 
-    // Reads the input file, building and index of chunks and corresponding
+    // Reads the input file (or the index cache), building and index of chunks and corresponding
     // sequences.
     void Build(CorpusDescriptorPtr corpus);
 
+    // True, if the index was loaded from the index cache file.
+    bool IsLoadedFromCache() const { return m_loadedFromCache; }
+
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
 
@@ -34,9 +41,28 @@ public:
     // (by passing skipSequenceIds = true to the constructor).
     bool HasSequenceIds() const { return m_hasSequenceIds; }
 
+    // Gets the size and the modification time of the given file, which identify the version of its contents
+    // (e.g., the one that an index cache or a binary container was built from). Returns false if they are not available.
+    static bool GetFileStamp(FILE* file, uint64_t& size, int64_t& modificationTime);
+    static bool GetFileStamp(const std::wstring& path, uint64_t& size, int64_t& modificationTime);
+
 private:
+    // One sequence as stored in the index cache file, before corpus filtering and chunking.
+    struct CachedSequence
+    {
+        uint64_t m_key;
+        int64_t m_fileOffsetBytes;
+        uint64_t m_byteSize;
+        uint64_t m_numberOfSamples;
+    };
+
     FILE* m_file;
 
+    std::wstring m_indexCacheFile; // empty, if the index is not cached
+    std::vector<CachedSequence> m_cachedSequences; // all sequences found in the input, to be written to the cache
+    bool m_loadedFromCache;
+    bool m_skipSequenceIds; // as requested in the constructor
+
     int64_t m_fileOffsetStart;
     int64_t m_fileOffsetEnd;
 
@@ -70,6 +96,15 @@ private:
     // Otherwise, writes sequence id value to the provided reference, returns true.
     bool TryGetSequenceId(size_t& id);
 
+    // Scans the input file, building the chunk/sequence index.
+    void BuildFromFile(CorpusDescriptorPtr corpus);
+
+    // Builds the index from the cache file. Returns false, if there is no cache file or it does not match the input.
+    bool TryLoadCache(CorpusDescriptorPtr corpus);
+
+    // Writes the sequences found in the input to the cache file. Failures only produce a warning.
+    void SaveCache(uint64_t inputSize, int64_t inputModificationTime);
+
     // Build a chunk/sequence index, treating each line as an individual sequence.
     // Does not do any sequence parsing, instead uses line number as 
     // the corresponding sequence id.
@@ -149,6 +149,19 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_chunkSizeBytes = config(L"chunkSizeInBytes", 32 * 1024 * 1024); // 32 MB by default
     m_keepDataInMemory = config(L"keepDataInMemory", false);
     m_frameMode = config(L"frameMode", false);
+    m_numParsingThreads = config(L"numParsingThreads", (size_t) 1); // sequential by default, 0 parses large chunks on all cores
+
+    // The index of the input file can be cached next to it (or in the given file), so that it is only built once.
+    if (config.Exists(L"indexCacheFile"))
+    {
+        m_indexCacheFile = msra::strfun::utf16(config(L"indexCacheFile"));
+    }
+    else if (config(L"cacheIndex", false))
+    {
+        m_indexCacheFile = m_filepath + L".index";
+    }
+
+    m_binaryContainerFile = config.Exists(L"binaryFile") ? msra::strfun::utf16(config(L"binaryFile")) : m_filepath + L".bin";
 }
 
 }}}
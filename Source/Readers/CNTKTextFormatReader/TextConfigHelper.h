@@ -41,6 +41,15 @@ public:
 
     ElementType GetElementType() const { return m_elementType; }
 
+    // Path of the index cache file, empty if the index should not be cached.
+    const wstring& GetIndexCacheFile() const { return m_indexCacheFile; }
+
+    // Maximum number of threads that parse a single chunk, 0 means pick automatically.
+    size_t GetNumParsingThreads() const { return m_numParsingThreads; }
+
+    // Path of the binary container used by the binary deserializer (see BinaryTextDeserializer).
+    const wstring& GetBinaryContainerFile() const { return m_binaryContainerFile; }
+
     DISABLE_COPY_AND_MOVE(TextConfigHelper);
 
 private:
@@ -54,6 +63,9 @@ private:
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
+    std::wstring m_indexCacheFile; // where to keep the index of the input file, empty if not cached
+    size_t m_numParsingThreads; // number of threads that parse a chunk (0 = automatic, 1 = sequential)
+    std::wstring m_binaryContainerFile; // binary version of the input file
 };
 
 } } }
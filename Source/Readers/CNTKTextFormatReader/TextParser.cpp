@@ -10,6 +10,8 @@
 #include "Indexer.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
+#include "ExceptionCapture.h"
+#include <thread>
 
 #define isSign(c) ((c == '-' || c == '+'))
 #define isE(c) ((c == 'e' || c == 'E'))
@@ -72,6 +74,8 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams())
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetIndexCacheFile(helper.GetIndexCacheFile());
+    SetNumParsingThreads(helper.GetNumParsingThreads());
 
     Initialize();
 }
@@ -83,12 +87,9 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_file(nullptr),
     m_streamInfos(streams.size()),
     m_indexer(nullptr),
-    m_fileOffsetStart(0),
-    m_fileOffsetEnd(0),
     m_buffer(new char[BUFFER_SIZE + 1]),
-    m_bufferStart(nullptr),
-    m_bufferEnd(nullptr),
-    m_pos(nullptr),
+    m_state(0),
+    m_numParsingThreads(1),
     m_chunkSizeBytes(0),
     m_traceLevel(TraceLevel::Error),
     m_hadWarnings(false),
@@ -120,7 +121,19 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
 
     assert(m_maxAliasLength > 0);
 
-    m_scratch = unique_ptr<char[]>(new char[m_maxAliasLength + 1]);
+    m_state.m_scratch = unique_ptr<char[]>(new char[m_maxAliasLength + 1]);
+}
+
+template <class ElemType>
+TextParser<ElemType>::ParserState::ParserState(size_t maxAliasLength) :
+    m_fileOffsetStart(0),
+    m_fileOffsetEnd(0),
+    m_bufferStart(nullptr),
+    m_bufferEnd(nullptr),
+    m_pos(nullptr),
+    m_scratch(new char[maxAliasLength + 1]),
+    m_isMapped(false)
+{
 }
 
 template <class ElemType>
@@ -171,11 +184,16 @@ void TextParser<ElemType>::Initialize()
                 "UTF-16 encoding is currently not supported.", m_filename.c_str());
         }
 
-        m_indexer = make_unique<Indexer>(m_file, m_skipSequenceIds, m_chunkSizeBytes);
+        m_indexer = make_unique<Indexer>(m_file, m_skipSequenceIds, m_chunkSizeBytes, m_indexCacheFile);
 
         m_indexer->Build(m_corpus);
     });
 
+    if (m_indexer->IsLoadedFromCache() && m_traceLevel >= Info)
+    {
+        fprintf(stderr, "INFO: Loaded the index of the input file (%ls) from '%ls'.\n", m_filename.c_str(), m_indexCacheFile.c_str());
+    }
+
     assert(m_indexer != nullptr);
 
     int64_t position = _ftelli64(m_file);
@@ -184,8 +202,22 @@ void TextParser<ElemType>::Initialize()
         RuntimeError("Error retrieving current position in the input file (%ls).", m_filename.c_str());
     }
 
-    m_fileOffsetStart = position;
-    m_fileOffsetEnd = position;
+    m_state.m_fileOffsetStart = position;
+    m_state.m_fileOffsetEnd = position;
+
+    if (m_numParsingThreads != 1)
+    {
+        try
+        {
+            m_mappedFile.reset(new MemoryMappedFile(m_filename));
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "WARNING: Could not map the input file (%ls) into memory, "
+                "chunks will be parsed sequentially: %s\n", m_filename.c_str(), e.what());
+            m_numParsingThreads = 1;
+        }
+    }
 }
 
 template <class ElemType>
@@ -252,6 +284,14 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
     const auto& chunkDescriptor = m_indexer->GetIndex().m_chunks[chunkId];
     auto textChunk = make_shared<TextDataChunk>(chunkDescriptor, this);
 
+    size_t numSlices = GetNumberOfSlices(chunkDescriptor);
+    if (numSlices > 1)
+    {
+        // The mapped file does not need to be reopened, a failure to read it is not retried.
+        LoadChunkInParallel(textChunk, chunkDescriptor, numSlices);
+        return textChunk;
+    }
+
     attempt(m_numRetries, [this, &textChunk, &chunkDescriptor]()
     {
         if (ferror(m_file) != 0)
@@ -271,13 +311,79 @@ void TextParser<ElemType>::LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor&
     chunk->m_sequenceMap.resize(descriptor.m_sequences.size());
     for (const auto& sequenceDescriptor : descriptor.m_sequences)
     {
-        chunk->m_sequenceMap[sequenceDescriptor.m_id] = LoadSequence(sequenceDescriptor);
+        chunk->m_sequenceMap[sequenceDescriptor.m_id] = LoadSequence(m_state, sequenceDescriptor);
     }
 }
 
+template <class ElemType>
+size_t TextParser<ElemType>::GetNumberOfSlices(const ChunkDescriptor& descriptor) const
+{
+    if (m_mappedFile == nullptr)
+    {
+        return 1;
+    }
+
+    size_t numSlices = m_numParsingThreads;
+    if (numSlices == 0)
+    {
+        // Automatic: use all cores (up to a limit), but do not bother
+        // splitting a chunk into slices that are too small to pay off.
+        numSlices = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), MAX_AUTO_PARSING_THREADS);
+        numSlices = std::min(numSlices, std::max<size_t>(descriptor.m_byteSize / MIN_PARSING_SLICE_SIZE, 1));
+    }
+
+    return std::min(numSlices, descriptor.m_sequences.size());
+}
+
+template <class ElemType>
+void TextParser<ElemType>::LoadChunkInParallel(TextChunkPtr& chunk, const ChunkDescriptor& descriptor, size_t numSlices)
+{
+    const auto& sequences = descriptor.m_sequences;
+    chunk->m_sequenceMap.resize(sequences.size());
+
+    // Slice boundaries (indices into the sequences of the chunk), such that
+    // every slice holds about the same number of bytes.
+    std::vector<size_t> boundaries(1, 0);
+    size_t bytesSoFar = 0;
+    for (size_t i = 0; i < sequences.size() && boundaries.size() < numSlices; ++i)
+    {
+        bytesSoFar += sequences[i].m_byteSize;
+        if (bytesSoFar * numSlices >= descriptor.m_byteSize * boundaries.size())
+        {
+            boundaries.push_back(i + 1);
+        }
+    }
+    boundaries.push_back(sequences.size());
+
+    auto parseSlice = [this, &chunk, &sequences, &boundaries](int slice)
+    {
+        // Each slice sees the whole file as one window, so its state never refills.
+        ParserState state(m_maxAliasLength);
+        state.m_isMapped = true;
+        state.m_fileOffsetStart = 0;
+        state.m_fileOffsetEnd = m_mappedFile->Size();
+        state.m_bufferStart = m_mappedFile->Data();
+        state.m_bufferEnd = state.m_bufferStart + m_mappedFile->Size();
+        state.m_pos = state.m_bufferStart;
+
+        for (size_t i = boundaries[slice]; i < boundaries[slice + 1]; ++i)
+        {
+            chunk->m_sequenceMap[sequences[i].m_id] = LoadSequence(state, sequences[i]);
+        }
+    };
+
+    int numThreads = (int) boundaries.size() - 1;
+    ExceptionCapture capture;
+#pragma omp parallel for schedule(static, 1) num_threads(numThreads)
+    for (int slice = 0; slice < numThreads; ++slice)
+        capture.SafeRun(parseSlice, slice);
+    capture.RethrowIfHappened();
+}
+
 template <class ElemType>
 void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 {
+    std::unique_lock<std::mutex> lock(m_numAllowedErrorsLock);
     if (m_numAllowedErrors == 0)
     {
         PrintWarningNotification();
@@ -289,8 +395,14 @@ void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryRefillBuffer()
+bool TextParser<ElemType>::TryRefillBuffer(ParserState& state)
 {
+    if (state.m_isMapped)
+    {
+        // the window already spans the whole file.
+        return false;
+    }
+
     size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
 
     if (bytesRead == (size_t)-1)
@@ -304,16 +416,16 @@ bool TextParser<ElemType>::TryRefillBuffer()
         return false;
     }
 
-    m_fileOffsetStart = m_fileOffsetEnd;
-    m_fileOffsetEnd += bytesRead;
-    m_bufferStart = m_buffer.get();
-    m_pos = m_bufferStart;
-    m_bufferEnd = m_bufferStart + bytesRead;
+    state.m_fileOffsetStart = state.m_fileOffsetEnd;
+    state.m_fileOffsetEnd += bytesRead;
+    state.m_bufferStart = m_buffer.get();
+    state.m_pos = state.m_bufferStart;
+    state.m_bufferEnd = state.m_bufferStart + bytesRead;
     return true;
 }
 
 template <class ElemType>
-void TextParser<ElemType>::SetFileOffset(int64_t offset)
+void TextParser<ElemType>::SetFileOffset(ParserState& state, int64_t offset)
 {
     int rc = _fseeki64(m_file, offset, SEEK_SET);
     if (rc)
@@ -323,24 +435,24 @@ void TextParser<ElemType>::SetFileOffset(int64_t offset)
             offset, m_filename.c_str());
     }
 
-    m_fileOffsetStart = offset;
-    m_fileOffsetEnd = offset;
+    state.m_fileOffsetStart = offset;
+    state.m_fileOffsetEnd = offset;
 
-    TryRefillBuffer();
+    TryRefillBuffer(state);
 }
 
 template <class ElemType>
-typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence(const SequenceDescriptor& sequenceDsc)
+typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence(ParserState& state, const SequenceDescriptor& sequenceDsc)
 {
     auto fileOffset = sequenceDsc.m_fileOffsetBytes;
 
-    if (fileOffset < m_fileOffsetStart || fileOffset > m_fileOffsetEnd)
+    if (fileOffset < state.m_fileOffsetStart || fileOffset > state.m_fileOffsetEnd)
     {
-        SetFileOffset(fileOffset);
+        SetFileOffset(state, fileOffset);
     }
 
-    size_t bufferOffset = fileOffset - m_fileOffsetStart;
-    m_pos = m_bufferStart + bufferOffset;
+    size_t bufferOffset = fileOffset - state.m_fileOffsetStart;
+    state.m_pos = state.m_bufferStart + bufferOffset;
     size_t bytesToRead = sequenceDsc.m_byteSize;
 
     SequenceBuffer sequence;
@@ -362,7 +474,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
     size_t numRowsRead = 0, expectedRowCount = sequenceDsc.m_numberOfSamples;
     for (size_t i = 0; i < expectedRowCount; i++)
     {
-        if ((TryReadRow(sequence, bytesToRead)))
+        if ((TryReadRow(state, sequence, bytesToRead)))
         {
             ++numRowsRead;
         }
@@ -376,7 +488,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
                     " while loading sequence (id = %s) %ls.\n",
                     i + 1,
                     GetSequenceKey(sequenceDsc).c_str(),
-                    GetFileInfo().c_str());
+                    GetFileInfo(state).c_str());
             }
         }
 
@@ -389,7 +501,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
                     " expected for the current sequence (id = %s) %ls,"
                     " but only read %" PRIu64 " out of %" PRIu64 " expected rows.\n",
                     GetSequenceKey(sequenceDsc).c_str(),
-                    GetFileInfo().c_str(), numRowsRead, expectedRowCount);
+                    GetFileInfo(state).c_str(), numRowsRead, expectedRowCount);
             }
             break;
         }
@@ -405,7 +517,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
         {
             fprintf(stderr,
                 "ERROR: Input ('%ls') is empty in sequence (id = %s) %ls.\n",
-                m_streams[i]->m_name.c_str(), GetSequenceKey(sequenceDsc).c_str(), GetFileInfo().c_str());
+                m_streams[i]->m_name.c_str(), GetSequenceKey(sequenceDsc).c_str(), GetFileInfo(state).c_str());
             hasEmptyInputs = true;
         }
 
@@ -418,7 +530,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
                     "WARNING: Input ('%ls') contains more samples than expected"
                     " (%u vs. %" PRIu64 ") for sequence (id = %s) %ls.\n",
                     m_streams[i]->m_name.c_str(), sequence[i]->m_numberOfSamples, expectedRowCount,
-                    GetSequenceKey(sequenceDsc).c_str(), GetFileInfo().c_str());
+                    GetSequenceKey(sequenceDsc).c_str(), GetFileInfo(state).c_str());
             }
         }
         maxInputLength = max(sequence[i]->m_numberOfSamples, maxInputLength);
@@ -442,7 +554,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
                 "WARNING: Maximum per-input number of samples for sequence (id = %s) %ls"
                 " is less than expected (%u vs. %" PRIu64 ").\n",
                 GetSequenceKey(sequenceDsc).c_str(),
-                GetFileInfo().c_str(), maxInputLength, expectedRowCount);
+                GetFileInfo(state).c_str(), maxInputLength, expectedRowCount);
         }
         IncrementNumberOfErrorsOrDie();
     }
@@ -452,7 +564,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
         fprintf(stderr,
             "INFO: Finished loading sequence (id = %s) %ls,"
             " successfully read %" PRIu64 " out of expected %" PRIu64 " rows.\n",
-            GetSequenceKey(sequenceDsc).c_str(), GetFileInfo().c_str(), numRowsRead, expectedRowCount);
+            GetSequenceKey(sequenceDsc).c_str(), GetFileInfo(state).c_str(), numRowsRead, expectedRowCount);
     }
 
     FillSequenceMetadata(sequence, sequenceDsc.m_id);
@@ -485,37 +597,37 @@ void TextParser<ElemType>::FillSequenceMetadata(SequenceBuffer& sequenceData, si
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadRow(ParserState& state, SequenceBuffer& sequence, size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead() && IsDigit(*m_pos))
+    while (bytesToRead && CanRead(state) && IsDigit(*state.m_pos))
     {
         // skip sequence ids
-        ++m_pos;
+        ++state.m_pos;
         --bytesToRead;
     }
 
     size_t numSampleRead = 0;
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(state))
     {
-        char c = *m_pos;
+        char c = *state.m_pos;
 
         if (c == ROW_DELIMITER)
         {
             // found the end of row, skip the delimiter, return.
-            ++m_pos;
+            ++state.m_pos;
             --bytesToRead;
 
             if (numSampleRead == 0 && ShouldWarn())
             {
                 fprintf(stderr,
-                    "WARNING: Empty input row %ls.\n", GetFileInfo().c_str());
+                    "WARNING: Empty input row %ls.\n", GetFileInfo(state).c_str());
             }
             else if (numSampleRead > m_streams.size() && ShouldWarn())
             {
                 fprintf(stderr,
                     "WARNING: Input row %ls contains more"
                     " samples than expected (%" PRIu64 " vs. %" PRIu64 ").\n",
-                    GetFileInfo().c_str(), numSampleRead, m_streams.size());
+                    GetFileInfo(state).c_str(), numSampleRead, m_streams.size());
             }
 
             return numSampleRead > 0;
@@ -524,19 +636,19 @@ bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToR
         if (isColumnDelimiter(c))
         {
             // skip column (input) delimiters.
-            ++m_pos;
+            ++state.m_pos;
             --bytesToRead;
             continue;
         }
 
-        if (TryReadSample(sequence, bytesToRead))
+        if (TryReadSample(state, sequence, bytesToRead))
         {
             numSampleRead++;
         }
         else
         {
             // skip over until the next sample/end of row
-            SkipToNextInput(bytesToRead);
+            SkipToNextInput(state, bytesToRead);
         }
     }
 
@@ -545,47 +657,47 @@ bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToR
         fprintf(stderr,
             "WARNING: Exhausted all input expected for the current sequence"
             " while reading an input row %ls."
-            " Possibly, a trailing newline is missing.\n", GetFileInfo().c_str());
+            " Possibly, a trailing newline is missing.\n", GetFileInfo(state).c_str());
     }
     return false;
 }
 
 // Reads one sample (an pipe-prefixed input identifier followed by a list of values)
 template <class ElemType>
-bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadSample(ParserState& state, SequenceBuffer& sequence, size_t& bytesToRead)
 {
-    assert(m_pos < m_bufferEnd);
+    assert(state.m_pos < state.m_bufferEnd);
 
     // prefix check.
-    if (*m_pos != NAME_PREFIX)
+    if (*state.m_pos != NAME_PREFIX)
     {
         if (ShouldWarn())
         {
             fprintf(stderr,
                 "WARNING: Unexpected character('%c') in place of a name prefix ('%c')"
                 " in an input name %ls.\n",
-                *m_pos, NAME_PREFIX, GetFileInfo().c_str());
+                *state.m_pos, NAME_PREFIX, GetFileInfo(state).c_str());
         }
         IncrementNumberOfErrorsOrDie();
         return false;
     }
 
     // skip name prefix
-    ++m_pos;
+    ++state.m_pos;
     --bytesToRead;
 
-    if (bytesToRead && CanRead() && *m_pos == ESCAPE_SYMBOL)
+    if (bytesToRead && CanRead(state) && *state.m_pos == ESCAPE_SYMBOL)
     {
         // A vertical bar followed by the number sign (|#) is treated as an escape sequence, 
         // everything that follows is ignored until the next vertical bar or the end of 
         // row, whichever comes first.
-        ++m_pos;
+        ++state.m_pos;
         --bytesToRead;
         return false;
     }
 
     size_t id;
-    if (!TryGetInputId(id, bytesToRead))
+    if (!TryGetInputId(state, id, bytesToRead))
     {
         IncrementNumberOfErrorsOrDie();
         return false;
@@ -599,7 +711,7 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
         vector<ElemType>& values = data->m_buffer;
         size_t size = values.size();
         assert(size % stream.m_sampleDimension == 0);
-        if (!TryReadDenseSample(values, stream.m_sampleDimension, bytesToRead))
+        if (!TryReadDenseSample(state, values, stream.m_sampleDimension, bytesToRead))
         {
             // expected a dense sample, but was not able to fully read it, ignore it.
             if (values.size() != size)
@@ -620,7 +732,7 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
         vector<IndexType>& indices = data->m_indicesBuffer;
         assert(values.size() == indices.size());
         size_t size = values.size();
-        if (!TryReadSparseSample(values, indices, stream.m_sampleDimension, bytesToRead))
+        if (!TryReadSparseSample(state, values, indices, stream.m_sampleDimension, bytesToRead))
         {
             // expected a sparse sample, but something went south, ignore it.
             if (values.size() != size)
@@ -648,22 +760,22 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
+bool TextParser<ElemType>::TryGetInputId(ParserState& state, size_t& id, size_t& bytesToRead)
 {
-    char* scratchIndex = m_scratch.get();
+    char* scratchIndex = state.m_scratch.get();
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(state))
     {
-        char c = *m_pos;
+        char c = *state.m_pos;
 
         // stop as soon as there's a value delimiter, an input prefix
         // or a non-printable character (e.g., newline, carriage return).
         if (isValueDelimiter(c) || c == NAME_PREFIX || isNonPrintable(c))
         {
-            size_t size = scratchIndex - m_scratch.get();
+            size_t size = scratchIndex - state.m_scratch.get();
             if (size)
             {
-                string name(m_scratch.get(), size);
+                string name(state.m_scratch.get(), size);
                 auto it = m_aliasToIdMap.find(name);
                 if (it != m_aliasToIdMap.end())
                 {
@@ -676,7 +788,7 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
                     fprintf(stderr,
                         "WARNING: Invalid input ('%s') %ls. "
                         "Input name '%s' was not specified in the reader config section.\n",
-                        name.c_str(), GetFileInfo().c_str(), name.c_str());
+                        name.c_str(), GetFileInfo(state).c_str(), name.c_str());
                 }
             }
             else if (ShouldWarn())
@@ -684,12 +796,12 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
                 fprintf(stderr,
                     "WARNING: Input name prefix ('%c') is followed by"
                     " an invalid character ('%c') %ls.\n",
-                    NAME_PREFIX, c, GetFileInfo().c_str());
+                    NAME_PREFIX, c, GetFileInfo(state).c_str());
             }
 
             return false;
         }
-        else if (scratchIndex < (m_scratch.get() + m_maxAliasLength))
+        else if (scratchIndex < (state.m_scratch.get() + m_maxAliasLength))
         {
             *scratchIndex = c;
             ++scratchIndex;
@@ -702,12 +814,12 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
             {
                 fprintf(stderr,
                     "WARNING: Did not find a valid input name %ls.\n",
-                    GetFileInfo().c_str());
+                    GetFileInfo(state).c_str());
             }
             return false;
         }
 
-        ++m_pos;
+        ++state.m_pos;
         --bytesToRead;
     }
 
@@ -715,25 +827,25 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
     {
         fprintf(stderr,
             "WARNING: Exhausted all input expected for the current sequence"
-            " while reading an input name %ls.\n", GetFileInfo().c_str());
+            " while reading an input name %ls.\n", GetFileInfo(state).c_str());
     }
     return false;
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadDenseSample(ParserState& state, vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead)
 {
     size_t counter = 0;
     ElemType value;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(state))
     {
-        char c = *m_pos;
+        char c = *state.m_pos;
 
         if (isValueDelimiter(c))
         {
             // skip value delimiters
-            ++m_pos;
+            ++state.m_pos;
             --bytesToRead;
             continue;
         }
@@ -748,7 +860,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
                     fprintf(stderr,
                         "WARNING: Dense sample (size = %" PRIu64 ") %ls"
                         " exceeds the expected size (%" PRIu64 ").\n",
-                        counter, GetFileInfo().c_str(), sampleSize);
+                        counter, GetFileInfo(state).c_str(), sampleSize);
                 }
                 return false;
             }
@@ -762,7 +874,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
                     fprintf(stderr,
                         "WARNING: A dense sample %ls has a sparse suffix "
                         "(expected size = %" PRIu64 ", actual size = %" PRIu64 ").\n",
-                        GetFileInfo().c_str(), sampleSize, counter);
+                        GetFileInfo(state).c_str(), sampleSize, counter);
                 }
                 for (; counter < sampleSize; ++counter)
                 {
@@ -773,7 +885,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
             return true;
         }
 
-        if (!TryReadRealNumber(value, bytesToRead))
+        if (!TryReadRealNumber(state, value, bytesToRead))
         {
             // bail out.
             return false;
@@ -788,26 +900,26 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
     {
         fprintf(stderr,
             "WARNING: Exhausted all input expected for the current sequence"
-            " while reading a dense sample %ls.\n", GetFileInfo().c_str());
+            " while reading a dense sample %ls.\n", GetFileInfo(state).c_str());
     }
     return false;
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, std::vector<IndexType>& indices,
+bool TextParser<ElemType>::TryReadSparseSample(ParserState& state, std::vector<ElemType>& values, std::vector<IndexType>& indices,
     size_t sampleSize, size_t& bytesToRead)
 {
     size_t index = 0;
     ElemType value;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(state))
     {
-        char c = *m_pos;
+        char c = *state.m_pos;
 
         if (isValueDelimiter(c))
         {
             // skip value delimiters
-            ++m_pos;
+            ++state.m_pos;
             --bytesToRead;
             continue;
         }
@@ -820,7 +932,7 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
         }
 
         // read next sparse index
-        if (!TryReadUint64(index, bytesToRead))
+        if (!TryReadUint64(state, index, bytesToRead))
         {
             // bail out.
             return false;
@@ -833,14 +945,14 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
                 fprintf(stderr,
                     "WARNING: Sparse index value (%" PRIu64 ") %ls"
                     " exceeds the expected sample size (%" PRIu64 ").\n",
-                    index, GetFileInfo().c_str(), sampleSize);
+                    index, GetFileInfo(state).c_str(), sampleSize);
             }
             // bail out.
             return false;
         }
 
         // an index must be followed by a delimiter
-        c = *m_pos;
+        c = *state.m_pos;
         if (c != INDEX_DELIMITER)
         {
             if (ShouldWarn())
@@ -849,17 +961,17 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
                     "WARNING: Unexpected character('%c')"
                     " in place of the index delimiter ('%c')"
                     " after a sparse value index (%" PRIu64 ") %ls.\n",
-                    c, INDEX_DELIMITER, index, GetFileInfo().c_str());
+                    c, INDEX_DELIMITER, index, GetFileInfo(state).c_str());
             }
             return false;
         }
 
         // skip index delimiter
-        ++m_pos;
+        ++state.m_pos;
         --bytesToRead;
 
         // read the corresponding value
-        if (!TryReadRealNumber(value, bytesToRead))
+        if (!TryReadRealNumber(state, value, bytesToRead))
         {
             // bail out.
             return false;
@@ -873,52 +985,52 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
     {
         fprintf(stderr,
             "WARNING: Exhausted all input expected for the current sequence"
-            " while reading a sparse sample %ls.\n", GetFileInfo().c_str());
+            " while reading a sparse sample %ls.\n", GetFileInfo(state).c_str());
     }
 
     return false;
 }
 
 template <class ElemType>
-void TextParser<ElemType>::SkipToNextValue(size_t& bytesToRead)
+void TextParser<ElemType>::SkipToNextValue(ParserState& state, size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(state))
     {
-        char c = *m_pos;
+        char c = *state.m_pos;
         // skip everything until we hit either a value delimiter, an input marker or the end of row.
         if (isValueDelimiter(c) || c == NAME_PREFIX || c == ROW_DELIMITER)
         {
             return;
         }
-        ++m_pos;
+        ++state.m_pos;
         --bytesToRead;
     }
 }
 
 template <class ElemType>
-void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
+void TextParser<ElemType>::SkipToNextInput(ParserState& state, size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(state))
     {
-        char c = *m_pos;
+        char c = *state.m_pos;
         // skip everything until we hit either an input marker or the end of row.
         if (c == NAME_PREFIX || c == ROW_DELIMITER)
         {
             return;
         }
-        ++m_pos;
+        ++state.m_pos;
         --bytesToRead;
     }
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadUint64(ParserState& state, size_t& value, size_t& bytesToRead)
 {
     value = 0;
     bool found = false;
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(state))
     {
-        char c = *m_pos;
+        char c = *state.m_pos;
 
         if (!IsDigit(c))
         {
@@ -935,13 +1047,13 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
             {
                 fprintf(stderr,
                     "WARNING: Overflow while reading a uint64 value %ls.\n",
-                    GetFileInfo().c_str());
+                    GetFileInfo(state).c_str());
             }
 
             return false;
         }
 
-        ++m_pos;
+        ++state.m_pos;
         --bytesToRead;
     }
 
@@ -949,7 +1061,7 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
     {
         fprintf(stderr,
             "WARNING: Exhausted all input expected for the current sequence"
-            " while reading a uint64 value %ls.\n", GetFileInfo().c_str());
+            " while reading a uint64 value %ls.\n", GetFileInfo(state).c_str());
     }
     return false;
 }
@@ -960,32 +1072,32 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 // Assumes that bytesToRead is greater than the number of characters 
 // in the string representation of the floating point number
 // (i.e., the string is followed by one of the delimiters)
-// Post condition: m_pos points to the first character that 
+// Post condition: state.m_pos points to the first character that 
 // cannot be parsed as part of a floating point number.
 // Returns true if parsing was successful.
 template <class ElemType>
-bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadRealNumber(ParserState& state, ElemType& value, size_t& bytesToRead)
 {
-    State state = State::Init;
+    State numberState = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(state))
     {
-        char c = *m_pos;
+        char c = *state.m_pos;
 
-        switch (state)
+        switch (numberState)
         {
         case State::Init:
             // the number must either start with a number or a sign
             if (IsDigit(c))
             {
-                state = IntegralPart;
+                numberState = IntegralPart;
                 number = (c - '0');
             }
             else if (isSign(c))
             {
-                state = Sign;
+                numberState = Sign;
                 negative = (c == '-');
             }
             else
@@ -995,7 +1107,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
                     fprintf(stderr,
                         "WARNING: Unexpected character ('%c')"
                         " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
+                        c, GetFileInfo(state).c_str());
                 }
                 return false;
             }
@@ -1004,7 +1116,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             // the sign must be followed by a number
             if (IsDigit(c))
             {
-                state = IntegralPart;
+                numberState = IntegralPart;
                 number = (c - '0');
             }
             else
@@ -1014,7 +1126,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
                     fprintf(stderr,
                         "WARNING: A sign symbol is followed by an invalid character('%c')"
                         " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
+                        c, GetFileInfo(state).c_str());
                 }
                 return false;
             }
@@ -1026,11 +1138,11 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             }
             else if (c == '.')
             {
-                state = Period;
+                numberState = Period;
             }
             else if (isE(c))
             {
-                state = TheLetterE;
+                numberState = TheLetterE;
                 coefficient = (negative) ? -number : number;
                 number = 0;
             }
@@ -1043,7 +1155,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
         case Period:
             if (IsDigit(c))
             {
-                state = FractionalPart;
+                numberState = FractionalPart;
                 coefficient = number;
                 number = (c - '0');
                 divider = 10;
@@ -1064,7 +1176,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             }
             else if (isE(c))
             {
-                state = TheLetterE;
+                numberState = TheLetterE;
                 coefficient += (number / divider);
                 if (negative)
                 {
@@ -1082,13 +1194,13 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             // followed with optional minus or plus sign and nonempty sequence of decimal digits
             if (IsDigit(c))
             {
-                state = Exponent;
+                numberState = Exponent;
                 negative = false;
                 number = (c - '0');
             }
             else if (isSign(c))
             {
-                state = ExponentSign;
+                numberState = ExponentSign;
                 negative = (c == '-');
             }
             else
@@ -1098,7 +1210,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
                     fprintf(stderr,
                         "WARNING: An exponent symbol is followed by"
                         " an invalid character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                        " in a floating point value %ls.\n", c, GetFileInfo(state).c_str());
                 }
                 return false;
             }
@@ -1107,7 +1219,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             // exponent sign must be followed by a number
             if (IsDigit(c))
             {
-                state = Exponent;
+                numberState = Exponent;
                 number = (c - '0');
             }
             else
@@ -1117,7 +1229,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
                     fprintf(stderr,
                         "WARNING: An exponent sign symbol followed by"
                         " an unexpected character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                        " in a floating point value %ls.\n", c, GetFileInfo(state).c_str());
                 }
                 return false;
             }
@@ -1138,10 +1250,10 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             break;
         default:
             LogicError("Reached an invalid state while reading a floating point value %ls.\n",
-                GetFileInfo().c_str());
+                GetFileInfo(state).c_str());
         }
 
-        ++m_pos;
+        ++state.m_pos;
         --bytesToRead;
     }
 
@@ -1149,7 +1261,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
     {
         fprintf(stderr,
             "WARNING: Exhausted all input expected for the current sequence"
-            " while reading a floating point value %ls.\n", GetFileInfo().c_str());
+            " while reading a floating point value %ls.\n", GetFileInfo(state).c_str());
     }
 
     return false;
@@ -1186,10 +1298,22 @@ void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
 }
 
 template <class ElemType>
-std::wstring TextParser<ElemType>::GetFileInfo()
+void TextParser<ElemType>::SetIndexCacheFile(const std::wstring& indexCacheFile)
+{
+    m_indexCacheFile = indexCacheFile;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetNumParsingThreads(size_t numThreads)
+{
+    m_numParsingThreads = numThreads;
+}
+
+template <class ElemType>
+std::wstring TextParser<ElemType>::GetFileInfo(const ParserState& state)
 {
     std::wstringstream info;
-    info << L"at offset " << GetFileOffset() << L" in the input file (" << m_filename << L")";
+    info << L"at offset " << GetFileOffset(state) << L" in the input file (" << m_filename << L")";
     return info.str();
 }
 
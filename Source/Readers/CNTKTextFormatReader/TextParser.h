@@ -10,6 +10,9 @@
 #include "TextConfigHelper.h"
 #include "Indexer.h"
 #include "CorpusDescriptor.h"
+#include "MemoryMappedFile.h"
+#include <atomic>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -95,22 +98,46 @@ private:
 
     std::unique_ptr<Indexer> m_indexer;
 
-    int64_t m_fileOffsetStart;
-    int64_t m_fileOffsetEnd;
+    // Position of a parser in the input file: a window of the file held in memory
+    // and the current position within that window. Every thread that parses
+    // a part of a chunk has a state of its own.
+    struct ParserState
+    {
+        explicit ParserState(size_t maxAliasLength);
+
+        int64_t m_fileOffsetStart;
+        int64_t m_fileOffsetEnd;
+
+        const char* m_bufferStart;
+        const char* m_bufferEnd;
+        const char* m_pos; // buffer index
+
+        unique_ptr<char[]> m_scratch; // local buffer for string parsing
+
+        // true if the window is the whole memory-mapped input file (it is never refilled).
+        bool m_isMapped;
+    };
 
     // TODO: not DRY (same in the Indexer), needs refactoring
-    unique_ptr<char[]> m_buffer;
-    const char* m_bufferStart;
-    const char* m_bufferEnd;
-    const char* m_pos; // buffer index
+    unique_ptr<char[]> m_buffer; // holds the window of m_state, which is read through m_file
 
-    unique_ptr<char[]> m_scratch; // local buffer for string parsing
+    // State of the sequential parser (reads through m_file).
+    ParserState m_state;
+
+    // The input file mapped into memory, used to parse parts of a chunk in parallel
+    // (null, if chunks are parsed sequentially).
+    std::unique_ptr<MemoryMappedFile> m_mappedFile;
+
+    // Maximum number of threads that parse a single chunk (0 = pick automatically).
+    size_t m_numParsingThreads;
 
     size_t m_chunkSizeBytes;
     unsigned int m_traceLevel;
-    bool m_hadWarnings;
+    std::atomic<bool> m_hadWarnings;
     unsigned int m_numAllowedErrors;
+    std::mutex m_numAllowedErrorsLock;
     bool m_skipSequenceIds;
+    std::wstring m_indexCacheFile; // empty, if the index is not cached
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
     // file operation should be repeated (default value is 5).
 
@@ -125,51 +152,58 @@ private:
     // have been swallowed.
     void PrintWarningNotification();
 
-    void SetFileOffset(int64_t position);
+    void SetFileOffset(ParserState& state, int64_t position);
 
-    void SkipToNextValue(size_t& bytesToRead);
-    void SkipToNextInput(size_t& bytesToRead);
+    void SkipToNextValue(ParserState& state, size_t& bytesToRead);
+    void SkipToNextInput(ParserState& state, size_t& bytesToRead);
 
-    bool TryRefillBuffer();
+    bool TryRefillBuffer(ParserState& state);
 
-    int64_t GetFileOffset() const { return m_fileOffsetStart + (m_pos - m_bufferStart); }
+    int64_t GetFileOffset(const ParserState& state) const { return state.m_fileOffsetStart + (state.m_pos - state.m_bufferStart); }
 
     // Returns a string containing input file information (current offset, file name, etc.),
     // which can be included as a part of the trace/log message.
-    std::wstring GetFileInfo();
+    std::wstring GetFileInfo(const ParserState& state);
 
     // Reads an alias/name and converts it to an internal stream id (= stream index).
-    bool TryGetInputId(size_t& id, size_t& bytesToRead);
+    bool TryGetInputId(ParserState& state, size_t& id, size_t& bytesToRead);
 
-    bool TryReadRealNumber(ElemType& value, size_t& bytesToRead);
+    bool TryReadRealNumber(ParserState& state, ElemType& value, size_t& bytesToRead);
 
-    bool TryReadUint64(size_t& value, size_t& bytesToRead);
+    bool TryReadUint64(ParserState& state, size_t& value, size_t& bytesToRead);
 
     // Reads dense sample values into the provided vector.
-    bool TryReadDenseSample(std::vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
+    bool TryReadDenseSample(ParserState& state, std::vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
 
     // Reads sparse sample values and corresponding indices into the provided vectors.
-    bool TryReadSparseSample(std::vector<ElemType>& values, std::vector<IndexType>& indices,
+    bool TryReadSparseSample(ParserState& state, std::vector<ElemType>& values, std::vector<IndexType>& indices,
         size_t sampleSize, size_t& bytesToRead);
 
     // Reads one sample (an input identifier followed by a list of values)
-    bool TryReadSample(SequenceBuffer& sequence, size_t& bytesToRead);
+    bool TryReadSample(ParserState& state, SequenceBuffer& sequence, size_t& bytesToRead);
 
     // Reads one whole row (terminated by a row delimiter) of samples
-    bool TryReadRow(SequenceBuffer& sequence, size_t& bytesToRead);
+    bool TryReadRow(ParserState& state, SequenceBuffer& sequence, size_t& bytesToRead);
 
     // Returns true if there's still data available.
-    bool inline CanRead() { return m_pos != m_bufferEnd || TryRefillBuffer(); }
+    bool inline CanRead(ParserState& state) { return state.m_pos != state.m_bufferEnd || TryRefillBuffer(state); }
 
     // Returns true if the trace level is greater or equal to 'Warning'
     bool inline ShouldWarn() { m_hadWarnings = true; return m_traceLevel >= Warning; }
 
     // Given a descriptor, retrieves the data for the corresponding sequence from the file.
-    SequenceBuffer LoadSequence(const SequenceDescriptor& descriptor);
+    SequenceBuffer LoadSequence(ParserState& state, const SequenceDescriptor& descriptor);
 
     // Given a descriptor, retrieves the data for the corresponding chunk from the file.
     void LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor);
 
+    // Splits the sequences of a chunk into contiguous slices of about the same size in bytes
+    // and parses each slice on its own thread, reading from the memory-mapped input file.
+    void LoadChunkInParallel(TextChunkPtr& chunk, const ChunkDescriptor& descriptor, size_t numSlices);
+
+    // Returns the number of slices the given chunk should be split into (1, if it should be parsed sequentially).
+    size_t GetNumberOfSlices(const ChunkDescriptor& descriptor) const;
+
     TextParser(CorpusDescriptorPtr corpus, const std::wstring& filename, const vector<StreamDescriptor>& streams);
 
     // Fills some metadata members to be conformant to the exposed SequenceData interface.
@@ -185,6 +219,10 @@ private:
 
     void SetNumRetries(unsigned int numRetries);
 
+    void SetIndexCacheFile(const std::wstring& indexCacheFile);
+
+    void SetNumParsingThreads(size_t numThreads);
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
     const std::string& GetSequenceKey(const SequenceDescriptor& s) const;
@@ -20,6 +20,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     const auto BUFFER_SIZE = 2 * 1024 * 1024;
 
+    // Parallel parsing of a chunk (see TextParser::LoadChunkInParallel): when the number of
+    // threads is picked automatically, it is at most MAX_AUTO_PARSING_THREADS and every thread
+    // gets at least MIN_PARSING_SLICE_SIZE bytes of the chunk.
+    const size_t MAX_AUTO_PARSING_THREADS = 8;
+    const size_t MIN_PARSING_SLICE_SIZE = 1024 * 1024;
+
     inline bool isPrintable(char c)
     {
         return c >= SPACE_CHAR;
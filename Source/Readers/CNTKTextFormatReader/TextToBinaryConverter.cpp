@@ -0,0 +1,174 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "TextToBinaryConverter.h"
+#include "BinaryTextFormat.h"
+#include "TextParser.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Writes to the container, keeping track of the current offset.
+class ContainerWriter
+{
+public:
+    explicit ContainerWriter(FILE* file) : m_file(file), m_offset(0)
+    {}
+
+    void Write(const void* data, size_t size)
+    {
+        if (size > 0)
+        {
+            fwriteOrDie(data, 1, size, m_file);
+            m_offset += size;
+        }
+    }
+
+    // Pads the container with zeros up to the next aligned offset.
+    void Align()
+    {
+        static const char zeros[BINARY_CONTAINER_ALIGNMENT] = {};
+        Write(zeros, AlignToBinaryContainer(m_offset) - m_offset);
+    }
+
+    uint64_t Offset() const { return m_offset; }
+
+private:
+    FILE* m_file;
+    uint64_t m_offset;
+};
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::Convert(const TextConfigHelper& helper, const std::wstring& containerFile)
+{
+    const std::wstring& textFile = helper.GetFilePath();
+    const auto& streams = helper.GetStreams();
+
+    BinaryContainerHeader header = {};
+    memcpy(header.m_magic, BINARY_CONTAINER_MAGIC, sizeof(BINARY_CONTAINER_MAGIC));
+    header.m_version = BINARY_CONTAINER_VERSION;
+    header.m_elementSize = sizeof(ElemType);
+    header.m_numberOfStreams = streams.size();
+
+    // Taking the stamp before reading, so that a container of a file modified while converting gets invalidated.
+    if (!Indexer::GetFileStamp(textFile, header.m_sourceSize, header.m_sourceModificationTime))
+    {
+        RuntimeError("Cannot access the input file '%ls'.", textFile.c_str());
+    }
+
+    // All sequences are converted, the corpus is applied when the container is read.
+    auto corpus = std::make_shared<CorpusDescriptor>();
+    TextParser<ElemType> parser(corpus, helper);
+    auto& keys = corpus->GetStringRegistry();
+
+    std::vector<BinaryChunkRecord> chunks;
+    std::vector<BinarySequenceRecord> sequences;
+
+    std::wstring tempFile = containerFile + L".tmp" + std::to_wstring(GetCurrentProcessId());
+    FILE* f = fopenOrDie(tempFile, L"wb");
+    try
+    {
+        ContainerWriter writer(f);
+        writer.Write(&header, sizeof(header)); // rewritten below, once all offsets are known
+        writer.Align();
+
+        std::vector<SequenceDescription> descriptions;
+        std::vector<SequenceDataPtr> data;
+        for (const auto& chunkDescription : parser.GetChunkDescriptions())
+        {
+            descriptions.clear();
+            parser.GetSequencesForChunk(chunkDescription->m_id, descriptions);
+            ChunkPtr chunk = parser.GetChunk(chunkDescription->m_id);
+
+            BinaryChunkRecord chunkRecord = {};
+            chunkRecord.m_firstSequence = sequences.size();
+            chunkRecord.m_numberOfSequences = descriptions.size();
+            chunkRecord.m_numberOfSamples = chunkDescription->m_numberOfSamples;
+            chunkRecord.m_offset = writer.Offset();
+
+            for (const auto& description : descriptions)
+            {
+                BinarySequenceRecord sequenceRecord = {};
+                sequenceRecord.m_key = std::stoull(keys[description.m_key.m_sequence]);
+                sequenceRecord.m_offset = writer.Offset();
+                sequenceRecord.m_numberOfSamples = description.m_numberOfSamples;
+                sequences.push_back(sequenceRecord);
+
+                data.clear();
+                chunk->GetSequence(description.m_id, data);
+                for (size_t i = 0; i < streams.size(); ++i)
+                {
+                    BinaryBlockHeader block = {};
+                    block.m_numberOfSamples = data[i]->m_numberOfSamples;
+                    if (streams[i].m_storageType == StorageType::dense)
+                    {
+                        writer.Write(&block, sizeof(block));
+                        writer.Write(data[i]->m_data, sizeof(ElemType) * block.m_numberOfSamples * streams[i].m_sampleDimension);
+                        writer.Align();
+                    }
+                    else
+                    {
+                        auto sparse = static_cast<SparseSequenceData*>(data[i].get());
+                        block.m_totalNnzCount = sparse->m_totalNnzCount;
+                        writer.Write(&block, sizeof(block));
+                        writer.Write(sparse->m_nnzCounts.data(), sizeof(IndexType) * sparse->m_nnzCounts.size());
+                        writer.Align();
+                        writer.Write(sparse->m_indices, sizeof(IndexType) * block.m_totalNnzCount);
+                        writer.Align();
+                        writer.Write(sparse->m_data, sizeof(ElemType) * block.m_totalNnzCount);
+                        writer.Align();
+                    }
+                }
+            }
+
+            chunkRecord.m_byteSize = writer.Offset() - chunkRecord.m_offset;
+            chunks.push_back(chunkRecord);
+        }
+
+        std::vector<BinaryStreamRecord> streamRecords;
+        for (const auto& stream : streams)
+        {
+            BinaryStreamRecord record = {};
+            record.m_storageType = (uint32_t) stream.m_storageType;
+            record.m_aliasLength = (uint32_t) stream.m_alias.size();
+            record.m_aliasOffset = writer.Offset();
+            record.m_sampleDimension = stream.m_sampleDimension;
+            writer.Write(stream.m_alias.data(), stream.m_alias.size());
+            streamRecords.push_back(record);
+        }
+        writer.Align();
+
+        header.m_streamTableOffset = writer.Offset();
+        writer.Write(streamRecords.data(), sizeof(BinaryStreamRecord) * streamRecords.size());
+        header.m_chunkTableOffset = writer.Offset();
+        header.m_numberOfChunks = chunks.size();
+        writer.Write(chunks.data(), sizeof(BinaryChunkRecord) * chunks.size());
+        header.m_sequenceTableOffset = writer.Offset();
+        header.m_numberOfSequences = sequences.size();
+        writer.Write(sequences.data(), sizeof(BinarySequenceRecord) * sequences.size());
+
+        fseekOrDie(f, 0, SEEK_SET);
+        fwriteOrDie(&header, sizeof(header), 1, f);
+        fflushOrDie(f);
+    }
+    catch (...)
+    {
+        fclose(f);
+        _wunlink(tempFile.c_str());
+        throw;
+    }
+    fclose(f);
+    renameOrDie(tempFile, containerFile);
+
+    fprintf(stderr, "Converted '%ls' into the binary container '%ls' (%" PRIu64 " chunks, %" PRIu64 " sequences).\n",
+        textFile.c_str(), containerFile.c_str(), header.m_numberOfChunks, header.m_numberOfSequences);
+}
+
+template class TextToBinaryConverter<float>;
+template class TextToBinaryConverter<double>;
+
+}}}
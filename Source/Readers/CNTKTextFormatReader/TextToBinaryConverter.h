@@ -0,0 +1,24 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include "TextConfigHelper.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Converts a CNTKTextFormat file into the binary container described in BinaryTextFormat.h.
+// The input file, its streams and its chunking are taken from the text reader configuration.
+// The container is written under a temporary name and renamed once complete,
+// so that concurrent readers (e.g., other MPI ranks) never see a partial container.
+template <class ElemType>
+class TextToBinaryConverter
+{
+public:
+    static void Convert(const TextConfigHelper& helper, const std::wstring& containerFile);
+};
+
+}}}
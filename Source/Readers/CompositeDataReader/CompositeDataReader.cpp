@@ -18,6 +18,7 @@
 #include "FramePacker.h"
 #include "SequencePacker.h"
 #include "TruncatedBpttPacker.h"
+#include "LengthBucketingEnumerator.h"
 #include "CorpusDescriptor.h"
 #include "ConfigUtil.h"
 #include "StringUtil.h"
@@ -85,7 +86,7 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
         deserializer = std::make_shared<Bundler>(config, deserializer, m_deserializers, cleanse);
     }
 
-    int verbosity = config(L"verbosity", 0);
+    m_verbosity = config(L"verbosity", 0);
 
     // Pick up the randomizer, always picking up no randomization for the write mode.
     bool randomize = isActionWrite ? false : config(L"randomize", false);
@@ -100,13 +101,33 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
         size_t randomizationWindow = config(L"randomizationWindow", requestDataSize);
         // By default using STL random number generator.
         bool useLegacyRandomization = config(L"useLegacyRandomization", false);
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization);
+        // Number of chunks to load ahead of the randomization window, on how many I/O threads, and a bound on their total size.
+        // More than one thread requires deserializers that can load different chunks concurrently (e.g. the HTK deserializers).
+        size_t prefetchDepth = config(L"prefetchDepth", (size_t) 1);
+        size_t prefetchThreads = config(L"prefetchThreads", (size_t) 1);
+        size_t prefetchBudgetInSamples = config(L"prefetchBudgetInSamples", (size_t) SIZE_MAX);
+        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(m_verbosity, randomizationWindow, deserializer, true /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization,
+                                                                 prefetchDepth, prefetchThreads, prefetchBudgetInSamples);
     }
     else
     {
         m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization);
     }
 
+    // Optionally grouping sequences of similar length into the same minibatch, to reduce padding.
+    m_lengthBucketing = config(L"lengthBucketing", false);
+    if (m_lengthBucketing)
+    {
+        if (m_packingMode != PackingMode::sequence)
+        {
+            InvalidArgument("lengthBucketing is only supported when packing whole sequences, not with frameMode or truncated.");
+        }
+
+        // Number of minibatches whose sequences are bucketed together.
+        size_t window = config(L"lengthBucketingWindow", (size_t) 32);
+        m_sequenceEnumerator = std::make_shared<LengthBucketingEnumerator>(m_sequenceEnumerator, window);
+    }
+
     // In case when there are transforms, applying them to the data.
     m_sequenceEnumerator = m_transforms.empty()
         ? m_sequenceEnumerator 
@@ -256,32 +277,40 @@ void CompositeDataReader::StartEpoch(const EpochConfiguration& cfg)
 
     m_sequenceEnumerator->StartEpoch(config);
 
-    // TODO: As the next step the packers should be moved into the network.
-    switch (m_packingMode)
-    {
-    case PackingMode::sample:
-        m_packer = std::make_shared<FramePacker>(
-            m_provider,
-            m_sequenceEnumerator,
-            m_streams);
-        break;
-    case PackingMode::sequence:
-        m_packer = std::make_shared<SequencePacker>(
-            m_provider,
-            m_sequenceEnumerator,
-            m_streams);
-        break;
-    case PackingMode::truncated:
+    if (m_packingMode == PackingMode::truncated)
     {
         config.m_truncationSize = m_truncationLength;
-        m_packer = std::make_shared<TruncatedBPTTPacker>(
-            m_provider,
-            m_sequenceEnumerator,
-            m_streams);
-        break;
     }
-    default:
-        LogicError("Unsupported type of packer '%d'.", (int)m_packingMode);
+
+    // The packer is created once and kept across epochs, as in the other readers.
+    // TODO: As the next step the packers should be moved into the network.
+    if (!m_packer)
+    {
+        switch (m_packingMode)
+        {
+        case PackingMode::sample:
+            m_packer = std::make_shared<FramePacker>(
+                m_provider,
+                m_sequenceEnumerator,
+                m_streams);
+            break;
+        case PackingMode::sequence:
+            m_packer = std::make_shared<SequencePacker>(
+                m_provider,
+                m_sequenceEnumerator,
+                m_streams,
+                m_lengthBucketing,
+                m_lengthBucketing || m_verbosity > 0 /* reportPadding */);
+            break;
+        case PackingMode::truncated:
+            m_packer = std::make_shared<TruncatedBPTTPacker>(
+                m_provider,
+                m_sequenceEnumerator,
+                m_streams);
+            break;
+        default:
+            LogicError("Unsupported type of packer '%d'.", (int)m_packingMode);
+        }
     }
 
     m_packer->StartEpoch(config);
@@ -45,6 +45,7 @@ struct Minibatch;
 //     - deserializers provide sequences according to the corpus descriptor
 //     - sequences can be transformed by the transformers applied on top of deserializer
 //     - deserializers are bound together using the bundler - it bundles sequences with the same sequence id retrieved from different deserializers
+//     - sequences of similar length can be grouped into the same minibatch (lengthBucketing), to reduce padding
 //     - packer is used to pack randomized sequences into the minibatch
 // The composite reader is currently also responsible for asynchronous prefetching of the minibatch data.
 
@@ -127,6 +128,12 @@ private:
 
     // Truncation length for BPTT mode.
     size_t m_truncationLength;
+
+    // Whether sequences of similar length are grouped into the same minibatch, and packed best-fit.
+    bool m_lengthBucketing;
+
+    // Verbosity of the diagnostic output.
+    int m_verbosity;
 };
 
 }}}
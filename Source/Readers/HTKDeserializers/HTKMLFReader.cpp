@@ -16,6 +16,7 @@
 #include "TruncatedBpttPacker.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
+#include "LengthBucketingEnumerator.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -113,7 +114,12 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
     // TODO: this should be bool. Change when config per deserializer is allowed.
     if (AreEqualIgnoreCase(readMethod, std::wstring(L"blockRandomize")))
     {
-        m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, true  /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, true /* useLegacyRandomization */);
+        // Number of chunks to load ahead of the randomization window, on how many I/O threads, and a bound on their total size.
+        size_t prefetchDepth = readerConfig(L"prefetchDepth", (size_t) 1);
+        size_t prefetchThreads = readerConfig(L"prefetchThreads", (size_t) 1);
+        size_t prefetchBudgetInSamples = readerConfig(L"prefetchBudgetInSamples", (size_t) SIZE_MAX);
+        m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, true  /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, true /* useLegacyRandomization */, false /* multithreadedGetNextSequences */,
+                                                         prefetchDepth, prefetchThreads, prefetchBudgetInSamples);
     }
     else if (AreEqualIgnoreCase(readMethod, std::wstring(L"none")))
     {
@@ -124,6 +130,19 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
         RuntimeError("readMethod must be 'blockRandomize' or 'none'.");
     }
 
+    // Optionally grouping utterances of similar length into the same minibatch, to reduce padding.
+    bool lengthBucketing = readerConfig(L"lengthBucketing", false);
+    if (lengthBucketing)
+    {
+        if (m_packingMode != PackingMode::sequence)
+        {
+            InvalidArgument("lengthBucketing is only supported when packing whole utterances, not with frameMode or truncated.");
+        }
+
+        size_t bucketingWindow = readerConfig(L"lengthBucketingWindow", (size_t) 32);
+        m_randomizer = std::make_shared<LengthBucketingEnumerator>(m_randomizer, bucketingWindow);
+    }
+
     // Create output stream descriptions (all dense)
     for (auto d : deserializers)
     {
@@ -150,7 +169,7 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
         m_packer = std::make_shared<FramePacker>(m_provider, m_randomizer, m_streams);
         break;
     case PackingMode::sequence:
-        m_packer = std::make_shared<SequencePacker>(m_provider, m_randomizer, m_streams);
+        m_packer = std::make_shared<SequencePacker>(m_provider, m_randomizer, m_streams, lengthBucketing, lengthBucketing || verbosity > 0 /* reportPadding */);
         break;
     case PackingMode::truncated:
         m_packer = std::make_shared<TruncatedBPTTPacker>(m_provider, m_randomizer, m_streams);
@@ -24,7 +24,10 @@ BlockRandomizer::BlockRandomizer(
     bool shouldPrefetch,
     DecimationMode decimationMode,
     bool useLegacyRandomization,
-    bool multithreadedGetNextSequence)
+    bool multithreadedGetNextSequence,
+    size_t prefetchDepth,
+    size_t numPrefetchThreads,
+    size_t prefetchBudgetInSamples)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_decimationMode(decimationMode),
@@ -36,11 +39,17 @@ BlockRandomizer::BlockRandomizer(
       m_lastSeenChunkId(CHUNKID_MAX),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRangeInSamples, useLegacyRandomization)),
       m_multithreadedGetNextSequences(multithreadedGetNextSequence),
-      m_prefetchedChunk(CHUNKID_MAX)
+      m_prefetchDepth(std::max<size_t>(prefetchDepth, 1)),
+      m_prefetchBudgetInSamples(prefetchBudgetInSamples),
+      m_stallTime(0),
+      m_numLoadedChunks(0),
+      m_numPrefetchedChunks(0),
+      m_epochStatisticsReported(false)
 {
     assert(deserializer != nullptr);
 
-    m_launchType = shouldPrefetch ? launch::async : launch::deferred;
+    // Without prefetch, chunks are loaded on demand, on the main thread.
+    m_loaderPool.reset(new IOThreadPool(shouldPrefetch ? std::max<size_t>(numPrefetchThreads, 1) : 0));
 
     m_streams = m_deserializer->GetStreamDescriptions();
     m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
@@ -58,6 +67,11 @@ void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
 {
     m_lastSeenChunkId = CHUNKID_MAX;
 
+    m_stallTime = std::chrono::duration<double>(0);
+    m_numLoadedChunks = 0;
+    m_numPrefetchedChunks = 0;
+    m_epochStatisticsReported = false;
+
     m_config = config;
     if (config.m_totalEpochSizeInSamples == requestDataSize)
     {
@@ -117,6 +131,11 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
     Sequences result;
     std::vector<RandomizedSequenceDescription> sequences;
     result.m_endOfEpoch = GetNextSequenceDescriptions(sampleCount, sequences);
+    if (result.m_endOfEpoch)
+    {
+        ReportEpochStatistics();
+    }
+
     if (sequences.size() == 0)
     {
         return result;
@@ -132,7 +151,7 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
     }
 
     // Retrieve new data chunks if required.
-    ChunkIdType chunkToPrefetchNext = LoadDataChunks();
+    auto chunksToPrefetchNext = LoadDataChunks();
 
     if (m_verbosity >= Debug)
         fprintf(stderr, "BlockRandomizer::GetNextSequences(): getting %" PRIu64 " out of %" PRIu64 " sequences for %" PRIu64 " requested samples in sweep %" PRIu64 "\n",
@@ -177,7 +196,7 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
     m_sequenceRandomizer->ReleaseChunks();
 
     // Now it is safe to start the new chunk prefetch.
-    Prefetch(chunkToPrefetchNext);
+    Prefetch(chunksToPrefetchNext);
 
     return result;
 }
@@ -243,15 +262,15 @@ void BlockRandomizer::Decimate(const std::vector<RandomizedSequenceDescription>&
 }
 
 // Retrieves chunk data based on the window information provided by SequenceRandomizer
-// Returns the next chunk id to prefetch.
-ChunkIdType BlockRandomizer::LoadDataChunks()
+// Returns the next chunks to prefetch.
+std::vector<std::pair<ChunkIdType, size_t>> BlockRandomizer::LoadDataChunks()
 {
     size_t randomizedEnd = 0;
     const auto& window = m_sequenceRandomizer->GetChunkWindow(randomizedEnd);
     if (window[randomizedEnd - 1].m_chunkId == m_lastSeenChunkId)
     {
         // nothing to prefetch.
-        return CHUNKID_MAX;
+        return std::vector<std::pair<ChunkIdType, size_t>>();
     }
 
     m_lastSeenChunkId = window[randomizedEnd - 1].m_chunkId;
@@ -290,7 +309,9 @@ ChunkIdType BlockRandomizer::LoadDataChunks()
     // TODO diagnostics for paged out chunks?
     m_chunks.swap(chunks);
 
-    // Adding new ones.
+    // Adding new ones: taking the prefetched chunks, and requesting all others at once, so that they load in parallel.
+    std::vector<std::pair<size_t, std::future<ChunkPtr>>> pending; // (index in the window, chunk data)
+    std::vector<bool> prefetched;
     for (size_t i = 0; i < randomizedEnd; ++i)
     {
         if (!needed[i])
@@ -298,33 +319,38 @@ ChunkIdType BlockRandomizer::LoadDataChunks()
             continue;
         }
 
-        auto const& chunk = window[i];
-        if (chunk.m_original->m_id == m_prefetchedChunk && m_prefetch.valid())
+        ChunkIdType chunkId = window[i].m_original->m_id;
+        auto it = m_prefetchedChunks.find(chunkId);
+        if (it != m_prefetchedChunks.end())
         {
-            // Taking prefetched chunk.
-            m_chunks[chunk.m_original->m_id] = m_prefetch.get();
-            if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in prefetched chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
-                chunk.m_chunkId,
-                chunk.m_original->m_id,
-                ++numLoadedChunks);
+            pending.push_back(std::make_pair(i, std::move(it->second.m_data)));
+            m_prefetchedChunks.erase(it);
+            prefetched.push_back(true);
         }
         else
         {
-            // Make sure we have no outstanding prefetches.
-            if (m_prefetch.valid())
-            {
-                m_prefetch.wait();
-            }
+            pending.push_back(std::make_pair(i, m_loaderPool->Submit<ChunkPtr>([this, chunkId]() { return m_deserializer->GetChunk(chunkId); })));
+            prefetched.push_back(false);
+        }
+    }
 
-            m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
-            if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
+    auto waitStart = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < pending.size(); ++k)
+    {
+        auto const& chunk = window[pending[k].first];
+        m_chunks[chunk.m_original->m_id] = pending[k].second.get();
+        m_numLoadedChunks++;
+        if (prefetched[k])
+            m_numPrefetchedChunks++;
+
+        if (m_verbosity >= Information)
+            fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in %s chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
+                prefetched[k] ? "prefetched" : "randomized",
                 chunk.m_chunkId,
                 chunk.m_original->m_id,
                 ++numLoadedChunks);
-        }
     }
+    m_stallTime += std::chrono::steady_clock::now() - waitStart;
 
     if (m_verbosity >= Notification)
         fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: %" PRIu64 " chunks paged-in from chunk window [%u..%u]\n",
@@ -332,48 +358,95 @@ ChunkIdType BlockRandomizer::LoadDataChunks()
                 window.front().m_chunkId,
                 window.back().m_chunkId);
 
-    return GetChunkToPrefetch(window.begin() + randomizedEnd, window.end());
+    return GetChunksToPrefetch(window.begin() + randomizedEnd, window.end());
 }
 
-// Identifies chunk id that should be prefetched.
+// Identifies chunks that should be prefetched.
 // TODO: DecimationMode::sequence is not supported because it should eventually go away.
 template<class Iter>
-ChunkIdType BlockRandomizer::GetChunkToPrefetch(const Iter& begin, const Iter& end)
+std::vector<std::pair<ChunkIdType, size_t>> BlockRandomizer::GetChunksToPrefetch(const Iter& begin, const Iter& end)
 {
-    auto current = begin;
-    ChunkIdType toBePrefetched = CHUNKID_MAX;
-    while (current != end)
+    std::vector<std::pair<ChunkIdType, size_t>> toBePrefetched;
+    for (auto current = begin; current != end && toBePrefetched.size() < m_prefetchDepth; ++current)
     {
         if (m_chunks.find(current->m_original->m_id) == m_chunks.end() &&
-            m_decimationMode == DecimationMode::chunk && 
+            m_decimationMode == DecimationMode::chunk &&
             current->m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank)
         {
-            toBePrefetched = current->m_original->m_id;
-            break;
+            toBePrefetched.push_back(std::make_pair(current->m_original->m_id, (size_t)current->m_original->m_numberOfSamples));
         }
-        ++current;
     }
     return toBePrefetched;
 }
 
-// Performs io prefetch of the specified chunk if needed.
-void BlockRandomizer::Prefetch(ChunkIdType chunkId)
+// Performs io prefetch of the specified chunks if needed.
+void BlockRandomizer::Prefetch(const std::vector<std::pair<ChunkIdType, size_t>>& chunks)
 {
-    // Start new prefetch if necessary.
-    if (m_prefetchedChunk != chunkId && chunkId != CHUNKID_MAX)
+    if (chunks.empty())
     {
-        // Wait to make sure there is no outstanding prefetches.
-        if (m_prefetch.valid())
+        return;
+    }
+
+    // Drop loaded prefetches that the next window does not need anymore.
+    // A submitted load runs to completion even if its future is dropped, so chunks still being loaded are kept
+    // (and counted against the depth and budget) until they are done; should a later window need them after all,
+    // their pending load is reused instead of a second one being started.
+    for (auto it = m_prefetchedChunks.begin(); it != m_prefetchedChunks.end();)
+    {
+        bool stillNeeded = std::any_of(chunks.begin(), chunks.end(), [&](const std::pair<ChunkIdType, size_t>& c) { return c.first == it->first; });
+        bool inFlight = it->second.m_data.wait_for(std::chrono::seconds(0)) == std::future_status::timeout;
+        it = (stillNeeded || inFlight) ? std::next(it) : m_prefetchedChunks.erase(it);
+    }
+
+    size_t prefetchedSamples = 0;
+    for (const auto& p : m_prefetchedChunks)
+    {
+        prefetchedSamples += p.second.m_numberOfSamples;
+    }
+
+    // Start new prefetches in window order, within the depth and the memory budget.
+    for (const auto& chunk : chunks)
+    {
+        if (m_prefetchedChunks.size() >= m_prefetchDepth)
         {
-            m_prefetch.wait();
+            break;
         }
 
-        m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+        ChunkIdType chunkId = chunk.first;
+        if (m_prefetchedChunks.find(chunkId) != m_prefetchedChunks.end())
+        {
+            continue;
+        }
+
+        if (!m_prefetchedChunks.empty() && prefetchedSamples + chunk.second > m_prefetchBudgetInSamples)
+        {
+            break;
+        }
+
+        prefetchedSamples += chunk.second;
+        m_prefetchedChunks[chunkId] = PrefetchedChunk{ m_loaderPool->Submit<ChunkPtr>([this, chunkId]() { return m_deserializer->GetChunk(chunkId); }), chunk.second };
 
         if (m_verbosity >= Debug)
             fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
     }
 }
 
+// Prints the chunk loading statistics of the current epoch, once.
+void BlockRandomizer::ReportEpochStatistics()
+{
+    if (m_epochStatisticsReported || m_verbosity < Notification)
+    {
+        return;
+    }
+
+    m_epochStatisticsReported = true;
+    fprintf(stderr, "BlockRandomizer: epoch %" PRIu64 ": waited %.3f seconds for chunk data; %" PRIu64 " chunks paged in, %" PRIu64 " of them prefetched (prefetch depth %" PRIu64 ", %" PRIu64 " I/O threads)\n",
+            m_config.m_epochIndex,
+            m_stallTime.count(),
+            m_numLoadedChunks,
+            m_numPrefetchedChunks,
+            m_prefetchDepth,
+            m_loaderPool->NumThreads());
+}
+
 }}}
@@ -11,6 +11,8 @@
 #include "DataDeserializer.h"
 #include "ChunkRandomizer.h"
 #include "SequenceRandomizer.h"
+#include "IOThreadPool.h"
+#include <chrono>
 #include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -30,6 +32,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //         6) request chunks of data based on decimated sequences and return sequence data
 //
 // This class is responsible for decimation and loading the data chunks in to memory.
+// Chunks are loaded on a small pool of I/O threads: while the current window is consumed, up to prefetchDepth chunks of
+// the next window are loaded ahead, as long as their total size stays within prefetchBudgetInSamples (at least one chunk is
+// always prefetched). With more than one I/O thread, the deserializer's GetChunk() is called concurrently for different chunks.
+// The time the reader spends waiting for chunk data is reported at the end of each epoch.
 // Actual randomization happens in ChunkRandomizer and SequenceRandomizer.
 // TODO: The behavior can be simplified by only randomizing sequences forward.
 class BlockRandomizer : public SequenceEnumerator
@@ -49,7 +55,10 @@ public:
         bool shouldPrefetch,
         DecimationMode decimationMode = DecimationMode::chunk,
         bool useLegacyRandomization = false,
-        bool multithreadedGetNextSequences = false);
+        bool multithreadedGetNextSequences = false,
+        size_t prefetchDepth = 1,
+        size_t numPrefetchThreads = 1,
+        size_t prefetchBudgetInSamples = SIZE_MAX);
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -63,18 +72,17 @@ public:
         return m_deserializer->GetStreamDescriptions();
     }
 
-    ~BlockRandomizer()
+private:
+    // A chunk of the next window that is loaded ahead of time.
+    struct PrefetchedChunk
     {
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
-    }
+        std::future<ChunkPtr> m_data;
+        size_t m_numberOfSamples;
+    };
 
-private:
     // Load data for chunks if needed.
-    // Returns the next chunk id to prefetch.
-    ChunkIdType LoadDataChunks();
+    // Returns the next chunks to prefetch (original chunk id, number of samples), in window order.
+    std::vector<std::pair<ChunkIdType, size_t>> LoadDataChunks();
 
     // Get next sequence descriptions that do not exceed sample count.
     // Returns true if epoch end is reached.
@@ -86,12 +94,15 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
-    // Performs io prefetch of the specified chunk if needed.
-    void Prefetch(ChunkIdType chunkId);
+    // Performs io prefetch of the specified chunks if needed, within the prefetch depth and budget.
+    void Prefetch(const std::vector<std::pair<ChunkIdType, size_t>>& chunks);
 
-    // Returns next candidate for the prefetch in the given range.
+    // Returns candidates for the prefetch in the given range.
     template<class Iter>
-    ChunkIdType GetChunkToPrefetch(const Iter& begin, const Iter& end);
+    std::vector<std::pair<ChunkIdType, size_t>> GetChunksToPrefetch(const Iter& begin, const Iter& end);
+
+    // Prints the chunk loading statistics of the current epoch (verbosity 1 and above).
+    void ReportEpochStatistics();
 
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
@@ -150,12 +161,23 @@ private:
 
     int m_verbosity;
 
-    // Prefetch future.
-    std::future<ChunkPtr> m_prefetch;
-    // Whether to have async or deferred prefetch.
-    launch m_launchType;
-    // Prefetched original chunk id.
-    ChunkIdType m_prefetchedChunk;
+    // Chunks being prefetched, by original chunk id. Loads that are still running stay here until they complete,
+    // so that their result can be reused if needed again.
+    std::map<ChunkIdType, PrefetchedChunk> m_prefetchedChunks;
+    // Maximum number of chunks to prefetch.
+    size_t m_prefetchDepth;
+    // Maximum total number of samples in prefetched chunks.
+    size_t m_prefetchBudgetInSamples;
+
+    // Per epoch statistics: time spent waiting for chunk data, chunks paged in, and how many of those were prefetched.
+    std::chrono::duration<double> m_stallTime;
+    size_t m_numLoadedChunks;
+    size_t m_numPrefetchedChunks;
+    bool m_epochStatisticsReported;
+
+    // I/O threads that load chunks, none if loading is deferred.
+    // Declared last, so that it is destroyed first, while the deserializer is still alive.
+    std::unique_ptr<IOThreadPool> m_loaderPool;
 };
 
 }}}
@@ -6,24 +6,44 @@
 #pragma once
 
 #include <algorithm>
+#include <new>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 #include "MemoryProvider.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Allocates from the heap, aligned to a cache line, since input matrices use the packed
+// minibatch in place (see ReaderShim::FillMatrixFromStream()).
 class HeapMemoryProvider : public MemoryProvider
 {
-    static const size_t size_of_first_pointer = sizeof(void*);
+    static const size_t alignment = 64;
 
 public:
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
     {
-        // Currently not alligned.
-        return ::operator new(elementSize * numberOfElements);
+        size_t size = std::max(elementSize * numberOfElements, (size_t)1);
+#ifdef _WIN32
+        void* p = _aligned_malloc(size, alignment);
+#else
+        void* p = nullptr;
+        if (posix_memalign(&p, alignment, size) != 0)
+            p = nullptr;
+#endif
+        if (!p)
+            throw std::bad_alloc();
+        return p;
     }
 
     virtual void Free(void* p) override
     {
-        ::operator delete(p);
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
     }
 };
 
@@ -0,0 +1,93 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A small fixed-size pool of threads that run blocking I/O tasks, e.g. loading of data chunks, off the main thread.
+// Tasks are started in the order of submission. A pool without threads runs each task deferred,
+// i.e. on the thread that first waits for its result.
+// On destruction, tasks that have not started yet are dropped (their futures report a broken promise),
+// running tasks are finished.
+class IOThreadPool
+{
+public:
+    explicit IOThreadPool(size_t numThreads) : m_stop(false)
+    {
+        for (size_t i = 0; i < numThreads; ++i)
+            m_threads.emplace_back([this]() { Run(); });
+    }
+
+    ~IOThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_tasks.clear();
+        }
+        m_wakeUp.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    size_t NumThreads() const
+    {
+        return m_threads.size();
+    }
+
+    template <class Result>
+    std::future<Result> Submit(std::function<Result()> task)
+    {
+        if (m_threads.empty())
+            return std::async(std::launch::deferred, task);
+
+        auto packagedTask = std::make_shared<std::packaged_task<Result()>>(task);
+        auto result = packagedTask->get_future();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_tasks.push_back([packagedTask]() { (*packagedTask)(); });
+        }
+        m_wakeUp.notify_one();
+        return result;
+    }
+
+private:
+    void Run()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeUp.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+                if (m_stop)
+                    return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task(); // exceptions are captured in the task's future
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    bool m_stop;
+
+    IOThreadPool(const IOThreadPool&) = delete;
+    IOThreadPool& operator=(const IOThreadPool&) = delete;
+};
+
+}}}
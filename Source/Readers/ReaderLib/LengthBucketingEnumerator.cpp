@@ -0,0 +1,135 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "LengthBucketingEnumerator.h"
+#include <algorithm>
+#include <random>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+LengthBucketingEnumerator::LengthBucketingEnumerator(SequenceEnumeratorPtr sequenceProvider, size_t windowInMinibatches)
+    : m_sequenceProvider(sequenceProvider),
+      m_windowInMinibatches(std::max<size_t>(windowInMinibatches, 1)),
+      m_endOfEpoch(false),
+      m_epochIndex(0),
+      m_windowIndex(0)
+{
+    assert(sequenceProvider != nullptr);
+}
+
+void LengthBucketingEnumerator::StartEpoch(const EpochConfiguration& config)
+{
+    m_sequenceProvider->StartEpoch(config);
+    m_buckets.clear();
+    m_endOfEpoch = false;
+    m_epochIndex = config.m_epochIndex;
+    m_windowIndex = 0;
+}
+
+Sequences LengthBucketingEnumerator::GetNextSequences(size_t sampleCount)
+{
+    if (m_buckets.empty() && !m_endOfEpoch)
+    {
+        ReadWindow(sampleCount);
+    }
+
+    Sequences result;
+    if (m_buckets.empty())
+    {
+        result.m_endOfEpoch = m_endOfEpoch;
+        return result;
+    }
+
+    const Bucket& bucket = m_buckets.front();
+    size_t numStreams = bucket.front().size();
+    result.m_data.resize(numStreams, std::vector<SequenceDataPtr>(bucket.size()));
+    for (size_t i = 0; i < bucket.size(); ++i)
+    {
+        for (size_t j = 0; j < numStreams; ++j)
+        {
+            result.m_data[j][i] = bucket[i][j];
+        }
+    }
+
+    m_buckets.pop_front();
+    result.m_endOfEpoch = m_endOfEpoch && m_buckets.empty();
+    return result;
+}
+
+void LengthBucketingEnumerator::ReadWindow(size_t sampleCount)
+{
+    // Reading the window, sequence by sequence.
+    Bucket window;
+    std::vector<size_t> lengths;
+    size_t numMinibatches = 0;
+    while (numMinibatches < m_windowInMinibatches && !m_endOfEpoch)
+    {
+        Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
+        m_endOfEpoch = sequences.m_endOfEpoch;
+        if (sequences.m_data.empty() && m_endOfEpoch)
+        {
+            break;
+        }
+
+        // (an empty minibatch before the end of the epoch is one that the randomizer gave to other workers)
+        numMinibatches++;
+        for (size_t i = 0; !sequences.m_data.empty() && i < sequences.m_data.front().size(); ++i)
+        {
+            std::vector<SequenceDataPtr> sequence(sequences.m_data.size());
+            size_t length = 0;
+            for (size_t j = 0; j < sequences.m_data.size(); ++j)
+            {
+                sequence[j] = sequences.m_data[j][i];
+                length = std::max<size_t>(length, sequence[j]->m_numberOfSamples);
+            }
+
+            window.push_back(std::move(sequence));
+            lengths.push_back(length);
+        }
+    }
+
+    if (window.empty())
+    {
+        return;
+    }
+
+    // Sorting the sequences by decreasing length, and cutting them into minibatches of about the same number
+    // of samples: a sequence goes to the minibatch that its first sample falls into.
+    std::vector<size_t> order(window.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&lengths](size_t a, size_t b) { return lengths[a] > lengths[b]; });
+
+    size_t totalNumberOfSamples = 0;
+    for (size_t length : lengths)
+    {
+        totalNumberOfSamples += length;
+    }
+
+    std::vector<Bucket> buckets(numMinibatches);
+    size_t samplePosition = 0;
+    for (size_t i : order)
+    {
+        size_t bucketIndex = totalNumberOfSamples == 0 ? 0 : samplePosition * numMinibatches / totalNumberOfSamples;
+        buckets[bucketIndex].push_back(std::move(window[i]));
+        samplePosition += lengths[i];
+    }
+
+    // Minibatches that a long sequence spans completely remain empty; they are dropped.
+    buckets.erase(std::remove_if(buckets.begin(), buckets.end(), [](const Bucket& b) { return b.empty(); }), buckets.end());
+
+    std::mt19937 rng(static_cast<unsigned int>(m_epochIndex * 1000003 + m_windowIndex++));
+    std::shuffle(buckets.begin(), buckets.end(), rng);
+    for (auto& b : buckets)
+    {
+        m_buckets.push_back(std::move(b));
+    }
+}
+
+}}}
@@ -0,0 +1,61 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include "SequenceEnumerator.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A sequence enumerator that groups sequences of similar length into the same minibatch, so that
+// the packer needs fewer gap frames to lay them out (see MBLayout::InitAsPackedSequences()).
+// It sits between the randomizer and the packer:
+//     1) reads a window of the next windowInMinibatches minibatches from the randomizer (never beyond the epoch end)
+//     2) sorts the sequences of the window by length
+//     3) cuts the sorted window into as many minibatches of about the same number of samples as were read
+//     4) returns these minibatches in random order
+// Which sequences share a window is decided by the randomizer, so the randomization is kept across windows.
+// Since each worker buckets the sequences it was given by the randomizer, the number and size of the
+// minibatches per worker stay about the same as without bucketing.
+class LengthBucketingEnumerator : public SequenceEnumerator
+{
+public:
+    LengthBucketingEnumerator(SequenceEnumeratorPtr sequenceProvider, size_t windowInMinibatches);
+
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+
+    virtual Sequences GetNextSequences(size_t sampleCount) override;
+
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_sequenceProvider->GetStreamDescriptions();
+    }
+
+private:
+    // The sequences of a minibatch, [sequence index][stream index].
+    typedef std::vector<std::vector<SequenceDataPtr>> Bucket;
+
+    // Reads the next window from the sequence provider and cuts it into m_buckets.
+    void ReadWindow(size_t sampleCount);
+
+    SequenceEnumeratorPtr m_sequenceProvider;
+
+    // Number of minibatches that are bucketed together.
+    size_t m_windowInMinibatches;
+
+    // Minibatches of the current window that have not been returned yet.
+    std::deque<Bucket> m_buckets;
+
+    // Whether the sequence provider has reached the end of the epoch.
+    bool m_endOfEpoch;
+
+    // Index of the current epoch and of the window in it, which seed the order of the minibatches.
+    size_t m_epochIndex;
+    size_t m_windowIndex;
+};
+
+}}}
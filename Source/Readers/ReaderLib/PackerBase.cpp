@@ -17,13 +17,28 @@ using namespace std;
 void PackerBase::StreamBuffer::Resize(size_t newSize)
 {
     m_size = newSize;
-    m_data.reset(reinterpret_cast<char*>(m_memoryProvider->Alloc(1, newSize)),
-        [this](char* p)
+    // the buffer may outlive the packer (it is handed out with the minibatch), so the deleter holds on to the provider
+    auto memoryProvider = m_memoryProvider;
+    m_data.reset(reinterpret_cast<char*>(memoryProvider->Alloc(1, newSize)),
+        [memoryProvider](char* p)
     {
-        m_memoryProvider->Free(p);
+        memoryProvider->Free(p);
     });
 }
 
+void PackerBase::StreamBuffer::SwitchBuffer(size_t requiredSize)
+{
+    swap(m_data, m_otherData);
+    swap(m_size, m_otherSize);
+
+    // The previous minibatch packed into this buffer may still be in use, e.g., by an input matrix
+    // of the network or by a Value returned to the user. Leave it to them, and pack into a new one.
+    if (m_size < requiredSize || (m_data && !m_data.unique()))
+    {
+        Resize(max(requiredSize, m_size));
+    }
+}
+
 void PackerBase::StartEpoch(const EpochConfiguration& config)
 {
     m_minibatchSize = config.m_minibatchSizeInSamples;
@@ -17,6 +17,10 @@ class PackerBase : public Packer
 {
 protected:
 
+    // Minibatches of a stream are packed into two alternating buffers, so that the network's input matrix
+    // can use one in place (see ReaderShim::FillMatrixFromStream()) while the next minibatch is packed into
+    // the other. A buffer that is still referenced outside of the packer belongs to whoever references it:
+    // the packer neither reads nor overwrites it, but packs into a new one instead.
     struct StreamBuffer
     {
         size_t m_size; // buffer size in bytes.
@@ -25,11 +29,18 @@ protected:
         MemoryProviderPtr m_memoryProvider;
         std::shared_ptr<char> m_data; // contiguous array of data.
 
+        std::shared_ptr<char> m_otherData; // the alternate buffer, and its size in bytes.
+        size_t m_otherSize;
+
         StreamBuffer(MemoryProviderPtr m_memoryProvider) :
-            m_size(0), m_memoryProvider(m_memoryProvider), m_data(nullptr)
+            m_size(0), m_memoryProvider(m_memoryProvider), m_data(nullptr), m_otherData(nullptr), m_otherSize(0)
         {
         }
         void Resize(size_t newSize);
+
+        // Switches to the other buffer, to be called before packing a minibatch. Allocates a new one
+        // if it is smaller than 'requiredSize' bytes, or if it is still in use.
+        void SwitchBuffer(size_t requiredSize);
     };
 
     PackerBase(MemoryProviderPtr memoryProvider,
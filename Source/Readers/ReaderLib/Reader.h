@@ -69,6 +69,9 @@ struct StreamMinibatch
     void* m_data;         // Contiguous array of data. Can be encoded in dense or sparse formats depending on the stream description.
                           // The size is (the number of rows * number of columns in the layout) * by the element size of the stream (float/double/etc.).
     MBLayoutPtr m_layout; // Layout of the data
+    std::shared_ptr<char> m_dataOwner; // If set, owns m_data, which is handed over to the consumer: the packer neither reads nor overwrites
+                                       // m_data as long as it is referenced elsewhere, so that a matrix can use it, and write to it,
+                                       // without a copy (see ReaderShim::FillMatrixFromStream()).
 };
 typedef std::shared_ptr<StreamMinibatch> StreamMinibatchPtr;
 
@@ -144,8 +144,9 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     map<wstring, wstring> layoutToInputMap;
     if (!minibatch.m_data.empty())
     {
-        // TODO: Use alternating pinned buffer in the packer, do not copy anything, but pack into the pinned memory.
-        // Copy returned minibatch to the matrices.
+        // Hand the returned minibatch to the matrices. Dense CPU matrices use the packer's buffers in place;
+        // others get a copy.
+        // TODO: Use alternating pinned buffers in the packer for matrices on the GPU.
         for (const auto& mx : matrices)
         {
             if (m_nameToStreamId.find(mx.first) == m_nameToStreamId.end())
@@ -208,8 +209,17 @@ template <class ElemType>
 
     if (type == StorageType::dense)
     {
-        auto data = reinterpret_cast<const ElemType*>(stream->m_data);
-        matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), const_cast<ElemType*>(data), matrixFlagNormal);
+        auto data = reinterpret_cast<ElemType*>(stream->m_data);
+        if (matrix->GetDeviceId() == CPUDEVICE && stream->m_dataOwner)
+        {
+            // Hand the packed minibatch over to the matrix, which may write to it (e.g., to mask gaps).
+            // The packer neither reads nor overwrites it again while the matrix references it.
+            matrix->SetSharedBuffer(numRows, numCols, shared_ptr<ElemType>(stream->m_dataOwner, data));
+        }
+        else
+        {
+            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), data, matrixFlagNormal);
+        }
     }
     else if (type == StorageType::sparse_csc)
     {
@@ -32,10 +32,20 @@ MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
 
     // Creating the minibatch layout.
     MBLayoutPtr pMBLayout = make_shared<MBLayout>();
-    pMBLayout->InitAsPackedSequences(infos, placement, rowAllocations);
+    pMBLayout->InitAsPackedSequences(infos, placement, rowAllocations, m_bestFitPacking);
     return pMBLayout;
 }
 
+void SequencePacker::StartEpoch(const EpochConfiguration& config)
+{
+    PackerBase::StartEpoch(config);
+
+    m_epochPass = (config.m_epochIndex == m_epochIndex) ? m_epochPass + 1 : 1;
+    m_epochIndex = config.m_epochIndex;
+    m_numPackedFrames = 0;
+    m_numGapFrames = 0;
+}
+
 Minibatch SequencePacker::ReadMinibatch()
 {
     auto sequences = m_sequenceEnumerator->GetNextSequences(m_minibatchSize);
@@ -44,6 +54,10 @@ Minibatch SequencePacker::ReadMinibatch()
     Minibatch minibatch(sequences.m_endOfEpoch);
     if (batch.empty())
     {
+        if (sequences.m_endOfEpoch)
+        {
+            ReportEpochStatistics();
+        }
         return minibatch;
     }
 
@@ -60,13 +74,41 @@ Minibatch SequencePacker::ReadMinibatch()
 
         auto streamMinibatch = std::make_shared<StreamMinibatch>();
         streamMinibatch->m_data = buffer.m_data.get();
+        streamMinibatch->m_dataOwner = buffer.m_data;
         streamMinibatch->m_layout = pMBLayout;
         minibatch.m_data.push_back(streamMinibatch);
+
+        m_numPackedFrames += pMBLayout->GetNumCols();
+        m_numGapFrames += pMBLayout->GetNumCols() - pMBLayout->GetActualNumSamples();
+    }
+
+    if (sequences.m_endOfEpoch)
+    {
+        ReportEpochStatistics();
     }
 
     return minibatch;
 }
 
+void SequencePacker::ReportEpochStatistics()
+{
+    if (!m_reportPadding || m_numPackedFrames == 0)
+    {
+        return;
+    }
+
+    // Epochs are numbered from 1, as in the SGD progress output.
+    std::string pass = m_epochPass > 1 ? ", pass " + std::to_string(m_epochPass) : std::string();
+    fprintf(stderr, "SequencePacker: epoch %" PRIu64 "%s: %.2f%% of the packed frames are padding (%" PRIu64 " gap frames out of %" PRIu64 ")%s\n",
+            m_epochIndex + 1,
+            pass.c_str(),
+            100.0 * m_numGapFrames / m_numPackedFrames,
+            m_numGapFrames,
+            m_numPackedFrames,
+            m_bestFitPacking ? ", packed best-fit" : "");
+    m_numPackedFrames = 0; // (reported once)
+}
+
 MBLayoutPtr SequencePacker::PackDenseStream(const StreamBatch& batch, size_t streamIndex)
 {
     assert(m_outputStreamDescriptions[streamIndex]->m_storageType == StorageType::dense);
@@ -75,10 +117,7 @@ MBLayoutPtr SequencePacker::PackDenseStream(const StreamBatch& batch, size_t str
     size_t sampleSize = GetSampleSize(stream);
     auto pMBLayout = CreateMBLayout(batch);
     size_t requiredSize = pMBLayout->GetNumCols() * sampleSize;
-    if (buffer.m_size < requiredSize)
-    {
-        buffer.Resize(requiredSize);
-    }
+    buffer.SwitchBuffer(requiredSize);
 
     auto elementSize = GetSizeByType(stream->m_elementType);
 
@@ -172,10 +211,7 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
         indexSize * (pMBLayout->GetNumCols() + 1);
 
     auto& buffer = m_streamBuffers[streamIndex];
-    if (buffer.m_size < requiredSize)
-    {
-        buffer.Resize(requiredSize);
-    }
+    buffer.SwitchBuffer(requiredSize);
 
     auto* destination = buffer.m_data.get();
     // insert the nnzCount as the first element in the buffer.
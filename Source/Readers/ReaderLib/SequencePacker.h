@@ -11,18 +11,32 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This packer generates minibatches containing full sequences packed for 
 // efficient (concurrent) consumption on a GPU.
+// The share of gap frames in the packed minibatches is reported at the end of each epoch.
 class SequencePacker : public PackerBase
 {
 public:
+    // bestFitPacking: lay out the sequences of a minibatch best-fit decreasing instead of first-fit
+    // (see MBLayout::InitAsPackedSequences()), usually together with a LengthBucketingEnumerator.
+    // reportPadding: print how much of each epoch is padding, usually with bestFitPacking or a verbosity above 0.
     SequencePacker(
         MemoryProviderPtr memoryProvider,
         SequenceEnumeratorPtr sequenceEnumerator,
-        const std::vector<StreamDescriptionPtr>& streams) :
-        PackerBase(memoryProvider, sequenceEnumerator, streams)
+        const std::vector<StreamDescriptionPtr>& streams,
+        bool bestFitPacking = false,
+        bool reportPadding = false) :
+        PackerBase(memoryProvider, sequenceEnumerator, streams),
+        m_reportPadding(reportPadding),
+        m_bestFitPacking(bestFitPacking),
+        m_epochIndex(SIZE_MAX),
+        m_epochPass(0),
+        m_numPackedFrames(0),
+        m_numGapFrames(0)
     {
 
     }
 
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+
     virtual Minibatch ReadMinibatch() override;
 
 protected:
@@ -33,6 +47,20 @@ protected:
     // Given a number of sequences, creates an MB layout that is used to guide
     // the actual packing.
     virtual MBLayoutPtr CreateMBLayout(const StreamBatch& batch);
+
+private:
+    // Prints the padding statistics of the current epoch.
+    void ReportEpochStatistics();
+
+    bool m_reportPadding;
+    bool m_bestFitPacking;
+
+    // Per epoch statistics: frames (columns) of all packed streams, and how many of them are gaps.
+    // An epoch may be read more than once (e.g., by the precompute pass before the first epoch), each is a pass.
+    size_t m_epochIndex;
+    size_t m_epochPass;
+    size_t m_numPackedFrames;
+    size_t m_numGapFrames;
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
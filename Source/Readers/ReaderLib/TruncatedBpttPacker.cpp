@@ -159,12 +159,9 @@ void TruncatedBPTTPacker::StartEpoch(const EpochConfiguration& config)
 
         m_sequenceBufferPerStream.clear();
 
-        // Preparing the buffers.
+        // Preparing the sequence buffers (the stream buffers are sized in ReadMinibatch()).
         for (int i = 0; i < m_outputStreamDescriptions.size(); ++i)
         {
-            const auto& stream = m_outputStreamDescriptions[i];
-            auto& buffer = m_streamBuffers[i];
-            buffer.Resize(m_numParallelSequences * m_truncationSize * GetSampleSize(stream));
             m_sequenceBufferPerStream.push_back(make_shared<SequenceBuffer>(m_numParallelSequences));
         }
     }
@@ -191,6 +188,9 @@ Minibatch TruncatedBPTTPacker::ReadMinibatch()
     // Iterating over the streams/slots and packing them into the minibatch.
     for (size_t streamIndex = 0; streamIndex < m_outputStreamDescriptions.size(); ++streamIndex)
     {
+        auto& buffer = m_streamBuffers[streamIndex];
+        buffer.SwitchBuffer(m_numParallelSequences * m_truncationSize * GetSampleSize(m_outputStreamDescriptions[streamIndex]));
+
         m_currentLayouts[streamIndex]->Init(m_numParallelSequences, m_truncationSize);
         size_t sequenceId = 0;
         for (size_t slotIndex = 0; slotIndex < m_numParallelSequences; ++slotIndex)
@@ -199,7 +199,8 @@ Minibatch TruncatedBPTTPacker::ReadMinibatch()
         }
 
         StreamMinibatchPtr m = make_shared<StreamMinibatch>();
-        m->m_data = m_streamBuffers[streamIndex].m_data.get();
+        m->m_data = buffer.m_data.get();
+        m->m_dataOwner = buffer.m_data;
         m->m_layout = m_currentLayouts[streamIndex];
         result.m_data.push_back(m);
     }
@@ -0,0 +1,87 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "Basics.h"
+#include "File.h"
+#include "fileutil.h"
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// AsyncCheckPointWriter -- writes model and checkpoint files in the background
+//
+// The caller serializes the files into memory (File::CreateInMemory()), which only takes as long as
+// copying the model to the host, and hands them over with WriteAsync(). A background thread then writes
+// each one to '<path>.tmp', syncs it to disk, and renames it to '<path>', so that readers never see a
+// half-written file, also if the process dies in the middle. The files are written in the given order,
+// and the obsolete files are only deleted after all of them have been written.
+//
+// Only one write is in flight at a time; WriteAsync() first waits for the previous one. Call Wait()
+// before reading or deleting any of the files, and before the end of training. Errors of the background
+// write are rethrown by the next WriteAsync() or Wait().
+// -----------------------------------------------------------------------
+
+class AsyncCheckPointWriter
+{
+public:
+    typedef std::vector<std::pair<std::wstring, std::unique_ptr<File>>> FileList; // (path, serialized content)
+
+    ~AsyncCheckPointWriter()
+    {
+        // no exceptions from the destructor; we may be unwinding already
+        try
+        {
+            Wait();
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "AsyncCheckPointWriter: Writing the checkpoint failed: %s\n", e.what());
+        }
+    }
+
+    void WriteAsync(FileList&& files, std::vector<std::wstring>&& filesToDelete)
+    {
+        Wait();
+        // (std::function needs a copyable functor, hence the shared_ptrs)
+        auto filesPtr = std::make_shared<FileList>(std::move(files));
+        auto filesToDeletePtr = std::make_shared<std::vector<std::wstring>>(std::move(filesToDelete));
+        m_pending = std::async(std::launch::async, [filesPtr, filesToDeletePtr]()
+        {
+            for (auto& file : *filesPtr)
+                WriteDurably(*file.second, file.first);
+            for (const auto& path : *filesToDeletePtr)
+                _wunlink(path.c_str());
+        });
+    }
+
+    // block until the pending write (if any) is complete
+    void Wait()
+    {
+        if (m_pending.valid())
+            m_pending.get(); // (rethrows the exception, if any)
+    }
+
+private:
+    static void WriteDurably(File& content, const std::wstring& path)
+    {
+        std::wstring tempPath = path + L".tmp";
+        msra::files::make_intermediate_dirs(path);
+        FILE* f = fopenOrDie(tempPath, L"wb");
+        content.CopyTo(f);
+        fflushOrDie(f);
+        fsyncOrDie(f);
+        fcloseOrDie(f);
+        renameOrDie(tempPath, path);
+    }
+
+    std::future<void> m_pending;
+};
+
+}}}
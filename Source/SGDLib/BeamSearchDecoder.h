@@ -0,0 +1,331 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BeamSearchDecoder.h -- beam search over a recurrent decoder network
+//
+// The decoder is the subgraph that computes the unnormalized scores of the next token from the previous token
+// and from per-sequence context inputs (e.g. the final encoder state). All hypotheses of all input sequences are
+// advanced together, as one minibatch with one time step per hypothesis. The recurrent state (PastValue, RNNStack)
+// is carried over from step to step, and reordered to follow the surviving hypotheses, so that no prefix is ever
+// recomputed.
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "ComputationNode.h"
+#include "Sequences.h"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct BeamSearchOptions
+{
+    size_t beamSize = 5;             // number of hypotheses kept per input sequence
+    double lengthNormalization = 0;  // hypotheses are ranked by logP / length^lengthNormalization
+    size_t startSymbol = 0;          // token fed in the first step
+    size_t endSymbol = 0;            // token that finishes a hypothesis
+    size_t maxLength = 100;          // hypotheses are finished after this many tokens (including the end symbol)
+};
+
+struct BeamSearchResult
+{
+    std::vector<size_t> tokens; // excluding the start symbol, including the end symbol if it was produced
+    double logProbability;
+    double score;               // logProbability after length normalization
+};
+
+template <class ElemType>
+class BeamSearchDecoder
+{
+public:
+    // 'scoreNode' computes [V] unnormalized token scores from 'tokenNode' (the previous token, one-hot [V]) and
+    // 'contextNodes' (one vector per input sequence, constant over the decoding steps). These must be all the inputs
+    // that 'scoreNode' depends on, and they must share one dynamic axis that is used for nothing else.
+    BeamSearchDecoder(ComputationNetworkPtr net, const ComputationNodeBasePtr& scoreNode, const ComputationNodeBasePtr& tokenNode,
+                      const std::vector<ComputationNodeBasePtr>& contextNodes, const BeamSearchOptions& options)
+        : m_net(net), m_scoreNode(scoreNode), m_tokenNode(tokenNode), m_contextNodes(contextNodes), m_options(options)
+    {
+        const size_t vocabSize = m_tokenNode->GetSampleLayout().GetNumElements();
+        if (m_scoreNode->GetSampleLayout().GetNumElements() != vocabSize)
+            InvalidArgument("BeamSearchDecoder: The score node '%ls' must have the dimension of the token input '%ls' (%d).",
+                            m_scoreNode->NodeName().c_str(), m_tokenNode->NodeName().c_str(), (int) vocabSize);
+        if (m_options.startSymbol >= vocabSize || m_options.endSymbol >= vocabSize)
+            InvalidArgument("BeamSearchDecoder: Start and end symbols must be less than the vocabulary size %d.", (int) vocabSize);
+        if (m_options.beamSize == 0 || m_options.maxLength == 0)
+            InvalidArgument("BeamSearchDecoder: Beam size and maximum length must be positive.");
+        if (m_options.lengthNormalization < 0)
+            InvalidArgument("BeamSearchDecoder: Length normalization must not be negative.");
+
+        m_inputNodes = m_contextNodes;
+        m_inputNodes.push_back(m_tokenNode);
+        for (const auto& node : ComputationNodeBase::EnumerateNodes({ m_scoreNode }))
+        {
+            if (node->IsLeaf() && node->HasMBLayout() && find(m_inputNodes.begin(), m_inputNodes.end(), node) == m_inputNodes.end())
+                InvalidArgument("BeamSearchDecoder: The score node '%ls' depends on input '%ls', which is neither the token nor a context input.",
+                                m_scoreNode->NodeName().c_str(), node->NodeName().c_str());
+            auto reorderableNode = dynamic_pointer_cast<IReorderableStateNode>(node);
+            if (reorderableNode)
+                m_stateNodes.push_back(reorderableNode);
+            else if (dynamic_pointer_cast<IStatefulNode>(node))
+                InvalidArgument("BeamSearchDecoder: Node '%ls' carries state that cannot follow the hypotheses.", node->NodeName().c_str());
+        }
+        for (const auto& node : m_inputNodes)
+            if (node->GetMBLayout() != m_tokenNode->GetMBLayout())
+                InvalidArgument("BeamSearchDecoder: Input '%ls' must have the dynamic axis of the token input '%ls'.",
+                                node->NodeName().c_str(), m_tokenNode->NodeName().c_str());
+    }
+
+    // 'contexts' holds one [dim x numSequences] matrix per context node.
+    // Returns the finished hypotheses of each input sequence, best first, at most beamSize of them.
+    std::vector<std::vector<BeamSearchResult>> Decode(const std::vector<std::shared_ptr<Matrix<ElemType>>>& contexts, size_t numSequences)
+    {
+        if (contexts.size() != m_contextNodes.size())
+            InvalidArgument("BeamSearchDecoder: Expected %d context values, got %d.", (int) m_contextNodes.size(), (int) contexts.size());
+        for (size_t i = 0; i < contexts.size(); i++)
+            if (contexts[i]->GetNumRows() != m_contextNodes[i]->GetSampleLayout().GetNumElements() || contexts[i]->GetNumCols() != numSequences)
+                InvalidArgument("BeamSearchDecoder: Context value for '%ls' must be [%d x %d].",
+                                m_contextNodes[i]->NodeName().c_str(), (int) m_contextNodes[i]->GetSampleLayout().GetNumElements(), (int) numSequences);
+
+        ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+
+        const size_t vocabSize = m_tokenNode->GetSampleLayout().GetNumElements();
+        const double maxLengthFactor = LengthFactor(m_options.maxLength);
+
+        // each step, hypothesis (slot) s of the minibatch continues the token history m_history[active[s].history]
+        std::vector<HistoryEntry> history;
+        std::vector<Hypothesis> active;
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            history.push_back(HistoryEntry{ m_options.startSymbol, SIZE_MAX });
+            active.push_back(Hypothesis{ i, history.size() - 1, 0.0, 0 });
+        }
+        std::vector<std::vector<Hypothesis>> finished(numSequences);
+
+        auto& layout = m_tokenNode->GetMBLayout();
+        std::vector<ElemType> scores;
+        std::vector<double> logProbs;
+        for (size_t step = 0; !active.empty(); step++)
+        {
+            const size_t numSlots = active.size();
+
+            // one time step per hypothesis, continuing its sequence from the previous step
+            layout->Init(numSlots, 1);
+            for (size_t s = 0; s < numSlots; s++)
+                layout->AddSequence(NEW_SEQUENCE_ID, s, -(ptrdiff_t) step, 2);
+            SetTokens(active, history, vocabSize);
+            SetContexts(active, contexts);
+            ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+            m_net->ForwardProp(m_scoreNode);
+
+            // log softmax of the scores, in double precision
+            auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(m_scoreNode)->Value();
+            scores.resize(vocabSize * numSlots);
+            value.CopySection(vocabSize, numSlots, scores.data(), vocabSize);
+            logProbs.resize(vocabSize * numSlots);
+            for (size_t s = 0; s < numSlots; s++)
+            {
+                const ElemType* z = scores.data() + s * vocabSize;
+                double maxZ = *std::max_element(z, z + vocabSize);
+                double sum = 0;
+                for (size_t k = 0; k < vocabSize; k++)
+                    sum += exp(z[k] - maxZ);
+                const double logSum = maxZ + log(sum);
+                for (size_t k = 0; k < vocabSize; k++)
+                    logProbs[s * vocabSize + k] = active[s].logProbability + z[k] - logSum;
+            }
+
+            // the best 'beamSize' expansions of each input sequence survive; slots of one input are adjacent
+            std::vector<Hypothesis> nextActive;
+            std::vector<size_t> fromSlots;
+            for (size_t begin = 0, end; begin < numSlots; begin = end)
+            {
+                const size_t sequence = active[begin].sequence;
+                for (end = begin + 1; end < numSlots && active[end].sequence == sequence;)
+                    end++;
+
+                // candidates are (slot, token) pairs, encoded as slot * vocabSize + token
+                std::vector<size_t> candidates;
+                for (size_t s = begin; s < end; s++)
+                {
+                    std::vector<size_t> tokens(vocabSize);
+                    for (size_t k = 0; k < vocabSize; k++)
+                        tokens[k] = s * vocabSize + k;
+                    const size_t n = std::min(m_options.beamSize, vocabSize);
+                    std::partial_sort(tokens.begin(), tokens.begin() + n, tokens.end(), [&](size_t a, size_t b) { return logProbs[a] > logProbs[b]; });
+                    candidates.insert(candidates.end(), tokens.begin(), tokens.begin() + n);
+                }
+                const size_t n = std::min(m_options.beamSize, candidates.size());
+                std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(), [&](size_t a, size_t b) { return logProbs[a] > logProbs[b]; });
+
+                auto& sequenceFinished = finished[sequence];
+                const size_t firstNext = nextActive.size();
+                for (size_t c = 0; c < n; c++)
+                {
+                    const size_t slot = candidates[c] / vocabSize;
+                    const size_t token = candidates[c] % vocabSize;
+                    history.push_back(HistoryEntry{ token, active[slot].history });
+                    Hypothesis hypothesis{ sequence, history.size() - 1, logProbs[candidates[c]], active[slot].length + 1 };
+                    if (token == m_options.endSymbol || hypothesis.length >= m_options.maxLength)
+                        sequenceFinished.push_back(hypothesis);
+                    else
+                    {
+                        nextActive.push_back(hypothesis);
+                        fromSlots.push_back(slot);
+                    }
+                }
+
+                // stop early once enough hypotheses are finished, or none of the active ones can beat the best finished one
+                if (!sequenceFinished.empty())
+                {
+                    double bestScore = -std::numeric_limits<double>::infinity();
+                    for (const auto& hypothesis : sequenceFinished)
+                        bestScore = std::max(bestScore, Score(hypothesis));
+                    size_t kept = firstNext;
+                    for (size_t i = firstNext; i < nextActive.size(); i++)
+                    {
+                        // logP only decreases, so logP / maxLength^alpha bounds the score of every continuation
+                        if (sequenceFinished.size() < m_options.beamSize && nextActive[i].logProbability / maxLengthFactor > bestScore)
+                        {
+                            nextActive[kept] = nextActive[i];
+                            fromSlots[kept] = fromSlots[i];
+                            kept++;
+                        }
+                    }
+                    nextActive.resize(kept);
+                    fromSlots.resize(kept);
+                }
+            }
+
+            active.swap(nextActive);
+            if (!active.empty())
+                for (const auto& node : m_stateNodes)
+                    node->ReorderState(fromSlots);
+        }
+
+        std::vector<std::vector<BeamSearchResult>> results(numSequences);
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            auto& sequenceFinished = finished[i];
+            std::stable_sort(sequenceFinished.begin(), sequenceFinished.end(), [&](const Hypothesis& a, const Hypothesis& b) { return Score(a) > Score(b); });
+            if (sequenceFinished.size() > m_options.beamSize)
+                sequenceFinished.resize(m_options.beamSize);
+            for (const auto& hypothesis : sequenceFinished)
+            {
+                BeamSearchResult result;
+                for (size_t h = hypothesis.history; history[h].parent != SIZE_MAX; h = history[h].parent)
+                    result.tokens.push_back(history[h].token);
+                std::reverse(result.tokens.begin(), result.tokens.end());
+                result.logProbability = hypothesis.logProbability;
+                result.score = Score(hypothesis);
+                results[i].push_back(std::move(result));
+            }
+        }
+        return results;
+    }
+
+    // Returns the last frame of each sequence in 'value' as one column per sequence, ordered by sequence id,
+    // e.g. to turn the output of an encoder into context values. The sequences must end within the minibatch.
+    static std::shared_ptr<Matrix<ElemType>> LastFrameOfEachSequence(const Matrix<ElemType>& value, const MBLayoutPtr& layout)
+    {
+        std::vector<MBLayout::SequenceInfo> sequences;
+        for (const auto& sequence : layout->GetAllSequences())
+        {
+            if (sequence.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (sequence.tEnd > layout->GetNumTimeSteps())
+                InvalidArgument("BeamSearchDecoder: Sequences must end within the minibatch.");
+            sequences.push_back(sequence);
+        }
+        std::stable_sort(sequences.begin(), sequences.end(), [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b) { return a.seqId < b.seqId; });
+
+        std::vector<ElemType> columnIndices;
+        for (const auto& sequence : sequences)
+            columnIndices.push_back((ElemType) layout->GetColumnIndex(sequence, sequence.GetNumTimeSteps() - 1));
+        Matrix<ElemType> indexMatrix(1, columnIndices.size(), columnIndices.data(), CPUDEVICE);
+        indexMatrix.TransferToDeviceIfNotThere(value.GetDeviceId(), true);
+        auto frames = std::make_shared<Matrix<ElemType>>(value.GetNumRows(), sequences.size(), value.GetDeviceId());
+        frames->DoGatherColumnsOf(0, indexMatrix, value, 1);
+        return frames;
+    }
+
+private:
+    struct HistoryEntry
+    {
+        size_t token;
+        size_t parent; // index into the history, SIZE_MAX for the start symbol
+    };
+
+    struct Hypothesis
+    {
+        size_t sequence;       // input sequence
+        size_t history;        // last token
+        double logProbability;
+        size_t length;         // number of tokens after the start symbol
+    };
+
+    double LengthFactor(size_t length) const
+    {
+        return m_options.lengthNormalization == 0 ? 1.0 : pow((double) length, m_options.lengthNormalization);
+    }
+
+    double Score(const Hypothesis& hypothesis) const
+    {
+        return hypothesis.logProbability / LengthFactor(hypothesis.length);
+    }
+
+    // feed the last token of each hypothesis as a one-hot vector
+    void SetTokens(const std::vector<Hypothesis>& active, const std::vector<HistoryEntry>& history, size_t vocabSize)
+    {
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(m_tokenNode)->Value();
+        const size_t numSlots = active.size();
+        if (value.GetMatrixType() == SPARSE)
+        {
+            std::vector<CPUSPARSE_INDEX_TYPE> colStarts(numSlots + 1), rows(numSlots);
+            std::vector<ElemType> ones(numSlots, 1);
+            for (size_t s = 0; s < numSlots; s++)
+            {
+                colStarts[s] = (CPUSPARSE_INDEX_TYPE) s;
+                rows[s] = (CPUSPARSE_INDEX_TYPE) history[active[s].history].token;
+            }
+            colStarts[numSlots] = (CPUSPARSE_INDEX_TYPE) numSlots;
+            value.SetMatrixFromCSCFormat(colStarts.data(), rows.data(), ones.data(), numSlots, vocabSize, numSlots);
+        }
+        else
+        {
+            std::vector<ElemType> oneHot(vocabSize * numSlots, 0);
+            for (size_t s = 0; s < numSlots; s++)
+                oneHot[s * vocabSize + history[active[s].history].token] = 1;
+            value.SetValue(vocabSize, numSlots, value.GetDeviceId(), oneHot.data());
+        }
+    }
+
+    // each hypothesis sees the context of its input sequence
+    void SetContexts(const std::vector<Hypothesis>& active, const std::vector<std::shared_ptr<Matrix<ElemType>>>& contexts)
+    {
+        std::vector<ElemType> sequenceIndices;
+        for (const auto& hypothesis : active)
+            sequenceIndices.push_back((ElemType) hypothesis.sequence);
+        for (size_t i = 0; i < contexts.size(); i++)
+        {
+            auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(m_contextNodes[i])->Value();
+            Matrix<ElemType> indexMatrix(1, sequenceIndices.size(), sequenceIndices.data(), value.GetDeviceId());
+            value.DoGatherColumnsOf(0, indexMatrix, *contexts[i], 1);
+        }
+    }
+
+    ComputationNetworkPtr m_net;
+    ComputationNodeBasePtr m_scoreNode;
+    ComputationNodeBasePtr m_tokenNode;
+    std::vector<ComputationNodeBasePtr> m_contextNodes;
+    std::vector<ComputationNodeBasePtr> m_inputNodes; // contexts and token
+    std::vector<std::shared_ptr<IReorderableStateNode>> m_stateNodes;
+    BeamSearchOptions m_options;
+};
+
+}}}
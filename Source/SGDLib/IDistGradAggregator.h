@@ -21,6 +21,18 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) = 0;
 
+    // Aggregators that can overlap communication with backprop return true here. The training loop then calls
+    // OnGradientComplete() during backprop for each gradient matrix (of those passed to AggregateGradients())
+    // as soon as it is final, and AggregateGradients() only completes what has not been started yet.
+    virtual bool SupportsGradientCompletionCallbacks() const
+    {
+        return false;
+    }
+
+    virtual void OnGradientComplete(Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "MatrixQuantizerImpl.h"
+#include "TimerUtility.h"
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// QuantizedDistGradAggregator -- data-parallel gradient aggregation of quantized gradients on the CPU
+//
+// Each worker quantizes its gradients column by column to 1, 2, 4 or 8 bits per value, after adding the
+// quantization error that it left over from the previous minibatch (error feedback; the error is kept in a
+// residual matrix per gradient). The quantized gradients of all workers are exchanged with one allgather
+// per gradient, and every worker unquantizes and sums them up in rank order, so that all workers end up
+// with the same aggregate. This sends about 32/numGradientBits times fewer bytes than the float allreduce
+// of SimpleDistGradAggregator, which pays off where aggregation is bandwidth-bound.
+//
+// This does not need the 1-bit SGD submodule, but is limited to gradients on the CPU. The total received
+// per worker grows with the number of workers, so it is meant for a moderate number of workers.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class QuantizedDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    QuantizedDistGradAggregator(const MPIWrapperPtr& mpi, size_t numGradientBits, bool zeroThresholdFor1Bit, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_numGradientBits(numGradientBits), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_currentEpochNumber(-1)
+    {
+        if (!IsSupportedNumGradientBits(numGradientBits))
+            InvalidArgument("QuantizedDistGradAggregator: Gradients can only be quantized to 1, 2, 4 or 8 bits, not %d.", (int) numGradientBits);
+    }
+
+    static bool IsSupportedNumGradientBits(size_t numGradientBits)
+    {
+        return (numGradientBits == 1) || (numGradientBits == 2) || (numGradientBits == 4) || (numGradientBits == 8);
+    }
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) override
+    {
+        if (epochNumber != m_currentEpochNumber)
+            ResetState(gradients, headerCPU->numEvalNode);
+        m_currentEpochNumber = epochNumber;
+
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        if (headerCPU->numSamples == 0)
+        {
+            headerCPU->criterion = 0.0;
+            for (int i = 0; i < headerCPU->numEvalNode; ++i)
+                headerCPU->evalErrors[i] = { 0.0, 0 };
+
+            // If the current node did not process any samples, the gradients should be zero'd
+            for (size_t i = 0; i < gradients.size(); ++i)
+                gradients[i]->SetValue(0);
+        }
+
+        // exchange the headers while the gradients are being quantized
+        size_t headerSize = headerCPU->Size();
+        memcpy(m_allHeaders.data() + MyRank() * headerSize, headerCPU, headerSize);
+        MPI_Request headerRequest;
+        MPI_Iallgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, m_allHeaders.data(), (int) headerSize, MPI_CHAR, m_mpi->Communicator(), &headerRequest) || MpiFail("MPI_Iallgather");
+
+        // quantize each gradient into this worker's slice of its exchange buffer, and start exchanging it right away
+        std::vector<MPI_Request> gradientRequests(gradients.size());
+        size_t numBytesPerWorker = 0;
+        for (size_t i = 0; i < gradients.size(); ++i)
+        {
+            if ((gradients[i]->GetNumRows() != m_residuals[i]->GetNumRows()) || (gradients[i]->GetNumCols() != m_residuals[i]->GetNumCols()))
+                LogicError("QuantizedDistGradAggregator: Gradient matrix dimensions changed since the aggregation buffers were set up.");
+
+            QuantizedMatrix<ElemType>& ownSlice = *m_workerSlices[i][MyRank()];
+            m_quantizer->QuantizeAsync(*gradients[i], *m_residuals[i], ownSlice, *m_residuals[i], m_zeroThresholdFor1Bit);
+            m_quantizer->WaitQuantizeAsyncDone();
+
+            MPI_Iallgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, m_exchangeBuffers[i]->Buffer(), (int) ownSlice.GetSize(), MPI_CHAR, m_mpi->Communicator(), &gradientRequests[i]) || MpiFail("MPI_Iallgather");
+            numBytesPerWorker += ownSlice.GetSize();
+        }
+
+        // sum up the unquantized gradients of all workers, in the same order on every worker
+        for (size_t i = 0; i < gradients.size(); ++i)
+        {
+            MPI_Wait(&gradientRequests[i], MPI_STATUS_IGNORE) || MpiFail("MPI_Wait");
+            for (size_t rank = 0; rank < NumProc(); ++rank)
+            {
+                m_quantizer->UnquantizeAsync(*m_workerSlices[i][rank], *gradients[i], /*add=*/rank > 0);
+                m_quantizer->WaitUnquantizeAsyncDone();
+            }
+        }
+
+        MPI_Wait(&headerRequest, MPI_STATUS_IGNORE) || MpiFail("MPI_Wait");
+        for (size_t rank = 0; rank < NumProc(); ++rank)
+            headerCPU->Aggregate((DistGradHeader*) (m_allHeaders.data() + rank * headerSize), /*add=*/rank > 0);
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Quantized gradient aggregation time: %.6g, %.1f KB per worker at %d bits\n",
+                    aggregationTimer.ElapsedSeconds(), numBytesPerWorker / 1024.0, (int) m_numGradientBits);
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    // set up the buffers on first use, and clear the residuals at the start of each epoch (since SGD may have reloaded the model)
+    void ResetState(const std::vector<Matrix<ElemType>*>& gradients, int numEvalNode)
+    {
+        if (m_currentEpochNumber != -1)
+        {
+            for (auto& residual : m_residuals)
+                residual->SetValue(0);
+            return;
+        }
+
+        m_quantizer.reset(MatrixQuantizerImpl<ElemType>::Create(CPUDEVICE, /*useAsync=*/false));
+        for (size_t i = 0; i < gradients.size(); ++i)
+        {
+            if (gradients[i]->GetMatrixType() != DENSE)
+                RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+            if (gradients[i]->GetDeviceId() != CPUDEVICE)
+                RuntimeError("QuantizedDistGradAggregator: Quantized gradient aggregation on the GPU requires the 1-bit SGD submodule.");
+
+            size_t numRows = gradients[i]->GetNumRows();
+            size_t numCols = gradients[i]->GetNumCols();
+            m_residuals.push_back(std::unique_ptr<Matrix<ElemType>>(new Matrix<ElemType>(numRows, numCols, CPUDEVICE)));
+            m_residuals.back()->SetValue(0);
+
+            // the quantized gradients of all workers side by side, in column slices of numCols columns
+            m_exchangeBuffers.push_back(std::unique_ptr<QuantizedMatrix<ElemType>>(new QuantizedMatrix<ElemType>(numRows, numCols * NumProc(), m_numGradientBits, CPUDEVICE)));
+            m_workerSlices.push_back(std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>>());
+            for (size_t rank = 0; rank < NumProc(); ++rank)
+                m_workerSlices.back().push_back(std::unique_ptr<QuantizedMatrix<ElemType>>(new QuantizedMatrix<ElemType>(m_exchangeBuffers.back()->ColumnSlice(rank * numCols, numCols))));
+        }
+
+        DistGradHeader* header = DistGradHeader::Create(numEvalNode);
+        m_allHeaders.resize(header->Size() * NumProc());
+        DistGradHeader::Destroy(header);
+    }
+
+private:
+    size_t m_numGradientBits;
+    bool m_zeroThresholdFor1Bit;
+
+    std::unique_ptr<MatrixQuantizerImpl<ElemType>> m_quantizer;
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_residuals;                             // [gradient index] quantization error carried over to the next minibatch
+    std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>> m_exchangeBuffers;              // [gradient index] quantized gradients of all workers
+    std::vector<std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>>> m_workerSlices;    // [gradient index][rank] views into m_exchangeBuffers
+    std::vector<char> m_allHeaders;                                                         // DistGradHeaders of all workers
+
+    int m_syncStatsTrace;
+
+    // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
+    size_t m_iterationCount;
+
+    int m_currentEpochNumber;
+};
+} } }
@@ -5,7 +5,7 @@
 #include "Basics.h"
 #include "SGD.h"
 #include "NonlinearityNodes.h"          // for DropoutNode
-#include "SpecialPurposeNodes.h"        // for SequenceWithSoftmaxNode
+#include "SpecialPurposeNodes.h"        // for SequenceWithSoftmaxNode, FusedElementwiseNode
 #include "DataReaderHelpers.h"
 #include "MatrixQuantizerImpl.h"
 
@@ -17,6 +17,7 @@
 #endif
 
 #include "SimpleDistGradAggregator.h"
+#include "QuantizedDistGradAggregator.h"
 #include "ProgressTracing.h"
 
 #include <map>
@@ -165,6 +166,16 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         InvalidArgument("TrainOrAdaptModel: No criterion node was specified.");
     }
 
+    // The FusedElementwise nodes written by the 'optimize' action (with fuseElementwise=true) cannot be differentiated.
+    for (const auto& node : criterionNodes)
+    {
+        auto fusedNodes = net->GetNodesWithType(OperationNameOf(FusedElementwiseNode), node);
+        if (!fusedNodes.empty())
+            InvalidArgument("TrainOrAdaptModel: The criterion node '%ls' depends on the %ls node '%ls'. "
+                            "Models optimized with fuseElementwise=true are for inference only and cannot be trained. Please train the original model.",
+                            node->NodeName().c_str(), fusedNodes.front()->OperationName().c_str(), fusedNodes.front()->NodeName().c_str());
+    }
+
     // determine evaluationNodes from GetEvalCriterionNodes(), ensuring each criterion is only logged once
     std::vector<ComputationNodeBasePtr> evaluationNodes;
     {
@@ -196,7 +207,10 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     auto preComputeNodesList = net->GetNodesRequiringPreComputation();
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
-    // allocate memory for forward and backward computation
+    // allocate memory for forward and backward computation, planned for the first epoch's minibatch size
+    net->SetMemoryPlanHint(m_mbSize[0], m_traceLevel);
+    if (m_gradientCheckpointing || !m_gradientCheckpointNodes.empty())
+        net->SetGradientCheckpointing(true, m_gradientCheckpointNodes);
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]);
 
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
@@ -245,6 +259,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         refNet->CompileNetwork();
 
         // allocate memory for forward computation
+        refNet->SetMemoryPlanHint(m_mbSize[0], m_traceLevel);
         refNet->AllocateAllMatrices({refNode}, {}, nullptr);
     }
 
@@ -351,6 +366,14 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                                   m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR);
     }
 
+    // Writing the checkpoints in the background is only safe if they are not read back during training.
+    bool modelsReloadedDuringTraining = m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch ||
+                                        (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch && m_loadBestModel) ||
+                                        m_autoAdjustMinibatch;
+    bool asyncCheckPointSaving = m_asyncCheckPointSaving && !modelsReloadedDuringTraining;
+    if (m_asyncCheckPointSaving && !asyncCheckPointSaving)
+        LOGPRINTF(stderr, "SGD: Not saving checkpoints in the background, since the automatic learning-rate or minibatch-size control reloads them.\n");
+
     // --- MAIN EPOCH LOOP
     for (int i = startEpoch; i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
     {
@@ -669,10 +692,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             }
             else
             {
-                SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
-                auto modelName = GetModelNameForEpoch(i);
-                LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                vector<wstring> filesToDelete;
                 if (!m_keepCheckPointFiles)
                 {
                     // delete previous checkpoint file to save space
@@ -680,18 +700,39 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     {
                         if (epochsSinceLastLearnRateAdjust != 1)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                            filesToDelete.push_back(GetCheckPointFileNameForEpoch(i - 1));
                         }
                         if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
+                            filesToDelete.push_back(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval));
                         }
                     }
                     else
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                        filesToDelete.push_back(GetCheckPointFileNameForEpoch(i - 1));
                     }
                 }
+
+                auto modelName = GetModelNameForEpoch(i);
+                if (asyncCheckPointSaving)
+                {
+                    // take a snapshot in host memory, and write it out while the next epoch is running
+                    AsyncCheckPointWriter::FileList files;
+                    files.push_back(make_pair(GetCheckPointFileNameForEpoch(i), File::CreateInMemory(FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite)));
+                    SaveCheckPointInfo(*files.back().second, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
+                    files.push_back(make_pair(modelName, File::CreateInMemory(FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite)));
+                    net->Save(*files.back().second);
+                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls' in the background\n", modelName.c_str());
+                    m_checkPointWriter.WriteAsync(move(files), move(filesToDelete));
+                }
+                else
+                {
+                    SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
+                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
+                    net->Save(modelName);
+                    for (const auto& fileName : filesToDelete)
+                        _wunlink(fileName.c_str());
+                }
             }
         }
         else
@@ -711,6 +752,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    m_checkPointWriter.Wait();
+
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
     if (m_mpi != nullptr)
@@ -791,6 +834,12 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // resetting this, so profiling is performed for one epoch only
     m_numMBsToCUDAProfile = 0;
 
+    // same for the per-node CPU profile
+    if (m_nodeProfilerMinibatches > 0)
+        net->SetNodeProfiler(make_shared<NodeProfiler>(m_nodeProfilerMinibatches, m_nodeProfilerSkipMinibatches));
+    m_nodeProfilerMinibatches = 0;
+    NodeProfiler* nodeProfiler = net->GetNodeProfiler().get();
+
     bool useDistributedMBReading = useParallelTrain &&
                                    m_enableDistributedMBReading &&
                                    trainSetDataReader->SupportsDistributedMBRead();
@@ -881,6 +930,17 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         if (m_perfTraceLevel > 0)
             fineGrainedPerfMeasurementTimer.Start();
 
+        if (nodeProfiler)
+        {
+            nodeProfiler->NextMinibatch();
+            if (nodeProfiler->IsDone())
+            {
+                FinishNodeProfile(net);
+                nodeProfiler = nullptr;
+            }
+        }
+        auto readStartTime = NodeProfiler::Clock::now();
+
         // get minibatch
         // TODO: is it guaranteed that the GPU is already completed at this point, is it safe to overwrite the buffers?
         size_t actualMBSize = 0;
@@ -889,6 +949,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
             break;                                                                // end of epoch
 
+        if (nodeProfiler)
+            nodeProfiler->RecordSpan(L"ReadMinibatch", readStartTime);
+
         if (m_perfTraceLevel > 0)
         {
             fineGrainedPerfMeasurementTimer.Stop();
@@ -973,7 +1036,17 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // ===========================================================
 
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                {
+                    // let the aggregator start on each parameter gradient as soon as it is final
+                    // (not with sub-minibatches, where gradients are still accumulated after each backprop)
+                    if (useGradientAggregation && (actualNumSubminibatches == 1) && m_distGradAgg->SupportsGradientCompletionCallbacks())
+                        net->Backprop(criterionNodes[0], [this](const ComputationNodeBasePtr& node)
+                                      {
+                                          m_distGradAgg->OnGradientComplete(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                                      });
+                    else
+                        net->Backprop(criterionNodes[0]);
+                }
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -1018,9 +1091,14 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             // distributed gradient aggregation
             if (learnParamsGradients.size() == 0)
             {
+                // in the order in which backprop completes them (reverse evaluation order), so that the aggregator can start early
                 learnParamsGradients.reserve(learnableNodes.size());
-                for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+                set<ComputationNodeBasePtr> learnableNodeSet(learnableNodes.begin(), learnableNodes.end());
+                const auto& evalOrder = net->GetEvalOrder(criterionNodes[0]);
+                for (auto nodeIter = evalOrder.rbegin(); nodeIter != evalOrder.rend(); nodeIter++)
                 {
+                    if (learnableNodeSet.find(*nodeIter) == learnableNodeSet.end())
+                        continue;
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
                     if (node->IsParameterUpdateRequired())
                     {
@@ -1051,8 +1129,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             for (size_t i = 0; i < evaluationNodes.size(); i++)
                 m_gradHeader->evalErrors[i] = localEpochEvalErrors.GetCriterion(i);
 
+            auto aggregationStartTime = NodeProfiler::Clock::now();
             bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), epochNumber);
             noMoreSamplesToProcess = !samplesProcessed;
+            if (nodeProfiler)
+                nodeProfiler->RecordSpan(L"AggregateGradients", aggregationStartTime);
 
             aggregateNumSamples          = m_gradHeader->numSamples;
             aggregateNumSamplesWithLabel = m_gradHeader->numSamplesWithLabel;
@@ -1074,6 +1155,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (numSamplesInMinibatch != aggregateNumSamples)
                 fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)aggregateNumSamples);
 #endif
+            auto updateStartTime = NodeProfiler::Clock::now();
             auto smoothedGradientIter = smoothedGradients.begin();
             for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
             {
@@ -1096,6 +1178,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 #endif
                 }
             }
+            if (nodeProfiler)
+                nodeProfiler->RecordSpan(L"UpdateWeights", updateStartTime);
         }
 
         if (m_perfTraceLevel > 0)
@@ -1230,6 +1314,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     // --- END MAIN MINIBATCH LOOP
 
+    // the epoch ended before all minibatches were profiled
+    if (nodeProfiler)
+        FinishNodeProfile(net);
+
+    if (m_traceLevel > 0)
+        net->PrintMatrixPoolUsage();
+
     if (useModelAggregation )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
@@ -1826,6 +1917,22 @@ void SGD<ElemType>::AttemptUtteranceDerivativeFeatures(ComputationNetworkPtr net
     }
 }
 
+template <class ElemType>
+void SGD<ElemType>::FinishNodeProfile(ComputationNetworkPtr net)
+{
+    auto profiler = net->GetNodeProfiler();
+    net->SetNodeProfiler(nullptr);
+    if ((m_mpi != nullptr) && !m_mpi->IsMainNode())
+        return;
+
+    profiler->WriteSummary(stderr);
+    if (!m_nodeProfilerTimeline.empty())
+    {
+        profiler->WriteTimeline(m_nodeProfilerTimeline);
+        LOGPRINTF(stderr, "Node profile timeline written to %ls.\n", m_nodeProfilerTimeline.c_str());
+    }
+}
+
 template <class ElemType>
 void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
 {
@@ -1838,10 +1945,18 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
 #else
             if (m_numGradientBits != (8 * sizeof(ElemType)))
             {
-                RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
-            }
+                // without the 1-bit SGD submodule, quantized gradients are aggregated on the CPU
+                if (!QuantizedDistGradAggregator<ElemType>::IsSupportedNumGradientBits(m_numGradientBits))
+                    RuntimeError("Gradient quantization to %d bits is unsupported in CNTK binaries built without the 1-bit SGD submodule; use 1, 2, 4 or 8 gradientBits.", (int) m_numGradientBits);
+                if (m_bufferedAsyncGradientAggregation)
+                    RuntimeError("Buffered async gradient aggregation is unsupported with gradient quantization in CNTK binaries built without the 1-bit SGD submodule.");
 
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+                m_distGradAgg = std::make_shared<QuantizedDistGradAggregator<ElemType>>(m_mpi, m_numGradientBits, m_zeroThresholdFor1Bit, m_syncStatsTrace);
+            }
+            else
+            {
+                m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, m_gradientBucketSizeInBytes);
+            }
 #endif // !CNTK_PARALLEL_TRAINING_SUPPORT
         }
 
@@ -2037,39 +2152,50 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
 
         {
             File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
-            fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
-
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
-            fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+            SaveCheckPointInfo(fstream, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, minibatchSize);
+        }
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
-            fstream << minibatchSize;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
+        _wunlink(checkPointFileName.c_str());
+        renameOrDie(tempFileName, checkPointFileName);
+    }
+}
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+// write the checkpoint info into an open file
+template <class ElemType>
+void SGD<ElemType>::SaveCheckPointInfo(File& fstream, const size_t totalSamplesSeen,
+                                       const double learnRatePerSample,
+                                       const std::list<Matrix<ElemType>>& smoothedGradients,
+                                       const double prevCriterion,
+                                       const size_t minibatchSize)
+{
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
+    fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
 
-            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
-            {
-                const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-                fstream << smoothedGradient;
-            }
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
+    fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
+    fstream << minibatchSize;
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
-            if (m_pMASGDHelper)
-                m_pMASGDHelper->SaveToCheckPoint(fstream);
-            // Ensuring that data is written
-            fstream.Flush();
-        }
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
-        _wunlink(checkPointFileName.c_str());
-        renameOrDie(tempFileName, checkPointFileName);
+    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+    {
+        const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
+        fstream << smoothedGradient;
     }
+
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
+    if (m_pMASGDHelper)
+        m_pMASGDHelper->SaveToCheckPoint(fstream);
+    // Ensuring that data is written
+    fstream.Flush();
 }
 
 template <class ElemType>
@@ -2590,11 +2716,16 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_perfTraceLevel = configSGD(L"perfTraceLevel", (int)0);
 
+    m_nodeProfilerMinibatches = configSGD(L"nodeProfilerMinibatches", (size_t)0);
+    m_nodeProfilerSkipMinibatches = configSGD(L"nodeProfilerSkipMinibatches", (size_t)0);
+    m_nodeProfilerTimeline = (wstring) configSGD(L"nodeProfilerTimeline", L"");
+
     // parallel training
     m_parallelizationMethod = ParallelizationMethod::none;
     m_numGradientBits = 32;
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientBucketSizeInBytes = 0;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
@@ -2624,6 +2755,8 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 m_numGradientBits = configDataParallelSGD(L"gradientBits", defaultGradientBits);
                 m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
                 m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+                // Bucketing is opt-in. On GPUs, the buckets are packed in page-locked host memory, like the per-matrix buffers.
+                m_gradientBucketSizeInBytes = (size_t) configDataParallelSGD(L"gradientBucketSizeInKB", (size_t) 0) * 1024;
                 if ( m_numGradientBits < 1 || m_numGradientBits > (8 * sizeofElemType) )
                 {
                     InvalidArgument("gradientBits must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double!");
@@ -19,6 +19,7 @@
 #include <random>
 #include "Profiler.h"
 #include "MASGD.h"
+#include "AsyncCheckPointWriter.h"
 
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
@@ -250,6 +251,11 @@ protected:
 
     int m_perfTraceLevel;
 
+    // per-node CPU profile of the first epoch, see NodeProfiler
+    size_t m_nodeProfilerMinibatches;     // number of minibatches to profile; 0 to disable
+    size_t m_nodeProfilerSkipMinibatches; // number of minibatches to skip before profiling, to exclude warm-up
+    std::wstring m_nodeProfilerTimeline;  // if not empty, the timeline is written to this file in Chrome trace-event format
+
     // Parallel training
     MPIWrapperPtr m_mpi;
 
@@ -267,6 +273,7 @@ protected:
     int m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    size_t m_gradientBucketSizeInBytes; // gradients are reduced in buckets of about this size; 0 (default): one reduction per gradient matrix
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
@@ -314,11 +321,14 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_asyncCheckPointSaving(configSGD(L"asyncCheckPointSaving", false)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_traceNodeNamesReal    (configSGD(L"traceNodeNamesReal",     ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesCategory(configSGD(L"traceNodeNamesCategory", ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesSparse  (configSGD(L"traceNodeNamesSparse",   ConfigRecordType::Array(stringargvector()))),
+          m_gradientCheckpointing  (configSGD(L"gradientCheckpointing",   false)),
+          m_gradientCheckpointNodes(configSGD(L"gradientCheckpointNodes", ConfigRecordType::Array(stringargvector()))),
           m_prevChosenMinibatchSize(0),
           m_lastFinishedEpochTrainLoss(0.0),
           m_distGradAgg(nullptr),
@@ -450,6 +460,9 @@ protected:
                                             const std::vector<ComputationNodeBasePtr>& featureNodes,
                                             StreamMinibatchInputs* inputMatrices);
 
+    // prints the network's node profile, writes its timeline if requested, and removes it from the network
+    void FinishNodeProfile(ComputationNetworkPtr net);
+
     size_t TrainOneEpoch(ComputationNetworkPtr net,
                          ComputationNetworkPtr refNet,
                          const ComputationNodeBasePtr& refNode,
@@ -502,6 +515,11 @@ protected:
                             const std::list<Matrix<ElemType>>& smoothedGradients,
                             const double prevCriterion,
                             const size_t minibatchSize);
+    void SaveCheckPointInfo(File& fstream, const size_t totalSamplesSeen,
+                            const double learnRatePerSample,
+                            const std::list<Matrix<ElemType>>& smoothedGradients,
+                            const double prevCriterion,
+                            const size_t minibatchSize);
 
     bool TryLoadCheckPointInfo(const size_t epochNumber,
                                /*out*/ size_t& totalSamplesSeen,
@@ -542,6 +560,8 @@ public:
 protected:
     std::wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    bool m_asyncCheckPointSaving;               // save the model and checkpoint at the end of each epoch in the background, see AsyncCheckPointWriter
+    AsyncCheckPointWriter m_checkPointWriter;
 
     std::wstring m_trainCriterionNodeName;
     std::wstring m_evalCriterionNodeName;
@@ -551,6 +571,10 @@ protected:
     std::vector<std::wstring> m_traceNodeNamesCategory;
     std::vector<std::wstring> m_traceNodeNamesSparse;
 
+    // gradient checkpointing: drop values after forward prop and compute them again for backprop, see ComputationNetwork::SetGradientCheckpointing()
+    bool m_gradientCheckpointing;
+    std::vector<std::wstring> m_gradientCheckpointNodes; // segments end at these nodes; if empty, at every sqrt(N)-th value
+
     size_t m_prevChosenMinibatchSize;
     double m_lastFinishedEpochTrainLoss;
 
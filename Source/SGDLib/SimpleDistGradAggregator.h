@@ -3,6 +3,7 @@
 #include "IDistGradAggregator.h"
 #include "CUDAPageLockedMemAllocator.h"
 #include <future>
+#include <unordered_map>
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
 #include "MatrixQuantizerImpl.h"
@@ -15,8 +16,11 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    // If bucketSizeInBytes > 0, the gradients are packed into contiguous buckets of about that size, and each bucket is
+    // reduced with a single MPI call. Otherwise, each gradient matrix is reduced separately.
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace, size_t bucketSizeInBytes = 0)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0),
+          m_bucketSizeInBytes(bucketSizeInBytes), m_numBucketsStarted(0)
     {
     }
 
@@ -122,7 +126,151 @@ public:
         }
     }
 
+    // Backprop can only report completed gradients once the buckets exist, i.e. from the second minibatch on.
+    // With async aggregation, the gradients are swapped into buffers first, so there is nothing to overlap.
+    bool SupportsGradientCompletionCallbacks() const override
+    {
+        return !m_useAsyncAggregation && !m_buckets.empty();
+    }
+
+    // Start reducing a bucket as soon as all of its gradients are final.
+    // Buckets are always started in order, so that all workers issue their collectives in the same sequence.
+    void OnGradientComplete(Matrix<ElemType>* gradient) override
+    {
+        auto gradientIndex = m_gradientIndices.find(gradient);
+        if (gradientIndex == m_gradientIndices.end())
+            return;
+
+        GradientBucket& bucket = m_buckets[m_bucketOfGradient[gradientIndex->second]];
+        assert(bucket.numPending > 0);
+        bucket.numPending--;
+        while ((m_numBucketsStarted < m_buckets.size()) && (m_buckets[m_numBucketsStarted].numPending == 0))
+            StartBucket(m_numBucketsStarted, m_gradients, /*duringBackprop=*/true);
+
+        // most MPI implementations only make progress on non-blocking operations from within MPI calls
+        TestBuckets();
+    }
+
 private:
+    // a range of consecutive gradient matrices that are packed into one buffer and reduced together
+    struct GradientBucket
+    {
+        size_t firstGradient;
+        size_t numGradients;
+        std::shared_ptr<ElemType> buffer; // packed gradients, reduced in place; page-locked if the gradients are on a GPU
+        size_t bufferSize;                // in elements
+        size_t numPending;            // gradients not yet reported complete in the current iteration
+        bool startedDuringBackprop;
+        bool completed;
+        MPI_Request request;
+        Timer timer;                  // from the start of the reduction until it is found complete
+    };
+
+    // Greedily group consecutive gradients into buckets of up to m_bucketSizeInBytes (a larger gradient gets a bucket of its own).
+    // The caller passes the gradients in the order in which backprop completes them, so that buckets become ready one after the other.
+    void CreateBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        m_gradients = gradients;
+        m_bucketOfGradient.resize(gradients.size());
+        for (size_t i = 0; i < gradients.size();)
+        {
+            GradientBucket bucket;
+            bucket.firstGradient = i;
+            bucket.numGradients = 0;
+            size_t numElements = 0;
+            do
+            {
+                m_gradientIndices[gradients[i]] = i;
+                m_bucketOfGradient[i] = m_buckets.size();
+                numElements += gradients[i]->GetNumElements();
+                bucket.numGradients++;
+                i++;
+            } while ((i < gradients.size()) && ((numElements + gradients[i]->GetNumElements()) * sizeof(ElemType) <= m_bucketSizeInBytes));
+
+            bucket.buffer = AllocateBucketBuffer(gradients[0]->GetDeviceId(), numElements);
+            bucket.bufferSize = numElements;
+            bucket.numPending = bucket.numGradients;
+            bucket.startedDuringBackprop = false;
+            bucket.completed = false;
+            bucket.request = MPI_REQUEST_NULL;
+            m_buckets.push_back(std::move(bucket));
+        }
+    }
+
+    void StartBucket(size_t bucketIndex, const std::vector<Matrix<ElemType>*>& gradients, bool duringBackprop)
+    {
+        GradientBucket& bucket = m_buckets[bucketIndex];
+        ElemType* packed = bucket.buffer.get();
+        for (size_t i = bucket.firstGradient; i < bucket.firstGradient + bucket.numGradients; i++)
+        {
+            if (packed + gradients[i]->GetNumElements() > bucket.buffer.get() + bucket.bufferSize)
+                LogicError("SimpleDistGradAggregator: Gradient matrix dimensions changed since the aggregation buckets were set up.");
+            if (gradients[i]->GetNumElements() > 0)
+                gradients[i]->CopySection(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), packed, gradients[i]->GetNumRows());
+            packed += gradients[i]->GetNumElements();
+        }
+
+        bucket.startedDuringBackprop = duringBackprop;
+        bucket.timer.Start();
+        MPI_Iallreduce(MPI_IN_PLACE, bucket.buffer.get(), (int) bucket.bufferSize, MPIWrapper::GetDataType(bucket.buffer.get()), MPI_SUM, m_mpi->Communicator(), &bucket.request) || MpiFail("MPI_Iallreduce");
+        m_numBucketsStarted++;
+    }
+
+    void TestBuckets()
+    {
+        for (size_t b = 0; b < m_numBucketsStarted; b++)
+        {
+            GradientBucket& bucket = m_buckets[b];
+            if (bucket.completed)
+                continue;
+            int completed = 0;
+            MPI_Test(&bucket.request, &completed, MPI_STATUS_IGNORE) || MpiFail("MPI_Test");
+            if (completed)
+            {
+                bucket.timer.Stop();
+                bucket.completed = true;
+            }
+        }
+    }
+
+    // wait for all bucket reductions, unpack the results, and get ready for the next iteration
+    void FinishBuckets(const std::vector<Matrix<ElemType>*>& gradients, bool showSyncPerfStats)
+    {
+        for (size_t b = 0; b < m_buckets.size(); b++)
+        {
+            GradientBucket& bucket = m_buckets[b];
+            Timer waitTimer;
+            waitTimer.Start();
+            if (!bucket.completed)
+            {
+                MPI_Wait(&bucket.request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+                bucket.timer.Stop();
+            }
+            waitTimer.Stop();
+
+            ElemType* packed = bucket.buffer.get();
+            for (size_t i = bucket.firstGradient; i < bucket.firstGradient + bucket.numGradients; i++)
+            {
+                if (gradients[i]->GetNumElements() > 0)
+                    gradients[i]->SetValue(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), gradients[i]->GetDeviceId(), packed);
+                packed += gradients[i]->GetNumElements();
+            }
+
+            if (showSyncPerfStats)
+            {
+                fprintf(stderr, "Gradient bucket %d: %d matrices, %.1f KB, started %s backprop, reduction time: %.6g, wait time: %.6g\n",
+                        (int) b, (int) bucket.numGradients, bucket.bufferSize * sizeof(ElemType) / 1024.0,
+                        bucket.startedDuringBackprop ? "during" : "after", bucket.timer.ElapsedSeconds(), waitTimer.ElapsedSeconds());
+            }
+
+            bucket.numPending = bucket.numGradients;
+            bucket.startedDuringBackprop = false;
+            bucket.completed = false;
+        }
+
+        m_numBucketsStarted = 0;
+    }
+
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
         assert(deviceID >= 0);
@@ -135,6 +283,14 @@ private:
                                          });
     }
 
+    // GPU gradients are copied into page-locked memory, like the per-matrix buffers above
+    std::shared_ptr<ElemType> AllocateBucketBuffer(int deviceID, size_t numElements)
+    {
+        if (deviceID != CPUDEVICE)
+            return AllocateIntermediateBuffer(deviceID, numElements);
+        return std::shared_ptr<ElemType>(new ElemType[numElements], [](ElemType* p) { delete[] p; });
+    }
+
     bool ResetCurrentEpoch(const std::vector<Matrix<ElemType>*>& gradients, int numEvalNode, int epochNumber)
     {
         bool isNewEpoch = (m_currentEpochNumber != epochNumber);
@@ -143,6 +299,7 @@ private:
         if (m_currentEpochNumber == -1)
         {
             int deviceId = gradients[0]->GetDeviceId();
+            bool useBuckets = (m_bucketSizeInBytes > 0);
             if (deviceId != CPUDEVICE)
             {
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
@@ -154,7 +311,7 @@ private:
                 if (gradients[i]->GetMatrixType() != DENSE)
                     RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
 
-                if (deviceId != CPUDEVICE)
+                if (deviceId != CPUDEVICE && !useBuckets)
                 {
                     m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation)));
                     m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
@@ -166,6 +323,11 @@ private:
                 }
             }
 
+            if (useBuckets)
+            {
+                CreateBuckets(gradients);
+            }
+
             if (m_useAsyncAggregation)
             {
                 m_bufferedGradHeader = DistGradHeader::Create(numEvalNode);
@@ -218,6 +380,7 @@ private:
         }
 
         size_t numGradMatrices = gradients.size();
+        bool useBuckets = !m_buckets.empty();
 
         if (headerCPU->numSamples == 0)
         {
@@ -239,7 +402,7 @@ private:
         }
 
         // Initiate transfer of the gradient matrices to the CPU if needed
-        if (deviceId >= 0)
+        if (deviceId >= 0 && !useBuckets)
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
@@ -267,8 +430,14 @@ private:
         }
 
         // Perform MPI async allreduce on the gradient data
-        std::vector<MPI_Request> allReduceRequests(numGradMatrices);
-        for (size_t i = 0; i < numGradMatrices; ++i)
+        // With buckets, some may have been started during backprop already (OnGradientComplete()); start the rest, in order.
+        std::vector<MPI_Request> allReduceRequests(useBuckets ? 0 : numGradMatrices);
+        while (m_numBucketsStarted < m_buckets.size())
+        {
+            StartBucket(m_numBucketsStarted, gradients, /*duringBackprop=*/false);
+        }
+
+        for (size_t i = 0; i < allReduceRequests.size(); ++i)
         {
             ElemType* reductionBuffer = gradients[i]->Data();
             if (deviceId >= 0)
@@ -322,7 +491,12 @@ private:
         }
 
         // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
-        for (size_t i = 0; i < numGradMatrices; ++i)
+        if (useBuckets)
+        {
+            FinishBuckets(gradients, showSyncPerfStats);
+        }
+
+        for (size_t i = 0; i < allReduceRequests.size(); ++i)
         {
             MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
             if (deviceId >= 0)
@@ -338,7 +512,7 @@ private:
         }
 
         // Wait for all the transfers to finish
-        if (deviceId >= 0)
+        if (deviceId >= 0 && !useBuckets)
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
@@ -388,5 +562,13 @@ private:
     size_t m_iterationCount;
 
     int m_currentEpochNumber;
+
+    // Bucketed aggregation
+    size_t m_bucketSizeInBytes;
+    std::vector<GradientBucket> m_buckets;
+    std::vector<size_t> m_bucketOfGradient;                          // [gradient index] -> bucket index
+    std::unordered_map<Matrix<ElemType>*, size_t> m_gradientIndices; // gradient matrix -> gradient index, for OnGradientComplete()
+    std::vector<Matrix<ElemType>*> m_gradients;                      // the gradients the buckets were set up for
+    size_t m_numBucketsStarted;                                      // buckets [0, m_numBucketsStarted) have been started in the current iteration
 };
 } } }
@@ -87,6 +87,7 @@ public:
         std::vector<EpochCriterion> evalResults(evalNodes.size(), EpochCriterion(0));
 
         // allocate memory for forward computation
+        m_net->SetMemoryPlanHint(mbSize, m_traceLevel);
         m_net->AllocateAllMatrices(evalNodes, {}, nullptr);
 
         // prepare features and labels
@@ -46,6 +46,7 @@ public:
         std::vector<ComputationNodeBasePtr> inputNodes  = m_net->InputNodesForOutputs(outputNodeNames);
 
         // allocate memory for forward computation
+        m_net->SetMemoryPlanHint(mbSize, m_verbosity);
         m_net->AllocateAllMatrices({}, outputNodes, nullptr);
 
         StreamMinibatchInputs inputMatrices = DataReaderHelpers::RetrieveInputMatrices(inputNodes);
@@ -160,6 +161,7 @@ public:
         std::vector<ComputationNodePtr> gradientNodes;
         std::vector<ComputationNodeBasePtr> allOutputNodes = outputNodes;
 
+        m_net->SetMemoryPlanHint(mbSize, m_verbosity);
         if (!nodeUnitTest)                                        // regular operation
         {
             m_net->AllocateAllMatrices({}, outputNodes, nullptr); // don't allocate for backward pass
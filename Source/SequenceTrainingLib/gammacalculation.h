@@ -8,6 +8,8 @@
 #include "Matrix.h"
 #include "CUDAPageLockedMemAllocator.h"
 
+#include <algorithm>
+#include <exception>
 #include <memory>
 #include <vector>
 
@@ -100,9 +102,6 @@ public:
     {
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
-        size_t boundaryframenum;
-        std::vector<size_t> validframes; // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
-        validframes.assign(samplesInRecurrentStep, 0);
         ElemType objectValue = 0.0;
         // convert from Microsoft::MSR::CNTK::Matrix to  msra::math::ssematrixbase
         size_t numrows = loglikelihood.GetNumRows();
@@ -126,131 +125,210 @@ public:
             assert(T == pMBLayout->GetNumTimeSteps());
         }
 
-        size_t mapi = 0; // parallel-sequence index for utterance [i]
-        // cal gamma for each utterance
+        // find the frames of each utterance in the minibatch
+        std::vector<utterancelocation> utterances(lattices.size());
+        std::vector<size_t> validframes; // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
+        validframes.assign(samplesInRecurrentStep, 0);
         size_t ts = 0;
         for (size_t i = 0; i < lattices.size(); i++)
         {
-            const size_t numframes = lattices[i]->getnumframes();
-
-            msra::dbn::matrixstripe predstripe(pred, ts, numframes);           // logLLs for this utterance
-            msra::dbn::matrixstripe dengammasstripe(dengammas, ts, numframes); // denominator gammas
-
-            if (samplesInRecurrentStep == 1) // no sequence parallelism
-            {
-                tempmatrix = loglikelihood.ColumnSlice(ts, numframes);
-                // if (m_deviceid == CPUDEVICE)
-                {
-                    CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
-                }
-
-                if (m_deviceid != CPUDEVICE)
-                    parallellattice.setloglls(tempmatrix);
-            }
-            else // multiple parallel sequences
+            auto& utt = utterances[i];
+            utt.ts = ts;
+            utt.numframes = lattices[i]->getnumframes();
+            utt.s = 0;
+            utt.t = ts;
+            if (samplesInRecurrentStep > 1)
             {
-                // get number of frames for the utterance
-                mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                utt.s = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                utt.t = validframes[utt.s];
 
                 // scan MBLayout for end of utterance
                 size_t mapframenum = SIZE_MAX; // duration of utterance [i] as determined from MBLayout
-                for (size_t t = validframes[mapi]; t < T; t++)
+                for (size_t t = utt.t; t < T; t++)
                 {
                     // TODO: Adapt this to new MBLayout, m_sequences would be easier to work off.
-                    if (pMBLayout->IsEnd(mapi, t))
+                    if (pMBLayout->IsEnd(utt.s, t))
                     {
-                        mapframenum = t - validframes[mapi] + 1;
+                        mapframenum = t - utt.t + 1;
                         break;
                     }
                 }
 
                 // must match the explicit information we get from the reader
-                if (numframes != mapframenum)
-                    LogicError("gammacalculation: IsEnd() not working, numframes (%d) vs. mapframenum (%d)", (int) numframes, (int) mapframenum);
-                assert(numframes == mapframenum);
+                if (utt.numframes != mapframenum)
+                    LogicError("gammacalculation: IsEnd() not working, numframes (%d) vs. mapframenum (%d)", (int) utt.numframes, (int) mapframenum);
+                assert(utt.numframes == mapframenum);
 
-                if (numframes > tempmatrix.GetNumCols())
-                    tempmatrix.Resize(numrows, numframes);
-
-                Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
-                tempmatrix.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
+                validframes[utt.s] += utt.numframes; // advance the cursor within the parallel sequence
+            }
+            ts += utt.numframes;
+        }
 
-                // if (doreferencealign || m_deviceid == CPUDEVICE)
+        // cal gamma for each utterance
+        std::vector<double> numavlogps(lattices.size());
+        std::vector<double> denavlogps(lattices.size());
+        if (m_deviceid == CPUDEVICE)
+        {
+            // On the CPU, the lattices are independent of each other and are processed concurrently.
+            // Each one only touches its own column stripes of 'pred' and 'dengammas', while all copying
+            // from and to the CNTK matrices goes through shared buffers and is therefore done serially.
+            for (size_t i = 0; i < lattices.size(); i++)
+                setloglls(utterances[i], loglikelihood, tempmatrix, samplesInRecurrentStep);
+
+            // hand out the longest lattices first, so that a long one does not end up last on a single thread
+            std::vector<size_t> order(lattices.size());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&utterances](size_t a, size_t b)
+                             {
+                                 return utterances[a].numframes > utterances[b].numframes;
+                             });
+
+            std::exception_ptr firsterror;
+#pragma omp parallel for schedule(dynamic, 1)
+            for (long k = 0; k < (long) order.size(); k++)
+            {
+                const size_t i = order[k];
+                try
                 {
-                    CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
+                    denavlogps[i] = forwardbackward(*lattices[i], utterances[i], uids, boundaries, doreferencealign, numavlogps[i]);
                 }
-
-                if (m_deviceid != CPUDEVICE)
+                catch (...)
                 {
-                    parallellattice.setloglls(tempmatrix);
+#pragma omp critical
+                    {
+                        if (!firsterror)
+                            firsterror = std::current_exception();
+                    }
                 }
             }
+            if (firsterror)
+                std::rethrow_exception(firsterror);
 
-            array_ref<size_t> uidsstripe(&uids[ts], numframes);
-
-            if (doreferencealign)
+            for (size_t i = 0; i < lattices.size(); i++)
+                getgammas(utterances[i], uids, gammafromlattice, labels, tempmatrix, samplesInRecurrentStep, doreferencealign);
+        }
+        else
+        {
+            // on the GPU, all lattices share the device state in 'parallellattice' and are processed one by one
+            for (size_t i = 0; i < lattices.size(); i++)
             {
-                boundaryframenum = numframes;
+                setloglls(utterances[i], loglikelihood, tempmatrix, samplesInRecurrentStep);
+                denavlogps[i] = forwardbackward(*lattices[i], utterances[i], uids, boundaries, doreferencealign, numavlogps[i]);
+                getgammas(utterances[i], uids, gammafromlattice, labels, tempmatrix, samplesInRecurrentStep, doreferencealign);
             }
-            else
-                boundaryframenum = 0;
-            array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
+        }
 
-            double numavlogp = 0;
-            foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
-            {
-                const size_t s = uidsstripe[t];
-                numavlogp += predstripe(s, t) / amf;
-            }
-            numavlogp /= numframes;
+        // accumulate the objective in utterance order, so that it does not depend on the thread schedule
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            objectValue += (ElemType)((numavlogps[i] - denavlogps[i]) * utterances[i].numframes);
+            fprintf(stderr, "dengamma value %f\n", denavlogps[i]);
+        }
+        functionValues.SetValue(objectValue);
+    }
 
-            // auto_timer dengammatimer;
-            double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
-                                                                   (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
-                                                                   (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
-                                                                   lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
-            objectValue += (ElemType)((numavlogp - denavlogp) * numframes);
+private:
+    // location of an utterance's frames in the minibatch
+    struct utterancelocation
+    {
+        size_t ts;        // first column of the utterance in 'pred', 'dengammas', 'uids', and 'boundaries', where all utterances are concatenated
+        size_t numframes; // number of frames of the utterance
+        size_t s;         // parallel sequence the utterance is in
+        size_t t;         // time step the utterance begins at within its parallel sequence
+    };
+
+    // copy the log LLs of one utterance into its stripe of 'pred', and to the GPU if enabled
+    void setloglls(const utterancelocation& utt, const Microsoft::MSR::CNTK::Matrix<ElemType>& loglikelihood, Microsoft::MSR::CNTK::Matrix<ElemType>& tempmatrix, size_t samplesInRecurrentStep)
+    {
+        msra::dbn::matrixstripe predstripe(pred, utt.ts, utt.numframes); // logLLs for this utterance
 
-            if (samplesInRecurrentStep == 1)
-            {
-                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
-            }
+        if (samplesInRecurrentStep == 1) // no sequence parallelism
+        {
+            tempmatrix = loglikelihood.ColumnSlice(utt.ts, utt.numframes);
+        }
+        else // multiple parallel sequences
+        {
+            if (utt.numframes > tempmatrix.GetNumCols())
+                tempmatrix.Resize(loglikelihood.GetNumRows(), utt.numframes);
 
-            // copy gamma to tempmatrix
-            if (m_deviceid == CPUDEVICE)
-            {
-                CopyFromSSEMatrixToCNTKMatrix(dengammas, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
-            }
-            else
-                parallellattice.getgamma(tempmatrix);
+            Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(utt.s + (utt.t * samplesInRecurrentStep), ((utt.numframes - 1) * samplesInRecurrentStep) + 1);
+            tempmatrix.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, utt.numframes, samplesInRecurrentStep, 1);
+        }
 
-            // set gamma for multi channel
-            if (samplesInRecurrentStep > 1)
-            {
-                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
-                gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
-            }
+        // if (doreferencealign || m_deviceid == CPUDEVICE)
+        {
+            CopyFromCNTKMatrixToSSEMatrix(tempmatrix, utt.numframes, predstripe);
+        }
+
+        if (m_deviceid != CPUDEVICE)
+            parallellattice.setloglls(tempmatrix);
+    }
+
+    // run the lattice forward-backward for one utterance, filling its stripe of 'dengammas'
+    // Returns the denominator's average log prob, and the numerator's in 'numavlogp'.
+    // On the CPU, this is safe to call concurrently for different utterances.
+    double forwardbackward(const msra::dbn::latticepair& lattice, const utterancelocation& utt,
+                           std::vector<size_t>& uids, std::vector<size_t>& boundaries, bool doreferencealign, double& numavlogp)
+    {
+        msra::dbn::matrixstripe predstripe(pred, utt.ts, utt.numframes);           // logLLs for this utterance
+        msra::dbn::matrixstripe dengammasstripe(dengammas, utt.ts, utt.numframes); // denominator gammas
+
+        array_ref<size_t> uidsstripe(&uids[utt.ts], utt.numframes);
+        array_ref<size_t> boundariesstripe(&boundaries[utt.ts], doreferencealign ? utt.numframes : 0);
+
+        numavlogp = 0;
+        foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
+        {
+            const size_t s = uidsstripe[t];
+            numavlogp += predstripe(s, t) / amf;
+        }
+        numavlogp /= utt.numframes;
+
+        // Note: all per-lattice working storage (alignments, alphas/betas) is allocated inside forwardbackward().
+        return lattice.second.forwardbackward(parallellattice,
+                                              (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
+                                              (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
+                                              lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
+    }
 
-            if (doreferencealign)
+    // copy the gammas of one utterance into 'gammafromlattice', and set its reference labels if requested
+    void getgammas(const utterancelocation& utt, const std::vector<size_t>& uids, Microsoft::MSR::CNTK::Matrix<ElemType>& gammafromlattice,
+                   Microsoft::MSR::CNTK::Matrix<ElemType>& labels, Microsoft::MSR::CNTK::Matrix<ElemType>& tempmatrix, size_t samplesInRecurrentStep, bool doreferencealign)
+    {
+        if (samplesInRecurrentStep == 1)
+        {
+            tempmatrix = gammafromlattice.ColumnSlice(utt.ts, utt.numframes);
+        }
+
+        // copy gamma to tempmatrix
+        if (m_deviceid == CPUDEVICE)
+        {
+            msra::dbn::matrixstripe dengammasstripe(dengammas, utt.ts, utt.numframes);
+            CopyFromSSEMatrixToCNTKMatrix(dengammasstripe, dengammasstripe.rows(), utt.numframes, tempmatrix, gammafromlattice.GetDeviceId());
+        }
+        else
+            parallellattice.getgamma(tempmatrix);
+
+        // set gamma for multi channel
+        if (samplesInRecurrentStep > 1)
+        {
+            Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(utt.s + (utt.t * samplesInRecurrentStep), ((utt.numframes - 1) * samplesInRecurrentStep) + 1);
+            gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, utt.numframes, 1, samplesInRecurrentStep);
+        }
+
+        if (doreferencealign)
+        {
+            for (size_t nframe = 0; nframe < utt.numframes; nframe++)
             {
-                for (size_t nframe = 0; nframe < numframes; nframe++)
-                {
-                    size_t uid = uidsstripe[nframe];
-                    if (samplesInRecurrentStep > 1)
-                        labels(uid, (nframe + validframes[mapi]) * samplesInRecurrentStep + mapi) = 1.0;
-                    else
-                        labels(uid, ts + nframe) = 1.0;
-                }
+                size_t uid = uids[utt.ts + nframe];
+                if (samplesInRecurrentStep > 1)
+                    labels(uid, (nframe + utt.t) * samplesInRecurrentStep + utt.s) = 1.0;
+                else
+                    labels(uid, utt.ts + nframe) = 1.0;
             }
-            if (samplesInRecurrentStep > 1)
-                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
-            fprintf(stderr, "dengamma value %f\n", denavlogp);
-            ts += numframes;
         }
-        functionValues.SetValue(objectValue);
     }
-
-private:
     // Helper methods for copying between ssematrix objects and CNTK matrices
     void CopyFromCNTKMatrixToSSEMatrix(const Microsoft::MSR::CNTK::Matrix<ElemType>& src, size_t numCols, msra::math::ssematrixbase& dest)
     {
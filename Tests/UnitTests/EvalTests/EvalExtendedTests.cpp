@@ -7,6 +7,9 @@
 #include "EvalTestHelper.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <thread>
+#include <algorithm>
+#include <cmath>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -284,5 +287,258 @@ BOOST_AUTO_TEST_CASE(EvalSparseTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalBatchedSequencesTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(2) \n"
+        "p1 = PastValue(2, i1, timeStep=1, defaultHiddenActivity=0) \n"
+        "o1 = Plus(Times(Constant(2, rows=1, cols=2), i1), Times(Constant(1, rows=1, cols=2), p1), tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    // Three sequences of different lengths, each output is 2 * (sum of the sample) + sum of the previous sample.
+    std::vector<Values<float>> inputs(3, Values<float>(1));
+    inputs[0][0].m_buffer = { 1, 2, 3, 4, 5, 6 };
+    inputs[1][0].m_buffer = { 7, 8 };
+    inputs[2][0].m_buffer = { 1, 1, 2, 2 };
+    std::vector<std::vector<float>> expected{ { 6, 17, 29 }, { 30 }, { 4, 10 } };
+
+    std::vector<Values<float>> outputs;
+    for (size_t s = 0; s < inputs.size(); ++s)
+        outputs.push_back(outputLayouts.CreateBuffers<float>({ 3 }));
+
+    std::vector<Values<float>> tooFewOutputs(2);
+    BOOST_REQUIRE_THROW(eval->ForwardPass(inputs, tooFewOutputs), std::exception); // Outputs for all sequences are needed
+
+    eval->ForwardPass(inputs, outputs);
+    for (size_t s = 0; s < inputs.size(); ++s)
+    {
+        auto buf = outputs[s][0].m_buffer;
+        BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[s].begin(), expected[s].end());
+    }
+
+    // Every sequence evaluated on its own must give the same result.
+    for (size_t s = 0; s < inputs.size(); ++s)
+    {
+        Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 3 });
+        eval->ForwardPass(inputs[s], outputBuffer);
+        auto buf = outputBuffer[0].m_buffer;
+        BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[s].begin(), expected[s].end());
+    }
+
+    // Do the same via ValueRefs
+    std::vector<ValueRefs<float>> inputRefs(3, ValueRefs<float>(1));
+    std::vector<ValueRefs<float>> outputRefs(3, ValueRefs<float>(1));
+    std::vector<std::vector<float>> output(3, std::vector<float>(3));
+    for (size_t s = 0; s < inputs.size(); ++s)
+    {
+        inputRefs[s][0].m_buffer.InitFrom(inputs[s][0].m_buffer);
+        outputRefs[s][0].m_buffer.InitFrom(output[s]);
+    }
+    eval->ForwardPass(inputRefs, outputRefs);
+    for (size_t s = 0; s < inputs.size(); ++s)
+    {
+        BOOST_CHECK_EQUAL(outputRefs[s][0].m_buffer.size(), expected[s].size());
+        BOOST_CHECK_EQUAL_COLLECTIONS(output[s].begin(), output[s].begin() + expected[s].size(), expected[s].begin(), expected[s].end());
+    }
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchedSparseSequencesTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = SparseInput(3) \n"
+        "o1 = Times(Constant(2, rows=1, cols=3), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    std::vector<Values<float>> inputs(2, Values<float>(1));
+    inputs[0][0].m_buffer = { 1, 2, 3, 5, 6 };
+    inputs[0][0].m_indices = { 0, 2, 2, 1, 2 };
+    inputs[0][0].m_colIndices = { 0, 2, 2, 5 };
+    inputs[1][0].m_buffer = { 4 };
+    inputs[1][0].m_indices = { 1 };
+    inputs[1][0].m_colIndices = { 0, 1 };
+    std::vector<std::vector<float>> expected{ { 6, 0, 28 }, { 8 } };
+
+    std::vector<Values<float>> outputs;
+    outputs.push_back(outputLayouts.CreateBuffers<float>({ 3 }));
+    outputs.push_back(outputLayouts.CreateBuffers<float>({ 1 }));
+    eval->ForwardPass(inputs, outputs);
+    for (size_t s = 0; s < inputs.size(); ++s)
+    {
+        auto buf = outputs[s][0].m_buffer;
+        BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[s].begin(), expected[s].end());
+    }
+
+    outputs[1] = outputLayouts.CreateBuffers<float>({ 0 });
+    BOOST_REQUIRE_THROW(eval->ForwardPass(inputs, outputs), std::exception); // Not enough capacity in the output of the second sequence.
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalConcurrentClonesTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    // Clones are started like the evaluator they come from, and evaluate concurrently.
+    const size_t numClones = 4;
+    std::vector<IEvaluateModelExtended<float>*> clones;
+    for (size_t c = 0; c < numClones; ++c)
+        clones.push_back(eval->Clone());
+
+    // The clones don't depend on the original evaluator.
+    eval->Destroy();
+
+    std::vector<size_t> numErrors(numClones, 0);
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < numClones; ++c)
+    {
+        threads.push_back(std::thread([&, c]()
+        {
+            Values<float> inputBuffer(1);
+            Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+            for (size_t i = 0; i < 100; ++i)
+            {
+                float x = (float)(c * 100 + i);
+                inputBuffer[0].m_buffer = { x, x, x, 1 };
+                clones[c]->ForwardPass(inputBuffer, outputBuffer);
+                if (outputBuffer[0].m_buffer.size() != 1 || outputBuffer[0].m_buffer[0] != 6 * x + 2)
+                    numErrors[c]++;
+            }
+        }));
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t c = 0; c < numClones; ++c)
+    {
+        BOOST_CHECK_EQUAL(numErrors[c], 0);
+        clones[c]->Destroy();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EvalQuantizedTimesTest)
+{
+    // The same model, evaluated in float and with quantizedInference, which computes the Times with 16-bit integers.
+    auto modelDefinition = [](bool quantized)
+    {
+        return std::string(
+            "deviceId = -1 \n"
+            "precision = \"float\" \n"
+            "traceLevel = 1 \n") +
+            (quantized ? "quantizedInference = true \n" : "") +
+            "run=NDLNetworkBuilder \n"
+            "NDLNetworkBuilder=[ \n"
+            "i1 = Input(64) \n"
+            "W = Parameter(16, 64, init=\"uniform\", randomSeed=1) \n"
+            "o1 = Times(W, i1, tag=\"output\") \n"
+            "FeatureNodes = (i1) \n"
+            "] \n";
+    };
+
+    const size_t numSamples = 5;
+    Values<float> inputBuffer(1);
+    for (size_t i = 0; i < 64 * numSamples; ++i)
+        inputBuffer[0].m_buffer.push_back((float)((i * 37) % 101) / 50 - 1);
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    std::vector<float> outputs[2];
+    IEvaluateModelExtended<float>* quantizedEval = nullptr;
+    for (int quantized = 0; quantized < 2; ++quantized)
+    {
+        IEvaluateModelExtended<float>* eval = SetupNetworkAndGetLayouts(modelDefinition(quantized != 0), inputLayouts, outputLayouts);
+        Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ numSamples });
+        eval->ForwardPass(inputBuffer, outputBuffer);
+        outputs[quantized] = outputBuffer[0].m_buffer;
+        if (quantized)
+            quantizedEval = eval;
+        else
+            eval->Destroy();
+    }
+
+    // close to the float result, but really computed differently
+    BOOST_REQUIRE_EQUAL(outputs[0].size(), 16 * numSamples);
+    BOOST_REQUIRE_EQUAL(outputs[1].size(), outputs[0].size());
+    float maxAbs = 0, maxDifference = 0;
+    for (size_t i = 0; i < outputs[0].size(); ++i)
+    {
+        maxAbs = std::max(maxAbs, std::abs(outputs[0][i]));
+        maxDifference = std::max(maxDifference, std::abs(outputs[1][i] - outputs[0][i]));
+    }
+    BOOST_CHECK_GT(maxAbs, 0.0f);
+    BOOST_CHECK_LE(maxDifference, 0.01f * maxAbs);
+    BOOST_CHECK_GT(maxDifference, 0.0f);
+
+    // Clones evaluate quantized as well, concurrently, with the same result.
+    const size_t numClones = 3;
+    std::vector<IEvaluateModelExtended<float>*> clones;
+    for (size_t c = 0; c < numClones; ++c)
+        clones.push_back(quantizedEval->Clone());
+    quantizedEval->Destroy();
+
+    std::vector<size_t> numErrors(numClones, 0);
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < numClones; ++c)
+    {
+        threads.push_back(std::thread([&, c]()
+        {
+            Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ numSamples });
+            for (size_t i = 0; i < 20; ++i)
+            {
+                clones[c]->ForwardPass(inputBuffer, outputBuffer);
+                if (outputBuffer[0].m_buffer != outputs[1])
+                    numErrors[c]++;
+            }
+        }));
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t c = 0; c < numClones; ++c)
+    {
+        BOOST_CHECK_EQUAL(numErrors[c], 0);
+        clones[c]->Destroy();
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
\ No newline at end of file
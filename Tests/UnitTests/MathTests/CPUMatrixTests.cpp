@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include <omp.h>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -898,6 +899,66 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_AUTO_TEST_CASE(CPUPhiloxKnownAnswer)
+{
+    // known answer for key 0 and counter 0 from the Random123 distribution
+    const Philox4x32::Block expected = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+    BOOST_CHECK(Philox4x32::Generate(0, 0) == expected);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRandomIndependentOfThreads, RandomSeedFixture)
+{
+    const unsigned long seed = 4711;
+
+    // The thread count is set directly, since SetNumThreads() does not go above the number of cores.
+    const int previousNumThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    auto u1 = CPUMatrix<float>::RandomUniform(257, 33, -1, 1, seed);
+    auto g1 = CPUMatrix<double>::RandomGaussian(257, 33, 0, 1, seed);
+    omp_set_num_threads(4);
+    auto u2 = CPUMatrix<float>::RandomUniform(257, 33, -1, 1, seed);
+    auto g2 = CPUMatrix<double>::RandomGaussian(257, 33, 0, 1, seed);
+    omp_set_num_threads(previousNumThreads);
+
+    BOOST_CHECK(u1.IsEqualTo(u2, 0));
+    BOOST_CHECK(g1.IsEqualTo(g2, 0));
+    foreach_coord (i, j, u1)
+    {
+        BOOST_CHECK(u1(i, j) >= -1 && u1(i, j) < 1);
+    }
+
+    // mean 0 and variance 1, within 5 standard errors
+    const double n = (double) g1.GetNumElements();
+    const double mean = g1.SumOfElements() / n;
+    const double variance = g1.ElementMultiplyWith(g1).SumOfElements() / n - mean * mean;
+    BOOST_CHECK_SMALL(mean, 5 / sqrt(n));
+    BOOST_CHECK_SMALL(variance - 1, 5 * sqrt(2 / n));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRandomMask, RandomSeedFixture)
+{
+    const unsigned long seed = 4711;
+    auto rng1 = RNGHandle::Create(CPUDEVICE, seed);
+    auto rng2 = RNGHandle::Create(CPUDEVICE, seed);
+
+    SMatrix m1(100, 100), m2(100, 100), m3(100, 100);
+    m1.SetUniformRandomMask(0.3f, 2, *rng1);
+    m2.SetUniformRandomMask(0.3f, 2, *rng1);
+    m3.SetUniformRandomMask(0.3f, 2, *rng2);
+
+    // the same seed gives the same masks, and each mask continues the stream
+    BOOST_CHECK(m1.IsEqualTo(m3, 0));
+    BOOST_CHECK(!m1.IsEqualTo(m2, 0));
+
+    size_t numMasked = 0;
+    foreach_coord (i, j, m1)
+    {
+        BOOST_CHECK(m1(i, j) == 0 || m1(i, j) == 2);
+        numMasked += m1(i, j) == 0;
+    }
+    BOOST_CHECK_CLOSE((double) numMasked, 0.3 * m1.GetNumElements(), 5);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -61,6 +61,73 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+// fills an empty CSC or CSR matrix with the elements of a dense matrix that are not zero
+static void SetSparseFromDense(SparseMatrix& sm, const DenseMatrix& dm)
+{
+    bool isCSC = sm.GetFormat() == MatrixFormat::matrixFormatSparseCSC;
+    size_t numOuter = isCSC ? dm.GetNumCols() : dm.GetNumRows();
+    size_t numInner = isCSC ? dm.GetNumRows() : dm.GetNumCols();
+    for (size_t outer = 0; outer < numOuter; outer++)
+    {
+        for (size_t inner = 0; inner < numInner; inner++)
+        {
+            size_t row = isCSC ? inner : outer;
+            size_t col = isCSC ? outer : inner;
+            if (dm(row, col) != 0)
+                sm.SetValue(row, col, dm(row, col));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixDenseTimesSparse, RandomSeedFixture)
+{
+    // more rows than one task of the product computes
+    const size_t m = 300;
+    const size_t k = 40;
+    const size_t n = 30;
+    const double alpha = 0.5;
+    const double beta = 2.0;
+
+    for (auto format : { MatrixFormat::matrixFormatSparseCSC, MatrixFormat::matrixFormatSparseCSR })
+    {
+        for (int transpose = 0; transpose < 4; transpose++)
+        {
+            bool transposeA = (transpose & 1) != 0;
+            bool transposeB = (transpose & 2) != 0;
+
+            DenseMatrix lhs(transposeA ? k : m, transposeA ? m : k);
+            lhs.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+            // about a fifth of the elements are not zero, some columns and rows are empty
+            DenseMatrix rhsDense(transposeB ? n : k, transposeB ? k : n);
+            rhsDense.SetUniformRandomValue(-1, 1, IncrementCounter());
+            foreach_coord (row, col, rhsDense)
+            {
+                if (fabs(rhsDense(row, col)) < 0.8 || row == 3 || col == 5)
+                    rhsDense(row, col) = 0;
+            }
+            SparseMatrix rhs(format, rhsDense.GetNumRows(), rhsDense.GetNumCols(), 0);
+            SetSparseFromDense(rhs, rhsDense);
+
+            // dense x sparse = dense
+            DenseMatrix expected(m, n);
+            expected.SetUniformRandomValue(-1, 1, IncrementCounter());
+            DenseMatrix result(expected);
+            DenseMatrix::MultiplyAndWeightedAdd(alpha, lhs, transposeA, rhsDense, transposeB, beta, expected);
+            SparseMatrix::MultiplyAndWeightedAdd(alpha, lhs, transposeA, rhs, transposeB, beta, result);
+            BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+
+            // dense x sparse = sparse (SparseBlockCol), added to a dense matrix
+            DenseMatrix::MultiplyAndWeightedAdd(alpha, lhs, transposeA, rhsDense, transposeB, 0, expected);
+            SparseMatrix blockResult(MatrixFormat::matrixFormatSparseBlockCol);
+            SparseMatrix::MultiplyAndAdd(alpha, lhs, transposeA, rhs, transposeB, blockResult);
+            result.SetValue(0);
+            SparseMatrix::ScaleAndAdd(1, blockResult, result);
+            BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
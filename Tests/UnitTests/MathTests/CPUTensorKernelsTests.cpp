@@ -0,0 +1,249 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Compares the explicitly vectorized CPU TensorOp kernels against the generic loops.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUTensorKernels.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef CPUSingleMatrix SMatrix;
+
+// restores the instruction set on scope exit
+struct InstructionSetScope
+{
+    CPUInstructionSet m_saved;
+    InstructionSetScope(CPUInstructionSet isa) : m_saved(CPUTensorKernels::GetInstructionSet()) { CPUTensorKernels::SetInstructionSet(isa); }
+    ~InstructionSetScope() { CPUTensorKernels::SetInstructionSet(m_saved); }
+};
+
+static void CheckClose(const SMatrix& expected, const SMatrix& actual, float tolerance)
+{
+    BOOST_REQUIRE_EQUAL(expected.GetNumElements(), actual.GetNumElements());
+    for (size_t i = 0; i < expected.GetNumElements(); i++)
+    {
+        const float e = expected.Data()[i];
+        const float a = actual.Data()[i];
+        BOOST_CHECK_SMALL(a - e, tolerance * std::max(1.0f, fabs(e)));
+    }
+}
+
+// elementwise unary op over a [rows x cols] matrix, with both a flat and a 2-dim (column-strided) layout
+static void TestUnaryOp(ElementWiseOperator op, const SMatrix& a, float alpha, float beta, float tolerance)
+{
+    const size_t rows = a.GetNumRows(), cols = a.GetNumCols();
+    SMatrix expected(rows, cols), actual(rows, cols);
+    expected.SetValue(1.0f);
+    actual.SetValue(1.0f);
+    array<size_t, 2> offsets = {0, 0};
+    SmallVector<size_t> dims = {rows, cols};
+    array<SmallVector<ptrdiff_t>, 2> strides = {SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}, SmallVector<ptrdiff_t>{1, (ptrdiff_t) rows}};
+    {
+        InstructionSetScope scope(CPUInstructionSet::None);
+        expected.TensorOp(beta, a, alpha, op, opSum, offsets, dims, strides, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>());
+    }
+    actual.TensorOp(beta, a, alpha, op, opSum, offsets, dims, strides, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>());
+    CheckClose(expected, actual, tolerance);
+}
+
+static void TestBinaryOp(ElementWiseOperator op, const SMatrix& a, const SMatrix& b, float alpha, float beta)
+{
+    const size_t rows = a.GetNumRows(), cols = a.GetNumCols();
+    SMatrix expected(rows, cols), actual(rows, cols);
+    expected.SetValue(1.0f);
+    actual.SetValue(1.0f);
+    array<size_t, 3> offsets = {0, 0, 0};
+    SmallVector<size_t> dims = {rows * cols};
+    array<SmallVector<ptrdiff_t>, 3> strides = {SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}};
+    {
+        InstructionSetScope scope(CPUInstructionSet::None);
+        expected.TensorOp(beta, a, b, alpha, op, opSum, offsets, dims, strides, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 3>());
+    }
+    actual.TensorOp(beta, a, b, alpha, op, opSum, offsets, dims, strides, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 3>());
+    CheckClose(expected, actual, 1e-6f);
+}
+
+BOOST_AUTO_TEST_SUITE(CPUMatrixSuite)
+
+BOOST_FIXTURE_TEST_CASE(CPUTensorKernelsUnaryOps, RandomSeedFixture)
+{
+    BOOST_TEST_MESSAGE("Vectorized kernels: " << CPUTensorKernels::InstructionSetName(CPUTensorKernels::SupportedInstructionSet()));
+    // odd sizes, so that the remainder handling is exercised
+    SMatrix a = SMatrix::RandomUniform(37, 53, -20.0f, 20.0f, IncrementCounter());
+    for (auto op : {opCopy, opSigmoid, opTanh, opExp, opLinearRectifier})
+    {
+        TestUnaryOp(op, a, 1.0f, 0.0f, 1e-5f);
+        TestUnaryOp(op, a, 0.5f, 0.25f, 1e-5f);
+    }
+    // Log(), including the clipped range
+    SMatrix p = SMatrix::RandomUniform(37, 53, 0.0f, 1000.0f, IncrementCounter());
+    p(0, 0) = 0;
+    p(1, 0) = -1;
+    p(2, 0) = 1e-38f;
+    TestUnaryOp(opLog, p, 1.0f, 0.0f, 1e-5f);
+    // small arguments of tanh
+    SMatrix s = SMatrix::RandomUniform(37, 53, -1.0f, 1.0f, IncrementCounter());
+    TestUnaryOp(opTanh, s, 1.0f, 0.0f, 1e-6f);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUTensorKernelsBinaryOps, RandomSeedFixture)
+{
+    // large enough to be split across threads
+    SMatrix a = SMatrix::RandomUniform(257, 301, -1.0f, 1.0f, IncrementCounter());
+    SMatrix b = SMatrix::RandomUniform(257, 301, -1.0f, 1.0f, IncrementCounter());
+    for (auto op : {opSum, opDifference, opElementwiseProduct, opElementwiseProductWithSigmoidDerivativeFromOutput,
+                    opElementwiseProductWithTanhDerivativeFromOutput, opElementwiseProductWithLinearRectifierDerivativeFromOutput})
+    {
+        TestBinaryOp(op, a, b, 1.0f, 0.0f);
+        TestBinaryOp(op, a, b, -2.0f, 1.0f);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUTensorKernelsReductions, RandomSeedFixture)
+{
+    const size_t rows = 129, cols = 67;
+    SMatrix a = SMatrix::RandomUniform(rows, cols, -1.0f, 1.0f, IncrementCounter());
+    array<size_t, 2> offsets = {0, 0};
+
+    // reference sums in double precision
+    vector<double> rowSums(rows, 0), colSums(cols, 0);
+    double total = 0;
+    float maxVal = a(0, 0), minVal = a(0, 0);
+    for (size_t j = 0; j < cols; j++)
+        for (size_t i = 0; i < rows; i++)
+        {
+            rowSums[i] += a(i, j);
+            colSums[j] += a(i, j);
+            total += a(i, j);
+            maxVal = std::max(maxVal, a(i, j));
+            minVal = std::min(minVal, a(i, j));
+        }
+
+    for (auto precision : {CPUReductionPrecision::Double, CPUReductionPrecision::ElemType, CPUReductionPrecision::Compensated})
+    {
+        CPUTensorKernels::SetReductionPrecision(precision);
+
+        // all elements into a scalar
+        SMatrix r(1, 1);
+        r.TensorOp(0, a, 1, opCopy, opSum, offsets, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>(),
+                   SmallVector<size_t>{rows * cols}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+        BOOST_CHECK_SMALL(r(0, 0) - total, 1e-3);
+        r.TensorOp(0, a, 1, opCopy, opMax, offsets, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>(),
+                   SmallVector<size_t>{rows * cols}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+        BOOST_CHECK_EQUAL(r(0, 0), maxVal);
+        r.TensorOp(0, a, 1, opCopy, opMin, offsets, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>(),
+                   SmallVector<size_t>{rows * cols}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+        BOOST_CHECK_EQUAL(r(0, 0), minVal);
+
+        // column sums (reduction over the contiguous dimension)
+        SMatrix c(1, cols);
+        c.TensorOp(0, a, 1, opCopy, opSum, offsets,
+                   SmallVector<size_t>{cols}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{(ptrdiff_t) rows}, SmallVector<ptrdiff_t>{1}},
+                   SmallVector<size_t>{rows}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+        for (size_t j = 0; j < cols; j++)
+            BOOST_CHECK_SMALL(c(0, j) - colSums[j], 1e-4);
+
+        // row sums (reduction over the outer dimension), accumulated into the target
+        SMatrix g(rows, 1);
+        g.SetValue(1.0f);
+        g.TensorOp(1, a, 2, opCopy, opSum, offsets,
+                   SmallVector<size_t>{rows}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}},
+                   SmallVector<size_t>{cols}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{(ptrdiff_t) rows}, SmallVector<ptrdiff_t>{0}});
+        for (size_t i = 0; i < rows; i++)
+            BOOST_CHECK_SMALL(g(i, 0) - (1 + 2 * rowSums[i]), 1e-4);
+
+        // inner product
+        SMatrix d(1, 1);
+        d.TensorOp(0, a, a, 1, opElementwiseProduct, opSum, array<size_t, 3>{0, 0, 0}, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 3>(),
+                   SmallVector<size_t>{rows * cols}, array<SmallVector<ptrdiff_t>, 3>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+        BOOST_CHECK_CLOSE(d(0, 0), a.FrobeniusNorm() * a.FrobeniusNorm(), 1e-3);
+    }
+    CPUTensorKernels::SetReductionPrecision(CPUReductionPrecision::Double);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUTensorKernelsCompensatedSum, RandomSeedFixture)
+{
+    // many small values on top of a large one, where plain float accumulation loses digits
+    const size_t n = 1 << 20;
+    SMatrix a(n, 1);
+    a.SetValue(0.1f);
+    a(0, 0) = 1e4f;
+    const double expected = 1e4 + (n - 1) * (double) 0.1f;
+    array<size_t, 2> offsets = {0, 0};
+    SMatrix r(1, 1);
+    CPUTensorKernels::SetReductionPrecision(CPUReductionPrecision::Compensated);
+    r.TensorOp(0, a, 1, opCopy, opSum, offsets, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>(),
+               SmallVector<size_t>{n}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+    CPUTensorKernels::SetReductionPrecision(CPUReductionPrecision::Double);
+    BOOST_CHECK_CLOSE(r(0, 0), expected, 1e-5);
+
+    // the default accumulates in double, and gives the same result as the generic loops
+    SMatrix g(1, 1);
+    {
+        InstructionSetScope scope(CPUInstructionSet::None);
+        g.TensorOp(0, a, 1, opCopy, opSum, offsets, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>(),
+                   SmallVector<size_t>{n}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+    }
+    r.TensorOp(0, a, 1, opCopy, opSum, offsets, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>(),
+               SmallVector<size_t>{n}, array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+    BOOST_CHECK_CLOSE(g(0, 0), expected, 1e-5);
+    BOOST_CHECK_EQUAL(r(0, 0), g(0, 0));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUTensorKernelsExpRange, RandomSeedFixture)
+{
+    // overflow to inf, underflow through the denormals to 0, and NaN, like expf()
+    const float inf = std::numeric_limits<float>::infinity();
+    const vector<float> x = {0.0f, 1.0f, -1.0f, 50.0f, 88.5f, 88.72f, 88.8f, 100.0f, 1e10f, inf,
+                             -50.0f, -87.0f, -87.5f, -95.0f, -103.0f, -103.9f, -104.5f, -110.0f, -1e10f, -inf,
+                             std::numeric_limits<float>::quiet_NaN()};
+    SMatrix a(x.size(), 1);
+    for (size_t i = 0; i < x.size(); i++)
+        a(i, 0) = x[i];
+    array<size_t, 2> offsets = {0, 0};
+    SmallVector<size_t> dims = {x.size()};
+    array<SmallVector<ptrdiff_t>, 2> strides = {SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{1}};
+    for (auto isa : {CPUInstructionSet::AVX2, CPUInstructionSet::AVX512}) // capped at what the CPU supports
+    {
+        InstructionSetScope scope(isa);
+        SMatrix e(x.size(), 1);
+        e.TensorOp(0, a, 1, opExp, opSum, offsets, dims, strides, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>());
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            const float expected = expf(x[i]);
+            const float actual = e(i, 0);
+            if (std::isnan(expected))
+                BOOST_CHECK(std::isnan(actual));
+            else if (std::isinf(expected) || expected == 0)
+                BOOST_CHECK_EQUAL(actual, expected);
+            else // denormal results have fewer significant bits, hence the absolute tolerance
+                BOOST_CHECK_SMALL(actual - expected, std::max(1e-6f * expected, 1e-44f));
+        }
+    }
+
+    // Sigmoid and Tanh at the ends of the range
+    SMatrix b(x.size(), 1);
+    for (size_t i = 0; i < x.size(); i++)
+        b(i, 0) = x[i] * 2;
+    for (auto op : {opSigmoid, opTanh})
+    {
+        SMatrix expected(x.size(), 1), actual(x.size(), 1);
+        {
+            InstructionSetScope scope(CPUInstructionSet::None);
+            expected.TensorOp(0, b, 1, op, opSum, offsets, dims, strides, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>());
+        }
+        actual.TensorOp(0, b, 1, op, opSum, offsets, dims, strides, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 2>());
+        for (size_t i = 0; i + 1 < x.size(); i++) // all but NaN
+            BOOST_CHECK_SMALL(actual(i, 0) - expected(i, 0), 1e-6f);
+        BOOST_CHECK(std::isnan(actual(x.size() - 1, 0)));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+} } }
@@ -12,6 +12,7 @@
 #include "../../../Source/Math/GPUMatrix.h"
 #include "../../../Source/Math/ConvolutionEngine.h"
 #include "../../../Source/Math/CuDnnFactories.h"
+#include "../../../Source/Math/DirectConvolutionEngine.h"
 #include "common.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -580,6 +581,145 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+// The direct engine is compared with the GEMM engine for convolutions and with the reference engine for pooling, both on the CPU.
+BOOST_AUTO_TEST_CASE(DirectConvolution)
+{
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<> batchSizeG(1, 8);
+    std::normal_distribution<float> nd;
+
+    auto initMat = [&](SingleMatrix& buf, size_t r, size_t c, vec& data) -> SingleMatrix
+    {
+        data.resize(r * 3 * c);
+        std::fill(begin(data), end(data), std::numeric_limits<float>::quiet_NaN());
+        std::generate(begin(data) + r * c, begin(data) + 2 * r * c, [&] { return nd(rng); });
+        buf.SetValue(r, 3 * c, buf.GetDeviceId(), data.data());
+        // Get center slice.
+        return buf.ColumnSlice(c, c);
+    };
+    auto randomMat = [&](size_t r, size_t c) -> SingleMatrix
+    {
+        vec data(r * c);
+        std::generate(begin(data), end(data), [&] { return nd(rng); });
+        return SingleMatrix(r, c, data.data(), CPUDEVICE, matrixFlagNormal);
+    };
+
+    auto configs = GenerateConvTestConfigs();
+    // More maps and channels than the engine processes in one block.
+    configs.push_back(std::make_shared<ConvolveGeometry>(TensorShape(7, 6, 10),
+        TensorShape(3, 3, 10), TensorShape(12), TensorShape(2, 2, 10),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+
+    size_t tested = 0;
+    for (const auto& g : configs)
+    {
+        if (!DirectConvolutionEngineFactory<float>::IsSupported(CPUDEVICE, g, PoolKind::None))
+            continue;
+        tested++;
+        auto baseEng = ConvEng::Create(g, CPUDEVICE, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Gemm);
+        auto testEng = ConvEng::Create(g, CPUDEVICE, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+
+        size_t n = batchSizeG(rng);
+        size_t crowIn = g->InputShape().GetNumElements();
+        size_t crowOut = g->OutputShape().GetNumElements();
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        SingleMatrix in = randomMat(crowIn, n);
+        SingleMatrix srcGrad = randomMat(crowOut, n);
+        SingleMatrix kernel = randomMat(mapCount, g->KernelShape().GetNumElements());
+        SingleMatrix workspace(CPUDEVICE);
+        vec buf;
+
+        std::stringstream tmsg;
+        tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n;
+        std::string msg = " are not equal, " + tmsg.str();
+        std::string msgNotNan = " has buffer overflow/underflow, " + tmsg.str();
+        float relErr = Err<float>::Rel;
+        float absErr = Err<float>::Abs;
+        std::string emsg;
+
+        SingleMatrix outBuf(CPUDEVICE);
+        SingleMatrix out = initMat(outBuf, crowOut, n, buf);
+        SingleMatrix outB(crowOut, n, CPUDEVICE);
+        testEng->Forward(in, kernel, out, workspace);
+        baseEng->Forward(in, kernel, outB, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr * 4, absErr * 9), "out" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(outBuf) == crowOut * 2 * n, "out" << msgNotNan);
+
+        SingleMatrix gradBuf(CPUDEVICE);
+        SingleMatrix grad = initMat(gradBuf, crowIn, n, buf);
+        SingleMatrix gradB(grad.DeepClone(), CPUDEVICE);
+        testEng->BackwardData(srcGrad, kernel, grad, workspace);
+        baseEng->BackwardData(srcGrad, kernel, gradB, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, relErr * 16, absErr * 16), "grad" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(gradBuf) == crowIn * 2 * n, "grad" << msgNotNan);
+
+        SingleMatrix kernelGradBuf(CPUDEVICE);
+        SingleMatrix kernelGrad = initMat(kernelGradBuf, mapCount, g->KernelShape().GetNumElements(), buf);
+        SingleMatrix kernelGradB(kernelGrad.DeepClone(), CPUDEVICE);
+        testEng->BackwardKernel(srcGrad, in, kernelGrad, false, workspace);
+        baseEng->BackwardKernel(srcGrad, in, kernelGradB, false, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradB, emsg, relErr * 32, absErr * 32), "kernel" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(kernelGradBuf) == kernelGrad.GetNumElements() * 2, "kernel" << msgNotNan);
+    }
+    BOOST_REQUIRE(tested > 0);
+
+    tested = 0;
+    for (auto kind : {PoolKind::Max, PoolKind::Average})
+    {
+        for (const auto& g : GeneratePoolTestConfigs())
+        {
+            if (!DirectConvolutionEngineFactory<float>::IsSupported(CPUDEVICE, g, kind))
+                continue;
+            tested++;
+            auto baseEng = ConvEng::Create(g, CPUDEVICE, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::Reference);
+            auto testEng = ConvEng::Create(g, CPUDEVICE, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::Direct);
+
+            size_t n = batchSizeG(rng);
+            size_t crowIn = g->InputShape().GetNumElements();
+            size_t crowOut = g->OutputShape().GetNumElements();
+            SingleMatrix in = randomMat(crowIn, n);
+            SingleMatrix srcGrad = randomMat(crowOut, n);
+            vec buf;
+
+            std::stringstream tmsg;
+            tmsg << "Geometry: " << (std::string)(*g) << ", Pool: " << (int)kind << ", Batch: " << n;
+            std::string msg = " are not equal, " + tmsg.str();
+            std::string msgNotNan = " has buffer overflow/underflow, " + tmsg.str();
+            float relErr = Err<float>::Rel;
+            float absErr = Err<float>::Abs;
+            std::string emsg;
+
+            SingleMatrix outBuf(CPUDEVICE);
+            SingleMatrix out = initMat(outBuf, crowOut, n, buf);
+            SingleMatrix outB(crowOut, n, CPUDEVICE);
+            testEng->ForwardPooling(in, out);
+            baseEng->ForwardPooling(in, outB);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr, absErr * 8), "out" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CountNans(outBuf) == crowOut * 2 * n, "out" << msgNotNan);
+
+            SingleMatrix gradBuf(CPUDEVICE);
+            SingleMatrix grad = initMat(gradBuf, crowIn, n, buf);
+            SingleMatrix gradB(grad.DeepClone(), CPUDEVICE);
+            testEng->BackwardPooling(out, srcGrad, in, grad);
+            baseEng->BackwardPooling(outB, srcGrad, in, gradB);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, relErr, absErr * 8), "grad" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CountNans(gradBuf) == crowIn * 2 * n, "grad" << msgNotNan);
+
+            if (kind == PoolKind::Max)
+            {
+                SingleMatrix inU(crowIn, n, CPUDEVICE);
+                inU.SetValue(0);
+                SingleMatrix inUB(inU.DeepClone(), CPUDEVICE);
+                testEng->MaxUnpooling(out, in, inU);
+                baseEng->MaxUnpooling(outB, in, inUB);
+                BOOST_REQUIRE_MESSAGE(CheckEqual(inU, inUB, emsg, 0.0f, 0.0f), "inU" << msg << ". " << emsg);
+            }
+        }
+    }
+    BOOST_REQUIRE(tested > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
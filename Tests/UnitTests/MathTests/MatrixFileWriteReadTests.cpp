@@ -73,6 +73,45 @@ BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixSparseRead.IsEqualTo(matrixSparseCopy, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixFileWriteReadBinary, RandomSeedFixture)
+{
+    Matrix<float> matrix = Matrix<float>::RandomUniform(43, 10, CPUDEVICE, -26.3f, 30.2f, IncrementCounter());
+    Matrix<float> matrixCopy = matrix.DeepClone();
+
+    std::wstring fileName(L"MB.bin");
+    {
+        File file(fileName, fileOptionsBinary | fileOptionsWrite);
+        file << 'x'; // elements are aligned within the file regardless of what precedes the matrix
+        file << matrix << matrix;
+    }
+
+    // read into a buffer of its own
+    {
+        File file(fileName, fileOptionsBinary | fileOptionsRead);
+        char tag;
+        file >> tag;
+        Matrix<float> matrixRead(CPUDEVICE), matrixRead2(CPUDEVICE);
+        file >> matrixRead >> matrixRead2;
+        BOOST_CHECK(matrixRead.IsEqualTo(matrixCopy, c_epsilonFloatE5));
+        BOOST_CHECK(matrixRead2.IsEqualTo(matrixCopy, c_epsilonFloatE5));
+        BOOST_CHECK(matrixRead.OwnBuffer());
+    }
+
+    // use the elements in place from the mapping, which outlives the file object
+    Matrix<float> matrixMapped(CPUDEVICE), matrixMapped2(CPUDEVICE);
+    {
+        File file(fileName, fileOptionsBinary | fileOptionsRead);
+        file.MapIntoMemory();
+        char tag;
+        file >> tag;
+        file >> matrixMapped >> matrixMapped2;
+    }
+    BOOST_CHECK(!matrixMapped.OwnBuffer());
+    BOOST_CHECK_EQUAL(0, reinterpret_cast<uintptr_t>(matrixMapped.Data()) % 64);
+    BOOST_CHECK(matrixMapped.IsEqualTo(matrixCopy, c_epsilonFloatE5));
+    BOOST_CHECK(matrixMapped2.IsEqualTo(matrixCopy, c_epsilonFloatE5));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(GPUMatrixSuite)
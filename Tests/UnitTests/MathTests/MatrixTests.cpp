@@ -301,6 +301,77 @@ BOOST_FIXTURE_TEST_CASE(MatrixSetValueMethods, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixSetSharedBuffer, RandomSeedFixture)
+{
+    const size_t numRows = 7, numCols = 5;
+    std::shared_ptr<float> buffer(new float[numRows * numCols], [](float* p) { delete[] p; });
+    for (size_t k = 0; k < numRows * numCols; k++)
+        buffer.get()[k] = (float) k;
+    std::weak_ptr<float> bufferAlive = buffer;
+
+    // the matrix uses the buffer in place and keeps it alive
+    SingleMatrix a(3, 3, CPUDEVICE);
+    a.SetSharedBuffer(numRows, numCols, buffer);
+    buffer.reset();
+    BOOST_CHECK(!bufferAlive.expired());
+    BOOST_CHECK(!a.OwnBuffer());
+    BOOST_CHECK_EQUAL(numRows, a.GetNumRows());
+    BOOST_CHECK_EQUAL(numCols, a.GetNumCols());
+    BOOST_CHECK_EQUAL(bufferAlive.lock().get(), a.Data());
+    foreach_coord (i, j, a)
+        BOOST_CHECK_EQUAL((float) (j * numRows + i), a(i, j));
+
+    // the buffer is handed over, so the matrix may write to it
+    a.SetValue(0, 0, -1.0f);
+    BOOST_CHECK_EQUAL(-1.0f, bufferAlive.lock().get()[0]);
+
+    // a resize to the same number of elements keeps the buffer and its data
+    a.Resize(numRows * numCols, 1);
+    BOOST_CHECK(!a.OwnBuffer());
+    BOOST_CHECK_EQUAL(bufferAlive.lock().get(), a.Data());
+    BOOST_CHECK_EQUAL(-1.0f, a(0, 0));
+    for (size_t k = 1; k < numRows * numCols; k++)
+        BOOST_CHECK_EQUAL((float) k, a(k, 0));
+
+    // a resize to a different number of elements replaces the buffer by one of the matrix' own, and releases the shared one
+    a.Resize(numRows, numCols - 1);
+    BOOST_CHECK(a.OwnBuffer());
+    BOOST_CHECK(bufferAlive.expired());
+    BOOST_CHECK_EQUAL(numRows, a.GetNumRows());
+    BOOST_CHECK_EQUAL(numCols - 1, a.GetNumCols());
+
+    // so does assigning a different shape
+    SingleMatrix b(3, 3, CPUDEVICE);
+    std::shared_ptr<float> buffer2(new float[numRows * numCols], [](float* p) { delete[] p; });
+    std::weak_ptr<float> buffer2Alive = buffer2;
+    b.SetSharedBuffer(numRows, numCols, buffer2);
+    buffer2.reset();
+    SingleMatrix c = SingleMatrix::Ones(numRows, numCols - 1, CPUDEVICE);
+    b.SetValue(c);
+    BOOST_CHECK(b.OwnBuffer());
+    BOOST_CHECK(b.IsEqualTo(c));
+    BOOST_CHECK(buffer2Alive.expired());
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixSetReadOnlyBuffer, RandomSeedFixture)
+{
+    const size_t numRows = 7, numCols = 5;
+    std::shared_ptr<float> buffer(new float[numRows * numCols], [](float* p) { delete[] p; });
+    for (size_t k = 0; k < numRows * numCols; k++)
+        buffer.get()[k] = (float) k;
+
+    // a read-only buffer (e.g., a memory-mapped model) is used in place, but cannot be resized
+    CPUMatrix<float> a(3, 3);
+    a.SetReadOnlyBuffer(numRows, numCols, std::shared_ptr<const float>(buffer));
+    BOOST_CHECK_EQUAL(buffer.get(), a.Data());
+    BOOST_CHECK_EQUAL((float) (numRows + 1), a(1, 1));
+    BOOST_CHECK_THROW(a.Resize(numRows, numCols - 1), std::logic_error);
+    BOOST_CHECK_THROW(a.Resize(numRows * numCols, 1), std::logic_error);
+    BOOST_CHECK_EQUAL(buffer.get(), a.Data());
+    for (size_t k = 0; k < numRows * numCols; k++)
+        BOOST_CHECK_EQUAL((float) k, buffer.get()[k]);
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixTransposeTest, RandomSeedFixture)
 {
     SingleMatrix a = SingleMatrix::RandomGaussian(64, 23, c_deviceIdZero, 0, 2, IncrementCounter());
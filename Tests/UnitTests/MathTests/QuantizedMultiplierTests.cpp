@@ -0,0 +1,150 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Compares the quantized 16-bit matrix product against the floating-point one.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/QuantizedMultiplier.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef Matrix<float> SingleMatrix;
+
+static float ColumnAbsMax(const SingleMatrix& m, size_t j)
+{
+    float absMax = 0;
+    for (size_t i = 0; i < m.GetNumRows(); i++)
+        absMax = std::max(absMax, fabs(m(i, j)));
+    return absMax;
+}
+
+static float RowAbsMax(const SingleMatrix& m, size_t i)
+{
+    float absMax = 0;
+    for (size_t j = 0; j < m.GetNumCols(); j++)
+        absMax = std::max(absMax, fabs(m(i, j)));
+    return absMax;
+}
+
+// Multiplies random [m x k] weights with random [k x n] input, and checks each result element against the
+// worst-case rounding error of the quantization, which is half a quantization step of each operand.
+static void TestQuantizedMultiply(size_t m, size_t k, size_t n, unsigned long seed)
+{
+    SingleMatrix weights = SingleMatrix::RandomUniform(m, k, CPUDEVICE, -1.0f, 1.0f, seed);
+    SingleMatrix input = SingleMatrix::RandomUniform(k, n, CPUDEVICE, -3.0f, 3.0f, seed + 1);
+    SingleMatrix expected(m, n, CPUDEVICE);
+    SingleMatrix::Multiply(weights, false, input, false, expected);
+
+    // the result goes into a column slice, as TimesNode does it with minibatch slices
+    SingleMatrix resultBuffer(m, n + 2, CPUDEVICE);
+    resultBuffer.SetValue(7.0f);
+    SingleMatrix result = resultBuffer.ColumnSlice(1, n);
+
+    QuantizedMultiplier<float> multiplier(weights);
+    BOOST_REQUIRE_EQUAL(multiplier.GetNumRows(), m);
+    BOOST_REQUIRE_EQUAL(multiplier.GetNumCols(), k);
+    for (int pass = 0; pass < 2; pass++) // the same multiplier must be reusable
+    {
+        multiplier.Multiply(input, result);
+
+        const float range = (float) ((1 << (QuantizedMultiplier<float>::QuantizedBits(k) - 1)) - 1);
+        for (size_t j = 0; j < n; j++)
+        {
+            const float halfStepX = ColumnAbsMax(input, j) / range / 2;
+            for (size_t i = 0; i < m; i++)
+            {
+                const float halfStepW = RowAbsMax(weights, i) / range / 2;
+                float bound = 0;
+                for (size_t l = 0; l < k; l++)
+                    bound += fabs(weights(i, l)) * halfStepX + fabs(input(l, j)) * halfStepW + halfStepW * halfStepX;
+                BOOST_CHECK_SMALL(result(i, j) - expected(i, j), bound * 1.01f + 1e-5f);
+            }
+        }
+    }
+
+    // columns outside the slice are untouched
+    for (size_t i = 0; i < m; i++)
+    {
+        BOOST_CHECK_EQUAL(resultBuffer(i, 0), 7.0f);
+        BOOST_CHECK_EQUAL(resultBuffer(i, n + 1), 7.0f);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(QuantizedMultiplierSuite)
+
+BOOST_FIXTURE_TEST_CASE(QuantizedMultiplyFourSamples, RandomSeedFixture)
+{
+    // multiples of four samples are processed four at a time
+    TestQuantizedMultiply(16, 128, 8, 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(QuantizedMultiplyAllBlockSizes, RandomSeedFixture)
+{
+    // hits all kernel block sizes of BlockMultiplier, one and four samples at a time
+    TestQuantizedMultiply(7, 128 + 64 + 32 + 16 + 8 + 3, 1, 2);
+    TestQuantizedMultiply(7, 128 + 64 + 32 + 16 + 8 + 3, 12, 3);
+    TestQuantizedMultiply(33, 2 * 128 + 8 + 1, 5, 4);
+}
+
+BOOST_FIXTURE_TEST_CASE(QuantizedMultiplyLargeInnerDimension, RandomSeedFixture)
+{
+    // with fewer bits per value for larger inner dimensions, the accumulation must not overflow
+    TestQuantizedMultiply(9, 2048, 4, 5);
+}
+
+BOOST_FIXTURE_TEST_CASE(QuantizedMultiplyZeroes, RandomSeedFixture)
+{
+    // all-zero rows and columns have no quantization scale, and must produce exact zeroes
+    SingleMatrix weights = SingleMatrix::RandomUniform(4, 10, CPUDEVICE, -1.0f, 1.0f, 6);
+    for (size_t j = 0; j < weights.GetNumCols(); j++)
+        weights(2, j) = 0;
+    SingleMatrix input = SingleMatrix::RandomUniform(10, 3, CPUDEVICE, -1.0f, 1.0f, 7);
+    input.ColumnSlice(1, 1).SetValue(0.0f);
+
+    SingleMatrix result(4, 3, CPUDEVICE);
+    QuantizedMultiplier<float> multiplier(weights);
+    multiplier.Multiply(input, result);
+    for (size_t j = 0; j < 3; j++)
+        BOOST_CHECK_EQUAL(result(2, j), 0.0f);
+    for (size_t i = 0; i < 4; i++)
+        BOOST_CHECK_EQUAL(result(i, 1), 0.0f);
+}
+
+BOOST_FIXTURE_TEST_CASE(QuantizedMultiplyCopy, RandomSeedFixture)
+{
+    // a copy shares the quantized weights, and yields the same products, also for another number of samples
+    SingleMatrix weights = SingleMatrix::RandomUniform(16, 40, CPUDEVICE, -1.0f, 1.0f, 8);
+    SingleMatrix input = SingleMatrix::RandomUniform(40, 6, CPUDEVICE, -1.0f, 1.0f, 9);
+    auto original = std::make_shared<QuantizedMultiplier<float>>(weights);
+    QuantizedMultiplier<float> copy(*original);
+    BOOST_CHECK_EQUAL(copy.GetNumRows(), 16);
+    BOOST_CHECK_EQUAL(copy.GetNumCols(), 40);
+
+    SingleMatrix expected(16, 6, CPUDEVICE);
+    original->Multiply(input, expected);
+    SingleMatrix oneSample(16, 1, CPUDEVICE);
+    original->Multiply(input.ColumnSlice(0, 1), oneSample);
+    original.reset(); // the copy keeps the weights alive
+
+    SingleMatrix result(16, 6, CPUDEVICE);
+    copy.Multiply(input, result);
+    BOOST_CHECK(result.IsEqualTo(expected, 0.0f));
+    SingleMatrix resultOneSample(16, 1, CPUDEVICE);
+    copy.Multiply(input.ColumnSlice(0, 1), resultOneSample);
+    BOOST_CHECK(resultOneSample.IsEqualTo(oneSample, 0.0f));
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedMultiplyBits)
+{
+    BOOST_CHECK_EQUAL(QuantizedMultiplier<float>::QuantizedBits(1), 16);
+    BOOST_CHECK_EQUAL(QuantizedMultiplier<float>::QuantizedBits(512), 12);
+    BOOST_CHECK_EQUAL(QuantizedMultiplier<float>::QuantizedBits(2048), 11);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,162 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for saving models in the background (SGD option asyncCheckPointSaving).
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "AsyncCheckPointWriter.h"
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iterator>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+struct CheckPointFixture
+{
+    boost::filesystem::path m_dir;
+
+    CheckPointFixture()
+        : m_dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+    {
+        boost::filesystem::create_directories(m_dir);
+    }
+    ~CheckPointFixture()
+    {
+        boost::filesystem::remove_all(m_dir);
+    }
+
+    wstring Path(const wstring& name) const
+    {
+        return (m_dir / name).wstring();
+    }
+
+    static ComputationNetworkPtr CreateNetwork(size_t dim)
+    {
+        auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+        ComputationNetworkBuilder<float> builder(*net);
+        auto features = builder.CreateInputNode(L"features", dim);
+        auto W = builder.CreateLearnableParameter(L"W", dim, dim);
+        W->Value().SetUniformRandomValue(-1, 1, 1);
+        net->AddToNodeGroup(L"output", builder.Tanh(builder.Times(W, features), L"out"));
+        net->CompileNetwork();
+        return net;
+    }
+
+    static unique_ptr<File> SaveInMemory(const ComputationNetworkPtr& net)
+    {
+        auto file = File::CreateInMemory(fileOptionsBinary | fileOptionsWrite);
+        net->Save(*file);
+        return file;
+    }
+
+    static vector<char> ReadBytes(const wstring& path)
+    {
+        std::ifstream stream(boost::filesystem::path(path).string(), std::ios::binary);
+        BOOST_REQUIRE(stream.good());
+        return vector<char>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(CheckPointSavingSuite, CheckPointFixture)
+
+BOOST_AUTO_TEST_CASE(AsyncCheckPointIsIdenticalToSyncSave)
+{
+    auto net = CreateNetwork(20);
+    net->Save(Path(L"sync.model"));
+
+    AsyncCheckPointWriter writer;
+    AsyncCheckPointWriter::FileList files;
+    files.push_back(make_pair(Path(L"async.model"), SaveInMemory(net)));
+    writer.WriteAsync(move(files), {});
+    writer.Wait();
+
+    BOOST_CHECK(!boost::filesystem::exists(Path(L"async.model.tmp")));
+    auto expected = ReadBytes(Path(L"sync.model"));
+    auto actual = ReadBytes(Path(L"async.model"));
+    BOOST_CHECK(!expected.empty());
+    BOOST_CHECK(expected == actual);
+
+    // and the model loads again
+    auto loaded = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, Path(L"async.model"));
+    BOOST_CHECK(loaded->GetNodeFromName(L"W")->As<ComputationNode<float>>()->Value().IsEqualTo(
+                net->GetNodeFromName(L"W")->As<ComputationNode<float>>()->Value(), 0));
+}
+
+BOOST_AUTO_TEST_CASE(PendingCheckPointIsWrittenBeforeTheNextOne)
+{
+    AsyncCheckPointWriter writer;
+    AsyncCheckPointWriter::FileList files;
+    files.push_back(make_pair(Path(L"model.1.ckp"), SaveInMemory(CreateNetwork(300))));
+    files.push_back(make_pair(Path(L"model.1"), SaveInMemory(CreateNetwork(300))));
+    writer.WriteAsync(move(files), {});
+
+    // the next write waits for the pending one, which then deletes the files it is told to
+    files.clear();
+    files.push_back(make_pair(Path(L"model.2"), SaveInMemory(CreateNetwork(10))));
+    writer.WriteAsync(move(files), { Path(L"model.1.ckp") });
+    BOOST_CHECK(boost::filesystem::exists(Path(L"model.1")));
+    BOOST_CHECK(!boost::filesystem::exists(Path(L"model.1.tmp")));
+    BOOST_CHECK(!boost::filesystem::exists(Path(L"model.1.ckp.tmp")));
+
+    writer.Wait();
+    BOOST_CHECK(boost::filesystem::exists(Path(L"model.2")));
+    BOOST_CHECK(!boost::filesystem::exists(Path(L"model.1.ckp")));
+}
+
+BOOST_AUTO_TEST_CASE(PendingCheckPointIsWrittenAtShutdown)
+{
+    auto net = CreateNetwork(300);
+    net->Save(Path(L"sync.model"));
+    {
+        AsyncCheckPointWriter writer;
+        AsyncCheckPointWriter::FileList files;
+        files.push_back(make_pair(Path(L"model"), SaveInMemory(net)));
+        writer.WriteAsync(move(files), {});
+    }
+    BOOST_CHECK(!boost::filesystem::exists(Path(L"model.tmp")));
+    BOOST_CHECK(ReadBytes(Path(L"sync.model")) == ReadBytes(Path(L"model")));
+}
+
+BOOST_AUTO_TEST_CASE(InMemoryFileCopyTo)
+{
+    auto file = File::CreateInMemory(fileOptionsBinary | fileOptionsWrite);
+    vector<float> values(1000);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = (float) i / 7;
+    file->PutMarker(fileMarkerBeginSection, std::wstring(L"BValues"));
+    *file << values.size();
+    for (float value : values)
+        *file << value;
+    file->PutMarker(fileMarkerEndSection, std::wstring(L"EValues"));
+
+    // copying twice gives the same content, since CopyTo() does not consume it
+    for (const auto& name : { L"copy1", L"copy2" })
+    {
+        FILE* f = fopenOrDie(Path(name), L"wb");
+        file->CopyTo(f);
+        fcloseOrDie(f);
+    }
+    BOOST_CHECK(ReadBytes(Path(L"copy1")) == ReadBytes(Path(L"copy2")));
+
+    File copy(Path(L"copy1"), fileOptionsBinary | fileOptionsRead);
+    copy.GetMarker(fileMarkerBeginSection, std::wstring(L"BValues"));
+    size_t size;
+    copy >> size;
+    BOOST_REQUIRE_EQUAL(size, values.size());
+    for (size_t i = 0; i < size; i++)
+    {
+        float value;
+        copy >> value;
+        BOOST_CHECK_EQUAL(value, values[i]);
+    }
+    copy.GetMarker(fileMarkerEndSection, std::wstring(L"EValues"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -6,9 +6,12 @@
 
 #include "Config.h"
 #include "Actions.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
 #include "boost/filesystem.hpp"
 #include <boost/test/unit_test_log.hpp>
 #include <boost/test/unit_test_suite.hpp>
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
@@ -158,6 +161,51 @@ struct DataFixture
         BOOST_CHECK_EQUAL_COLLECTIONS(beginStream1, end, beginStream2, end);
     }
 };
+
+typedef shared_ptr<ComputationNode<float>> NodePtr;
+
+// Builds a float network on the CPU, for tests that construct their network in code.
+// Parameters are drawn from one random stream with a fixed seed, in the order in which they are created,
+// so that the network is the same in every run.
+class TestNetworkBuilder : public ComputationNetworkBuilder<float>
+{
+public:
+    TestNetworkBuilder(unsigned int seed = 1)
+        : TestNetworkBuilder(make_shared<ComputationNetwork>(CPUDEVICE), seed)
+    {
+    }
+
+    const ComputationNetworkPtr& Network() const { return m_net; }
+
+    // a LearnableParameter with values drawn uniformly from [minValue, maxValue)
+    NodePtr CreateParameter(const wstring& name, size_t rows, size_t cols, float minValue = -0.5f, float maxValue = 0.5f)
+    {
+        auto node = CreateLearnableParameter(name, rows, cols);
+        std::uniform_real_distribution<float> distribution(minValue, maxValue);
+        vector<float> values(rows * cols);
+        for (auto& value : values)
+            value = distribution(m_rng);
+        node->Value().SetValue(rows, cols, CPUDEVICE, values.data());
+        return node;
+    }
+
+    // adds 'node' to the node group 'groupName', and compiles the network
+    ComputationNetworkPtr Compile(const wstring& groupName, const ComputationNodeBasePtr& node)
+    {
+        m_net->AddToNodeGroup(groupName, node);
+        m_net->CompileNetwork();
+        return m_net;
+    }
+
+private:
+    TestNetworkBuilder(const ComputationNetworkPtr& net, unsigned int seed)
+        : ComputationNetworkBuilder<float>(*net), m_net(net), m_rng(seed)
+    {
+    }
+
+    ComputationNetworkPtr m_net;
+    std::mt19937 m_rng;
+};
 }
 }
 }
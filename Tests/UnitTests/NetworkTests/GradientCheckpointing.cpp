@@ -0,0 +1,207 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for gradient checkpointing (ComputationNetwork::SetGradientCheckpointing()) and the memory plan it relies on.
+//
+#include "stdafx.h"
+#include "Common/NetworkTestHelper.h"
+#include "MatrixPool.h"
+#include "TrainingNodes.h"
+#include <limits>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featureDim = 4;
+static const size_t labelDim = 3;
+static const size_t hiddenDim = 8;
+static const size_t rnnDim = 5;
+static const size_t numSequences = 2;
+static const size_t numTimeSteps = 5;
+
+static NodePtr SigmoidLayer(TestNetworkBuilder& builder, const NodePtr& input, size_t inputDim, const wstring& name)
+{
+    auto W = builder.CreateParameter(name + L".W", hiddenDim, inputDim);
+    auto b = builder.CreateParameter(name + L".b", hiddenDim, 1);
+    return builder.Sigmoid(builder.Plus(builder.Times(W, input), b), name);
+}
+
+// A network with the nodes that carry state from forward prop and are therefore never computed again
+// (Dropout, BatchNormalization, a delay in a recurrent loop, RNNStack), between plain layers that are.
+static ComputationNetworkPtr CreateNetwork()
+{
+    TestNetworkBuilder builder;
+
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    auto labels = builder.CreateInputNode(L"labels", labelDim);
+
+    // The CPU has no batch normalization training in this tree, so the statistics are frozen (infinite time constants)
+    // and it normalizes the features, where no gradient is needed.
+    auto scale = builder.CreateParameter(L"scale", featureDim, 1);
+    auto bias = builder.CreateParameter(L"bias", featureDim, 1);
+    auto runMean = builder.CreateParameter(L"runMean", featureDim, 1);
+    auto runInvStdDev = builder.CreateParameter(L"runInvStdDev", featureDim, 1);
+    for (const auto& parameter : { scale, bias, runMean, runInvStdDev })
+        parameter->SetLearningRateMultiplier(0);
+    const double infinity = std::numeric_limits<double>::infinity();
+    auto bn = builder.BatchNormalization(features, scale, bias, runMean, runInvStdDev, false, infinity, infinity, 1e-5, true, ImageLayoutKind::CHW, L"bn");
+
+    auto h1 = SigmoidLayer(builder, bn, featureDim, L"h1");
+    auto dropout = builder.Dropout(h1, L"dropout");
+    dropout->As<DropoutNode<float>>()->SetDropoutRate(0.5);
+    dropout->As<DropoutNode<float>>()->SetRandomSeed(4711);
+    auto h2 = SigmoidLayer(builder, dropout, hiddenDim, L"h2");
+
+    auto W3 = builder.CreateParameter(L"W3", hiddenDim, hiddenDim);
+    auto h3 = builder.Tanh(builder.Times(W3, h2), L"h3");
+
+    // h4 = Tanh(W4 * h3 + U4 * PastValue(h4))
+    auto pastValue = builder.PastValue(nullptr, 0.1f, hiddenDim, 1);
+    auto W4 = builder.CreateParameter(L"W4", hiddenDim, hiddenDim);
+    auto U4 = builder.CreateParameter(L"U4", hiddenDim, hiddenDim);
+    auto h4 = builder.Tanh(builder.Plus(builder.Times(W4, h3), builder.Times(U4, pastValue)), L"h4");
+    pastValue->AttachInputs({ h4 });
+
+    auto rnnWeights = builder.CreateParameter(L"rnnWeights", 4 * rnnDim, (hiddenDim + rnnDim + 1));
+    auto rnn = builder.RNNStack(rnnWeights, h4, rnnDim, 1, L"lstm", L"rnn");
+
+    auto h5 = SigmoidLayer(builder, rnn, rnnDim, L"h5");
+    auto h6 = SigmoidLayer(builder, h5, hiddenDim, L"h6");
+    auto h7 = SigmoidLayer(builder, h6, hiddenDim, L"h7");
+    auto Wo = builder.CreateParameter(L"Wo", labelDim, hiddenDim);
+    auto z = builder.Times(Wo, h7, 1, L"z");
+    auto ce = builder.CrossEntropyWithSoftmax(labels, z, L"ce");
+
+    return builder.Compile(L"criterion", ce);
+}
+
+static void SetInputs(const ComputationNetworkPtr& net, size_t minibatch)
+{
+    auto layout = net->GetMBLayoutPtrOfNetwork();
+    layout->Init(numSequences, numTimeSteps);
+    for (size_t s = 0; s < numSequences; s++)
+        layout->AddSequence(s, s, 0, numTimeSteps);
+
+    const size_t numCols = numSequences * numTimeSteps;
+    std::mt19937 rng((unsigned int) minibatch + 2);
+    std::uniform_real_distribution<float> distribution(-1, 1);
+    vector<float> features(featureDim * numCols);
+    for (auto& value : features)
+        value = distribution(rng);
+    vector<float> labels(labelDim * numCols, 0);
+    for (size_t j = 0; j < numCols; j++)
+        labels[j * labelDim + rng() % labelDim] = 1;
+
+    auto featureNode = net->GetNodeFromName(L"features");
+    auto labelNode = net->GetNodeFromName(L"labels");
+    featureNode->As<ComputationNode<float>>()->Value().SetValue(featureDim, numCols, CPUDEVICE, features.data());
+    labelNode->As<ComputationNode<float>>()->Value().SetValue(labelDim, numCols, CPUDEVICE, labels.data());
+    ComputationNetwork::BumpEvalTimeStamp({ featureNode, labelNode });
+}
+
+// [parameter name] -> gradient, for each of a few minibatches
+static vector<map<wstring, vector<float>>> ComputeGradients(bool gradientCheckpointing, const vector<wstring>& checkpointNodeNames = vector<wstring>())
+{
+    auto net = CreateNetwork();
+    auto criterion = net->GetNodeFromName(L"ce");
+    net->SetMemoryPlanHint(numSequences * numTimeSteps);
+    if (gradientCheckpointing)
+        net->SetGradientCheckpointing(true, checkpointNodeNames);
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    vector<map<wstring, vector<float>>> gradients;
+    for (size_t minibatch = 0; minibatch < 3; minibatch++)
+    {
+        SetInputs(net, minibatch);
+        net->StartEvaluateMinibatchLoop(criterion);
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+
+        gradients.push_back(map<wstring, vector<float>>());
+        for (const auto& node : net->LearnableParameterNodes(criterion))
+        {
+            if (!node->NeedsGradient())
+                continue;
+            const auto& gradient = node->As<ComputationNode<float>>()->Gradient();
+            gradients.back()[node->NodeName()] = vector<float>(gradient.Data(), gradient.Data() + gradient.GetNumElements());
+        }
+    }
+    return gradients;
+}
+
+static void CheckIdentical(const vector<map<wstring, vector<float>>>& expected, const vector<map<wstring, vector<float>>>& actual)
+{
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t minibatch = 0; minibatch < expected.size(); minibatch++)
+    {
+        BOOST_REQUIRE_EQUAL(expected[minibatch].size(), actual[minibatch].size());
+        for (const auto& gradient : expected[minibatch])
+        {
+            auto other = actual[minibatch].find(gradient.first);
+            BOOST_REQUIRE(other != actual[minibatch].end());
+            BOOST_CHECK_MESSAGE(gradient.second == other->second, "gradient of " << string(gradient.first.begin(), gradient.first.end()) << " differs in minibatch " << minibatch);
+        }
+    }
+}
+
+// shares node values like the config option shareNodeValueMatrices does, which the dropped values rely on
+struct GradientCheckpointingFixture
+{
+    bool m_wasSharing;
+
+    GradientCheckpointingFixture()
+        : m_wasSharing(g_shareNodeValueMatrices)
+    {
+        g_shareNodeValueMatrices = true;
+    }
+    ~GradientCheckpointingFixture()
+    {
+        g_shareNodeValueMatrices = m_wasSharing;
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(GradientCheckpointingSuite)
+
+BOOST_FIXTURE_TEST_CASE(GradientCheckpointingGivesIdenticalGradients, GradientCheckpointingFixture)
+{
+    auto expected = ComputeGradients(false);
+    BOOST_REQUIRE_EQUAL(expected[0].size(), 15);
+
+    CheckIdentical(expected, ComputeGradients(true));
+    CheckIdentical(expected, ComputeGradients(true, { L"h2", L"h5", L"h6" }));
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolDoesNotShareBuffersOfLiveMatrices)
+{
+    // a is released and requested again, as a value that is computed again before backprop
+    MatrixPool pool;
+    shared_ptr<Matrix<float>> a, b, c, d;
+    pool.RequestAllocate<float>(CPUDEVICE, &a, 10, true);
+    pool.RequestAllocate<float>(CPUDEVICE, &b, 10, true);
+    pool.Release(&a);
+    pool.RequestAllocate<float>(CPUDEVICE, &c, 10, true);
+    pool.Release(&c);
+    pool.RequestAgain(&a, /*keptWithoutRecomputation=*/true);
+    pool.RequestAllocate<float>(CPUDEVICE, &d, 10, true);
+    pool.Release(&b);
+    pool.Release(&d);
+    pool.Release(&a);
+    pool.OptimizedMemoryAllocation<float>(4);
+
+    // c lives while a is dropped, so they can share; everything else overlaps
+    BOOST_CHECK(a == c);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK(a != d);
+    BOOST_CHECK(b != c);
+    BOOST_CHECK(b != d);
+    BOOST_CHECK(c != d);
+    BOOST_CHECK_EQUAL(pool.GetPlannedBytes(4), 3 * 10 * 4 * sizeof(float));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
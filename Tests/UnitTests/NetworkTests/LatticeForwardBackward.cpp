@@ -0,0 +1,235 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for the lattice forward-backward of sequence training (GammaCalculation::calgammaformb()), which processes
+// the lattices of a minibatch concurrently on the CPU.
+//
+#include "stdafx.h"
+#include "Sequences.h"
+#include "gammacalculation.h"
+#include <boost/filesystem.hpp>
+#include <omp.h>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// units: HMM index in the order of the tying file below; each has 3 states
+enum { unitSil, unitA, unitB, numUnits };
+static const size_t numStates = 3;
+static const size_t numSenones = numUnits * numStates;
+
+// layout of lattice::header_v1_v2, to write lattices in the V1 archive format
+struct LatticeHeader
+{
+    size_t numnodes : 32;
+    size_t numedges : 32;
+    float lmf;
+    float wp;
+    double frameduration;
+    size_t numframes : 32;
+    size_t impliedspunitid : 31;
+    size_t hasacscores : 1;
+};
+
+struct LatticeFixture
+{
+    boost::filesystem::path m_dir;
+    msra::asr::simplesenonehmm m_hset;
+
+    LatticeFixture()
+        : m_dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+    {
+        boost::filesystem::create_directories(m_dir);
+
+        // three left-to-right HMMs with senones sil0..sil2, a0..a2, b0..b2
+        const char* unitNames[numUnits] = { "sil", "a", "b" };
+        WriteLines(L"states.list", [&](FILE* f)
+                   {
+                       for (size_t u = 0; u < numUnits; u++)
+                           for (size_t s = 0; s < numStates; s++)
+                               fprintf(f, "%s%d\n", unitNames[u], (int) s);
+                   });
+        WriteLines(L"model.transprob", [](FILE* f)
+                   {
+                       fprintf(f, "T3 3 1 0 0 0 0.5 0.5 0 0 0 0.5 0.5 0 0 0 0.5 0.5\n");
+                   });
+        WriteLines(L"model.tying", [&](FILE* f)
+                   {
+                       for (size_t u = 0; u < numUnits; u++)
+                           fprintf(f, "%s T3 %s0 %s1 %s2\n", unitNames[u], unitNames[u], unitNames[u], unitNames[u]);
+                   });
+        m_hset.loadfromfile(Path(L"model.tying"), Path(L"states.list"), Path(L"model.transprob"));
+    }
+    ~LatticeFixture()
+    {
+        boost::filesystem::remove_all(m_dir);
+    }
+
+    wstring Path(const wstring& name) const
+    {
+        return (m_dir / name).wstring();
+    }
+
+    template <class WRITER>
+    void WriteLines(const wstring& name, WRITER writeLines)
+    {
+        FILE* f = fopenOrDie(Path(name), L"w");
+        writeLines(f);
+        fcloseOrDie(f);
+    }
+
+    // A denominator lattice of 'numFrames' frames: "a" or "b" up to 'wordEnd', followed by "sil".
+    // It is written in the V1 archive format and read back like the lattice reader does.
+    shared_ptr<const msra::dbn::latticepair> CreateLattice(const wstring& key, size_t numFrames, size_t wordEnd)
+    {
+        vector<msra::lattices::nodeinfo> nodes = { msra::lattices::nodeinfo(0), msra::lattices::nodeinfo(wordEnd), msra::lattices::nodeinfo(numFrames) };
+        // sorted by end node, then start node
+        vector<msra::lattices::edgeinfowithscores> edges = {
+            msra::lattices::edgeinfowithscores(0, 1, 0, -1.0f, 0),
+            msra::lattices::edgeinfowithscores(0, 1, 0, -2.0f, 1),
+            msra::lattices::edgeinfowithscores(1, 2, 0, -0.5f, 2),
+        };
+        vector<msra::lattices::aligninfo> align = {
+            msra::lattices::aligninfo(unitA, wordEnd),
+            msra::lattices::aligninfo(unitB, wordEnd),
+            msra::lattices::aligninfo(unitSil, numFrames - wordEnd),
+        };
+        LatticeHeader header;
+        header.numnodes = nodes.size();
+        header.numedges = edges.size();
+        header.lmf = 1.0f;
+        header.wp = 0.0f;
+        header.frameduration = 0.01;
+        header.numframes = numFrames;
+        header.impliedspunitid = INT_MAX;
+        header.hasacscores = 0;
+
+        auto path = Path(key + L".lat");
+        FILE* f = fopenOrDie(path, L"wb");
+        fputTag(f, "LAT ");
+        fputint(f, 1);
+        fwriteOrDie(&header, sizeof(header), 1, f);
+        fputTag(f, "NODE");
+        fputint(f, (int) nodes.size());
+        fwriteOrDie(nodes, f);
+        fputTag(f, "EDGE");
+        fputint(f, (int) edges.size());
+        fwriteOrDie(edges, f);
+        fputTag(f, "ALIG");
+        fputint(f, (int) align.size());
+        fwriteOrDie(align, f);
+        fputTag(f, "END ");
+        fcloseOrDie(f);
+
+        vector<size_t> idmap(numUnits);
+        for (size_t u = 0; u < numUnits; u++)
+            idmap[u] = u;
+        auto lattice = make_shared<msra::dbn::latticepair>();
+        f = fopenOrDie(path, L"rb");
+        lattice->second.fread(f, idmap, SIZE_MAX);
+        fcloseOrDie(f);
+        lattice->second.key = key;
+        return lattice;
+    }
+};
+
+// the result of calgammaformb() for a minibatch of frame-concatenated utterances
+struct Gammas
+{
+    float objective;
+    vector<float> gammas; // [senone + frame * numSenones]
+    vector<float> labels;
+};
+
+static Gammas ComputeGammas(const msra::asr::simplesenonehmm& hset, vector<shared_ptr<const msra::dbn::latticepair>> lattices,
+                            const Matrix<float>& logLLs, vector<size_t> uids, vector<size_t> boundaries)
+{
+    msra::lattices::GammaCalculation<float> gammaCalculation;
+    gammaCalculation.init(hset, CPUDEVICE);
+
+    const size_t numFrames = logLLs.GetNumCols();
+    Matrix<float> objective(1, 1, CPUDEVICE), labels(numSenones, numFrames, CPUDEVICE), gammas(numSenones, numFrames, CPUDEVICE);
+    vector<size_t> extraUttMap;
+    gammaCalculation.calgammaformb(objective, lattices, logLLs, labels, gammas, uids, boundaries, 1, nullptr, extraUttMap, /*doreferencealign=*/true);
+
+    Gammas result;
+    result.objective = objective.Get00Element();
+    result.gammas.assign(gammas.Data(), gammas.Data() + gammas.GetNumElements());
+    result.labels.assign(labels.Data(), labels.Data() + labels.GetNumElements());
+    return result;
+}
+
+BOOST_FIXTURE_TEST_SUITE(LatticeForwardBackwardSuite, LatticeFixture)
+
+BOOST_AUTO_TEST_CASE(ConcurrentLatticesGiveTheSameGammas)
+{
+    // utterances of different lengths, so that the longest ones are processed first
+    const vector<pair<size_t, size_t>> utterances = { { 7, 4 }, { 12, 6 }, { 6, 3 }, { 15, 9 }, { 9, 5 } }; // (frames, end of word)
+    vector<shared_ptr<const msra::dbn::latticepair>> lattices;
+    vector<size_t> uids, boundaries; // boundaries: 1 + unit at the first frame of each unit, else 0
+    for (size_t i = 0; i < utterances.size(); i++)
+    {
+        lattices.push_back(CreateLattice(L"utt" + std::to_wstring(i), utterances[i].first, utterances[i].second));
+        // reference: "a" for odd utterances, "b" for even ones, then "sil"; the states are spread evenly over each word
+        const size_t unit = i % 2 ? unitA : unitB;
+        for (size_t t = 0; t < utterances[i].first; t++)
+        {
+            const bool isWord = t < utterances[i].second;
+            const size_t begin = isWord ? 0 : utterances[i].second;
+            const size_t length = isWord ? utterances[i].second : utterances[i].first - utterances[i].second;
+            uids.push_back((isWord ? unit : unitSil) * numStates + (t - begin) * numStates / length);
+            boundaries.push_back(t == begin ? (isWord ? unit : unitSil) + 1 : 0);
+        }
+    }
+    const size_t numFrames = uids.size();
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> distribution(-10, 0);
+    vector<float> values(numSenones * numFrames);
+    for (auto& value : values)
+        value = distribution(rng);
+    Matrix<float> logLLs(numSenones, numFrames, values.data(), CPUDEVICE);
+
+    const int previousNumThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    auto serial = ComputeGammas(m_hset, lattices, logLLs, uids, boundaries);
+    omp_set_num_threads(4);
+    auto concurrent = ComputeGammas(m_hset, lattices, logLLs, uids, boundaries);
+    omp_set_num_threads(previousNumThreads);
+
+    // the result does not depend on the number of threads
+    BOOST_CHECK_EQUAL(serial.objective, concurrent.objective);
+    BOOST_CHECK(serial.gammas == concurrent.gammas);
+    BOOST_CHECK(serial.labels == concurrent.labels);
+
+    // and each utterance gets the gammas that it gets on its own
+    size_t begin = 0;
+    float objective = 0;
+    for (size_t i = 0; i < utterances.size(); i++)
+    {
+        const size_t length = utterances[i].first;
+        auto single = ComputeGammas(m_hset, { lattices[i] }, logLLs.ColumnSlice(begin, length),
+                                    vector<size_t>(uids.begin() + begin, uids.begin() + begin + length),
+                                    vector<size_t>(boundaries.begin() + begin, boundaries.begin() + begin + length));
+        BOOST_CHECK(std::equal(single.gammas.begin(), single.gammas.end(), concurrent.gammas.begin() + begin * numSenones));
+        BOOST_CHECK(std::equal(single.labels.begin(), single.labels.end(), concurrent.labels.begin() + begin * numSenones));
+        objective += single.objective;
+        begin += length;
+    }
+    BOOST_CHECK_CLOSE(objective, concurrent.objective, 1e-3);
+
+    // the gammas are posteriors
+    for (size_t t = 0; t < numFrames; t++)
+    {
+        float sum = 0;
+        for (size_t s = 0; s < numSenones; s++)
+            sum += concurrent.gammas[s + t * numSenones];
+        BOOST_CHECK_CLOSE(sum, 1.0f, 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -0,0 +1,133 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for the memory plan of MatrixPool, which shares buffers between matrices whose lifetimes do not overlap.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "MatrixPool.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(MemorySharingSuite)
+
+BOOST_AUTO_TEST_CASE(MatrixPoolPicksTheBestFittingBuffer)
+{
+    // a and b are live together, c and d come after them, one at a time
+    MatrixPool pool;
+    shared_ptr<Matrix<float>> a, b, c, d;
+    pool.RequestAllocate<float>(CPUDEVICE, &a, 100, false);
+    pool.RequestAllocate<float>(CPUDEVICE, &b, 20, false);
+    pool.Release(&a);
+    pool.Release(&b);
+    pool.RequestAllocate<float>(CPUDEVICE, &c, 15, false);
+    pool.Release(&c);
+    pool.RequestAllocate<float>(CPUDEVICE, &d, 60, false);
+    pool.Release(&d);
+    pool.OptimizedMemoryAllocation<float>(1);
+
+    // c would fit into either buffer and goes into the smaller one; d only fits into the larger one
+    BOOST_CHECK(a != b);
+    BOOST_CHECK(c == b);
+    BOOST_CHECK(d == a);
+    BOOST_CHECK_EQUAL(pool.GetPlannedBytes(1), (100 + 20) * sizeof(float));
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolPlansForTheMinibatchSize)
+{
+    // x and y scale with the minibatch size, z does not and comes after them
+    MatrixPool pool;
+    shared_ptr<Matrix<float>> x, y, z;
+    pool.RequestAllocate<float>(CPUDEVICE, &x, 10, true);
+    pool.RequestAllocate<float>(CPUDEVICE, &y, 5, true);
+    pool.Release(&x);
+    pool.Release(&y);
+    pool.RequestAllocate<float>(CPUDEVICE, &z, 40, false);
+    pool.Release(&z);
+    pool.OptimizedMemoryAllocation<float>(4);
+
+    // planned for 4 columns: x (40 elements) and z (40) share, y (20) gets its own
+    BOOST_CHECK(x != y);
+    BOOST_CHECK(z == x);
+    BOOST_CHECK_EQUAL(pool.GetPlannedBytes(4), (40 + 20) * sizeof(float));
+    // the shared buffers grow with the minibatch
+    BOOST_CHECK_EQUAL(pool.GetPlannedBytes(8), (80 + 40) * sizeof(float));
+    BOOST_CHECK_EQUAL(pool.GetPlannedBytes(1), (40 + 5) * sizeof(float));
+}
+
+// shares node values for the duration of a test, like the config option shareNodeValueMatrices does
+struct ValueSharingFixture
+{
+    bool m_wasSharing;
+
+    ValueSharingFixture()
+        : m_wasSharing(g_shareNodeValueMatrices)
+    {
+        g_shareNodeValueMatrices = true;
+    }
+    ~ValueSharingFixture()
+    {
+        g_shareNodeValueMatrices = m_wasSharing;
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(NetworkSharesValuesOfLayersThatAreNotLiveTogether, ValueSharingFixture)
+{
+    const size_t dim = 16, numLayers = 8, numSamples = 10;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    shared_ptr<ComputationNode<float>> input = builder.CreateInputNode(L"features", dim);
+    vector<shared_ptr<ComputationNode<float>>> products, layers;
+    for (size_t i = 0; i < numLayers; i++)
+    {
+        auto W = builder.CreateLearnableParameter(L"W" + std::to_wstring(i), dim, dim);
+        W->Value().SetUniformRandomValue(-1, 1, (unsigned long) i + 1);
+        products.push_back(builder.Times(W, input, 1, L"z" + std::to_wstring(i)));
+        input = builder.Sigmoid(products.back(), L"h" + std::to_wstring(i));
+        layers.push_back(input);
+    }
+    ComputationNodeBasePtr output = input;
+    net->AddToNodeGroup(L"output", output);
+    net->CompileNetwork();
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    net->AllocateAllMatrices({ output }, {}, nullptr);
+    auto features = net->GetNodeFromName(L"features");
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    features->As<ComputationNode<float>>()->Value().Resize(dim, numSamples);
+    features->As<ComputationNode<float>>()->Value().SetUniformRandomValue(-1, 1, 1);
+    ComputationNetwork::BumpEvalTimeStamp({ features });
+    net->StartEvaluateMinibatchLoop(output);
+    net->ForwardProp(output);
+
+    // Each value is only read by the next node, so values further apart share a buffer,
+    // but never with the value they are computed from.
+    set<const Matrix<float>*> buffers;
+    for (size_t i = 0; i < numLayers; i++)
+    {
+        buffers.insert(&products[i]->Value());
+        buffers.insert(&layers[i]->Value());
+        BOOST_CHECK(&products[i]->Value() != &layers[i]->Value());
+        if (i > 0)
+            BOOST_CHECK(&products[i]->Value() != &layers[i - 1]->Value());
+    }
+    BOOST_CHECK_LT(buffers.size(), 2 * numLayers);
+
+    // and the output is that of the layers computed one after another
+    Matrix<float> expected(features->As<ComputationNode<float>>()->Value().DeepClone());
+    for (size_t i = 0; i < numLayers; i++)
+    {
+        Matrix<float> product(CPUDEVICE);
+        Matrix<float>::Multiply(net->GetNodeFromName(L"W" + std::to_wstring(i))->As<ComputationNode<float>>()->Value(), false, expected, false, product);
+        expected.AssignSigmoidOf(product);
+    }
+    BOOST_CHECK(layers.back()->Value().IsEqualTo(expected, 1e-6f));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
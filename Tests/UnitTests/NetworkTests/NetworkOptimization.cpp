@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests that ComputationNetwork::OptimizeForInference() does not change what the network computes.
+//
+#include "stdafx.h"
+#include "Common/NetworkTestHelper.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "TrainingNodes.h"
+#include "SpecialPurposeNodes.h"
+#include <boost/filesystem.hpp>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t numInputs = 3;
+static const size_t numOutputs = 4;
+static const size_t numSamples = 5;
+
+// out = Tanh(Sigmoid(BatchNormalization(Times(A * B, features) + b0) .* c + d))
+// A * B only depends on parameters, the BatchNormalization follows a Times() with a bias,
+// and the nodes after Times() form an elementwise chain.
+static ComputationNetworkPtr CreateNetwork()
+{
+    TestNetworkBuilder builder;
+
+    auto features = builder.CreateInputNode(L"features", numInputs);
+    auto A = builder.CreateParameter(L"A", numOutputs, 2, -1, 1);
+    auto B = builder.CreateParameter(L"B", 2, numInputs, -1, 1);
+    auto b0 = builder.CreateParameter(L"b0", numOutputs, 1, -1, 1);
+    auto scale = builder.CreateParameter(L"scale", numOutputs, 1, 0.5, 2);
+    auto bias = builder.CreateParameter(L"bias", numOutputs, 1, -1, 1);
+    auto runMean = builder.CreateParameter(L"runMean", numOutputs, 1, -1, 1);
+    auto runInvStdDev = builder.CreateParameter(L"runInvStdDev", numOutputs, 1, 0.5, 2);
+    auto c = builder.CreateParameter(L"c", numOutputs, 1, -1, 1);
+    auto d = builder.CreateParameter(L"d", numOutputs, 1, -1, 1);
+
+    auto W = builder.Times(A, B, 1, L"W");
+    auto z = builder.Plus(builder.Times(W, features), b0);
+    auto bn = builder.BatchNormalization(z, scale, bias, runMean, runInvStdDev);
+    auto out = builder.Tanh(builder.Sigmoid(builder.Plus(builder.ElementTimes(bn, c), d)), L"out");
+
+    return builder.Compile(L"output", out);
+}
+
+static vector<float> Evaluate(const ComputationNetworkPtr& net)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    auto features = net->GetNodeFromName(L"features");
+    auto out = net->GetNodeFromName(L"out");
+    net->AllocateAllMatrices({ out }, {}, nullptr);
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> distribution(-2, 2);
+    vector<float> input(numInputs * numSamples);
+    for (auto& value : input)
+        value = distribution(rng);
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    features->As<ComputationNode<float>>()->Value().SetValue(numInputs, numSamples, CPUDEVICE, input.data());
+    ComputationNetwork::BumpEvalTimeStamp({ features });
+
+    net->StartEvaluateMinibatchLoop(out);
+    net->ForwardProp(out);
+    const auto& value = out->As<ComputationNode<float>>()->Value();
+    BOOST_REQUIRE_EQUAL(value.GetNumElements(), numOutputs * numSamples);
+    return vector<float>(value.Data(), value.Data() + value.GetNumElements());
+}
+
+// optimizes a copy of the network, and returns it as the 'optimize' action writes it
+static ComputationNetworkPtr Optimize(bool fuseElementwise)
+{
+    auto net = CreateNetwork();
+    net->OptimizeForInference<float>({ L"out" }, fuseElementwise);
+
+    auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    net->Save(path.wstring());
+    auto optimized = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, path.wstring());
+    boost::filesystem::remove(path);
+    return optimized;
+}
+
+static void CheckEqual(const vector<float>& expected, const vector<float>& actual)
+{
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+        BOOST_CHECK_SMALL(expected[i] - actual[i], 1e-5f);
+}
+
+BOOST_AUTO_TEST_SUITE(NetworkOptimizationSuite)
+
+BOOST_AUTO_TEST_CASE(OptimizeForInferenceFoldsConstantsAndBatchNormalization)
+{
+    auto original = CreateNetwork();
+    auto optimized = Optimize(/*fuseElementwise=*/false);
+
+    BOOST_CHECK_EQUAL(original->GetNodesWithType(OperationNameOf(TimesNode)).size(), 2);
+    BOOST_CHECK_EQUAL(optimized->GetNodesWithType(OperationNameOf(TimesNode)).size(), 1);
+    BOOST_CHECK_EQUAL(optimized->GetNodesWithType(OperationNameOf(BatchNormalizationNode)).size(), 0);
+    BOOST_CHECK_EQUAL(optimized->GetNodesWithType(OperationNameOf(FusedElementwiseNode)).size(), 0);
+
+    CheckEqual(Evaluate(original), Evaluate(optimized));
+}
+
+BOOST_AUTO_TEST_CASE(OptimizeForInferenceFusesElementwiseChains)
+{
+    auto original = CreateNetwork();
+    auto optimized = Optimize(/*fuseElementwise=*/true);
+
+    BOOST_CHECK_EQUAL(optimized->GetNodesWithType(OperationNameOf(BatchNormalizationNode)).size(), 0);
+    BOOST_CHECK_EQUAL(optimized->GetNodesWithType(OperationNameOf(FusedElementwiseNode)).size(), 1);
+    BOOST_CHECK_EQUAL(optimized->GetNodesWithType(OperationNameOf(SigmoidNode)).size(), 0);
+
+    CheckEqual(Evaluate(original), Evaluate(optimized));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
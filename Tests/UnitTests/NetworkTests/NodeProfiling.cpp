@@ -0,0 +1,145 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for NodeProfiler, which SGD uses for the options nodeProfilerMinibatches, nodeProfilerSkipMinibatches and nodeProfilerTimeline.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "NodeProfiler.h"
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <fstream>
+#include <iterator>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t inputDim = 6;
+static const size_t outputDim = 4;
+static const size_t numSamples = 8;
+
+struct NodeProfilerFixture
+{
+    ComputationNetworkPtr m_net;
+    ComputationNodeBasePtr m_criterion;
+    boost::filesystem::path m_dir;
+
+    NodeProfilerFixture()
+        : m_net(make_shared<ComputationNetwork>(CPUDEVICE)),
+          m_dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+    {
+        ComputationNetworkBuilder<float> builder(*m_net);
+        auto features = builder.CreateInputNode(L"features", inputDim);
+        auto labels = builder.CreateInputNode(L"labels", outputDim);
+        auto W = builder.CreateLearnableParameter(L"W", outputDim, inputDim);
+        auto b = builder.CreateLearnableParameter(L"b", outputDim, 1);
+        W->Value().SetUniformRandomValue(-1, 1, 1);
+        auto z = builder.Sigmoid(builder.Plus(builder.Times(W, features, 1, L"Wx"), b, L"Wxb"), L"z");
+        auto criterion = builder.SquareError(labels, z, L"se");
+        m_net->AddToNodeGroup(L"criterion", criterion);
+        m_net->CompileNetwork();
+        m_net->AllocateAllMatrices({}, {}, criterion);
+        m_criterion = criterion;
+
+        boost::filesystem::create_directories(m_dir);
+    }
+    ~NodeProfilerFixture()
+    {
+        boost::filesystem::remove_all(m_dir);
+    }
+
+    // run minibatches like SGD does, with the profiler set on the network
+    void Train(NodeProfiler& profiler, size_t numMinibatches)
+    {
+        m_net->SetNodeProfiler(shared_ptr<NodeProfiler>(&profiler, [](NodeProfiler*) { }));
+        ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::training);
+        for (size_t i = 0; i < numMinibatches; i++)
+        {
+            profiler.NextMinibatch();
+            auto readStart = NodeProfiler::Clock::now();
+            m_net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+            auto features = m_net->GetNodeFromName(L"features");
+            auto labels = m_net->GetNodeFromName(L"labels");
+            features->As<ComputationNode<float>>()->Value().Resize(inputDim, numSamples);
+            features->As<ComputationNode<float>>()->Value().SetUniformRandomValue(-1, 1, (unsigned long) i + 1);
+            labels->As<ComputationNode<float>>()->Value().Resize(outputDim, numSamples);
+            labels->As<ComputationNode<float>>()->Value().SetUniformRandomValue(0, 1, (unsigned long) i + 100);
+            ComputationNetwork::BumpEvalTimeStamp({ features, labels });
+            profiler.RecordSpan(L"ReadMinibatch", readStart);
+
+            m_net->StartEvaluateMinibatchLoop(m_criterion);
+            m_net->ForwardProp(m_criterion);
+            m_net->Backprop(m_criterion);
+        }
+        m_net->SetNodeProfiler(nullptr);
+    }
+
+    wstring Path(const wstring& name) const
+    {
+        return (m_dir / name).wstring();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(NodeProfilerSuite, NodeProfilerFixture)
+
+BOOST_AUTO_TEST_CASE(NodeProfilerSummaryCoversEachNode)
+{
+    NodeProfiler profiler(3);
+    Train(profiler, 3);
+    BOOST_CHECK_EQUAL(profiler.GetNumProfiledMinibatches(), 3);
+
+    auto path = Path(L"summary.txt");
+    FILE* f = fopenOrDie(path, L"w");
+    profiler.WriteSummary(f, SIZE_MAX);
+    fcloseOrDie(f);
+    std::ifstream stream(boost::filesystem::path(path).string());
+    string summary((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    BOOST_CHECK(summary.find("Node profile of 3 minibatches (after skipping 0)") != string::npos);
+    for (const auto& node : m_net->GetEvalOrder(m_criterion))
+    {
+        if (node->IsLeaf())
+            continue;
+        string name = msra::strfun::utf8(node->NodeName() + L" (" + node->OperationName() + L")");
+        BOOST_CHECK_MESSAGE(summary.find(name) != string::npos, "node " << name << " is missing from the summary");
+    }
+    BOOST_CHECK(summary.find("ReadMinibatch") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(NodeProfilerTimelineIsChromeTrace)
+{
+    // skip 2 minibatches and profile 3 of the 7
+    NodeProfiler profiler(3, 2);
+    Train(profiler, 7);
+    BOOST_CHECK(profiler.IsDone());
+    BOOST_CHECK_EQUAL(profiler.GetNumProfiledMinibatches(), 3);
+
+    auto path = Path(L"timeline.json");
+    profiler.WriteTimeline(path);
+    boost::property_tree::ptree trace;
+    BOOST_REQUIRE_NO_THROW(boost::property_tree::read_json(boost::filesystem::path(path).string(), trace));
+
+    // complete events ("ph": "X") with a start and a duration; each node is run once per profiled minibatch
+    map<pair<string, string>, size_t> numEvents; // (name, category) -> number
+    for (const auto& event : trace.get_child("traceEvents"))
+    {
+        BOOST_CHECK_EQUAL(event.second.get<string>("ph"), "X");
+        BOOST_CHECK_GE(event.second.get<double>("ts"), 0);
+        BOOST_CHECK_GE(event.second.get<double>("dur"), 0);
+        numEvents[make_pair(event.second.get<string>("name"), event.second.get<string>("cat"))]++;
+    }
+    BOOST_CHECK_EQUAL(numEvents[make_pair(string("ReadMinibatch"), string("other"))], 3);
+    for (const auto& name : { "Wx", "Wxb", "z", "se" })
+    {
+        BOOST_CHECK_EQUAL(numEvents[make_pair(string(name), string("forward"))], 3);
+        BOOST_CHECK_EQUAL(numEvents[make_pair(string(name), string("backward"))], 3);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
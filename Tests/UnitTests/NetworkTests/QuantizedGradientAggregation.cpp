@@ -0,0 +1,213 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for QuantizedDistGradAggregator and SimpleDistGradAggregator. They pass for any number of MPI ranks (as do the other network tests); to test
+// the exchange itself, run e.g.
+//     mpiexec -n 2 networktests
+//
+#include "stdafx.h"
+#include "Matrix.h"
+#include "MPIWrapper.h"
+#include "DistGradHeader.h"
+#include "QuantizedDistGradAggregator.h"
+#include "SimpleDistGradAggregator.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// MPIWrapper is a singleton that can only be created once per process
+static MPIWrapperPtr GetMPI()
+{
+    static MPIWrapperPtr mpi = std::make_shared<MPIWrapper>();
+    return mpi;
+}
+
+template <class ElemType>
+static void TestQuantizedAggregation(size_t numGradientBits)
+{
+    auto mpi = GetMPI();
+    const size_t rank = mpi->CurrentNodeRank();
+    const size_t numRanks = mpi->NumNodesInUse();
+    const size_t rows = 37, cols = 5;
+    const int numSteps = 50;
+
+    QuantizedDistGradAggregator<ElemType> aggregator(mpi, numGradientBits, /*zeroThresholdFor1Bit=*/true, /*syncStatsTrace=*/0);
+    Matrix<ElemType> gradient(rows, cols, CPUDEVICE);
+    Matrix<ElemType> constantGradient(100, 3, CPUDEVICE);
+    std::vector<Matrix<ElemType>*> gradients = { &gradient, &constantGradient };
+    DistGradHeader* header = DistGradHeader::Create(1);
+
+    Matrix<ElemType> trueSum(rows, cols, CPUDEVICE), cumulativeTrueSum(rows, cols, CPUDEVICE), cumulativeAggregate(rows, cols, CPUDEVICE);
+    Matrix<ElemType> difference(rows, cols, CPUDEVICE);
+    cumulativeTrueSum.SetValue(0);
+    cumulativeAggregate.SetValue(0);
+    double maxStepError = 0;
+    for (int step = 0; step < numSteps; step++)
+    {
+        // every rank generates the gradients of all ranks, to know the exact sum
+        trueSum.SetValue(0);
+        for (size_t r = 0; r < numRanks; r++)
+        {
+            auto rankGradient = Matrix<ElemType>::RandomUniform(rows, cols, CPUDEVICE, -1, 1, 1000 * step + r + 1);
+            trueSum += rankGradient;
+            if (r == rank)
+                gradient.SetValue(rankGradient);
+        }
+        constantGradient.SetValue((ElemType) (rank + 1));
+        header->numSamples = 10 + rank;
+        header->numSamplesWithLabel = 10 + rank;
+        header->criterion = 1.5 * (rank + 1);
+        header->evalErrors[0] = std::make_pair(1.0, rank + 1);
+
+        aggregator.AggregateGradients(gradients, header, /*epochNumber=*/0);
+
+        // the headers are summed
+        BOOST_REQUIRE_EQUAL(header->numSamples, 10 * numRanks + numRanks * (numRanks - 1) / 2);
+        BOOST_REQUIRE_EQUAL(header->numSamplesWithLabel, header->numSamples);
+        BOOST_REQUIRE_CLOSE(header->criterion, 1.5 * numRanks * (numRanks + 1) / 2, 1e-8);
+        BOOST_REQUIRE_EQUAL(header->evalErrors[0].second, numRanks * (numRanks + 1) / 2);
+
+        difference.AssignDifferenceOf(gradient, trueSum);
+        maxStepError = std::max(maxStepError, (double) difference.FrobeniusNorm());
+        cumulativeTrueSum += trueSum;
+        cumulativeAggregate += gradient;
+    }
+
+    // A constant column is represented exactly.
+    for (size_t j = 0; j < constantGradient.GetNumCols(); j++)
+        for (size_t i = 0; i < constantGradient.GetNumRows(); i++)
+            BOOST_CHECK_CLOSE((double) constantGradient(i, j), numRanks * (numRanks + 1) / 2.0, 1e-4);
+
+    // With error feedback, the quantization error does not accumulate: the error of the sum over all steps
+    // is that of a single step, rather than growing with the number of steps.
+    difference.AssignDifferenceOf(cumulativeAggregate, cumulativeTrueSum);
+    BOOST_CHECK_LE(difference.FrobeniusNorm(), 2 * maxStepError);
+
+    // all ranks have the same result
+    double checksum = gradient.SumOfElements() + cumulativeAggregate.SumOfElements();
+    double minChecksum = checksum, maxChecksum = checksum;
+    MPI_Allreduce(MPI_IN_PLACE, &minChecksum, 1, MPI_DOUBLE, MPI_MIN, mpi->Communicator());
+    MPI_Allreduce(MPI_IN_PLACE, &maxChecksum, 1, MPI_DOUBLE, MPI_MAX, mpi->Communicator());
+    BOOST_CHECK_EQUAL(minChecksum, maxChecksum);
+
+    DistGradHeader::Destroy(header);
+}
+
+BOOST_AUTO_TEST_SUITE(QuantizedGradientAggregationSuite)
+
+BOOST_AUTO_TEST_CASE(QuantizedAggregation1Bit)
+{
+    TestQuantizedAggregation<float>(1);
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedAggregation2Bits)
+{
+    TestQuantizedAggregation<float>(2);
+    TestQuantizedAggregation<double>(2);
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedAggregation4And8Bits)
+{
+    TestQuantizedAggregation<float>(4);
+    TestQuantizedAggregation<float>(8);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// Aggregates the same gradients with and without buckets. The buckets are small, so that gradients are split
+// across several of them; from the second step on, they are started during a simulated backprop.
+template <class ElemType>
+static void TestBucketedAggregation(size_t bucketSizeInBytes)
+{
+    auto mpi = GetMPI();
+    const size_t rank = mpi->CurrentNodeRank();
+    const size_t numRanks = mpi->NumNodesInUse();
+    const std::vector<std::pair<size_t, size_t>> shapes = { { 37, 5 }, { 1, 1 }, { 100, 3 }, { 64, 16 }, { 7, 1 } };
+    const int numSteps = 5;
+
+    SimpleDistGradAggregator<ElemType> bucketed(mpi, /*useAsyncAggregation=*/false, /*syncStatsTrace=*/0, bucketSizeInBytes);
+    SimpleDistGradAggregator<ElemType> unbucketed(mpi, /*useAsyncAggregation=*/false, /*syncStatsTrace=*/0);
+    std::vector<std::unique_ptr<Matrix<ElemType>>> bucketedGradients, unbucketedGradients, trueSums;
+    std::vector<Matrix<ElemType>*> bucketedPtrs, unbucketedPtrs;
+    for (const auto& shape : shapes)
+    {
+        bucketedGradients.emplace_back(new Matrix<ElemType>(shape.first, shape.second, CPUDEVICE));
+        unbucketedGradients.emplace_back(new Matrix<ElemType>(shape.first, shape.second, CPUDEVICE));
+        trueSums.emplace_back(new Matrix<ElemType>(shape.first, shape.second, CPUDEVICE));
+        bucketedPtrs.push_back(bucketedGradients.back().get());
+        unbucketedPtrs.push_back(unbucketedGradients.back().get());
+    }
+    DistGradHeader* bucketedHeader = DistGradHeader::Create(1);
+    DistGradHeader* unbucketedHeader = DistGradHeader::Create(1);
+
+    for (int step = 0; step < numSteps; step++)
+    {
+        // every rank generates the gradients of all ranks, to know the exact sum
+        for (size_t i = 0; i < shapes.size(); i++)
+        {
+            trueSums[i]->SetValue(0);
+            for (size_t r = 0; r < numRanks; r++)
+            {
+                auto rankGradient = Matrix<ElemType>::RandomUniform(shapes[i].first, shapes[i].second, CPUDEVICE, -1, 1, 1000 * step + 100 * i + r + 1);
+                *trueSums[i] += rankGradient;
+                if (r == rank)
+                {
+                    bucketedGradients[i]->SetValue(rankGradient);
+                    unbucketedGradients[i]->SetValue(rankGradient);
+                }
+            }
+        }
+        for (auto header : { bucketedHeader, unbucketedHeader })
+        {
+            header->numSamples = 10 + rank;
+            header->numSamplesWithLabel = 10 + rank;
+            header->criterion = 1.5 * (rank + 1);
+            header->evalErrors[0] = std::make_pair(1.0, rank + 1);
+        }
+
+        // backprop completes the gradients in reverse order
+        BOOST_REQUIRE_EQUAL(bucketed.SupportsGradientCompletionCallbacks(), step > 0);
+        BOOST_REQUIRE(!unbucketed.SupportsGradientCompletionCallbacks());
+        if (bucketed.SupportsGradientCompletionCallbacks())
+        {
+            for (size_t i = shapes.size(); i-- > 0;)
+                bucketed.OnGradientComplete(bucketedPtrs[i]);
+        }
+
+        bucketed.AggregateGradients(bucketedPtrs, bucketedHeader, /*epochNumber=*/0);
+        unbucketed.AggregateGradients(unbucketedPtrs, unbucketedHeader, /*epochNumber=*/0);
+
+        BOOST_REQUIRE_EQUAL(bucketedHeader->numSamples, unbucketedHeader->numSamples);
+        BOOST_REQUIRE_EQUAL(bucketedHeader->numSamples, 10 * numRanks + numRanks * (numRanks - 1) / 2);
+        BOOST_REQUIRE_CLOSE(bucketedHeader->criterion, unbucketedHeader->criterion, 1e-8);
+        BOOST_REQUIRE_EQUAL(bucketedHeader->evalErrors[0].second, unbucketedHeader->evalErrors[0].second);
+        for (size_t i = 0; i < shapes.size(); i++)
+        {
+            // both sum the same numbers, possibly in a different order if there are more than two ranks
+            BOOST_CHECK(bucketedGradients[i]->IsEqualTo(*unbucketedGradients[i], numRanks <= 2 ? 0 : (ElemType) 1e-6));
+            BOOST_CHECK(bucketedGradients[i]->IsEqualTo(*trueSums[i], (ElemType) 1e-5));
+        }
+    }
+
+    DistGradHeader::Destroy(bucketedHeader);
+    DistGradHeader::Destroy(unbucketedHeader);
+}
+
+BOOST_AUTO_TEST_SUITE(GradientBucketingSuite)
+
+BOOST_AUTO_TEST_CASE(BucketedAggregationMatchesUnbucketed)
+{
+    TestBucketedAggregation<float>(/*bucketSizeInBytes=*/256);
+    TestBucketedAggregation<double>(/*bucketSizeInBytes=*/256);
+}
+
+BOOST_AUTO_TEST_CASE(BucketedAggregationWithOneBucket)
+{
+    TestBucketedAggregation<float>(/*bucketSizeInBytes=*/1 << 20);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -0,0 +1,104 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for quantized inference of TimesNode, which computes W * X with 16-bit integers while inferring.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "LinearAlgebraNodes.h"
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t inputDim = 64;
+static const size_t outputDim = 16;
+static const size_t numSamples = 7;
+
+// features -> Times(W, features) twice, quantized ("quantized") and in float ("float")
+static ComputationNetworkPtr CreateNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto W = builder.CreateLearnableParameter(L"W", outputDim, inputDim);
+    W->Value().SetUniformRandomValue(-1, 1, 1);
+    auto quantized = builder.Times(W, features, 1, L"quantized");
+    auto reference = builder.Times(W, features, 1, L"float");
+    dynamic_pointer_cast<IQuantizableNode>(quantized)->SetQuantizedInference(true);
+    net->AddToNodeGroup(L"output", quantized);
+    net->AddToNodeGroup(L"output", reference);
+    net->CompileNetwork();
+    net->AllocateAllMatrices(net->OutputNodes(), {}, nullptr);
+    return net;
+}
+
+// returns the values of the nodes "quantized" and "float"
+static pair<Matrix<float>, Matrix<float>> Evaluate(const ComputationNetworkPtr& net, NetworkOperationMode mode)
+{
+    ScopedNetworkOperationMode modeGuard(net, mode);
+    auto features = net->GetNodeFromName(L"features");
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    features->As<ComputationNode<float>>()->Value().Resize(inputDim, numSamples);
+    features->As<ComputationNode<float>>()->Value().SetUniformRandomValue(-1, 1, 2);
+    ComputationNetwork::BumpEvalTimeStamp({ features });
+    net->StartEvaluateMinibatchLoop(net->OutputNodes());
+    net->ForwardProp(net->OutputNodes());
+    return make_pair(net->GetNodeFromName(L"quantized")->As<ComputationNode<float>>()->Value().DeepClone(),
+                     net->GetNodeFromName(L"float")->As<ComputationNode<float>>()->Value().DeepClone());
+}
+
+BOOST_AUTO_TEST_SUITE(QuantizedInferenceSuite)
+
+BOOST_AUTO_TEST_CASE(QuantizedTimesIsCloseToFloatTimes)
+{
+    auto net = CreateNetwork();
+    auto result = Evaluate(net, NetworkOperationMode::inferring);
+
+    // With 13-bit operands for K = 64, the error is far below 1% of the largest output.
+    Matrix<float> difference(CPUDEVICE);
+    difference.AssignDifferenceOf(result.first, result.second);
+    float maxAbs = result.second.MatrixNormInf();
+    BOOST_CHECK_GT(maxAbs, 1.0f);
+    BOOST_CHECK_LE(difference.MatrixNormInf(), 0.01f * maxAbs);
+    // but the product was really computed differently
+    BOOST_CHECK_GT(difference.MatrixNormInf(), 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedTimesIsNotUsedInTraining)
+{
+    auto net = CreateNetwork();
+    auto result = Evaluate(net, NetworkOperationMode::training);
+    BOOST_CHECK(result.first.IsEqualTo(result.second, 0.0f));
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedTimesOfClones)
+{
+    // Clones share the quantized weights, but multiply on their own, also concurrently.
+    auto net = CreateNetwork();
+    auto expected = Evaluate(net, NetworkOperationMode::inferring).first;
+    const size_t numClones = 3;
+    vector<ComputationNetworkPtr> clones;
+    for (size_t c = 0; c < numClones; c++)
+    {
+        clones.push_back(net->CloneSharingParameters());
+        clones.back()->AllocateAllMatrices(clones.back()->OutputNodes(), {}, nullptr);
+    }
+
+    vector<shared_ptr<Matrix<float>>> results(numClones);
+    vector<std::thread> threads;
+    for (size_t c = 0; c < numClones; c++)
+        threads.push_back(std::thread([&, c]() { results[c] = make_shared<Matrix<float>>(Evaluate(clones[c], NetworkOperationMode::inferring).first); }));
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t c = 0; c < numClones; c++)
+        BOOST_CHECK(results[c]->IsEqualTo(expected, 0.0f));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -16,6 +16,7 @@
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
 #include "TextParser.h"
+#include "BinaryTextFormat.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -436,6 +437,57 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100_jagged_sparse)
         true);
 };
 
+// same as above, with the index written to the cache file by the first run and loaded from it by the second
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100_jagged_sparse_index_cache)
+{
+    const string indexCacheFile = "100x100_jagged_sparse.txt.index";
+    boost::filesystem::remove(indexCacheFile);
+    for (int run = 0; run < 2; run++)
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/CNTKTextFormatReader/sparse.cntk",
+            testDataPath() + "/Control/CNTKTextFormatReader/100x100_jagged_sparse.txt",
+            testDataPath() + "/Control/CNTKTextFormatReader/100x100_jagged_sparse_Output.txt",
+            "100x100_jagged",
+            "reader",
+            4887,  // epoch size
+            4887,  // mb size
+            1,  // num epochs
+            1,
+            0,
+            0,
+            1,
+            true,
+            false,
+            true,
+            { L"100x100_jagged=[reader=[cacheIndex=true;chunkSizeInBytes=1000]]" });
+        BOOST_CHECK(boost::filesystem::exists(indexCacheFile));
+    }
+    boost::filesystem::remove(indexCacheFile);
+};
+
+// same as above, with each chunk split into slices that are parsed in parallel
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100_jagged_sparse_parallel_parsing)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKTextFormatReader/sparse.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/100x100_jagged_sparse.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/100x100_jagged_sparse_Output.txt",
+        "100x100_jagged",
+        "reader",
+        4887,  // epoch size
+        4887,  // mb size
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true,
+        false,
+        true,
+        { L"100x100_jagged=[reader=[numParsingThreads=4]]" });
+};
+
 
 // 1 sequence with 2 samples for each of 3 inputs
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_space_separated)
@@ -807,6 +859,127 @@ BOOST_AUTO_TEST_CASE(CompositeCNTKTextFormatReader_5x5_and_5x10_jagged_minibatch
         false);
 };
 
+// same data as above, read from binary containers: the first run converts the text files, the second one maps the containers
+BOOST_AUTO_TEST_CASE(CompositeCNTKTextFormatReader_5x5_and_5x10_jagged_binary)
+{
+    // Using one file with two streams inside to write the output file.
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_Output.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_Output.txt",
+        "5x10_and_5x5_jagged",
+        "reader",
+        40,     // epoch size
+        10,     // mb size
+        3,      // num epochs
+        2,
+        0,
+        0,
+        1,
+        false,
+        false,
+        false);
+
+    const string containers[] = { "5x10_jagged.bin", "5x5_jagged.bin" };
+    for (const auto& container : containers)
+    {
+        boost::filesystem::remove(container);
+    }
+
+    for (int run = 0; run < 2; run++)
+    {
+        HelperRunReaderTest<double>(
+            testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+            testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_Output.txt",
+            testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_binary_Output.txt",
+            "5x10_and_5x5_jagged_binary",
+            "reader",
+            40,     // epoch size
+            10,     // mb size
+            3,      // num epochs
+            2,
+            0,
+            0,
+            1,
+            false,
+            false,
+            false);
+    }
+
+    for (const auto& container : containers)
+    {
+        BOOST_CHECK(boost::filesystem::exists(container));
+    }
+
+    // A corrupt container is reported, rather than read out of bounds. The header still matches the text file,
+    // so the container is used as it is.
+    auto readCorrupted = [&](size_t offset, uint64_t value, size_t valueSize)
+    {
+        std::fstream file(containers[0], std::ios::in | std::ios::out | std::ios::binary);
+        std::vector<char> original(valueSize);
+        file.seekg(offset);
+        file.read(original.data(), valueSize);
+        file.seekp(offset);
+        file.write(reinterpret_cast<const char*>(&value), valueSize);
+        file.close();
+
+        BOOST_REQUIRE_EXCEPTION(
+            HelperRunReaderTest<double>(
+                testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+                testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_Output.txt",
+                testDataPath() + "/Control/CNTKTextFormatReader/5x10_and_5x5_jagged_binary_Output.txt",
+                "5x10_and_5x5_jagged_binary",
+                "reader",
+                40,     // epoch size
+                10,     // mb size
+                1,      // num epochs
+                2,
+                0,
+                0,
+                1,
+                false,
+                false,
+                false),
+            std::runtime_error,
+            [](std::runtime_error const& ex)
+        {
+            return string(ex.what()).find("Binary container '5x10_jagged.bin' is corrupt") == 0;
+        });
+
+        file.open(containers[0], std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offset);
+        file.write(original.data(), valueSize);
+    };
+
+    BinaryContainerHeader header;
+    BinaryChunkRecord chunk;
+    BinarySequenceRecord sequence;
+    {
+        std::ifstream file(containers[0], std::ios::binary);
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        file.seekg(header.m_chunkTableOffset);
+        file.read(reinterpret_cast<char*>(&chunk), sizeof(chunk));
+        file.seekg(header.m_sequenceTableOffset + chunk.m_firstSequence * sizeof(BinarySequenceRecord));
+        file.read(reinterpret_cast<char*>(&sequence), sizeof(sequence));
+        BOOST_REQUIRE(file.good());
+    }
+
+    // sequences beyond the sequence table
+    readCorrupted(header.m_chunkTableOffset + offsetof(BinaryChunkRecord, m_firstSequence), header.m_numberOfSequences, sizeof(uint64_t));
+    // chunk data beyond the end of the file
+    readCorrupted(header.m_chunkTableOffset + offsetof(BinaryChunkRecord, m_byteSize), UINT64_MAX - 1, sizeof(uint64_t));
+    // a sequence outside of its chunk
+    readCorrupted(header.m_sequenceTableOffset + chunk.m_firstSequence * sizeof(BinarySequenceRecord) + offsetof(BinarySequenceRecord, m_offset),
+                  chunk.m_offset + chunk.m_byteSize, sizeof(uint64_t));
+    // a block that is larger than its chunk
+    readCorrupted(sequence.m_offset + offsetof(BinaryBlockHeader, m_numberOfSamples), UINT32_MAX, sizeof(uint32_t));
+
+    for (const auto& container : containers)
+    {
+        boost::filesystem::remove(container);
+    }
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
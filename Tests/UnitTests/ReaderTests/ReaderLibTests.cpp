@@ -9,6 +9,10 @@
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
 #include "CorpusDescriptor.h"
+#include "LengthBucketingEnumerator.h"
+#include "SequencePacker.h"
+#include "HeapMemoryProvider.h"
+#include "Sequences.h"
 
 #include <numeric>
 #include <random>
@@ -356,6 +360,55 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerChaosMonkey)
     BlockRandomizerChaosMonkeyTest(true);
 }
 
+// Reads two epochs with the given prefetch settings, returns the sequence values in order.
+vector<float> BlockRandomizerReadWithPrefetch(size_t numberOfWorkers, size_t workerRank, size_t prefetchDepth, size_t numPrefetchThreads, size_t prefetchBudgetInSamples)
+{
+    vector<float> data(50 * 4);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(50, 4, data);
+
+    auto randomizer = make_shared<BlockRandomizer>(0, 12, mockDeserializer, true, BlockRandomizer::DecimationMode::chunk, false, false,
+                                                   prefetchDepth, numPrefetchThreads, prefetchBudgetInSamples);
+
+    vector<float> actual;
+    for (size_t epoch = 0; epoch < 2; epoch++)
+    {
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = numberOfWorkers;
+        epochConfiguration.m_workerRank = workerRank;
+        epochConfiguration.m_minibatchSizeInSamples = 0;
+        epochConfiguration.m_totalEpochSizeInSamples = data.size();
+        epochConfiguration.m_epochIndex = epoch;
+        randomizer->StartEpoch(epochConfiguration);
+
+        Sequences sequences;
+        do
+        {
+            sequences = randomizer->GetNextSequences(3);
+            for (const auto& sequence : sequences.m_data.empty() ? vector<SequenceDataPtr>() : sequences.m_data.front())
+            {
+                actual.push_back(*((float*)reinterpret_cast<DenseSequenceData&>(*sequence).m_data));
+            }
+        } while (!sequences.m_endOfEpoch);
+    }
+    return actual;
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerPrefetchDepth)
+{
+    for (size_t numberOfWorkers : { 1, 3 })
+    {
+        vector<float> expected = BlockRandomizerReadWithPrefetch(numberOfWorkers, 0, 1, 1, SIZE_MAX);
+        BOOST_CHECK(!expected.empty());
+
+        // Deeper prefetch on several threads, with and without a memory budget, must not change the data.
+        vector<float> actual = BlockRandomizerReadWithPrefetch(numberOfWorkers, 0, 5, 3, SIZE_MAX);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+        actual = BlockRandomizerReadWithPrefetch(numberOfWorkers, 0, 5, 3, 8);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+    }
+}
+
 void BlockRandomizerOneEpochLegacyRandomizationTest(bool prefetch)
 {
     vector<float> data(10);
@@ -440,6 +493,220 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+// Returns sequences of the given lengths in order, whose samples hold the index of the sequence.
+class MockSequenceEnumerator : public SequenceEnumerator
+{
+private:
+    vector<vector<float>> m_sequenceData;
+    vector<StreamDescriptionPtr> m_streams;
+    size_t m_position;
+
+public:
+    size_t m_numMinibatches;
+
+    MockSequenceEnumerator(const vector<size_t>& lengths) : m_position(0), m_numMinibatches(0)
+    {
+        for (size_t i = 0; i < lengths.size(); i++)
+        {
+            m_sequenceData.push_back(vector<float>(lengths[i], (float)i));
+        }
+
+        m_streams.push_back(make_shared<StreamDescription>(StreamDescription{
+            L"input",
+            0,
+            StorageType::dense,
+            ElementType::tfloat,
+            make_shared<TensorShape>(1)
+        }));
+    }
+
+    vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    void StartEpoch(const EpochConfiguration&) override
+    {
+        m_position = 0;
+        m_numMinibatches = 0;
+    }
+
+    Sequences GetNextSequences(size_t sampleCount) override
+    {
+        Sequences result;
+        result.m_endOfEpoch = m_position == m_sequenceData.size();
+        if (result.m_endOfEpoch)
+        {
+            return result;
+        }
+
+        result.m_data.resize(1);
+        size_t numSamples = 0;
+        while (m_position < m_sequenceData.size() &&
+               (result.m_data[0].empty() || numSamples + m_sequenceData[m_position].size() <= sampleCount))
+        {
+            auto data = make_shared<DenseSequenceData>();
+            data->m_data = &m_sequenceData[m_position][0];
+            data->m_numberOfSamples = (uint32_t)m_sequenceData[m_position].size();
+            data->m_sampleLayout = m_streams[0]->m_sampleLayout;
+            result.m_data[0].push_back(data);
+            numSamples += m_sequenceData[m_position++].size();
+        }
+
+        m_numMinibatches++;
+        return result;
+    }
+};
+
+// Number of gap frames of a minibatch with the given sequences.
+size_t NumGapFrames(const vector<SequenceDataPtr>& sequences, bool bestFit)
+{
+    vector<MBLayout::SequenceInfo> infos;
+    for (size_t i = 0; i < sequences.size(); i++)
+    {
+        infos.push_back(MBLayout::SequenceInfo{ i, 0, 0, sequences[i]->m_numberOfSamples });
+    }
+
+    vector<pair<size_t, size_t>> placement;
+    vector<size_t> rowAllocations;
+    MBLayout layout;
+    layout.InitAsPackedSequences(infos, placement, rowAllocations, bestFit);
+    return layout.GetNumCols() - layout.GetActualNumSamples();
+}
+
+BOOST_AUTO_TEST_CASE(LengthBucketingOneEpoch)
+{
+    const size_t minibatchSize = 40;
+    mt19937 rng(7);
+    uniform_int_distribution<size_t> length(1, 20);
+    vector<size_t> lengths(300);
+    for (auto& l : lengths)
+    {
+        l = length(rng);
+    }
+
+    // Reading without bucketing for reference.
+    auto reference = make_shared<MockSequenceEnumerator>(lengths);
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = minibatchSize;
+    epochConfiguration.m_totalEpochSizeInSamples = accumulate(lengths.begin(), lengths.end(), (size_t)0);
+    epochConfiguration.m_epochIndex = 0;
+    reference->StartEpoch(epochConfiguration);
+    size_t referenceGapFrames = 0;
+    for (Sequences sequences; !(sequences = reference->GetNextSequences(minibatchSize)).m_endOfEpoch;)
+    {
+        referenceGapFrames += NumGapFrames(sequences.m_data[0], false);
+    }
+
+    auto provider = make_shared<MockSequenceEnumerator>(lengths);
+    auto bucketing = make_shared<LengthBucketingEnumerator>(provider, 4);
+    for (size_t epoch = 0; epoch < 2; epoch++)
+    {
+        epochConfiguration.m_epochIndex = epoch;
+        bucketing->StartEpoch(epochConfiguration);
+
+        vector<float> actual;
+        size_t numMinibatches = 0;
+        size_t gapFrames = 0;
+        Sequences sequences;
+        do
+        {
+            sequences = bucketing->GetNextSequences(minibatchSize);
+            if (sequences.m_data.empty())
+            {
+                continue;
+            }
+
+            numMinibatches++;
+            for (const auto& sequence : sequences.m_data[0])
+            {
+                actual.push_back(*((float*)reinterpret_cast<DenseSequenceData&>(*sequence).m_data));
+            }
+            gapFrames += NumGapFrames(sequences.m_data[0], true);
+        } while (!sequences.m_endOfEpoch);
+
+        // All sequences are returned once, in no more minibatches than the provider returned, with less padding.
+        vector<float> expected(lengths.size());
+        iota(expected.begin(), expected.end(), 0.0f);
+        BOOST_CHECK(actual != expected);
+        sort(actual.begin(), actual.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+        BOOST_CHECK_LE(numMinibatches, provider->m_numMinibatches);
+        BOOST_CHECK_LT(gapFrames, referenceGapFrames * 2 / 3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerBufferReuse)
+{
+    auto enumerator = make_shared<MockSequenceEnumerator>(vector<size_t>(100, 2));
+    auto packer = make_shared<SequencePacker>(make_shared<HeapMemoryProvider>(), enumerator, enumerator->GetStreamDescriptions());
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 8;
+    epochConfiguration.m_totalEpochSizeInSamples = 200;
+    epochConfiguration.m_epochIndex = 0;
+    packer->StartEpoch(epochConfiguration);
+
+    auto readMinibatch = [&packer]()
+    {
+        Minibatch minibatch = packer->ReadMinibatch();
+        BOOST_REQUIRE_EQUAL(minibatch.m_data.size(), 1);
+        BOOST_REQUIRE(minibatch.m_data[0]->m_dataOwner != nullptr);
+        BOOST_CHECK_EQUAL(minibatch.m_data[0]->m_data, minibatch.m_data[0]->m_dataOwner.get());
+        return minibatch.m_data[0]->m_dataOwner;
+    };
+    auto values = [](const shared_ptr<char>& buffer)
+    {
+        const float* data = reinterpret_cast<const float*>(buffer.get());
+        return vector<float>(data, data + 8);
+    };
+
+    // Minibatches are packed into two alternating buffers.
+    auto first = readMinibatch();
+    const vector<float> firstValues = values(first);
+    auto second = readMinibatch();
+    BOOST_CHECK(first != second);
+
+    // The first buffer is still in use, so the third minibatch goes to a new one, and the first one is left alone.
+    auto third = readMinibatch();
+    BOOST_CHECK(third != first);
+    BOOST_CHECK(third != second);
+    const vector<float> actualFirstValues = values(first);
+    BOOST_CHECK_EQUAL_COLLECTIONS(firstValues.begin(), firstValues.end(), actualFirstValues.begin(), actualFirstValues.end());
+
+    // Once the second buffer is no longer used, it is reused.
+    const char* secondBuffer = second.get();
+    second.reset();
+    auto fourth = readMinibatch();
+    BOOST_CHECK_EQUAL(fourth.get(), secondBuffer);
+}
+
+BOOST_AUTO_TEST_CASE(MBLayoutBestFitPacking)
+{
+    vector<MBLayout::SequenceInfo> infos;
+    size_t lengths[] = { 1, 1, 4, 3, 3 };
+    for (size_t i = 0; i < 5; i++)
+    {
+        infos.push_back(MBLayout::SequenceInfo{ i, 0, 0, lengths[i] });
+    }
+
+    vector<pair<size_t, size_t>> placement;
+    vector<size_t> rowAllocations;
+    MBLayout firstFit;
+    firstFit.InitAsPackedSequences(infos, placement, rowAllocations);
+    BOOST_CHECK_EQUAL(firstFit.GetNumParallelSequences(), 4);
+    BOOST_CHECK_EQUAL(firstFit.GetNumCols() - firstFit.GetActualNumSamples(), 4);
+
+    MBLayout bestFit;
+    bestFit.InitAsPackedSequences(infos, placement, rowAllocations, true);
+    BOOST_CHECK_EQUAL(bestFit.GetNumParallelSequences(), 3);
+    BOOST_CHECK_EQUAL(bestFit.GetNumCols(), bestFit.GetActualNumSamples());
+    BOOST_CHECK_EQUAL(bestFit.GetNumTimeSteps(), 4);
+}
+
 BOOST_AUTO_TEST_CASE(DefaultCorpusDescriptor)
 {
     const int seed = 13;
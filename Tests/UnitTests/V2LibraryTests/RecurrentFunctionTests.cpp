@@ -483,6 +483,283 @@ void TestSimpleRecurrence(size_t inputDim,
     }
 }
 
+// Extract a block of the packed RNNStack weights as a separate Parameter for the composed reference network
+template <typename ElementType>
+Parameter RNNStackWeightsBlock(const std::vector<ElementType>& packedWeights, size_t numPackedRows, size_t firstRow, size_t numRows, size_t firstCol, size_t numCols, const DeviceDescriptor& device)
+{
+    std::vector<ElementType> block(numRows * numCols);
+    for (size_t c = 0; c < numCols; ++c)
+        for (size_t r = 0; r < numRows; ++r)
+            block[(c * numRows) + r] = packedWeights[((firstCol + c) * numPackedRows) + firstRow + r];
+
+    NDShape blockShape = (numCols == 1) ? NDShape({ numRows }) : NDShape({ numRows, numCols });
+    auto blockValue = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), blockShape, device);
+    blockValue->CopyFrom(NDArrayView(blockShape, (const ElementType*)block.data(), block.size(), DeviceDescriptor::CPUDevice()));
+    return Parameter(blockValue);
+}
+
+// One LSTM or GRU layer composed from primitive Functions, using the same weights as layer 'layerIndex' of an RNNStack.
+// The per-gate parameters are appended to 'gateParameters' in the order (Wx, Wh, b) for each gate.
+template <typename ElementType>
+FunctionPtr RNNStackReferenceLayer(Variable input, size_t hiddenDim, bool isLSTM, const std::vector<ElementType>& packedWeights, size_t columnOffset, std::vector<Parameter>& gateParameters, const DeviceDescriptor& device)
+{
+    size_t inputDim = input.Shape()[0];
+    size_t numGates = isLSTM ? 4 : 3;
+    std::vector<Parameter> Wx, Wh, b;
+    for (size_t k = 0; k < numGates; ++k)
+    {
+        Wx.push_back(RNNStackWeightsBlock(packedWeights, numGates * hiddenDim, k * hiddenDim, hiddenDim, columnOffset, inputDim, device));
+        Wh.push_back(RNNStackWeightsBlock(packedWeights, numGates * hiddenDim, k * hiddenDim, hiddenDim, columnOffset + inputDim, hiddenDim, device));
+        b.push_back(RNNStackWeightsBlock(packedWeights, numGates * hiddenDim, k * hiddenDim, hiddenDim, columnOffset + inputDim + hiddenDim, 1, device));
+        gateParameters.insert(gateParameters.end(), { Wx.back(), Wh.back(), b.back() });
+    }
+
+    auto dh = Placeholder({ hiddenDim });
+    if (isLSTM)
+    {
+        auto dc = Placeholder({ hiddenDim });
+        auto gate = [&](size_t k) { return Plus(Plus(Times(Wx[k], input), Times(Wh[k], dh)), b[k]); };
+        auto it = Sigmoid(gate(0));
+        auto ft = Sigmoid(gate(1));
+        auto ot = Sigmoid(gate(2));
+        auto gt = Tanh(gate(3));
+        auto ct = Plus(ElementTimes(ft, dc), ElementTimes(it, gt));
+        auto ht = ElementTimes(ot, Tanh(ct));
+
+        auto actualDh = PastValue(Constant({}, (ElementType)0.0, device), ht, 1);
+        auto actualDc = PastValue(Constant({}, (ElementType)0.0, device), ct, 1);
+        return ht->ReplacePlaceholders({ { dh, actualDh }, { dc, actualDc } });
+    }
+    else
+    {
+        auto rt = Sigmoid(Plus(Plus(Times(Wx[0], input), Times(Wh[0], dh)), b[0]));
+        auto zt = Sigmoid(Plus(Plus(Times(Wx[1], input), Times(Wh[1], dh)), b[1]));
+        auto nt = Tanh(Plus(Plus(Times(Wx[2], input), b[2]), ElementTimes(rt, Times(Wh[2], dh))));
+        auto ht = Plus(nt, ElementTimes(zt, Minus(dh, nt)));
+
+        auto actualDh = PastValue(Constant({}, (ElementType)0.0, device), ht, 1);
+        return ht->ReplacePlaceholders({ { dh, actualDh } });
+    }
+}
+
+// Compare the fused RNNStack Function against the same LSTM/GRU stack composed from primitive Functions
+template <typename ElementType>
+void TestRNNStack(size_t inputDim, size_t hiddenDim, size_t numLayers, const std::wstring& recurrentOp, size_t maxAllowedSequenceLength, size_t numSequences, const DeviceDescriptor& device, unsigned int seed = 1)
+{
+    bool isLSTM = (recurrentOp == L"lstm");
+    size_t numGates = isLSTM ? 4 : 3;
+    size_t numRows = numGates * hiddenDim;
+    size_t numCols = inputDim + hiddenDim + 1 + ((numLayers - 1) * ((2 * hiddenDim) + 1));
+
+    srand(seed);
+    std::vector<ElementType> packedWeights(numRows * numCols);
+    for (auto& w : packedWeights)
+        w = (((ElementType)rand()) / RAND_MAX) - (ElementType)0.5;
+
+    Variable inputVar({ inputDim }, false, AsDataType<ElementType>(), true, L"input");
+    auto weightsValue = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), NDShape({ numRows, numCols }), device);
+    weightsValue->CopyFrom(NDArrayView(NDShape({ numRows, numCols }), (const ElementType*)packedWeights.data(), packedWeights.size(), DeviceDescriptor::CPUDevice()));
+    Parameter weights(weightsValue, L"weights");
+    auto rnnStackFunction = RNNStack(weights, inputVar, hiddenDim, numLayers, recurrentOp, L"rnnStack");
+
+    std::vector<Parameter> gateParameters;
+    FunctionPtr referenceFunction;
+    for (size_t l = 0, columnOffset = 0; l < numLayers; ++l)
+    {
+        referenceFunction = RNNStackReferenceLayer<ElementType>((l == 0) ? inputVar : Variable(referenceFunction), hiddenDim, isLSTM, packedWeights, columnOffset, gateParameters, device);
+        columnOffset += ((l == 0) ? inputDim : hiddenDim) + hiddenDim + 1;
+    }
+
+    // The output of the composed network must not be part of the recurrence itself
+    referenceFunction = Plus(referenceFunction, Constant({ hiddenDim }, (ElementType)0.0, device));
+
+    std::vector<size_t> sequenceLengths(numSequences);
+    size_t maxActualSequenceLength = 0;
+    std::vector<std::vector<ElementType>> inputSequences;
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        sequenceLengths[i] = (rand() % maxAllowedSequenceLength) + 1;
+        maxActualSequenceLength = std::max(maxActualSequenceLength, sequenceLengths[i]);
+
+        std::vector<ElementType> currentSequence(inputDim * sequenceLengths[i]);
+        for (auto& x : currentSequence)
+            x = ((ElementType)rand()) / RAND_MAX;
+        inputSequences.push_back(std::move(currentSequence));
+    }
+    ValuePtr inputValue = Value::Create({ inputDim }, inputSequences, device, true);
+
+    NDShape outputShape = NDShape({ hiddenDim }).AppendShape({ maxActualSequenceLength, numSequences });
+    std::vector<ElementType> rootGradientsData(outputShape.TotalSize());
+    for (auto& g : rootGradientsData)
+        g = (((ElementType)rand()) / RAND_MAX) - (ElementType)0.5;
+    ValuePtr rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(outputShape, rootGradientsData.data(), rootGradientsData.size(), DeviceDescriptor::CPUDevice(), true), inputValue->Mask()->DeepClone());
+
+    // run forward and backward through both networks
+    auto forwardBackward = [&](const FunctionPtr& function, std::unordered_map<Variable, ValuePtr>& gradients) {
+        Variable output = function->Output();
+        std::unordered_map<Variable, ValuePtr> outputs = { { output, nullptr } };
+        auto backpropState = function->Forward({ { inputVar, inputValue } }, outputs, device, { output });
+        function->Backward(backpropState, { { output, rootGradientValue } }, gradients);
+        return outputs[output];
+    };
+
+    std::unordered_map<Variable, ValuePtr> rnnStackGradients = { { inputVar, nullptr }, { weights, nullptr } };
+    auto rnnStackOutput = forwardBackward(rnnStackFunction, rnnStackGradients);
+
+    std::unordered_map<Variable, ValuePtr> referenceGradients = { { inputVar, nullptr } };
+    for (auto& parameter : gateParameters)
+        referenceGradients[parameter] = nullptr;
+    auto referenceOutput = forwardBackward(referenceFunction, referenceGradients);
+
+    // only compare valid frames; gaps are undefined in the composed network
+    auto validFrames = [&](const ValuePtr& value, size_t dim) {
+        const ElementType* data = value->Data()->DataBuffer<ElementType>();
+        std::vector<ElementType> result;
+        for (size_t i = 0; i < numSequences; ++i)
+            result.insert(result.end(), data + (i * maxActualSequenceLength * dim), data + (((i * maxActualSequenceLength) + sequenceLengths[i]) * dim));
+        return result;
+    };
+
+    FloatingPointVectorCompare(validFrames(rnnStackOutput, hiddenDim), validFrames(referenceOutput, hiddenDim), "TestRNNStack: Forward prop results do not match the composed reference");
+    FloatingPointVectorCompare(validFrames(rnnStackGradients[inputVar], inputDim), validFrames(referenceGradients[inputVar], inputDim), "TestRNNStack: Backprop results for the input do not match the composed reference");
+
+    // scatter the reference gate parameter gradients back into the packed layout
+    std::vector<ElementType> expectedWeightsGradient(numRows * numCols);
+    size_t parameterIndex = 0;
+    for (size_t l = 0, columnOffset = 0; l < numLayers; ++l)
+    {
+        size_t layerInputDim = (l == 0) ? inputDim : hiddenDim;
+        for (size_t k = 0; k < numGates; ++k)
+        {
+            size_t firstCols[] = { columnOffset, columnOffset + layerInputDim, columnOffset + layerInputDim + hiddenDim };
+            for (size_t firstCol : firstCols)
+            {
+                auto& parameter = gateParameters[parameterIndex++];
+                const ElementType* gradient = referenceGradients[parameter]->Data()->DataBuffer<ElementType>();
+                size_t blockCols = parameter.Shape().TotalSize() / hiddenDim;
+                for (size_t c = 0; c < blockCols; ++c)
+                    for (size_t r = 0; r < hiddenDim; ++r)
+                        expectedWeightsGradient[((firstCol + c) * numRows) + (k * hiddenDim) + r] = gradient[(c * hiddenDim) + r];
+            }
+        }
+        columnOffset += layerInputDim + hiddenDim + 1;
+    }
+
+    const ElementType* weightsGradient = rnnStackGradients[weights]->Data()->DataBuffer<ElementType>();
+    FloatingPointVectorCompare(std::vector<ElementType>(weightsGradient, weightsGradient + expectedWeightsGradient.size()), expectedWeightsGradient, "TestRNNStack: Backprop results for the weights do not match the composed reference");
+}
+
+// Decodes with a small recurrent decoder, and compares the result with searches that recompute the whole prefix for every step
+template <typename ElementType>
+void TestBeamSearchDecode(size_t vocabSize, size_t hiddenDim, size_t contextDim, size_t numSequences, bool useSparseToken, const DeviceDescriptor& device, unsigned int seed = 1)
+{
+    const size_t startSymbol = 0;
+    const size_t endSymbol = vocabSize - 1;
+
+    Variable tokenVar({ vocabSize }, useSparseToken, AsDataType<ElementType>(), false, L"previousToken");
+    Variable contextVar({ contextDim }, false, AsDataType<ElementType>(), false, L"context");
+    auto W = Parameter(NDArrayView::RandomUniform<ElementType>({ hiddenDim, vocabSize }, -1.0, 1.0, seed++, device));
+    auto U = Parameter(NDArrayView::RandomUniform<ElementType>({ hiddenDim, hiddenDim }, -1.0, 1.0, seed++, device));
+    auto Wc = Parameter(NDArrayView::RandomUniform<ElementType>({ hiddenDim, contextDim }, -1.0, 1.0, seed++, device));
+    auto Wo = Parameter(NDArrayView::RandomUniform<ElementType>({ vocabSize, hiddenDim }, -2.0, 2.0, seed++, device));
+    auto bo = Parameter(NDArrayView::RandomUniform<ElementType>({ vocabSize }, -1.0, 1.0, seed++, device));
+
+    auto placeholder = Placeholder({ hiddenDim });
+    auto hidden = Tanh(Plus(Plus(Times(W, tokenVar), Times(U, placeholder)), Times(Wc, contextVar)));
+    hidden = hidden->ReplacePlaceholders({ { placeholder, PastValue(Constant({}, (ElementType)0.0, device), hidden, 1) } });
+    auto decoder = Plus(Times(Wo, hidden), bo, L"scores");
+    Variable scores = decoder->Output();
+
+    // context sequences of different lengths; only their last steps matter
+    srand(seed);
+    std::vector<std::vector<ElementType>> contextSequences;
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        std::vector<ElementType> sequence(contextDim * ((i % 3) + 1));
+        for (auto& x : sequence)
+            x = (((ElementType)rand()) / RAND_MAX) * 2 - 1;
+        contextSequences.push_back(std::move(sequence));
+    }
+    ValuePtr contextValue = Value::Create({ contextDim }, contextSequences, device, true);
+
+    // log probabilities of the token after 'prefix' (which starts with the start symbol), computed from scratch
+    auto nextLogProbabilities = [&](size_t i, const std::vector<size_t>& prefix) {
+        const auto& contextSequence = contextSequences[i];
+        std::vector<ElementType> contexts;
+        for (size_t t = 0; t < prefix.size(); ++t)
+            contexts.insert(contexts.end(), contextSequence.end() - contextDim, contextSequence.end());
+        ValuePtr tokenValue;
+        if (useSparseToken)
+            tokenValue = Value::Create<ElementType>({ vocabSize }, std::vector<std::vector<size_t>>({ prefix }), device, true);
+        else
+        {
+            std::vector<ElementType> oneHot(vocabSize * prefix.size(), 0);
+            for (size_t t = 0; t < prefix.size(); ++t)
+                oneHot[t * vocabSize + prefix[t]] = 1;
+            tokenValue = Value::Create({ vocabSize }, std::vector<std::vector<ElementType>>({ oneHot }), device, true);
+        }
+        std::unordered_map<Variable, ValuePtr> outputs = { { scores, nullptr } };
+        decoder->Forward({ { tokenVar, tokenValue }, { contextVar, Value::Create({ contextDim }, std::vector<std::vector<ElementType>>({ contexts }), device, true) } }, outputs, device);
+        const ElementType* z = outputs[scores]->Data()->DataBuffer<ElementType>() + (prefix.size() - 1) * vocabSize;
+        double maxZ = *std::max_element(z, z + vocabSize);
+        double sum = 0;
+        for (size_t k = 0; k < vocabSize; ++k)
+            sum += exp(z[k] - maxZ);
+        std::vector<double> logProbabilities(vocabSize);
+        for (size_t k = 0; k < vocabSize; ++k)
+            logProbabilities[k] = z[k] - maxZ - log(sum);
+        return logProbabilities;
+    };
+
+    // a wide enough beam finds the most probable sequence
+    const size_t maxLength = 4;
+    auto beamSearchResult = BeamSearchDecode<ElementType>(decoder, scores, tokenVar, { { contextVar, contextValue } }, 64, 0, startSymbol, endSymbol, maxLength, device);
+    if (beamSearchResult.size() != numSequences)
+        throw std::runtime_error("TestBeamSearchDecode: Expected one result per context sequence");
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        double bestLogProbability = -std::numeric_limits<double>::infinity();
+        std::vector<size_t> bestTokens;
+        std::function<void(std::vector<size_t>&, double)> search = [&](std::vector<size_t>& prefix, double logProbability) {
+            auto next = nextLogProbabilities(i, prefix);
+            for (size_t k = 0; k < vocabSize; ++k)
+            {
+                prefix.push_back(k);
+                if (k == endSymbol || prefix.size() - 1 == maxLength)
+                {
+                    if (logProbability + next[k] > bestLogProbability)
+                    {
+                        bestLogProbability = logProbability + next[k];
+                        bestTokens.assign(prefix.begin() + 1, prefix.end());
+                    }
+                }
+                else
+                    search(prefix, logProbability + next[k]);
+                prefix.pop_back();
+            }
+        };
+        std::vector<size_t> prefix = { startSymbol };
+        search(prefix, 0);
+        if (beamSearchResult[i] != bestTokens)
+            throw std::runtime_error("TestBeamSearchDecode: Beam search did not find the most probable sequence");
+    }
+
+    // a beam of one is greedy decoding
+    const size_t greedyMaxLength = 8;
+    beamSearchResult = BeamSearchDecode<ElementType>(decoder, scores, tokenVar, { { contextVar, contextValue } }, 1, 0.7, startSymbol, endSymbol, greedyMaxLength, device);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        std::vector<size_t> prefix = { startSymbol };
+        while (prefix.back() != endSymbol && prefix.size() - 1 < greedyMaxLength)
+        {
+            auto next = nextLogProbabilities(i, prefix);
+            prefix.push_back(std::max_element(next.begin(), next.end()) - next.begin());
+        }
+        if (beamSearchResult[i] != std::vector<size_t>(prefix.begin() + 1, prefix.end()))
+            throw std::runtime_error("TestBeamSearchDecode: Beam search with a beam of one does not match greedy decoding");
+    }
+}
+
 void RecurrentFunctionTests()
 {
     TestSimpleRecurrence<float>(2, 1, 4, 1, DeviceDescriptor::CPUDevice(), true, 3, false, false);
@@ -500,4 +777,11 @@ void RecurrentFunctionTests()
     TestRecurrentNetworkCreation<float>(DeviceDescriptor::GPUDevice(0), true);
 #endif
     TestRecurrentNetworkCreation<double>(DeviceDescriptor::CPUDevice(), false);
+
+    TestRNNStack<double>(5, 7, 1, L"lstm", 9, 4, DeviceDescriptor::CPUDevice());
+    TestRNNStack<double>(5, 7, 2, L"gru", 9, 4, DeviceDescriptor::CPUDevice());
+    TestRNNStack<float>(13, 16, 3, L"lstm", 6, 3, DeviceDescriptor::CPUDevice(), 2);
+
+    TestBeamSearchDecode<float>(4, 8, 3, 5, true, DeviceDescriptor::CPUDevice());
+    TestBeamSearchDecode<double>(4, 6, 2, 3, false, DeviceDescriptor::CPUDevice(), 3);
 }